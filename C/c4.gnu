@@ -29,6 +29,7 @@ CBL {
 
 		c4db_open;
 		c4db_openNamed;
+		c4db_openNamedWithTuning;
 		c4db_close;
 		c4db_copy;
 		c4db_delete;
@@ -70,6 +71,7 @@ CBL {
 		c4doc_selectNextLeafRevision;
 		c4doc_selectCommonAncestorRevision;
 		c4doc_put;
+		c4db_putDocs;
 		c4doc_create;
 		c4doc_update;
 		c4doc_resolveConflict;
@@ -86,7 +88,9 @@ CBL {
 
 		c4db_enumerateChanges;
 		c4db_enumerateAllDocs;
+		c4db_enumerateDocIDRange;
 		c4db_createIndex;
+		c4db_createDeferredIndex;
 		c4db_deleteIndex;
 		c4db_getIndexes;
 		c4enum_next;
@@ -109,6 +113,7 @@ CBL {
 		c4query_columnTitle;
 		c4query_run;
 		c4query_explain;
+		c4db_getQueryCacheStats;
 
 		c4blob_keyFromString;
 		c4blob_keyToString;
@@ -146,6 +151,8 @@ CBL {
 		c4repl_start;
 		c4repl_stop;
 		c4repl_getStatus;
+		c4repl_getFlowControl;
+		c4repl_getBlobStats;
 		c4repl_retry;
 		c4repl_getPendingDocIDs;
 		c4repl_isDocumentPending;
@@ -309,6 +316,7 @@ CBL {
 		c4db_deleteNamed;
 		c4db_openAgain;
 		c4db_openNamed;
+		c4db_openNamedWithTuning;
 		c4db_createFleeceEncoder;
 		c4db_lock;
 		c4db_unlock;
@@ -340,6 +348,8 @@ CBL {
 		c4doc_getSelectedRevIDGlobalForm;
 
 		c4db_getIndexesInfo;
+		c4db_getIndexedSequence;
+		c4db_updateIndexes;
 
 		c4error_getBacktrace;
 		c4error_getCaptureBacktraces;
@@ -358,6 +368,10 @@ CBL {
 		c4queryobs_free;
 
 		c4blob_computeKey;
+		c4blob_isChunkedStore;
+		c4blob_getChunkList;
+		c4blob_hasChunk;
+		c4blob_getChunk;
 		c4blob_freeStore;
 
 		c4stream_bytesWritten;
@@ -375,6 +389,7 @@ CBL {
 		c4error_return;
 		c4db_markSynced;
 		c4_dumpInstances;
+		c4_getActorStats;
 		gC4ExpectExceptions;
 
 		FLDoc_FromJSON;
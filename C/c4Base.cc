@@ -21,6 +21,7 @@
 #include "c4Socket.h"
 
 #include "Actor.hh"
+#include "ActorStats.hh"
 #include "Backtrace.hh"
 #include "FilePath.hh"
 #include "Logging.hh"
@@ -28,6 +29,7 @@
 
 #include "WebSocketInterface.hh"    // For websocket::WSLogDomain
 #include "InstanceCounted.hh"
+#include "fleece/Fleece.hh"
 #include "sqlite3.h"
 #include "repo_version.h"    // Generated by get_repo_version.sh at build time
 #include <cctype>
@@ -296,6 +298,19 @@ int c4_getObjectCount() noexcept {
     return fleece::InstanceCounted::count();
 }
 
+
+C4StringResult c4_getActorStats(void) C4API {
+    try {
+        fleece::JSONEncoder enc;
+        enc.beginArray();
+        for (auto &stats : actor::MailboxStats::snapshotAll())
+            stats.writeTo(enc);
+        enc.endArray();
+        return C4StringResult(enc.finish());
+    } catchExceptions()
+    return {};
+}
+
 // LCOV_EXCL_START
 void c4_dumpInstances(void) C4API {
 #if INSTANCECOUNTED_TRACK
@@ -20,6 +20,9 @@
 #include "c4BlobStore.h"
 #include "c4Database.hh"
 #include "BlobStore.hh"
+#include "c4Private.h"
+#include "Delimiter.hh"
+#include <sstream>
 using namespace std;
 
 
@@ -68,6 +71,7 @@ C4BlobStore* c4blob_openStore(C4Slice dirPath,
         BlobStore::Options options = {};
         options.create = (flags & kC4DB_Create) != 0;
         options.writeable = !(flags & kC4DB_ReadOnly);
+        options.chunked = (flags & kC4DB_ChunkedBlobs) != 0;
         if (key) {
             options.encryptionAlgorithm = (EncryptionAlgorithm)key->algorithm;
             options.encryptionKey = alloc_slice(key->bytes, sizeof(key->bytes));
@@ -119,9 +123,12 @@ C4SliceResult c4blob_getContents(C4BlobStore* store, C4BlobKey key, C4Error* out
 
 C4StringResult c4blob_getFilePath(C4BlobStore* store, C4BlobKey key, C4Error* outError) noexcept {
     try {
-        auto path = store->get(asInternal(key)).path();
+        auto blob = store->get(asInternal(key));
+        auto path = blob.path();
         if (!path.exists()) {
-            c4error_return(LiteCoreDomain, kC4ErrorNotFound, {}, outError);
+            // (A blob stored in chunks has no single file.)
+            c4error_return(LiteCoreDomain, blob.isChunked() ? kC4ErrorUnsupported : kC4ErrorNotFound,
+                           {}, outError);
             return {nullptr, 0};
         } else if (store->isEncrypted()) {
             c4error_return(LiteCoreDomain, kC4ErrorWrongFormat, {}, outError);
@@ -133,6 +140,41 @@ C4StringResult c4blob_getFilePath(C4BlobStore* store, C4BlobKey key, C4Error* ou
 }
 
 
+bool c4blob_isChunkedStore(C4BlobStore* store) noexcept {
+    return store->isChunked();
+}
+
+
+C4SliceResult c4blob_getChunkList(C4BlobStore* store, C4BlobKey key, C4Error* outError) noexcept {
+    try {
+        stringstream json;
+        json << '[';
+        delimiter delim(",");
+        for (auto &chunk : store->get(asInternal(key)).chunks())
+            json << delim << "[\"" << chunk.key.base64String() << "\"," << chunk.length << ']';
+        json << ']';
+        return sliceResult(json.str());
+    } catchError(outError)
+    return {nullptr, 0};
+}
+
+
+bool c4blob_hasChunk(C4BlobStore* store, C4BlobKey chunkKey) noexcept {
+    try {
+        return store->hasChunk(asInternal(chunkKey));
+    } catchExceptions()
+    return false;
+}
+
+
+C4SliceResult c4blob_getChunk(C4BlobStore* store, C4BlobKey chunkKey, C4Error* outError) noexcept {
+    try {
+        return C4SliceResult(store->readChunk(asInternal(chunkKey)));
+    } catchError(outError)
+    return {nullptr, 0};
+}
+
+
 C4BlobKey c4blob_computeKey(C4Slice contents) {
     return external(blobKey::computeFrom(contents));
 }
@@ -156,7 +198,7 @@ bool c4blob_create(C4BlobStore* store,
 
 bool c4blob_delete(C4BlobStore* store, C4BlobKey key, C4Error* outError) noexcept {
     try {
-        store->get(asInternal(key)).del();
+        store->deleteBlob(asInternal(key));
         return true;
     } catchError(outError)
     return false;
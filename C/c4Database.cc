@@ -116,13 +116,22 @@ C4Database* c4db_open(C4Slice path,
 C4Database* c4db_openNamed(C4String name,
                            const C4DatabaseConfig2 *config,
                            C4Error *outError) C4API
+{
+    return c4db_openNamedWithTuning(name, config, nullptr, outError);
+}
+
+
+C4Database* c4db_openNamedWithTuning(C4String name,
+                                     const C4DatabaseConfig2 *config,
+                                     const C4StorageTuning *tuning,
+                                     C4Error *outError) C4API
 {
     return tryCatch<C4Database*>(outError, [=]() -> C4Database* {
         if (!ensureConfigDirExists(config, outError))
             return nullptr;
         FilePath path = dbPath(name, config->parentDirectory);
         C4DatabaseConfig oldConfig = newToOldConfig(config);
-        return retain(new C4Database(path, oldConfig));
+        return retain(new C4Database(path, oldConfig, tuning ? *tuning : C4StorageTuning{}));
     });
 }
 
@@ -130,7 +139,8 @@ C4Database* c4db_openNamed(C4String name,
 C4Database* c4db_openAgain(C4Database* db,
                            C4Error *outError) noexcept
 {
-    return c4db_openNamed(c4db_getName(db), c4db_getConfig2(db), outError);
+    return c4db_openNamedWithTuning(c4db_getName(db), c4db_getConfig2(db),
+                                    db->storageTuning(), outError);
 }
 
 
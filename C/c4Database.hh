@@ -23,8 +23,9 @@
 
 // This is the struct that's forward-declared in the public c4Database.h
 struct C4Database : public c4Internal::Database {
-    C4Database(const FilePath &path, C4DatabaseConfig config)
-    :Database(path, config) { }
+    C4Database(const FilePath &path, C4DatabaseConfig config,
+               const C4StorageTuning &tuning = {})
+    :Database(path, config, tuning) { }
 
     C4ExtraInfo extraInfo { };
 
@@ -47,14 +47,16 @@ struct C4DocEnumerator : public RecordEnumerator, public fleece::InstanceCounted
     { }
 
     C4DocEnumerator(C4Database *database,
-                    const C4EnumeratorOptions &options)
-    :RecordEnumerator(database->defaultKeyStore(), recordOptions(database, options))
+                    const C4EnumeratorOptions &options,
+                    const C4DocIDRange *range =nullptr)
+    :RecordEnumerator(database->defaultKeyStore(), recordOptions(database, options, range))
     ,_database(database)
     ,_options(options)
     { }
 
     static RecordEnumerator::Options recordOptions(C4Database *database,
-                                                   const C4EnumeratorOptions &c4options)
+                                                   const C4EnumeratorOptions &c4options,
+                                                   const C4DocIDRange *range =nullptr)
     {
         RecordEnumerator::Options options;
         if (c4options.flags & kC4Descending)
@@ -67,6 +69,15 @@ struct C4DocEnumerator : public RecordEnumerator, public fleece::InstanceCounted
             options.contentOption = kMetaOnly;
         else
             options.contentOption = kEntireBody;
+        if (range) {
+            options.minKey = range->minDocID;
+            options.maxKey = range->maxDocID;
+            options.minKeyInclusive = !range->excludeMinDocID;
+            options.maxKeyInclusive = !range->excludeMaxDocID;
+            options.keyPrefix = range->docIDPrefix;
+            if (range->limit > 0)
+                options.limit = range->limit;
+        }
         return options;
     }
 
@@ -136,6 +147,19 @@ C4DocEnumerator* c4db_enumerateAllDocs(C4Database *database,
 }
 
 
+C4DocEnumerator* c4db_enumerateDocIDRange(C4Database *database,
+                                          const C4DocIDRange *range,
+                                          const C4EnumeratorOptions *c4options,
+                                          C4Error *outError) noexcept
+{
+    return tryCatch<C4DocEnumerator*>(outError, [&]{
+        return new C4DocEnumerator(database,
+                                   c4options ? *c4options : kC4DefaultEnumeratorOptions,
+                                   range);
+    });
+}
+
+
 bool c4enum_next(C4DocEnumerator *e, C4Error *outError) noexcept {
     return tryCatch<bool>(outError, [&]{
         if (e->next())
@@ -33,6 +33,7 @@
 #include "RevTree.hh"   // only for kDefaultRemoteID
 #include "SecureRandomize.hh"
 #include "FleeceImpl.hh"
+#include <unordered_set>
 
 using namespace fleece::impl;
 using namespace std;
@@ -528,6 +529,97 @@ C4Document* c4doc_put(C4Database *database,
 }
 
 
+int64_t c4db_putDocs(C4Database *database,
+                     const C4DocPutRequest requests[],
+                     size_t count,
+                     C4Document* outDocs[],
+                     C4Error outErrors[],
+                     C4Error *outError) noexcept
+{
+    if (!database->mustBeInTransaction(outError))
+        return -1;
+    for (size_t i = 0; i < count; ++i) {
+        if (!checkParam(requests[i].save, "c4db_putDocs requires every request to be saved",
+                        outError))
+            return -1;
+    }
+
+    vector<C4Document*> docs(count, nullptr);
+    vector<C4Error> errors(count, C4Error{});
+    try {
+        // Find out which of the new docs' IDs already exist, with a single query:
+        KeyStore &store = database->defaultKeyStore();
+        vector<slice> newDocIDs;
+        for (size_t i = 0; i < count; ++i) {
+            if (requests[i].docID.buf && isNewDocPutRequest(database, &requests[i]))
+                newDocIDs.push_back(requests[i].docID);
+        }
+        unordered_set<slice> existingDocIDs;
+        if (!newDocIDs.empty()) {
+            vector<Record> found = store.getMany(newDocIDs, kMetaOnly);
+            for (size_t i = 0; i < newDocIDs.size(); ++i) {
+                if (found[i].exists())
+                    existingDocIDs.insert(newDocIDs[i]);
+            }
+        }
+
+        // A request can be written as part of a batch if it creates a doc that doesn't exist,
+        // and no earlier request in this call has touched the same docID:
+        unordered_set<slice> touchedDocIDs;
+        auto batchable = [&](const C4DocPutRequest &rq) {
+            if (!isNewDocPutRequest(database, &rq))
+                return false;
+            return !rq.docID.buf || (existingDocIDs.count(rq.docID) == 0
+                                     && touchedDocIDs.count(rq.docID) == 0);
+        };
+
+        // Apply the requests in order. Each run of consecutive batchable requests is written
+        // with a few multi-row INSERTs; the others are saved one at a time:
+        for (size_t i = 0; i < count; ) {
+            size_t end = i;
+            while (end < count && batchable(requests[end])) {
+                if (requests[end].docID.buf)
+                    touchedDocIDs.insert(requests[end].docID);
+                ++end;
+            }
+            if (end - i > 1) {
+                // If the batch fails to flush, its rows are rolled back but the sequences and
+                // change notifications of its docs aren't; so the whole call fails, and the
+                // caller has to abort the transaction.
+                KeyStore::InsertBatch batch(store, database->transaction());
+                for (size_t j = i; j < end; ++j)
+                    docs[j] = c4doc_put(database, &requests[j], nullptr, &errors[j]);
+                batch.flush();
+                i = end;
+            } else {
+                if (requests[i].docID.buf)
+                    touchedDocIDs.insert(requests[i].docID);
+                docs[i] = c4doc_put(database, &requests[i], nullptr, &errors[i]);
+                ++i;
+            }
+        }
+    } catch (...) {
+        c4Internal::recordException(outError);
+        for (C4Document *doc : docs)
+            c4doc_release(doc);
+        return -1;
+    }
+
+    int64_t succeeded = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (docs[i])
+            ++succeeded;
+        if (outDocs)
+            outDocs[i] = docs[i];
+        else
+            c4doc_release(docs[i]);
+        if (outErrors)
+            outErrors[i] = docs[i] ? C4Error{} : errors[i];
+    }
+    return succeeded;
+}
+
+
 C4Document* c4doc_create(C4Database *db,
                          C4String docID,
                          C4Slice revBody,
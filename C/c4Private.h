@@ -88,6 +88,21 @@ bool c4db_markSynced(C4Database *database,
                      C4Error* C4NULLABLE outError) C4API;
 
 
+/** Returns true if the store saves new blobs as deduplicated chunks (see kC4DB_ChunkedBlobs.) */
+bool c4blob_isChunkedStore(C4BlobStore*) C4API;
+
+/** Returns the chunks of a blob stored in chunks, as a JSON array with a `[digest, length]`
+    array for each chunk, the digest being in the same form as a blob key string. Fails with
+    kC4ErrorNotFound if the blob doesn't exist or isn't stored in chunks. */
+C4SliceResult c4blob_getChunkList(C4BlobStore*, C4BlobKey, C4Error* C4NULLABLE) C4API;
+
+/** Returns true if the store has a chunk, given the digest of its data. */
+bool c4blob_hasChunk(C4BlobStore*, C4BlobKey chunkKey) C4API;
+
+/** Returns the data of a chunk, given its digest. */
+C4SliceResult c4blob_getChunk(C4BlobStore*, C4BlobKey chunkKey, C4Error* C4NULLABLE) C4API;
+
+
 /** Flags produced by \ref c4db_findDocAncestors, the result of comparing a local document's
     revision(s) against the requested revID. */
 typedef C4_OPTIONS(uint8_t, C4FindDocAncestorsResultFlags) {
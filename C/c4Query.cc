@@ -37,6 +37,18 @@ using namespace fleece::impl;
 CBL_CORE_API const C4QueryOptions kC4DefaultQueryOptions = { };
 
 
+// Brings deferred-update indexes up to date: each batch of rows is computed outside a
+// transaction, then saved in a short one.
+static void updateDeferredIndexes(Database *database) {
+    KeyStore &store = database->defaultKeyStore();
+    while (auto update = store.prepareDeferredIndexUpdate(1000)) {
+        Database::TransactionHelper t(database);
+        store.applyDeferredIndexUpdate(*update);
+        t.commit();
+    }
+}
+
+
 #pragma mark - QUERY API:
 
 
@@ -65,6 +77,17 @@ C4Query* c4query_new(C4Database *database, C4String expression, C4Error *error)
 }
 
 
+C4QueryCacheStats c4db_getQueryCacheStats(C4Database *database) noexcept {
+    try {
+        if (auto dataFile = dynamic_cast<SQLiteDataFile*>(database->dataFile())) {
+            auto stats = dataFile->queryCache().stats();
+            return {stats.hits, stats.misses, uint32_t(stats.count)};
+        }
+    } catchExceptions()
+    return {};
+}
+
+
 unsigned c4query_columnCount(C4Query *query) noexcept {
     return query->query()->columnCount();
 }
@@ -89,6 +112,8 @@ C4QueryEnumerator* c4query_run(C4Query *query,
                                C4Error *outError) noexcept
 {
     return tryCatch<C4QueryEnumerator*>(outError, [&]{
+        if (c4options && c4options->waitForIndexes)
+            updateDeferredIndexes(query->database());
         return retain(query->createEnumerator(c4options, encodedParameters));
     });
 }
@@ -206,6 +231,28 @@ C4QueryEnumerator* c4queryobs_getEnumerator(C4QueryObserver *obs,
 #pragma mark - INDEXES:
 
 
+static bool createIndex(C4Database *database,
+                        C4Slice name,
+                        C4Slice indexSpecJSON,
+                        C4IndexType indexType,
+                        const C4IndexOptions *indexOptions,
+                        bool deferUpdates,
+                        C4Error *outError) noexcept
+{
+    return tryCatch(outError, [&]{
+        IndexSpec::Options options {nullptr, true, false, nullptr, deferUpdates};
+        if (indexOptions) {
+            options.language = indexOptions->language;
+            options.ignoreDiacritics = indexOptions->ignoreDiacritics;
+            options.disableStemming = indexOptions->disableStemming;
+            options.stopWords = indexOptions->stopWords;
+        }
+        database->createIndex(slice(name), indexSpecJSON, (IndexSpec::Type)indexType,
+                              (indexOptions || deferUpdates) ? &options : nullptr);
+    });
+}
+
+
 bool c4db_createIndex(C4Database *database,
                       C4Slice name,
                       C4Slice indexSpecJSON,
@@ -213,14 +260,18 @@ bool c4db_createIndex(C4Database *database,
                       const C4IndexOptions *indexOptions,
                       C4Error *outError) noexcept
 {
-    static_assert(sizeof(C4IndexOptions) == sizeof(IndexSpec::Options),
-                  "IndexSpec::Options types must match");
-    return tryCatch(outError, [&]{
-        database->defaultKeyStore().createIndex(slice(name),
-                                                indexSpecJSON,
-                                                (IndexSpec::Type)indexType,
-                                                (const IndexSpec::Options*)indexOptions);
-    });
+    return createIndex(database, name, indexSpecJSON, indexType, indexOptions, false, outError);
+}
+
+
+bool c4db_createDeferredIndex(C4Database *database,
+                              C4Slice name,
+                              C4Slice indexSpecJSON,
+                              C4IndexType indexType,
+                              const C4IndexOptions *indexOptions,
+                              C4Error *outError) noexcept
+{
+    return createIndex(database, name, indexSpecJSON, indexType, indexOptions, true, outError);
 }
 
 
@@ -263,6 +314,20 @@ C4SliceResult c4db_getIndexesInfo(C4Database* database, C4Error* outError) noexc
 }
 
 
+C4SequenceNumber c4db_getIndexedSequence(C4Database* database, C4Error* outError) noexcept {
+    return tryCatch<C4SequenceNumber>(outError, [&]{
+        return database->defaultKeyStore().indexedSequence();
+    });
+}
+
+
+bool c4db_updateIndexes(C4Database* database, C4Error* outError) noexcept {
+    return tryCatch(outError, [&]{
+        updateDeferredIndexes(database);
+    });
+}
+
+
 C4SliceResult c4db_getIndexRows(C4Database* database, C4String indexName, C4Error* outError) noexcept {
     return tryCatch<C4SliceResult>(outError, [&]{
         int64_t rowCount;
@@ -181,6 +181,14 @@ int c4_getObjectCount(void) C4API;
 
 void c4_dumpInstances(void) C4API;
 
+/** Returns runtime statistics of all live Actors (the internal objects that run the
+    replicator, the BLIP protocol, etc.) as a JSON array. Each item is an object with keys
+    `name`, `enqueued`, `handled`, `queue_depth`, `max_queue_depth`, `latency_p50`,
+    `latency_p99`, `busy_time` and `lifetime`; times are in seconds.
+    This is a diagnostic tool; the result must be freed by the caller. Returns a null slice
+    if the stats could not be collected. */
+C4StringResult c4_getActorStats(void) C4API;
+
 
 /** @} */
 
@@ -111,7 +111,8 @@ extern "C" {
                        C4BlobKey *outKey,
                        C4Error* C4NULLABLE error) C4API;
 
-    /** Deletes a blob from the store given its key. */
+    /** Deletes a blob from the store given its key. In a chunked store, also deletes the chunks
+        that no other blob uses. */
     bool c4blob_delete(C4BlobStore*, C4BlobKey, C4Error* C4NULLABLE) C4API;
 
     /** @} */
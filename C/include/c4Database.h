@@ -44,6 +44,7 @@ extern "C" {
         kC4DB_VersionVectors= 0x08, ///< Upgrade DB to version vectors instead of rev trees [EXPERIMENTAL]
         kC4DB_NoUpgrade     = 0x20, ///< Disable upgrading an older-version database
         kC4DB_NonObservable = 0x40, ///< Disable C4DatabaseObserver, for slightly faster writes
+        kC4DB_ChunkedBlobs  = 0x80, ///< Store blobs as deduplicated chunks [EXPERIMENTAL]
     };
 
     /** Encryption algorithms. */
@@ -63,6 +64,24 @@ extern "C" {
         uint8_t bytes[32];
     } C4EncryptionKey;
 
+    /** Storage tuning presets, for C4StorageTuning. */
+    typedef C4_ENUM(uint32_t, C4StorageProfile) {
+        kC4StorageBalanced = 0,     ///< Default; suits typical mobile & desktop apps
+        kC4StorageEmbedded,         ///< Minimizes memory use, for constrained devices
+        kC4StorageServer,           ///< Uses lots of RAM for caching, for very large databases
+    };  // *NOTE:* These enum values must match the ones in DataFile::Tuning::Profile
+
+    /** Storage-engine tuning, given to c4db_openNamedWithTuning. Each zero-valued field takes its
+        value from the profile; nonzero fields override it. An all-zero struct is the default. */
+    typedef struct C4StorageTuning {
+        C4StorageProfile profile;       ///< Preset providing defaults for the fields below
+        uint32_t pageSize;              ///< Page size in bytes (power of 2; only for new files)
+        int64_t cacheSize;              ///< Page cache size in bytes (per connection)
+        int64_t mmapSize;               ///< Bytes of the file to memory-map; negative disables it
+        int64_t journalSizeLimit;       ///< Max size in bytes the WAL file is left at
+        uint32_t walAutoCheckpoint;     ///< WAL size, in pages, that triggers a checkpoint
+    } C4StorageTuning;
+
     /** Main database configuration struct (version 2) for use with c4db_openNamed etc. */
     typedef struct C4DatabaseConfig2 {
         C4Slice parentDirectory;        ///< Directory for databases
@@ -114,6 +133,17 @@ extern "C" {
                                const C4DatabaseConfig2 *config,
                                C4Error* C4NULLABLE outError) C4API;
 
+    /** Opens a database like c4db_openNamed, with storage-engine tuning parameters.
+        @param name  The name of the database (without the ".cblite2" extension.)
+        @param config  Database configuration (including directory.)
+        @param tuning  Storage tuning, or NULL for the defaults. An unknown profile is an error.
+        @param outError  On failure, error info will be written here.
+        @return  The new database handle, or NULL on failure. */
+    C4Database* c4db_openNamedWithTuning(C4String name,
+                                         const C4DatabaseConfig2 *config,
+                                         const C4StorageTuning* C4NULLABLE tuning,
+                                         C4Error* C4NULLABLE outError) C4API;
+
     /** Opens a new handle to the same database file as `db`.
         The new connection is completely independent and can be used on another thread. */
     C4Database* c4db_openAgain(C4Database* db,
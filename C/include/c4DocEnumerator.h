@@ -54,6 +54,19 @@ extern "C" {
 
     /** Default all-docs enumeration options. (Equal to kC4IncludeNonConflicted | kC4IncludeBodies) */
     CBL_CORE_API extern const C4EnumeratorOptions kC4DefaultEnumeratorOptions;
+
+
+    /** A range of docIDs to enumerate; see \ref c4db_enumerateDocIDRange.
+        The strings only need to remain valid until the enumerator is created.
+        Zero/null fields have no effect, so zero-initialize the struct. */
+    typedef struct {
+        C4String minDocID;          ///< If non-null, skips docIDs less than this
+        C4String maxDocID;          ///< If non-null, skips docIDs greater than this
+        C4String docIDPrefix;       ///< If non-null, includes only docIDs with this prefix
+        uint64_t limit;             ///< Maximum number of docs to return; 0 means no limit
+        bool excludeMinDocID;       ///< If true, `minDocID` itself is not included
+        bool excludeMaxDocID;       ///< If true, `maxDocID` itself is not included
+    } C4DocIDRange;
     
 
     /** Metadata about a document (actually about its current revision.) */
@@ -100,6 +113,20 @@ extern "C" {
                                            const C4EnumeratorOptions* C4NULLABLE options,
                                            C4Error* C4NULLABLE outError) C4API;
 
+    /** Creates an enumerator ordered by docID, over only the docIDs in a range, up to a limit.
+        The range is found by seeking in the docID index, so paging through docs by their IDs
+        this way is efficient. (With \ref kC4Descending, enumeration starts at the max docID.)
+        Caller is responsible for freeing the enumerator when finished with it.
+        @param database  The database.
+        @param range  The docID range and limit.
+        @param options  Enumeration options (NULL for defaults).
+        @param outError  Error will be stored here on failure.
+        @return  A new enumerator, or NULL on failure. */
+    C4DocEnumerator* c4db_enumerateDocIDRange(C4Database *database,
+                                              const C4DocIDRange *range,
+                                              const C4EnumeratorOptions* C4NULLABLE options,
+                                              C4Error* C4NULLABLE outError) C4API;
+
     /** Advances the enumerator to the next document.
         Returns false at the end, or on error; look at the C4Error to determine which occurred,
         and don't forget to free the enumerator. */
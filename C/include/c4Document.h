@@ -381,6 +381,32 @@ extern "C" {
                           size_t * C4NULLABLE outCommonAncestorIndex,
                           C4Error* C4NULLABLE outError) C4API;
 
+    /** Saves multiple revisions, with the same results as calling `c4doc_put` on each request
+        in order, but faster: a run of consecutive requests that create new documents (whose
+        docIDs don't exist and aren't used by an earlier request) is written to the database
+        together, with a handful of multi-row SQL statements instead of one per document.
+        A request that fails only fails itself, as with `c4doc_put`.
+        Must be called within a transaction. Every request must have `save` set to true.
+        @param database  The database.
+        @param requests  Array of put requests.
+        @param count  Number of put requests.
+        @param outDocs  If non-NULL, must point to an array of `count` pointers, which will be
+                    set to the saved documents (or NULL if the request failed.) The caller is
+                    responsible for releasing the documents.
+        @param outErrors  If non-NULL, must point to an array of `count` errors, which will be set
+                    to the error for each request that failed, or `{}` on success.
+        @param outError  On failure of the operation as a whole, the error will be stored here.
+        @return  The number of requests that succeeded; or -1 if the operation as a whole failed
+                    (for instance if a request doesn't have `save` set, or the database can't
+                    be read or written.) In that case some requests may already have been saved,
+                    so the caller must abort the transaction. */
+    int64_t c4db_putDocs(C4Database *database,
+                         const C4DocPutRequest requests[C4NONNULL],
+                         size_t count,
+                         C4Document* C4NULLABLE outDocs[C4NULLABLE],
+                         C4Error outErrors[C4NULLABLE],
+                         C4Error* C4NULLABLE outError) C4API;
+
     /** Convenience function to create a new document. This just a wrapper around c4doc_put.
         If the document already exists, it will fail with the error kC4ErrorConflict.
         @param db  The database to create the document in
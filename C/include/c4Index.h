@@ -132,6 +132,32 @@ extern "C" {
                           const C4IndexOptions* C4NULLABLE indexOptions,
                           C4Error* C4NULLABLE outError) C4API;
 
+    /** Creates a database index like `c4db_createIndex`, but one that is not updated as part
+        of every document save. Instead the changed documents are journaled, and the index is
+        brought up to date later in batches: by the database's background housekeeping task (see
+        `c4db_startHousekeeping`), or explicitly by calling `c4db_updateIndexes`.
+        This keeps a slow `PREDICTION()` model from stalling writers.
+
+        Until the index catches up, queries using it won't see changed or new documents;
+        `c4db_getIndexedSequence` tells how far behind it is.
+
+        Only full-text and predictive indexes support deferred updates; other types are created
+        as regular indexes. Calling this on an existing index of the same definition switches it
+        to deferred updates, and calling `c4db_createIndex` switches it back.
+        @param database  The database to index.
+        @param name  The name of the index.
+        @param indexSpecJSON  The definition of the index in JSON form, as for `c4db_createIndex`.
+        @param indexType  The type of index.
+        @param indexOptions  Options for the index. If NULL, each option will get a default value.
+        @param outError  On failure, will be set to the error status.
+        @return  True on success, false on failure. */
+    bool c4db_createDeferredIndex(C4Database *database,
+                                  C4String name,
+                                  C4String indexSpecJSON,
+                                  C4IndexType indexType,
+                                  const C4IndexOptions* C4NULLABLE indexOptions,
+                                  C4Error* C4NULLABLE outError) C4API;
+
     /** Deletes an index that was created by `c4db_createIndex`.
         @param database  The database to index.
         @param name The name of the index to delete
@@ -158,6 +184,28 @@ extern "C" {
     C4SliceResult c4db_getIndexesInfo(C4Database* database,
                                       C4Error* C4NULLABLE outError) C4API;
 
+    /** Returns the sequence through which all indexes are up to date: every change to a
+        document with this sequence or lower is reflected in every index.
+        This is the same as the database's last sequence, unless some indexes were created
+        with `c4db_createDeferredIndex` and haven't caught up yet. A client that needs fully
+        up-to-date query results can compare this with `c4db_getLastSequence`, and call
+        `c4db_updateIndexes` if they differ; or it can ignore the lag and accept stale results.
+        @param database  The database to check.
+        @param outError  On failure, will be set to the error status.
+        @return  The indexed sequence, or 0 on failure. */
+    C4SequenceNumber c4db_getIndexedSequence(C4Database* database,
+                                             C4Error* C4NULLABLE outError) C4API;
+
+    /** Synchronously brings all deferred-update indexes up to date on the calling thread.
+        Each batch of index rows is computed outside of a transaction, then saved in a short
+        one, so other writers are only blocked briefly. Afterwards, `c4db_getIndexedSequence` returns the last sequence.
+        (This is a no-op if there are no such indexes.)
+        @param database  The database whose indexes to update.
+        @param outError  On failure, will be set to the error status.
+        @return  True on success, false on failure. */
+    bool c4db_updateIndexes(C4Database* database,
+                            C4Error* C4NULLABLE outError) C4API;
+
     /** @} */
 
 #ifdef __cplusplus
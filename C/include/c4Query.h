@@ -64,6 +64,20 @@ extern "C" {
     C4StringResult c4query_explain(C4Query*) C4API;
 
 
+    /** Statistics of a database's cache of compiled queries. Creating a C4Query whose language
+        and expression match a recently created one reuses its compiled form, skipping parsing
+        and SQL preparation. The cache is cleared when indexes are created or deleted. */
+    typedef struct {
+        uint64_t hits;          ///< Number of queries created from the cache
+        uint64_t misses;        ///< Number of queries that had to be compiled
+        uint32_t count;         ///< Number of compiled queries currently in the cache
+    } C4QueryCacheStats;
+
+    /** Returns statistics about the database's compiled-query cache.
+        All fields are zero if the database has no such cache, or on error. */
+    C4QueryCacheStats c4db_getQueryCacheStats(C4Database*) C4API;
+
+
     /** Returns the number of columns (the values specified in the WHAT clause) in each row. */
     unsigned c4query_columnCount(C4Query*) C4API;
 
@@ -82,6 +96,9 @@ extern "C" {
     /** Options for running queries. */
     typedef struct {
         bool rankFullText_DEPRECATED;      ///< Ignored; use the `rank()` query function instead.
+        bool waitForIndexes;    ///< If true, first brings deferred-update indexes up to date, as
+                                ///< `c4db_updateIndexes` does. If false, results from indexes
+                                ///< created by `c4db_createDeferredIndex` may be stale.
     } C4QueryOptions;
 
 
@@ -101,6 +101,34 @@ extern "C" {
         C4ReplicatorStatusFlags flags;
     } C4ReplicatorStatus;
 
+    /** The adaptive flow-control state of one direction of replication: the measured round-trip
+        time and throughput of `rev` messages, and the limits chosen from them. */
+    typedef struct {
+        uint32_t roundTripMS;       ///< Smoothed round-trip time, in milliseconds
+        uint32_t minRoundTripMS;    ///< Lowest recent round-trip time, in milliseconds
+        uint64_t bytesPerSec;       ///< Estimated throughput of revision bodies
+        uint32_t maxInFlight;       ///< Max revisions sent (push) or requested (pull) at once
+        uint64_t maxBytesInFlight;  ///< Max bytes of revisions awaiting reply (0 = unlimited)
+        uint32_t batchSize;         ///< Number of changes per `changes` message
+    } C4FlowControlState;
+
+    /** The flow-control state of a replicator's pusher and puller. See c4repl_getFlowControl. */
+    typedef struct {
+        C4FlowControlState push;
+        C4FlowControlState pull;
+    } C4ReplicatorFlowControl;
+
+    /** Statistics of a replicator's blob transfers. See c4repl_getBlobStats. */
+    typedef struct {
+        uint64_t bytesPulled;       ///< Bytes of blobs received
+        uint64_t bytesPushed;       ///< Bytes of blobs sent
+        uint32_t blobsPulled;       ///< Number of blobs received
+        uint32_t blobsPushed;       ///< Number of blobs sent
+        uint64_t pullBytesPerSec;   ///< Average rate of receiving, while any blob was being pulled
+        uint32_t maxBlobsPulling;   ///< Most blobs being pulled at once
+        uint64_t peakBytesReserved; ///< Most blob bytes reserved for pulling at once
+    } C4BlobTransferStats;
+
     /** Information about a document that's been pushed or pulled. */
     typedef struct {
         C4HeapString docID;
@@ -278,6 +306,19 @@ extern "C" {
         This function is thread-safe.  */
     C4ReplicatorStatus c4repl_getStatus(C4Replicator *repl) C4API;
 
+    /** Returns the replicator's current flow-control state. The limits on revisions in flight
+        adapt to the connection's measured latency and throughput, unless the
+        `kC4ReplicatorOptionFixedFlowControl` option is set. After the replicator stops, this
+        returns the final state of its last connection.
+        This function is thread-safe.  */
+    C4ReplicatorFlowControl c4repl_getFlowControl(C4Replicator *repl) C4API;
+
+    /** Returns statistics of the replicator's blob transfers. Blobs are pulled several at a
+        time, limited by their total size, and are written to disk as they arrive. After the
+        replicator stops, this returns the statistics of its last connection.
+        This function is thread-safe.  */
+    C4BlobTransferStats c4repl_getBlobStats(C4Replicator *repl) C4API;
+
     /** Returns the HTTP response headers as a Fleece-encoded dictionary.
         \note This function is thread-safe.  */
     C4Slice c4repl_getResponseHeaders(C4Replicator *repl) C4API;
@@ -362,6 +403,9 @@ extern "C" {
     #define kC4ReplicatorOptionRemoteDBUniqueID "remoteDBUniqueID" ///< Stable ID for remote db with unstable URL (string)
     #define kC4ReplicatorOptionProgressLevel    "progress"  ///< If >=1, notify on every doc; if >=2, on every attachment (int)
     #define kC4ReplicatorOptionDisableDeltas    "noDeltas"   ///< Disables delta sync (bool)
+    #define kC4ReplicatorOptionDisableFleeceBodies "noFleeceBodies" ///< Always send revs as JSON (bool)
+    #define kC4ReplicatorOptionFixedFlowControl "fixedFlowControl" ///< Don't adapt flow control to network (bool)
+    #define kC4ReplicatorOptionMaxRevEncoders   "maxRevEncoders" ///< Max # of pushed revs to read & encode at once (int)
     #define kC4ReplicatorOptionMaxRetries       "maxRetries" ///< Max number of retry attempts (int)
     #define kC4ReplicatorOptionMaxRetryInterval "maxRetryInterval" ///< Max delay betw retries (secs)
 
@@ -382,6 +426,7 @@ extern "C" {
 
     // BLIP options:
     #define kC4ReplicatorCompressionLevel       "BLIPCompressionLevel" ///< Data compression level, 0..9
+    #define kC4ReplicatorCompressionAlgorithm   "BLIPCompressionAlgorithm" ///< "deflate" or "snappy" (string)
 
     // [1]: Auth dictionary keys:
     #define kC4ReplicatorAuthType       "type"           ///< Auth type; see [2] (string)
@@ -20,6 +20,7 @@
 #include "c4BlobStore.h"
 #include "c4Private.h"
 #include <fstream>
+#include <random>
 
 using namespace std;
 
@@ -392,3 +393,146 @@ N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write identical blob", "[blob][C]") {
         c4stream_closeWriter(stream);
     }
 }
+
+
+// Returns pseudo-random data, so that chunk boundaries fall at varying places.
+static string randomBlobData(size_t size, unsigned seed) {
+    mt19937 rng(seed);
+    string data(size, '\0');
+    for (auto &c : data)
+        c = char(rng());
+    return data;
+}
+
+
+// Returns the digests of a blob's chunks, checking that their lengths add up.
+static vector<string> chunkDigests(C4BlobStore *store, C4BlobKey key, size_t blobSize) {
+    C4Error error;
+    alloc_slice json = c4blob_getChunkList(store, key, ERROR_INFO(error));
+    REQUIRE(json);
+    Doc list = Doc::fromJSON(json);
+    REQUIRE(list.asArray());
+    vector<string> digests;
+    uint64_t total = 0;
+    for (Array::iterator i(list.asArray()); i; ++i) {
+        Array chunk = i->asArray();
+        digests.emplace_back(chunk[0].asString());
+        total += chunk[1].asUnsigned();
+    }
+    CHECK(total == blobSize);
+    return digests;
+}
+
+
+TEST_CASE("chunked blobs", "[blob][C]") {
+    C4Error error;
+    C4BlobStore *store = c4blob_openStore(TEMPDIR("cbl_chunked_blob_test" + kPathSeparator),
+                                          kC4DB_Create | kC4DB_ChunkedBlobs,
+                                          nullptr,
+                                          ERROR_INFO(error));
+    REQUIRE(store);
+    CHECK(c4blob_isChunkedStore(store));
+
+    // Small blobs are stored in a single chunk:
+    C4Slice small = C4STR("This is a blob to store in the store!");
+    C4BlobKey smallKey;
+    REQUIRE(c4blob_create(store, small, nullptr, &smallKey, WITH_ERROR(&error)));
+    alloc_slice str = c4blob_keyToString(smallKey);
+    CHECK(string(str) == "sha1-QneWo5IYIQ0ZrbCG0hXPGC6jy7E=");
+    CHECK(c4blob_getSize(store, smallKey) == small.size);
+    CHECK(chunkDigests(store, smallKey, small.size).size() == 1);
+
+    // A large blob has the same key as if it were stored whole:
+    string data = randomBlobData(2000000, 1);
+    C4BlobKey key;
+    REQUIRE(c4blob_create(store, slice(data), nullptr, &key, WITH_ERROR(&error)));
+    CHECK(memcmp(c4blob_computeKey(slice(data)).bytes, key.bytes, sizeof(key.bytes)) == 0);
+    CHECK(c4blob_getSize(store, key) == data.size());
+    alloc_slice contents = c4blob_getContents(store, key, ERROR_INFO(error));
+    CHECK(contents == slice(data));
+
+    // It has no single file:
+    alloc_slice path = c4blob_getFilePath(store, key, &error);
+    CHECK(!path);
+    CHECK(error == C4Error{LiteCoreDomain, kC4ErrorUnsupported});
+
+    // Its chunks are within the size limits, and can be read individually:
+    vector<string> digests = chunkDigests(store, key, data.size());
+    CHECK(digests.size() > 1);
+    size_t offset = 0;
+    for (auto &digest : digests) {
+        C4BlobKey chunkKey;
+        REQUIRE(c4blob_keyFromString(slice(digest), &chunkKey));
+        CHECK(c4blob_hasChunk(store, chunkKey));
+        alloc_slice chunk = c4blob_getChunk(store, chunkKey, ERROR_INFO(error));
+        REQUIRE(chunk);
+        CHECK(chunk.size <= 256 * 1024);
+        if (offset + chunk.size < data.size())
+            CHECK(chunk.size >= 16 * 1024);
+        REQUIRE(offset + chunk.size <= data.size());
+        CHECK(chunk == slice(&data[offset], chunk.size));
+        offset += chunk.size;
+    }
+    CHECK(offset == data.size());
+
+    // Read it back random-access, across chunk boundaries:
+    C4ReadStream *reader = c4blob_openReadStream(store, key, ERROR_INFO(error));
+    REQUIRE(reader);
+    CHECK(c4stream_getLength(reader, WITH_ERROR(&error)) == data.size());
+    vector<char> buf(100000);
+    for (size_t pos = 12345; pos < data.size(); pos += 234567) {
+        INFO("Reading at offset " << pos);
+        REQUIRE(c4stream_seek(reader, pos, WITH_ERROR(&error)));
+        size_t bytesRead = c4stream_read(reader, buf.data(), buf.size(), WITH_ERROR(&error));
+        REQUIRE(bytesRead == min(buf.size(), data.size() - pos));
+        CHECK(memcmp(buf.data(), &data[pos], bytesRead) == 0);
+    }
+    c4stream_close(reader);
+
+    // Insert a few bytes in the middle; only the chunks around the edit are new:
+    string edited = data;
+    edited.insert(1000000, "INSERTED");
+    C4BlobKey editedKey;
+    REQUIRE(c4blob_create(store, slice(edited), nullptr, &editedKey, WITH_ERROR(&error)));
+    vector<string> editedDigests = chunkDigests(store, editedKey, edited.size());
+    size_t newChunks = 0;
+    for (auto &digest : editedDigests) {
+        if (find(digests.begin(), digests.end(), digest) == digests.end())
+            ++newChunks;
+    }
+    CHECK(newChunks >= 1);
+    CHECK(newChunks <= 2);
+
+    // Deleting the original blob leaves the shared chunks, and deletes the others:
+    REQUIRE(c4blob_delete(store, key, WITH_ERROR(&error)));
+    CHECK(c4blob_getSize(store, key) == -1);
+    contents = c4blob_getContents(store, editedKey, ERROR_INFO(error));
+    CHECK(contents == slice(edited));
+    for (auto &digest : digests) {
+        C4BlobKey chunkKey;
+        REQUIRE(c4blob_keyFromString(slice(digest), &chunkKey));
+        bool shared = find(editedDigests.begin(), editedDigests.end(), digest)
+                            != editedDigests.end();
+        CHECK(c4blob_hasChunk(store, chunkKey) == shared);
+    }
+
+    // Deleting a blob doesn't delete the chunks of a blob still being written:
+    C4WriteStream *writer = c4blob_openWriteStream(store, ERROR_INFO(error));
+    REQUIRE(writer);
+    REQUIRE(c4stream_write(writer, edited.data(), edited.size(), WITH_ERROR(&error)));
+    REQUIRE(c4blob_delete(store, editedKey, WITH_ERROR(&error)));
+    C4BlobKey rewrittenKey = c4stream_computeBlobKey(writer);
+    REQUIRE(c4stream_install(writer, nullptr, WITH_ERROR(&error)));
+    c4stream_closeWriter(writer);
+    CHECK(memcmp(rewrittenKey.bytes, editedKey.bytes, sizeof(editedKey.bytes)) == 0);
+    contents = c4blob_getContents(store, editedKey, ERROR_INFO(error));
+    CHECK(contents == slice(edited));
+
+    {
+        ExpectingExceptions x;
+        CHECK(!c4blob_getChunkList(store, key, &error).buf);
+        CHECK(error == C4Error{LiteCoreDomain, kC4ErrorNotFound});
+    }
+
+    CHECK(c4blob_deleteStore(store, WITH_ERROR(&error)));
+}
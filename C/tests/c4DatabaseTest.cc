@@ -159,6 +159,37 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database OpenNamed", "[Database][C][!thr
 }
 
 
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database OpenNamed With Tuning", "[Database][C][!throws]") {
+    auto config = *c4db_getConfig2(db);
+    static constexpr slice kTestBundleName = "cbl_core_test_tuning";
+    C4Error error;
+    if (!c4db_deleteNamed(kTestBundleName, config.parentDirectory, &error))
+        REQUIRE(error.code == 0);
+
+    C4StorageTuning tuning = {};
+    tuning.profile = kC4StorageEmbedded;
+    tuning.cacheSize = 512 * 1024;
+    c4::ref<C4Database> tuned = c4db_openNamedWithTuning(kTestBundleName, &config, &tuning,
+                                                         ERROR_INFO());
+    REQUIRE(tuned);
+    c4::ref<C4Database> again = c4db_openAgain(tuned, ERROR_INFO());
+    REQUIRE(again);
+    REQUIRE(c4db_close(again, WITH_ERROR()));
+    REQUIRE(c4db_close(tuned, WITH_ERROR()));
+
+    // An out-of-range profile must not wrap around into a valid one:
+    {
+        ExpectingExceptions x;
+        tuning.profile = C4StorageProfile(256);
+        c4::ref<C4Database> bad = c4db_openNamedWithTuning(kTestBundleName, &config, &tuning,
+                                                           &error);
+        CHECK(!bad);
+        CHECK(error == C4Error{LiteCoreDomain, kC4ErrorInvalidParameter});
+    }
+    REQUIRE(c4db_deleteNamed(kTestBundleName, config.parentDirectory, WITH_ERROR()));
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database OpenNamed Bad Path", "[Database][C][!throws]") {
     auto badOpen = [&](slice parentDirectory) {
         C4Error error;
@@ -318,6 +349,47 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Enumerator With Info", "[Databa
 }
 
 
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Enumerator DocID Range", "[Database][Enumerator][C]") {
+    setupAllDocs();
+
+    C4EnumeratorOptions options = kC4DefaultEnumeratorOptions;
+    auto docIDs = [&](const C4DocIDRange &range) {
+        vector<string> result;
+        c4::ref<C4DocEnumerator> e = REQUIRED(c4db_enumerateDocIDRange(db, &range, &options,
+                                                                        WITH_ERROR()));
+        C4Error error;
+        while (c4enum_next(e, &error)) {
+            C4DocumentInfo info;
+            REQUIRE(c4enum_getDocumentInfo(e, &info));
+            result.push_back(slice(info.docID).asString());
+        }
+        CHECK(error == C4Error{});
+        return result;
+    };
+
+    C4DocIDRange range = {};
+    range.minDocID = "doc-010"_sl;
+    range.maxDocID = "doc-013"_sl;
+    CHECK(docIDs(range) == (vector<string>{"doc-010", "doc-011", "doc-012", "doc-013"}));
+
+    range.excludeMinDocID = range.excludeMaxDocID = true;
+    CHECK(docIDs(range) == (vector<string>{"doc-011", "doc-012"}));
+
+    range = {};
+    range.docIDPrefix = "doc-09"_sl;
+    range.limit = 3;
+    CHECK(docIDs(range) == (vector<string>{"doc-090", "doc-091", "doc-092"}));
+
+    options.flags |= kC4Descending;
+    CHECK(docIDs(range) == (vector<string>{"doc-099", "doc-098", "doc-097"}));
+
+    options = kC4DefaultEnumeratorOptions;
+    range = {};
+    range.minDocID = "doc-100"_sl;
+    CHECK(docIDs(range).empty());
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Enumerator With History", "[Database][Enumerator][C]") {
     if (isRevTrees())
         return;
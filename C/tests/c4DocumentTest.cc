@@ -216,6 +216,72 @@ N_WAY_TEST_CASE_METHOD(C4Test, "Document FindDocAncestors", "[Document][C]") {
 }
 
 
+// Measures how fast the puller can answer `changes` messages, which call c4db_findDocAncestors
+// on every revision they list.
+N_WAY_TEST_CASE_METHOD(C4Test, "Document FindDocAncestors Benchmark", "[Document][C][Perf][.slow]") {
+    if (!isRevTrees())
+        return;
+    static constexpr unsigned kNumDocs = 100000, kChangesPerMessage = 200;
+    static constexpr unsigned kMaxAncestors = 20;
+    C4RemoteID kRemoteID = 1;
+
+    Encoder enc;
+    enc.beginDict();
+    enc.writeKey("text"_sl);
+    enc.writeString(std::string(1000, 'x'));
+    enc.endDict();
+    alloc_slice body = enc.finish();
+
+    std::vector<std::string> docIDs;
+    {
+        TransactionHelper t(db);
+        for (unsigned i = 0; i < kNumDocs; ++i) {
+            char docID[20];
+            sprintf(docID, "doc-%07u", i);
+            docIDs.push_back(docID);
+            createRev(slice(docIDs.back()), kRevID, body);
+            createRev(slice(docIDs.back()), kRev2ID, body);
+            createRev(slice(docIDs.back()), kRev3ID, body);
+        }
+    }
+
+    // Every change is either a revision we have, a newer one, or one of a doc we don't have:
+    std::vector<std::string> ids, revs;
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        switch (i % 3) {
+            case 0: ids.push_back(docIDs[i]); revs.push_back(std::string(slice(kRev3ID))); break;
+            case 1: ids.push_back(docIDs[i]); revs.push_back("4-deadbeef"); break;
+            case 2: ids.push_back("missing-" + docIDs[i]); revs.push_back("1-abcd"); break;
+        }
+    }
+
+    std::vector<C4String> docIDSlices(kChangesPerMessage), revIDSlices(kChangesPerMessage);
+    std::vector<C4SliceResult> ancestors(kChangesPerMessage);
+    unsigned messages = 0, haveLocal = 0;
+    fleece::Stopwatch st;
+    for (unsigned start = 0; start < kNumDocs; start += kChangesPerMessage) {
+        unsigned n = std::min(kChangesPerMessage, kNumDocs - start);
+        for (unsigned i = 0; i < n; ++i) {
+            docIDSlices[i] = slice(ids[start + i]);
+            revIDSlices[i] = slice(revs[start + i]);
+        }
+        REQUIRE(c4db_findDocAncestors(db, n, kMaxAncestors, false, kRemoteID,
+                                      docIDSlices.data(), revIDSlices.data(), ancestors.data(),
+                                      WITH_ERROR()));
+        for (unsigned i = 0; i < n; ++i) {
+            alloc_slice result(std::move(ancestors[i]));
+            if (result == "8"_sl)
+                ++haveLocal;
+        }
+        ++messages;
+    }
+    st.stop();
+    CHECK(haveLocal == (kNumDocs + 2) / 3);
+    st.printReport("Checking revisions with c4db_findDocAncestors", kNumDocs, "revision");
+    C4Log("...in %u changes messages of %u revisions each", messages, kChangesPerMessage);
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4Test, "Document CreateVersionedDoc", "[Document][C]") {
     // Try reading doc with mustExist=true, which should fail:
     C4Error error;
@@ -712,6 +778,111 @@ N_WAY_TEST_CASE_METHOD(C4Test, "Document create from existing rev", "[Document][
 }
 
 
+N_WAY_TEST_CASE_METHOD(C4Test, "Document PutDocs", "[Document][C]") {
+    createRev(kDocID, kRevID, kFleeceBody);
+
+    C4Error error;
+    TransactionHelper t(db);
+
+    constexpr size_t kCount = 300;
+    vector<string> docIDs;
+    for (size_t i = 0; i < kCount; ++i) {
+        char docID[20];
+        sprintf(docID, "doc-%03zu", i);
+        docIDs.push_back(docID);
+    }
+    // Two requests that can't be batched: an existing doc, and a repeated docID:
+    docIDs.push_back(string(slice(kDocID)));
+    docIDs.push_back("doc-007");
+
+    vector<C4DocPutRequest> requests;
+    for (auto &docID : docIDs) {
+        C4DocPutRequest rq = {};
+        rq.docID = slice(docID);
+        rq.body = kFleeceBody;
+        rq.save = true;
+        requests.push_back(rq);
+    }
+
+    vector<C4Document*> docs(requests.size());
+    vector<C4Error> errors(requests.size());
+    int64_t n = c4db_putDocs(db, requests.data(), requests.size(), docs.data(), errors.data(),
+                             ERROR_INFO(error));
+    CHECK(n == kCount);
+    for (size_t i = 0; i < kCount; ++i) {
+        INFO("doc " << i);
+        REQUIRE(docs[i] != nullptr);
+        CHECK(docs[i]->docID == slice(docIDs[i]));
+        CHECK(errors[i].code == 0);
+        c4::ref<C4Document> saved = c4db_getDoc(db, slice(docIDs[i]), true, kDocGetAll,
+                                                ERROR_INFO(error));
+        REQUIRE(saved);
+        CHECK(saved->sequence == docs[i]->sequence);
+        c4doc_release(docs[i]);
+    }
+    // Creating docs that already exist is a conflict:
+    for (size_t i = kCount; i < requests.size(); ++i) {
+        CHECK(docs[i] == nullptr);
+        CHECK(errors[i] == C4Error{LiteCoreDomain, kC4ErrorConflict});
+    }
+    CHECK(c4db_getLastSequence(db) == kCount + 1);
+}
+
+
+N_WAY_TEST_CASE_METHOD(C4Test, "Document PutDocs In Order", "[Document][C]") {
+    if (!isRevTrees()) return;
+    C4Error error;
+    TransactionHelper t(db);
+
+    // An existing-revision put that creates "zz", then a request to create "zz" from scratch,
+    // then a run of new docs. Applied in order, the second request is a conflict:
+    C4String history[2] = {kRev2ID, kRevID};
+    vector<C4DocPutRequest> requests(2);
+    requests[0].docID = "zz"_sl;
+    requests[0].body = kFleeceBody;
+    requests[0].existingRevision = true;
+    requests[0].history = history;
+    requests[0].historyCount = 2;
+    requests[0].save = true;
+    requests[1].docID = "zz"_sl;
+    requests[1].body = kFleeceBody;
+    requests[1].save = true;
+    vector<string> docIDs;
+    for (int i = 0; i < 10; ++i) {
+        char docID[20];
+        sprintf(docID, "new-%d", i);
+        docIDs.push_back(docID);
+    }
+    for (auto &docID : docIDs) {
+        C4DocPutRequest rq = {};
+        rq.docID = slice(docID);
+        rq.body = kFleeceBody;
+        rq.save = true;
+        requests.push_back(rq);
+    }
+
+    vector<C4Document*> docs(requests.size());
+    vector<C4Error> errors(requests.size());
+    int64_t n = c4db_putDocs(db, requests.data(), requests.size(), docs.data(), errors.data(),
+                             ERROR_INFO(error));
+    CHECK(n == int64_t(requests.size()) - 1);
+    REQUIRE(docs[0]);
+    CHECK(slice(docs[0]->revID) == kRev2ID);
+    CHECK(docs[1] == nullptr);
+    CHECK(errors[1] == C4Error{LiteCoreDomain, kC4ErrorConflict});
+
+    // The docs' sequences follow the order of the requests:
+    C4SequenceNumber lastSeq = docs[0]->sequence;
+    for (size_t i = 2; i < requests.size(); ++i) {
+        REQUIRE(docs[i]);
+        CHECK(docs[i]->sequence > lastSeq);
+        lastSeq = docs[i]->sequence;
+    }
+    for (C4Document *doc : docs)
+        c4doc_release(doc);
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4Test, "Document Update", "[Document][C]") {
     C4Log("Begin test");
     C4Error error;
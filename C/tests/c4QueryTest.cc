@@ -434,6 +434,31 @@ N_WAY_TEST_CASE_METHOD(C4QueryTest, "C4Query FTS", "[Query][C][FTS]") {
 }
 
 
+N_WAY_TEST_CASE_METHOD(C4QueryTest, "C4Query FTS deferred index", "[Query][C][FTS]") {
+    C4Error err;
+    REQUIRE(c4db_createDeferredIndex(db, C4STR("byStreet"), C4STR("[[\".contact.address.street\"]]"),
+                                     kC4FullTextIndex, nullptr, WITH_ERROR(&err)));
+    compile(json5("['MATCH()', 'byStreet', 'Hwy']"));
+
+    auto rowCount = [&](bool waitForIndexes) {
+        C4QueryOptions options = kC4DefaultQueryOptions;
+        options.waitForIndexes = waitForIndexes;
+        c4::ref<C4QueryEnumerator> e = c4query_run(query, &options, nullslice, ERROR_INFO(err));
+        REQUIRE(e);
+        return c4queryenum_getRowCount(e, WITH_ERROR(&err));
+    };
+
+    // The index hasn't caught up with the existing docs, so results are stale:
+    CHECK(c4db_getIndexedSequence(db, WITH_ERROR(&err)) < c4db_getLastSequence(db));
+    CHECK(rowCount(false) == 0);
+
+    // Unless the query waits for the index:
+    CHECK(rowCount(true) == 5);
+    CHECK(c4db_getIndexedSequence(db, WITH_ERROR(&err)) == c4db_getLastSequence(db));
+    CHECK(rowCount(false) == 5);
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4QueryTest, "C4Query FTS multiple properties", "[Query][C][FTS]") {
     C4Error err;
     REQUIRE(c4db_createIndex(db, C4STR("byAddress"),
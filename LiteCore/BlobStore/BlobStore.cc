@@ -22,8 +22,10 @@
 #include "EncryptedStream.hh"
 #include "Logging.hh"
 #include "StringUtil.hh"
+#include "Endian.hh"
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <algorithm>
 
 namespace litecore {
@@ -38,6 +40,27 @@ namespace litecore {
 
     static constexpr size_t kBlobKeyStringLength = ((sizeof(blobKey::digest) + 2) / 3) * 4;
 
+    // Filename suffixes of a whole blob, of a chunked blob's list of chunks, and of a chunk:
+    static constexpr const char* kBlobSuffix = ".blob";
+    static constexpr const char* kChunkListSuffix = ".chunks";
+    static constexpr const char* kChunkSuffix = ".chunk";
+
+
+    static string keyFilename(const blobKey &key, const char *suffix) {
+        string str = slice(key.digest).base64String();
+        replace(str.begin(), str.end(), '/', '_');
+        return str + suffix;
+    }
+
+
+    static bool keyFromFilename(string filename, const char *suffix, blobKey &key) {
+        if (!hasSuffix(filename, suffix))
+            return false;
+        filename.resize(filename.size() - strlen(suffix));
+        replace(filename.begin(), filename.end(), '_', '/');
+        return key.readFromBase64(slice(filename), false);
+    }
+
 
     blobKey::blobKey(slice s) {
         if (!digest.setDigest(s))
@@ -75,18 +98,12 @@ namespace litecore {
 
 
     string blobKey::filename() const {
-        string str = slice(digest).base64String();
-        replace(str.begin(), str.end(), '/', '_');
-        return str + ".blob";
+        return keyFilename(*this, kBlobSuffix);
     }
 
 
     bool blobKey::readFromFilename(string filename) {
-        if (!hasSuffix(filename, ".blob"))
-            return false;
-        filename.resize(filename.size() - 5);
-        replace(filename.begin(), filename.end(), '_', '/');
-        return readFromBase64(slice(filename), false);
+        return keyFromFilename(move(filename), kBlobSuffix, *this);
     }
 
 
@@ -100,8 +117,67 @@ namespace litecore {
 #pragma mark - BLOB READING:
     
     
+    /** Reads a chunked blob by reading its chunks in turn. */
+    class ChunkedReadStream : public SeekableReadStream {
+    public:
+        ChunkedReadStream(const BlobStore &store, vector<BlobChunk> chunks)
+        :_store(store)
+        ,_chunks(move(chunks))
+        {
+            _starts.reserve(_chunks.size() + 1);
+            uint64_t pos = 0;
+            for (auto &chunk : _chunks) {
+                _starts.push_back(pos);
+                pos += chunk.length;
+            }
+            _starts.push_back(pos);
+        }
+
+        uint64_t getLength() const override     {return _starts.back();}
+
+        void seek(uint64_t pos) override {
+            _pos = min(pos, getLength());
+        }
+
+        size_t read(void *dst, size_t count) override {
+            size_t bytesRead = 0;
+            while (bytesRead < count && _pos < getLength()) {
+                // Find the chunk containing _pos, and load it if necessary:
+                auto i = size_t(upper_bound(_starts.begin(), _starts.end(), _pos)
+                                    - _starts.begin() - 1);
+                if (i != _loadedChunk) {
+                    _chunkData = _store.readChunk(_chunks[i].key);
+                    if (_chunkData.size != _chunks[i].length)
+                        error::_throw(error::CorruptData);
+                    _loadedChunk = i;
+                }
+                size_t offset = size_t(_pos - _starts[i]);
+                size_t n = min(count - bytesRead, _chunkData.size - offset);
+                memcpy((uint8_t*)dst + bytesRead, _chunkData.offset(offset), n);
+                bytesRead += n;
+                _pos += n;
+            }
+            return bytesRead;
+        }
+
+        void close() override {
+            _chunkData = nullslice;
+            _loadedChunk = SIZE_MAX;
+        }
+
+    private:
+        const BlobStore&        _store;
+        vector<BlobChunk> const _chunks;
+        vector<uint64_t>        _starts;            // Offset of each chunk, plus the length
+        uint64_t                _pos {0};           // Current position
+        size_t                  _loadedChunk {SIZE_MAX};    // Index of chunk in _chunkData
+        alloc_slice             _chunkData;         // Data of current chunk
+    };
+
+
     Blob::Blob(const BlobStore &store, const blobKey &key)
     :_path(store.dir(), key.filename()),
+     _chunkListPath(store.dir(), keyFilename(key, kChunkListSuffix)),
      _key(key),
      _store(store)
     { }
@@ -109,22 +185,45 @@ namespace litecore {
 
     int64_t Blob::contentLength() const {
         int64_t length = path().dataSize();
+        if (length < 0 && _chunkListPath.exists()) {
+            length = 0;
+            for (auto &chunk : chunks())
+                length += chunk.length;
+            return length;
+        }
         if (length >= 0 && _store.options().encryptionAlgorithm != kNoEncryption)
             length -= EncryptedReadStream::kFileSizeOverhead;
         return length;
     }
 
 
-
     unique_ptr<SeekableReadStream> Blob::read() const {
-        SeekableReadStream *reader = new FileReadStream(_path);
-        auto &options = _store.options();
-        if (options.encryptionAlgorithm != kNoEncryption) {
-            reader = new EncryptedReadStream(shared_ptr<SeekableReadStream>(reader),
-                                             options.encryptionAlgorithm,
-                                             options.encryptionKey);
+        if (isChunked())
+            return make_unique<ChunkedReadStream>(_store, chunks());
+        return _store.openFile(_path);
+    }
+
+
+    // A chunk list is a series of entries, each a chunk's raw digest and its big-endian
+    // 32-bit length.
+    static constexpr size_t kChunkEntrySize = sizeof(blobKey::digest) + sizeof(uint32_t);
+
+
+    vector<BlobChunk> Blob::chunks() const {
+        if (!_chunkListPath.exists())
+            error::_throw(error::NotFound);
+        alloc_slice list = _store.openFile(_chunkListPath)->readAll();
+        if (list.size % kChunkEntrySize != 0)
+            error::_throw(error::CorruptData);
+        vector<BlobChunk> chunks;
+        chunks.reserve(list.size / kChunkEntrySize);
+        for (slice entry = list; entry.size > 0; entry.moveStart(kChunkEntrySize)) {
+            uint32_t lengthBE;
+            memcpy(&lengthBE, entry.offset(sizeof(blobKey::digest)), sizeof(lengthBE));
+            chunks.push_back({blobKey(entry.upTo(sizeof(blobKey::digest))),
+                              endian::dec32(lengthBE)});
         }
-        return unique_ptr<SeekableReadStream>{reader};
+        return chunks;
     }
 
 
@@ -134,19 +233,17 @@ namespace litecore {
     BlobWriteStream::BlobWriteStream(BlobStore &store)
     :_store(store)
     {
-        FILE *file;
-        _tmpPath = store.dir()["incoming_"].mkTempFile(&file);
-        _writer = shared_ptr<WriteStream> {new FileWriteStream(file)};
-        auto &options = _store.options();
-        if (options.encryptionAlgorithm != kNoEncryption) {
-            _writer = make_shared<EncryptedWriteStream>(_writer,
-                                                        options.encryptionAlgorithm,
-                                                        options.encryptionKey);
+        // If chunked, the temporary file will get the list of chunks instead of the data:
+        _writer = store.createTempFile(_tmpPath);
+        if (store.isChunked()) {
+            _chunker = make_unique<ContentChunker>();
+            _chunkBuf = alloc_slice(ContentChunker::kMaxSize);
         }
     }
 
 
     BlobWriteStream::~BlobWriteStream() {
+        _store.removeWriterChunks(_chunks);
         if (!_installed) {
             try {
                 _tmpPath.del();
@@ -161,18 +258,62 @@ namespace litecore {
 
     void BlobWriteStream::write(slice data) {
         Assert(!_computedKey, "Attempted to write after computing digest");
-        _writer->write(data);
+        if (_chunker)
+            addToChunk(data);
+        else
+            _writer->write(data);
         _bytesWritten += data.size;
         _sha1ctx << data;
     }
 
     void BlobWriteStream::close() {
         if (_writer) {
+            if (_chunker) {
+                finishChunk();
+                // Write the list of chunks:
+                uint8_t entry[kChunkEntrySize];
+                for (auto &chunk : _chunks) {
+                    memcpy(entry, &chunk.key.digest, sizeof(chunk.key.digest));
+                    uint32_t lengthBE = endian::enc32(chunk.length);
+                    memcpy(&entry[sizeof(chunk.key.digest)], &lengthBE, sizeof(lengthBE));
+                    _writer->write(slice(entry, sizeof(entry)));
+                }
+            }
             _writer->close();
             _writer = nullptr;
         }
     }
 
+    // Appends data to the current chunk, storing each chunk as it's completed.
+    void BlobWriteStream::addToChunk(slice data) {
+        while (data.size > 0) {
+            size_t n = _chunker->findBoundary(data);
+            bool boundary = (n != ContentChunker::kNoBoundary);
+            if (!boundary)
+                n = data.size;
+            Assert(_chunkSize + n <= _chunkBuf.size);
+            memcpy((uint8_t*)_chunkBuf.buf + _chunkSize, data.buf, n);
+            _chunkSize += n;
+            data.moveStart(n);
+            if (boundary)
+                finishChunk();
+        }
+    }
+
+    void BlobWriteStream::finishChunk() {
+        if (_chunkSize == 0)
+            return;
+        slice chunk(_chunkBuf.buf, _chunkSize);
+        auto key = blobKey::computeFrom(chunk);
+        // Register the chunk before checking for it, so compaction can't delete it until this
+        // stream is done:
+        _store.addWriterChunk(key);
+        _chunks.push_back({key, uint32_t(_chunkSize)});
+        if (!_store.hasChunk(key))
+            _store.writeChunk(chunk, key);
+        _chunkSize = 0;
+    }
+
     blobKey BlobWriteStream::computeKey() noexcept {
         if (!_computedKey) {
             _key.digest = _sha1ctx.finish();
@@ -188,9 +329,9 @@ namespace litecore {
         if (expectedKey && *expectedKey != key)
             error::_throw(error::CorruptData);
         Blob blob(_store, key);
-        if(!blob.path().exists()) {
+        if(!blob.exists()) {
             _tmpPath.setReadOnly(true);
-            _tmpPath.moveTo(blob.path());
+            _tmpPath.moveTo(_chunker ? blob._chunkListPath : blob.path());
         } else {
             // If the destination already exists, then this blob
             // already exists and doesn't need to be written again
@@ -206,9 +347,78 @@ namespace litecore {
     
 #pragma mark - DELETING:
     
+    void BlobStore::addWriterChunk(const blobKey &chunkKey) {
+        lock_guard<mutex> lock(_mutex);
+        _writerChunks.insert(keyFilename(chunkKey, kChunkSuffix));
+    }
+
+
+    void BlobStore::removeWriterChunks(const vector<BlobChunk> &chunks) {
+        lock_guard<mutex> lock(_mutex);
+        for (auto &chunk : chunks) {
+            auto i = _writerChunks.find(keyFilename(chunk.key, kChunkSuffix));
+            if (i != _writerChunks.end())
+                _writerChunks.erase(i);
+        }
+    }
+
+
+    // Adds to `keep` the chunk lists of the chunked blobs in `inUse` (or of all blobs, if it's
+    // null), the chunks they contain, and the chunks of open writers. Returns false if a chunk
+    // list couldn't be read, in which case no chunks should be deleted. Must be called with
+    // `_mutex` locked.
+    bool BlobStore::addChunksInUse(unordered_set<string> &keep,
+                                   const unordered_set<string> *inUse)
+    {
+        bool ok = true;
+        _dir.forEachFile([&](const FilePath &path) {
+            blobKey key;
+            if (keyFromFilename(path.fileName(), kChunkListSuffix, key)
+                    && (!inUse || inUse->find(key.filename()) != inUse->end())) {
+                keep.insert(path.fileName());
+                try {
+                    for (auto &chunk : get(key).chunks())
+                        keep.insert(keyFilename(chunk.key, kChunkSuffix));
+                } catch (const std::exception &x) {
+                    Warn("BlobStore: Can't read chunk list %s, so keeping all chunks: %s",
+                         path.fileName().c_str(), x.what());
+                    ok = false;
+                }
+            }
+        });
+        keep.insert(_writerChunks.begin(), _writerChunks.end());
+        return ok;
+    }
+
+
+    // `inUse` contains the filenames of whole blobs, as given by `blobKey::filename`.
     void BlobStore::deleteAllExcept(const unordered_set<string> &inUse) {
-        _dir.forEachFile([&inUse](const FilePath &path) {
-            if(find(inUse.cbegin(), inUse.cend(), path.fileName()) == inUse.cend()) {
+        lock_guard<mutex> lock(_mutex);
+        unordered_set<string> keep = inUse;
+        bool deleteChunks = addChunksInUse(keep, &inUse);
+        _dir.forEachFile([&](const FilePath &path) {
+            if (keep.find(path.fileName()) == keep.end()
+                    && (deleteChunks || !hasSuffix(path.fileName(), kChunkSuffix))) {
+                path.del();
+            }
+        });
+    }
+
+
+    void BlobStore::deleteBlob(const blobKey &key) {
+        lock_guard<mutex> lock(_mutex);
+        Blob blob = get(key);
+        bool chunked = blob.isChunked();
+        blob.del();
+        if (!chunked)
+            return;
+        // Delete the chunks no remaining blob, or open writer, uses:
+        unordered_set<string> keep;
+        if (!addChunksInUse(keep, nullptr))
+            return;
+        _dir.forEachFile([&](const FilePath &path) {
+            if (hasSuffix(path.fileName(), kChunkSuffix)
+                    && keep.find(path.fileName()) == keep.end()) {
                 path.del();
             }
         });
@@ -242,10 +452,70 @@ namespace litecore {
     }
 
 
+    unique_ptr<SeekableReadStream> BlobStore::openFile(const FilePath &path) const {
+        SeekableReadStream *reader = new FileReadStream(path);
+        if (_options.encryptionAlgorithm != kNoEncryption) {
+            reader = new EncryptedReadStream(shared_ptr<SeekableReadStream>(reader),
+                                             _options.encryptionAlgorithm,
+                                             _options.encryptionKey);
+        }
+        return unique_ptr<SeekableReadStream>{reader};
+    }
+
+
+    shared_ptr<WriteStream> BlobStore::createTempFile(FilePath &outPath) const {
+        FILE *file;
+        outPath = _dir["incoming_"].mkTempFile(&file);
+        shared_ptr<WriteStream> writer {new FileWriteStream(file)};
+        if (_options.encryptionAlgorithm != kNoEncryption) {
+            writer = make_shared<EncryptedWriteStream>(writer,
+                                                       _options.encryptionAlgorithm,
+                                                       _options.encryptionKey);
+        }
+        return writer;
+    }
+
+
+    FilePath BlobStore::chunkPath(const blobKey &chunkKey) const {
+        return _dir[keyFilename(chunkKey, kChunkSuffix)];
+    }
+
+
+    bool BlobStore::hasChunk(const blobKey &chunkKey) const {
+        return chunkPath(chunkKey).exists();
+    }
+
+
+    alloc_slice BlobStore::readChunk(const blobKey &chunkKey) const {
+        FilePath path = chunkPath(chunkKey);
+        if (!path.exists())
+            error::_throw(error::NotFound);
+        return openFile(path)->readAll();
+    }
+
+
+    void BlobStore::writeChunk(slice data, const blobKey &chunkKey) {
+        FilePath tmpPath;
+        try {
+            auto writer = createTempFile(tmpPath);
+            writer->write(data);
+            writer->close();
+            tmpPath.setReadOnly(true);
+            tmpPath.moveTo(chunkPath(chunkKey));
+        } catch (...) {
+            tmpPath.del();
+            if (!hasChunk(chunkKey))
+                throw;
+            // (else another stream stored the same chunk at the same time; that's fine.)
+        }
+    }
+
+
     void BlobStore::copyBlobsTo(BlobStore &toStore) {
         _dir.forEachFile([&](const FilePath &path) {
             blobKey key;
-            if (!key.readFromFilename(path.fileName()))
+            if (!key.readFromFilename(path.fileName())
+                    && !keyFromFilename(path.fileName(), kChunkListSuffix, key))
                 return;
             Blob srcBlob(*this, key);
             auto src = srcBlob.read();
@@ -21,7 +21,10 @@
 #include "FilePath.hh"
 #include "Stream.hh"
 #include "SecureDigest.hh"
+#include "ContentChunker.hh"
+#include <mutex>
 #include <unordered_set>
+#include <vector>
 
 namespace litecore {
     class BlobStore;
@@ -56,20 +59,37 @@ namespace litecore {
     };
 
 
+    /** A chunk of a blob stored in chunks; see BlobStore::Options::chunked. The chunk's key is
+        the digest of its data. */
+    struct BlobChunk {
+        blobKey key;
+        uint32_t length;
+    };
+
+
     /** Represents a blob stored in a BlobStore. This class is thread-safe. */
     class Blob {
     public:
-        bool exists() const             {return _path.exists();}
+        bool exists() const             {return _path.exists() || _chunkListPath.exists();}
 
         blobKey key() const             {return _key;}
+
+        /** The file containing the blob's data; doesn't exist if the blob is stored in chunks. */
         FilePath path() const           {return _path;}
+
+        /** True if the blob is stored as a list of chunks instead of a single file. */
+        bool isChunked() const          {return !_path.exists() && _chunkListPath.exists();}
+
         int64_t contentLength() const;      // An overestimate, if blob is encrypted
 
         alloc_slice contents() const    {return read()->readAll();}
 
         unique_ptr<SeekableReadStream> read() const;
 
-        void del()                      {_path.del();}
+        /** The chunks of a chunked blob, in order. Throws NotFound if it isn't chunked. */
+        std::vector<BlobChunk> chunks() const;
+
+        void del()                      {_path.del(); _chunkListPath.del();}
 
     private:
         friend class BlobStore;
@@ -78,12 +98,15 @@ namespace litecore {
         Blob(const BlobStore&, const blobKey&);
 
         const FilePath _path;
+        const FilePath _chunkListPath;
         const blobKey _key;
         const BlobStore &_store;
     };
 
 
-    /** A stream for writing a new Blob. */
+    /** A stream for writing a new Blob. If the store is chunked, the data is split into chunks
+        as it's written; each chunk is stored unless the store already has it, and installing
+        the blob stores the list of its chunks. */
     class BlobWriteStream : public WriteStream {
     public:
         BlobWriteStream(BlobStore&);
@@ -105,9 +128,16 @@ namespace litecore {
         Blob install(const blobKey *expectedKey =nullptr);
 
     private:
+        void addToChunk(slice);
+        void finishChunk();
+
         BlobStore &_store;
         FilePath _tmpPath;
         shared_ptr<WriteStream> _writer;
+        std::unique_ptr<ContentChunker> _chunker;       // Only if store is chunked
+        alloc_slice _chunkBuf;                          // Data of the current chunk
+        size_t _chunkSize {0};                          // Bytes in _chunkBuf
+        std::vector<BlobChunk> _chunks;                 // Chunks written so far
         uint64_t _bytesWritten {0};
         SHA1Builder _sha1ctx;
         blobKey _key;
@@ -117,12 +147,19 @@ namespace litecore {
 
 
     /** Manages a content-addressable store of binary blobs, stored as files in a directory.
+
+        In a chunked store, new blobs are split into content-defined chunks (see ContentChunker),
+        each stored as a file named by its digest, and the blob itself is stored as the list of
+        its chunks. Blobs that share data, like successive versions of an edited file, share the
+        chunk files, and a replicator can transfer only the chunks the other side lacks. A blob's
+        key is still the digest of its entire data, and blobs stored whole are still readable.
         This class is thread-safe. */
     class BlobStore {
     public:
         struct Options {
             bool create         :1;     ///< Should the store be created if it doesn't exist?
             bool writeable      :1;     ///< If false, opened read-only
+            bool chunked        :1;     ///< Store new blobs as deduplicated chunks
             EncryptionAlgorithm encryptionAlgorithm;
             alloc_slice encryptionKey;
             
@@ -135,12 +172,16 @@ namespace litecore {
         const Options& options() const              {return _options;}
         bool isEncrypted() const                    {return _options.encryptionAlgorithm !=
                                                                 kNoEncryption;}
+        bool isChunked() const                      {return _options.chunked;}
         uint64_t count() const;
         uint64_t totalSize() const;
 
         void deleteStore()                          {_dir.delRecursive();}
         void deleteAllExcept(const std::unordered_set<std::string>& inUse);
 
+        /** Deletes a blob. If it's chunked, also deletes the chunks no other blob uses. */
+        void deleteBlob(const blobKey &key);
+
         bool has(const blobKey &key) const          {return get(key).exists();}
 
         const Blob get(const blobKey &key) const    {return Blob(*this, key);}
@@ -148,12 +189,29 @@ namespace litecore {
 
         Blob put(slice data, const blobKey *expectedKey =nullptr);
 
+        bool hasChunk(const blobKey &chunkKey) const;
+        alloc_slice readChunk(const blobKey &chunkKey) const;
+
         void copyBlobsTo(BlobStore &toStore);       // Copy my blobs into toStore
         void moveTo(BlobStore &toStore);            // Replace toStore's dir & options
 
     private:
+        friend class Blob;
+        friend class BlobWriteStream;
+
+        FilePath chunkPath(const blobKey &chunkKey) const;
+        unique_ptr<SeekableReadStream> openFile(const FilePath&) const;
+        shared_ptr<WriteStream> createTempFile(FilePath &outPath) const;
+        void writeChunk(slice data, const blobKey &chunkKey);
+        void addWriterChunk(const blobKey &chunkKey);
+        void removeWriterChunks(const std::vector<BlobChunk>&);
+        bool addChunksInUse(std::unordered_set<std::string> &keep,
+                            const std::unordered_set<std::string> *inUse);
+
         FilePath const  _dir;                           // Location
         Options         _options;                       // Option/capability flags
+        std::mutex      _mutex;                         // Guards _writerChunks & deletion
+        std::unordered_multiset<std::string> _writerChunks; // Chunks used by open writers
     };
 
 }
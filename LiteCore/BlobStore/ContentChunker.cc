@@ -0,0 +1,65 @@
+//
+// ContentChunker.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#include "ContentChunker.hh"
+#include <algorithm>
+#include <array>
+
+namespace litecore {
+    using namespace std;
+
+
+    // The gear table maps each byte value to a random 64-bit number. It's generated with
+    // SplitMix64 from a fixed seed, since it must never change (see the class comment.)
+    static constexpr array<uint64_t,256> makeGearTable() {
+        array<uint64_t,256> table {};
+        uint64_t state = 0x436F7563684C6974;    // arbitrary seed
+        for (size_t i = 0; i < table.size(); ++i) {
+            uint64_t z = (state += 0x9E3779B97F4A7C15);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            table[i] = z ^ (z >> 31);
+        }
+        return table;
+    }
+
+    static constexpr array<uint64_t,256> kGear = makeGearTable();
+
+    // The masks test the high bits of the hash, which depend on the last 64 bytes. The average
+    // chunk size is 2^16 bytes; below it the mask has two more bits (making a boundary 4x less
+    // likely), and above it two fewer bits (4x more likely.)
+    static constexpr uint64_t kMaskSmall = ~0ull << (64 - 18);
+    static constexpr uint64_t kMaskLarge = ~0ull << (64 - 14);
+
+    static_assert(ContentChunker::kAvgSize == 1 << 16, "masks don't match average chunk size");
+
+
+    size_t ContentChunker::findBoundary(slice data) {
+        auto bytes = (const uint8_t*)data.buf;
+        size_t i = 0;
+        if (_size < kMinSize) {
+            // No boundary can occur before the minimum size, so skip hashing those bytes:
+            i = min(kMinSize - _size, data.size);
+            _size += i;
+        }
+        uint64_t hash = _hash;
+        size_t size = _size;
+        for (; i < data.size; ++i) {
+            hash = (hash << 1) + kGear[bytes[i]];
+            ++size;
+            uint64_t mask = (size <= kAvgSize) ? kMaskSmall : kMaskLarge;
+            if ((hash & mask) == 0 || size >= kMaxSize) {
+                _hash = 0;
+                _size = 0;
+                return i + 1;
+            }
+        }
+        _hash = hash;
+        _size = size;
+        return kNoBoundary;
+    }
+
+}
@@ -0,0 +1,45 @@
+//
+// ContentChunker.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "Base.hh"
+#include <stdint.h>
+
+namespace litecore {
+
+    /** Splits a stream of data into chunks at content-defined boundaries, using the FastCDC
+        algorithm (Xia et al, USENIX ATC '16.) A rolling "gear" hash is computed over each
+        chunk past its minimum size, and a boundary is placed where the hash matches a mask.
+        Since a boundary depends only on the bytes just before it, inserting or deleting data
+        changes only the chunks around the edit, and identical runs of data produce identical
+        chunks wherever they appear.
+
+        Chunks are between kMinSize and kMaxSize bytes, and average about kAvgSize ("normalized
+        chunking" uses a stricter mask below the average size and a looser one above it.) These
+        sizes are part of the storage format: changing them would make new chunks different
+        from existing ones, defeating deduplication. */
+    class ContentChunker {
+    public:
+        static constexpr size_t kMinSize = 16 * 1024;
+        static constexpr size_t kAvgSize = 64 * 1024;
+        static constexpr size_t kMaxSize = 256 * 1024;
+
+        static constexpr size_t kNoBoundary = SIZE_MAX;
+
+        /** Scans `data`, which continues the current chunk. If the chunk ends within it, returns
+            the number of bytes of `data` that belong to the chunk, and starts a new chunk;
+            otherwise returns kNoBoundary. */
+        size_t findBoundary(slice data);
+
+        /** The number of bytes scanned of the current chunk. */
+        size_t currentSize() const          {return _size;}
+
+    private:
+        uint64_t    _hash {0};          // Rolling gear hash of the current chunk
+        size_t      _size {0};          // Bytes of the current chunk scanned so far
+    };
+
+}
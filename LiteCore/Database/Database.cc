@@ -106,9 +106,11 @@ namespace c4Internal {
 
 
     Database::Database(const string &bundlePath,
-                       C4DatabaseConfig inConfig)
+                       C4DatabaseConfig inConfig,
+                       const C4StorageTuning &tuning)
     :Database(bundlePath,
               inConfig,
+              tuning,
               findOrCreateBundle(bundlePath,
                                  (inConfig.flags & kC4DB_Create) != 0,
                                  inConfig.storageEngine))
@@ -117,11 +119,13 @@ namespace c4Internal {
     
     Database::Database(const string &bundlePath,
                        const C4DatabaseConfig &inConfig,
+                       const C4StorageTuning &tuning,
                        FilePath &&dataFilePath)
     :_name(dataFilePath.dir().unextendedName())
     ,_parentDirectory(dataFilePath.dir().parentDir())
     ,_config{slice(_parentDirectory), inConfig.flags, inConfig.encryptionKey}
     ,_configV1(inConfig)
+    ,_storageTuning(tuning)
     ,_encoder(new fleece::impl::Encoder())
     {
         // Set up DataFile options:
@@ -131,6 +135,15 @@ namespace c4Internal {
         options.writeable = (_config.flags & kC4DB_ReadOnly) == 0;
         options.upgradeable = (_config.flags & kC4DB_NoUpgrade) == 0;
         options.useDocumentKeys = true;
+        if (tuning.profile > kC4StorageServer)     // check before narrowing to the enum type
+            error::_throw(error::InvalidParameter, "Unknown storage profile %u",
+                          (unsigned)tuning.profile);
+        options.tuning.profile = (DataFile::Tuning::Profile)tuning.profile;
+        options.tuning.pageSize = tuning.pageSize;
+        options.tuning.cacheSize = tuning.cacheSize;
+        options.tuning.mmapSize = tuning.mmapSize;
+        options.tuning.journalSizeLimit = tuning.journalSizeLimit;
+        options.tuning.walAutoCheckpoint = tuning.walAutoCheckpoint;
         options.encryptionAlgorithm = (EncryptionAlgorithm)_config.encryptionKey.algorithm;
         if (options.encryptionAlgorithm != kNoEncryption) {
 #ifdef COUCHBASE_ENTERPRISE
@@ -433,6 +446,7 @@ namespace c4Internal {
         FilePath blobStorePath = path().subdirectoryNamed(dirname);
         auto options = BlobStore::Options::defaults;
         options.create = options.writeable = (_config.flags & kC4DB_ReadOnly) == 0;
+        options.chunked = (_config.flags & kC4DB_ChunkedBlobs) != 0;
         options.encryptionAlgorithm =(EncryptionAlgorithm)encryptionKey.algorithm;
         if (options.encryptionAlgorithm != kNoEncryption) {
             options.encryptionKey = alloc_slice(encryptionKey.bytes, sizeof(encryptionKey.bytes));
@@ -771,4 +785,14 @@ namespace c4Internal {
         return true;
     }
 
+
+    bool Database::createIndex(slice name, slice indexSpecJSON, IndexSpec::Type type,
+                               const IndexSpec::Options *options)
+    {
+        bool created = defaultKeyStore().createIndex(name, indexSpecJSON, type, options);
+        if (created && options && options->deferUpdates && _housekeeper)
+            _housekeeper->deferredIndexCreated();
+        return created;
+    }
+
 }
@@ -51,7 +51,7 @@ namespace c4Internal {
     /** A top-level LiteCore database. */
     class Database : public RefCounted, public DataFile::Delegate, public fleece::InstanceCountedIn<Database> {
     public:
-        Database(const string &path, C4DatabaseConfig config);
+        Database(const string &path, C4DatabaseConfig config, const C4StorageTuning &tuning = {});
 
         void close();
         void deleteDatabase();
@@ -84,6 +84,7 @@ namespace c4Internal {
 
         const C4DatabaseConfig2* config() const         {return &_config;}
         const C4DatabaseConfig* configV1() const        {return &_configV1;};   // TODO: DEPRECATED
+        const C4StorageTuning* storageTuning() const    {return &_storageTuning;}
 
         Transaction& transaction() const;
 
@@ -127,6 +128,8 @@ namespace c4Internal {
         bool purgeDocument(slice docID);
         int64_t purgeExpiredDocs();
         bool setExpiration(slice docID, expiration_t);
+        bool createIndex(slice name, slice indexSpecJSON, IndexSpec::Type,
+                         const IndexSpec::Options*);
         bool startHousekeeping();
 
         void validateRevisionBody(slice body);
@@ -168,7 +171,8 @@ namespace c4Internal {
         void mustNotBeInTransaction();
 
     private:
-        Database(const string &bundlePath, const C4DatabaseConfig&, FilePath &&dataFilePath);
+        Database(const string &bundlePath, const C4DatabaseConfig&, const C4StorageTuning&,
+                 FilePath &&dataFilePath);
         static FilePath findOrCreateBundle(const string &path, bool canCreate,
                                            C4StorageEngine &outStorageEngine);
         static bool deleteDatabaseFileAtPath(const string &dbPath, C4StorageEngine);
@@ -189,6 +193,7 @@ namespace c4Internal {
         const string                _parentDirectory;       // Path to parent directory
         C4DatabaseConfig2           _config;                // Configuration
         C4DatabaseConfig            _configV1;              // TODO: DEPRECATED
+        C4StorageTuning             _storageTuning;         // Storage-engine tuning
         unique_ptr<DataFile>        _dataFile;              // Underlying DataFile
         Transaction*                _transaction {nullptr}; // Current Transaction, or null
         int                         _transactionLevel {0};  // Nesting level of transaction
@@ -29,15 +29,31 @@ namespace litecore {
     using namespace actor;
     using namespace std;
 
+    // How long to wait after a commit before updating deferred indexes; this lets several
+    // consecutive transactions be indexed in one batch.
+    static constexpr auto kIndexUpdateDelay = chrono::milliseconds(100);
+
+    // Max number of docs to reindex per transaction, so the database isn't locked for too long.
+    static constexpr unsigned kIndexUpdateBatchSize = 100;
+
+
     Housekeeper::Housekeeper(Database *db)
     :Actor(DBLog, "Housekeeper")
     ,_bgdb(db->backgroundDatabase())
     ,_expiryTimer(std::bind(&Housekeeper::_doExpiration, this))
+    ,_indexTimer([this] {enqueue(FUNCTION_TO_QUEUE(Housekeeper::_updateIndexes));})
     { }
 
 
     void Housekeeper::start() {
-        enqueue(FUNCTION_TO_QUEUE(Housekeeper::_scheduleExpiration));
+        enqueue(FUNCTION_TO_QUEUE(Housekeeper::_start));
+    }
+
+
+    void Housekeeper::_start() {
+        _bgdb->addTransactionObserver(this);
+        _scheduleExpiration();
+        _updateIndexes();
     }
 
 
@@ -48,7 +64,9 @@ namespace litecore {
 
 
     void Housekeeper::_stop() {
+        _bgdb->removeTransactionObserver(this);
         _expiryTimer.stop();
+        _indexTimer.stop();
         LogVerbose(DBLog, "Housekeeper: stopped.");
     }
 
@@ -87,6 +105,45 @@ namespace litecore {
     }
 
 
+    // BackgroundDB::TransactionObserver method; called after any transaction commits.
+    void Housekeeper::transactionCommitted() {
+        if (_hasDeferredIndexes)
+            enqueue(FUNCTION_TO_QUEUE(Housekeeper::_scheduleIndexUpdate));
+    }
+
+
+    void Housekeeper::deferredIndexCreated() {
+        _hasDeferredIndexes = true;
+        enqueue(FUNCTION_TO_QUEUE(Housekeeper::_scheduleIndexUpdate));
+    }
+
+
+    void Housekeeper::_scheduleIndexUpdate() {
+        _indexTimer.fireEarlierAfter(kIndexUpdateDelay);
+    }
+
+
+    // Reindexes one batch of documents for deferred-update indexes. The new index rows are
+    // computed outside any transaction, then stored in a short one. If that did anything, the
+    // commit triggers transactionCommitted, which schedules the next batch.
+    void Housekeeper::_updateIndexes() {
+        unique_ptr<KeyStore::DeferredIndexUpdate> update;
+        _bgdb->use([&](DataFile *dataFile) {
+            if (!dataFile)
+                return;
+            KeyStore &store = dataFile->defaultKeyStore();
+            update = store.prepareDeferredIndexUpdate(kIndexUpdateBatchSize);
+            if (!update)
+                _hasDeferredIndexes = store.hasDeferredIndexes();
+        });
+        if (!update)
+            return;
+        _bgdb->useInTransaction([&](DataFile* dataFile, SequenceTracker*) -> bool {
+            return dataFile->defaultKeyStore().applyDeferredIndexUpdate(*update) > 0;
+        });
+    }
+
+
     void Housekeeper::documentExpirationChanged(expiration_t exp) {
         // This doesn't have to be enqueued, since Timer is thread-safe.
         if (exp == 0)
@@ -8,16 +8,21 @@
 #include "Base.hh"
 #include "Record.hh"
 #include "Actor.hh"
+#include "BackgroundDB.hh"
 #include "Timer.hh"
+#include <atomic>
 
 namespace c4Internal {
     class Database;
 }
 
 namespace litecore {
-    class BackgroundDB;
 
-    class Housekeeper : public actor::Actor {
+    /** Performs background maintenance tasks on a Database, using its BackgroundDB:
+        - Purges documents when they expire
+        - Updates indexes created with the `deferUpdates` option, after other transactions
+          commit. */
+    class Housekeeper : public actor::Actor, private BackgroundDB::TransactionObserver {
     public:
         /// Creates a Housekeeper for a Database.
         explicit Housekeeper(c4Internal::Database* NONNULL);
@@ -32,14 +37,22 @@ namespace litecore {
         /// reschedule its next expiration for earlier if necessary.
         void documentExpirationChanged(expiration_t exp);
 
+        /// Informs the Housekeeper that an index with deferred updates has been created.
+        void deferredIndexCreated();
+
     private:
+        void transactionCommitted() override;
         void _start();
         void _stop();
         void _scheduleExpiration();
         void _doExpiration();
+        void _scheduleIndexUpdate();
+        void _updateIndexes();
 
         BackgroundDB* _bgdb;
         actor::Timer _expiryTimer;
+        actor::Timer _indexTimer;
+        std::atomic<bool> _hasDeferredIndexes {true};   // False once none are found
     };
 
 
@@ -667,6 +667,11 @@ namespace c4Internal {
         return vdoc ? (TreeDocument*)vdoc->owner : nullptr;
     }
 
+    // Answers for a batch of docs whether each has the given revision, and if not, which of its
+    // revisions could be ancestors of it. Used by the replicator for every `changes` message,
+    // so it avoids the cost of loading documents: it reads only the metadata and rev tree of
+    // each doc (not its current body, which can be much larger), and scans the encoded rev tree
+    // in place instead of decoding it into a RevTree.
     vector<alloc_slice> TreeDocumentFactory::findAncestors(const vector<slice> &docIDs,
                                                            const vector<slice> &revIDs,
                                                            unsigned maxAncestors,
@@ -678,32 +683,64 @@ namespace c4Internal {
         for (ssize_t i = docIDs.size() - 1; i >= 0; --i)
             revMap[docIDs[i]] = revIDs[i];
         stringstream result;
+        vector<RawRevision::Scanned> revs;          // Reused for every doc, to avoid allocation
+        vector<RawRevision::ScannedRemote> remotes;
+        vector<slice> oldSchemaDocIDs;
+        bool readBodies = false;
 
         auto callback = [&](const RecordLite &rec) -> alloc_slice {
             // --- This callback runs inside the SQLite query ---
             // --- It will be called once for each docID in the vector ---
+            // In the 2.0 schema the entire rev tree is in the body, not in `extra`:
+            bool treeInBody = !rec.extra;
+            if (treeInBody && !readBodies) {
+                // The body wasn't read, so come back to this doc later. (rec.key is only valid
+                // during the callback, so remember the caller's copy of the docID.)
+                oldSchemaDocIDs.push_back(revMap.find(rec.key)->first);
+                return nullslice;
+            }
+            RawRevision::scanTree((treeInBody ? rec.body : rec.extra), revs, remotes);
+            if (revs.empty())
+                error::_throw(error::CorruptRevisionData);
+
             // Convert revID to encoded binary form:
             revidBuffer revID;
             revID.parse(revMap[rec.key]);
             auto revGeneration = revID.generation();
             C4FindDocAncestorsResultFlags status = {};
-            RevTree tree(rec.body, rec.extra, 0);
-            auto current = tree.currentRevision();
+
+            // The first rev is the current one; its body, if any, is in the record's body:
+            auto hasBody = [&](size_t i) {
+                return (i == 0 && !treeInBody) ? (rec.body.buf != nullptr) : revs[i].hasBody;
+            };
 
             // Does it exist in the doc?
-            if (const Rev *rev = tree[revID]) {
-                if (rev->isBodyAvailable())
+            auto found = find_if(revs.begin(), revs.end(), [&](const RawRevision::Scanned &rev) {
+                return rev.revID == revID;
+            });
+            if (found != revs.end()) {
+                int index = int(found - revs.begin());
+                if (hasBody(index))
                     status |= kRevsHaveLocal;
-                if (remoteDBID && rev == tree.latestRevisionOnRemote(remoteDBID))
-                    status |= kRevsAtThisRemote;
-                if (current != rev) {
-                    if (rev->isAncestorOf(current))
+                if (remoteDBID) {
+                    for (auto &remote : remotes) {
+                        if (remote.first == remoteDBID && int(remote.second) == index)
+                            status |= kRevsAtThisRemote;
+                    }
+                }
+                if (index != 0) {
+                    // Is it an ancestor of the current revision?
+                    int i = 0;
+                    do {
+                        i = revs[i].parentIndex;
+                    } while (i >= 0 && i != index);
+                    if (i == index)
                         status |= kRevsLocalIsNewer;
                     else
                         status |= kRevsConflict;
                 }
             } else {
-                if (current->revID.generation() < revGeneration)
+                if (revs[0].revID.generation() < revGeneration)
                     status |= kRevsLocalIsOlder;
                 else
                     status |= kRevsConflict;
@@ -719,11 +756,11 @@ namespace c4Internal {
             result << statusChar << '[';
             char expandedBuf[100];
             delimiter delim(",");
-            for (auto rev : tree.allRevisions()) {
-                if (rev->revID.generation() < revGeneration
-                            && !(mustHaveBodies && !rev->isBodyAvailable())) {
+            for (size_t i = 0; i < revs.size(); ++i) {
+                if (revs[i].revID.generation() < revGeneration
+                            && !(mustHaveBodies && !hasBody(i))) {
                     slice expanded(expandedBuf, sizeof(expandedBuf));
-                    if (rev->revID.expandInto(expanded)) {
+                    if (revs[i].revID.expandInto(expanded)) {
                         result << delim << '"' << expanded << '"';
                         if (delim.count() >= maxAncestors)
                             break;
@@ -733,7 +770,22 @@ namespace c4Internal {
             result << ']';
             return alloc_slice(result.str());
         };
-        return database()->dataFile()->defaultKeyStore().withDocBodies(docIDs, callback);
+
+        KeyStore &keyStore = database()->dataFile()->defaultKeyStore();
+        auto results = keyStore.withDocBodies(docIDs, callback, readBodies);
+        if (!oldSchemaDocIDs.empty()) {
+            // Look up the docs in the old schema again, this time reading their bodies:
+            readBodies = true;
+            auto oldResults = keyStore.withDocBodies(oldSchemaDocIDs, callback, readBodies);
+            unordered_map<slice,alloc_slice> oldResultMap;
+            for (size_t i = 0; i < oldSchemaDocIDs.size(); ++i)
+                oldResultMap[oldSchemaDocIDs[i]] = oldResults[i];
+            for (size_t i = 0; i < docIDs.size(); ++i) {
+                if (auto j = oldResultMap.find(docIDs[i]); j != oldResultMap.end())
+                    results[i] = j->second;
+            }
+        }
+        return results;
     }
 
 
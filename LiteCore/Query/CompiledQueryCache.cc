@@ -0,0 +1,98 @@
+//
+// CompiledQueryCache.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#include "CompiledQueryCache.hh"
+#include "Logging.hh"
+
+using namespace std;
+
+namespace litecore {
+
+    /*static*/ string CompiledQueryCache::makeKey(const string &keyStoreName,
+                                                  QueryLanguage language,
+                                                  slice text)
+    {
+        string key;
+        key.reserve(keyStoreName.size() + 2 + text.size);
+        key += keyStoreName;
+        key += '\0';
+        key += char('0' + int(language));
+        key.append((const char*)text.buf, text.size);
+        return key;
+    }
+
+
+    shared_ptr<const CompiledQuery> CompiledQueryCache::lookup(const string &keyStoreName,
+                                                               QueryLanguage language,
+                                                               slice queryText,
+                                                               int64_t schemaVersion,
+                                                               shared_ptr<SQLite::Statement> &outStatement)
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (schemaVersion != _schemaVersion) {
+            if (!_map.empty())
+                LogVerbose(QueryLog, "Schema changed; clearing compiled-query cache");
+            _clear();
+            _schemaVersion = schemaVersion;
+        }
+
+        auto i = _map.find(makeKey(keyStoreName, language, queryText));
+        if (i == _map.end()) {
+            ++_misses;
+            return nullptr;
+        }
+        ++_hits;
+        _lru.splice(_lru.begin(), _lru, i->second);     // Move entry to the front
+        auto &compiled = i->second->second;
+        // Only the cache itself holds the statement, so it's not in use:
+        if (compiled->statement.use_count() == 1)
+            outStatement = compiled->statement;
+        return compiled;
+    }
+
+
+    void CompiledQueryCache::insert(const string &keyStoreName,
+                                    QueryLanguage language,
+                                    slice queryText,
+                                    shared_ptr<const CompiledQuery> compiled)
+    {
+        lock_guard<mutex> lock(_mutex);
+        string key = makeKey(keyStoreName, language, queryText);
+        if (auto i = _map.find(key); i != _map.end()) {
+            _lru.erase(i->second);
+            _map.erase(i);
+        }
+        _lru.emplace_front(key, move(compiled));
+        _map.emplace(move(key), _lru.begin());
+        if (_lru.size() > _capacity) {
+            _map.erase(_lru.back().first);
+            _lru.pop_back();
+        }
+    }
+
+
+    void CompiledQueryCache::clear() {
+        lock_guard<mutex> lock(_mutex);
+        _clear();
+    }
+
+
+    void CompiledQueryCache::_clear() {
+        _map.clear();
+        _lru.clear();
+    }
+
+
+    CompiledQueryCache::Stats CompiledQueryCache::stats() const {
+        lock_guard<mutex> lock(_mutex);
+        Stats s;
+        s.hits = _hits;
+        s.misses = _misses;
+        s.count = _lru.size();
+        return s;
+    }
+
+}
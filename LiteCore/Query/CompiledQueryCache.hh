@@ -0,0 +1,96 @@
+//
+// CompiledQueryCache.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "KeyStore.hh"
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SQLite {
+    class Statement;
+}
+
+namespace litecore {
+
+    /** The result of compiling a query: everything SQLiteQuery's constructor derives from the
+        query text, including the prepared SQLite statement. */
+    struct CompiledQuery {
+        alloc_slice                     json;           // JSON form of the query
+        std::string                     sql;            // Translated SQL
+        std::set<std::string>           parameters;     // Names of required bindable parameters
+        std::vector<std::string>        ftsTables;      // Names of the FTS tables used
+        std::vector<std::string>        columnTitles;   // Titles of result columns
+        unsigned                        firstCustomResultColumn; // Index of 1st column in WHAT
+        bool                            usesExpiration; // Does query use the expiration column?
+        std::shared_ptr<SQLite::Statement> statement;   // Prepared statement
+    };
+
+
+    /** A per-DataFile LRU cache of CompiledQuery objects, keyed by KeyStore, language and query
+        text. This saves apps that create lots of short-lived query objects from re-parsing and
+        re-preparing the same queries.
+
+        The cache is cleared when indexes are created or deleted, and whenever the SQLite schema
+        version changes (which also catches schema changes made by other connections), since
+        the translated SQL depends on which index tables exist.
+
+        A prepared statement can only be used by one query at a time, so `lookup` only hands
+        out the cached statement when no other query is using it; otherwise the caller has to
+        prepare its own from the cached SQL. */
+    class CompiledQueryCache {
+    public:
+        static constexpr size_t kDefaultCapacity = 50;
+
+        struct Stats {
+            uint64_t hits {0};      ///< Number of lookups that found a cached query
+            uint64_t misses {0};    ///< Number of lookups that didn't
+            size_t   count {0};     ///< Number of queries currently cached
+        };
+
+        explicit CompiledQueryCache(size_t capacity =kDefaultCapacity)
+        :_capacity(capacity)
+        { }
+
+        /** Looks up a compiled query. `schemaVersion` is the current SQLite schema version; if
+            it's changed since the last call, the cache is cleared first.
+            On a hit, `outStatement` is set to the cached statement if it's not in use. */
+        std::shared_ptr<const CompiledQuery> lookup(const std::string &keyStoreName,
+                                                    QueryLanguage,
+                                                    slice queryText,
+                                                    int64_t schemaVersion,
+                                                    std::shared_ptr<SQLite::Statement> &outStatement);
+
+        /** Adds a compiled query to the cache, evicting the least recently used one if full. */
+        void insert(const std::string &keyStoreName,
+                    QueryLanguage,
+                    slice queryText,
+                    std::shared_ptr<const CompiledQuery>);
+
+        /** Removes all cached queries. */
+        void clear();
+
+        Stats stats() const;
+
+    private:
+        using Entry = std::pair<std::string, std::shared_ptr<const CompiledQuery>>;
+
+        static std::string makeKey(const std::string &keyStoreName, QueryLanguage, slice text);
+        void _clear();
+
+        size_t const                _capacity;
+        mutable std::mutex          _mutex;
+        std::list<Entry>            _lru;       // Most recently used first
+        std::unordered_map<std::string, std::list<Entry>::iterator> _map;
+        int64_t                     _schemaVersion {-1};
+        uint64_t                    _hits {0}, _misses {0};
+    };
+
+}
@@ -41,6 +41,7 @@ namespace litecore {
             bool ignoreDiacritics;  ///< True to strip diacritical marks/accents from letters
             bool disableStemming;   ///< Disables stemming
             const char* stopWords;  ///< NULL for default, or comma-delimited string, or empty
+            bool deferUpdates;      ///< Update index in background, not on every save
         };
 
         IndexSpec(std::string name_,
@@ -116,6 +116,7 @@ namespace litecore {
         }
         LogTo(QueryLog, "Creating %s index: %s", spec.typeName(), indexSQL.c_str());
         exec(indexSQL);
+        _queryCache.clear();    // Queries may compile differently now
         registerIndex(spec, keyStore->name(), indexTableName);
         return true;
     }
@@ -129,6 +130,7 @@ namespace litecore {
         LogTo(QueryLog, "Deleting %s index '%s'",
               spec.typeName(), spec.name.c_str());
         unregisterIndex(spec.name);
+        _queryCache.clear();
         if (spec.type != IndexSpec::kFullText)
             exec(CONCAT("DROP INDEX IF EXISTS \"" << spec.name << "\""));
         if (!spec.indexTableName.empty())
@@ -147,6 +149,8 @@ namespace litecore {
 
         LogTo(QueryLog, "Dropping unused index table '%s'", tableName.c_str());
         exec(CONCAT("DROP TABLE \"" << tableName << "\""));
+        // (Dropping the pending table, if any, also drops its trigger.)
+        exec(CONCAT("DROP TABLE IF EXISTS \"" << SQLiteKeyStore::pendingTableName(tableName) << "\""));
 
         stringstream sql;
         static const char* kTriggerSuffixes[] = {"ins", "del", "upd", "preupdate", "postupdate",
@@ -486,31 +486,6 @@ namespace litecore {
     }
 
 
-#pragma mark - REVISION HISTORY:
-
-
-    // fl_callback(docID, revID, body, extra, sequence, callback) -> string
-    static void fl_callback(sqlite3_context* ctx, int argc, sqlite3_value **argv) noexcept {
-        RecordLite rec;
-        rec.key = valueAsSlice(argv[0]);
-        rec.version = valueAsSlice(argv[1]);
-        rec.body = valueAsSlice(argv[2]);
-        rec.extra = valueAsSlice(argv[3]);
-        rec.sequence = sqlite3_value_int(argv[4]);
-        auto callback = sqlite3_value_pointer(argv[5], kWithDocBodiesCallbackPointerType);
-        if (!callback || !rec.key) {
-            sqlite3_result_error(ctx, "Missing or invalid callback", -1);
-            return;
-        }
-        try {
-            alloc_slice result = (*(KeyStore::WithDocBodyCallback*)callback)(rec);
-            setResultTextFromSlice(ctx, result);
-        } catch (const std::exception &) {
-            sqlite3_result_error(ctx, "fl_callback: exception!", -1);
-        }
-    }
-
-
 #pragma mark - REGISTRATION:
 
 
@@ -530,7 +505,6 @@ namespace litecore {
         { "fl_bool",           1, fl_bool },
         { "array_of",         -1, array_of },
         { "dict_of",          -1, dict_of },
-        { "fl_callback",       6, fl_callback },
         { }
     };
 
@@ -59,13 +59,34 @@ namespace litecore {
         string whereOldSQL = qp.whereClauseSQL(where, "old");
 
         // Build the SQL that creates an FTS table, including the tokenizer options:
-        {
-            stringstream sql;
-            sql << "CREATE VIRTUAL TABLE \"" << ftsTableName << "\" USING fts4(" << columns << ", ";
-            writeTokenizerOptions(sql, spec.optionsPtr());
-            sql << ")";
-            if (!db().createIndex(spec, this, ftsTableName, sql.str()))
+        stringstream sql;
+        sql << "CREATE VIRTUAL TABLE \"" << ftsTableName << "\" USING fts4(" << columns << ", ";
+        writeTokenizerOptions(sql, spec.optionsPtr());
+        sql << ")";
+
+        auto options = spec.optionsPtr();
+        bool deferred = options && options->deferUpdates;
+        string pendingTable = pendingTableName(ftsTableName);
+        if (!db().createIndex(spec, this, ftsTableName, sql.str())) {
+            // An identical FTS table exists; only switch it between immediate & deferred updates:
+            if (deferred == db().tableExists(pendingTable))
                 return false;
+            LogTo(QueryLog, "Switching FTS table '%s' to %s updates",
+                  ftsTableName.c_str(), (deferred ? "deferred" : "immediate"));
+            dropFTSTriggers(ftsTableName);
+            if (deferred) {
+                // The existing index is current, so nothing is pending yet:
+                createDeferredFTSTriggers(ftsTableName);
+                return true;
+            }
+            db().exec(CONCAT("DROP TABLE \"" << pendingTable << "\""));
+            db().exec(CONCAT("DELETE FROM \"" << ftsTableName << "\""));
+        } else if (deferred) {
+            createDeferredFTSTriggers(ftsTableName);
+            // All existing documents are pending:
+            db().exec(CONCAT("INSERT INTO \"" << pendingTable << "\" (docid) "
+                             "SELECT rowid FROM kv_" << name() << " WHERE (flags & 1) = 0"));
+            return true;
         }
 
         // Index the existing records:
@@ -103,6 +124,63 @@ namespace litecore {
     }
 
 
+    // Creates a "pending" table for a FTS table, and triggers that add documents to it when
+    // they're saved, instead of indexing them in the writer's transaction. The documents are
+    // indexed later, in batches: prepareDeferredIndexUpdate extracts their text outside any
+    // transaction, and applyDeferredIndexUpdate inserts it into the FTS table (which is when
+    // FTS tokenizes it) in a separate short transaction.
+    void SQLiteKeyStore::createDeferredFTSTriggers(const string &ftsTableName) {
+        string pendingTable = pendingTableName(ftsTableName);
+        LogTo(QueryLog, "Creating pending table '%s' for deferred updates", pendingTable.c_str());
+        db().exec(CONCAT("CREATE TABLE \"" << pendingTable << "\" "
+                         "(docid INTEGER PRIMARY KEY) WITHOUT ROWID"));
+
+        // Set up triggers to add changed documents to the pending table
+        // ...on insertion or update:
+        string pendingTriggerExpr = CONCAT("INSERT OR IGNORE INTO \"" << pendingTable << "\" "
+                                           "(docid) VALUES (new.rowid)");
+        createTrigger(ftsTableName, "ins",
+                      "AFTER INSERT",
+                      "",
+                      pendingTriggerExpr);
+        createTrigger(ftsTableName, "postupdate",
+                      "AFTER UPDATE OF body, flags",
+                      "",
+                      pendingTriggerExpr);
+
+        // ...on delete, remove the document from the index right away:
+        createTrigger(ftsTableName, "del",
+                      "AFTER DELETE",
+                      "",
+                      CONCAT("DELETE FROM \"" << ftsTableName << "\" WHERE docid = old.rowid"));
+    }
+
+
+    void SQLiteKeyStore::dropFTSTriggers(const string &ftsTableName) {
+        stringstream sql;
+        for (const char *suffix : {"ins", "del", "preupdate", "postupdate"})
+            sql << "DROP TRIGGER IF EXISTS \"" << ftsTableName << "::" << suffix << "\";";
+        db().exec(sql.str());
+    }
+
+
+    // Gets the SQL that prepareDeferredIndexUpdate uses to extract a document's indexed text.
+    void SQLiteKeyStore::deferredFTSSQL(const IndexSpec &spec, DeferredIndex &index) const {
+        QueryParser qp(*this);
+        qp.setBodyColumnName("doc.body");
+        vector<string> colNames;
+        for (Array::iterator i(spec.what()); i; ++i) {
+            colNames.push_back(CONCAT('"' << QueryParser::FTSColumnName(i.value()) << '"'));
+            index.valueSQL.push_back(qp.FTSExpressionSQL(i.value()));
+        }
+        index.columns = join(colNames, ", ");
+        qp.setBodyColumnName("body");
+        index.conditionSQL = qp.whereClauseSQL(spec.where(), "doc");
+        if (hasPrefix(index.conditionSQL, "WHERE "))
+            index.conditionSQL.erase(0, 6);
+    }
+
+
     string SQLiteKeyStore::FTSTableName(const std::string &property) const {
         return tableName() + "::" + property;
     }
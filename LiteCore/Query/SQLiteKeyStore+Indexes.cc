@@ -27,6 +27,8 @@
 #include "SQLiteCpp/SQLiteCpp.h"
 #include "Stopwatch.hh"
 #include "Array.hh"
+#include <algorithm>
+#include <sstream>
 
 using namespace std;
 using namespace fleece;
@@ -44,6 +46,9 @@ namespace litecore {
          * A SQL table named `kv_default:prediction:DIGEST`, where DIGEST is a unique digest
             of the prediction function name and the parameter dictionary
          * An index on that table named `NAME`
+     - A FTS or predictive index created with the `deferUpdates` option also has a "pending"
+       table named after its index table plus `:pending`, listing the rowids of documents that
+       need to be reindexed. (See updateDeferredIndexes, below.)
 
      Index table:
         - name (string primary key)
@@ -109,6 +114,235 @@ namespace litecore {
     }
 
 
+#pragma mark - DEFERRED UPDATES:
+
+
+    /* An index with deferred updates has a "pending" table, whose rows are the rowids of
+       documents that need to be reindexed; triggers on the kv table add to it. Updating the
+       index takes two steps, so that evaluating the index expressions (including a slow
+       prediction model) never runs under the write lock:
+       1. prepareDeferredIndexUpdate reads a batch of pending documents and computes their
+          index rows, outside any transaction. (For a FTS index that's the text to index; FTS
+          tokenizes it when it's inserted in step 2.)
+       2. applyDeferredIndexUpdate, in a short transaction, replaces those documents' rows in
+          the index table and removes them from the pending table. A document that has changed
+          since step 1 is skipped, and stays pending. */
+
+
+    namespace {
+        // A value read from a SQLite column, to be bound to another statement later.
+        struct SQLValue {
+            explicit SQLValue(const SQLite::Column &col)
+            :type(col.getType())
+            {
+                switch (type) {
+                    case SQLITE_INTEGER: integer = col.getInt64(); break;
+                    case SQLITE_FLOAT:   real = col.getDouble(); break;
+                    case SQLITE_TEXT:
+                    case SQLITE_BLOB:    data = alloc_slice(col.getBlob(), col.getBytes()); break;
+                }
+            }
+
+            void bind(SQLite::Statement &stmt, int param) const {
+                switch (type) {
+                    case SQLITE_INTEGER: stmt.bind(param, (long long)integer); break;
+                    case SQLITE_FLOAT:   stmt.bind(param, real); break;
+                    case SQLITE_TEXT:    stmt.bindNoCopy(param, (const char*)data.buf, (int)data.size); break;
+                    case SQLITE_BLOB:    stmt.bindNoCopy(param, data.buf, (int)data.size); break;
+                    default:             stmt.bind(param); break;
+                }
+            }
+
+            int         type;
+            int64_t     integer {0};
+            double      real {0};
+            alloc_slice data;
+        };
+
+        // A pending document and its newly computed index row.
+        struct PreparedDoc {
+            int64_t             docid;
+            int64_t             sequence;       // 0 if the document doesn't exist
+            bool                indexed;        // False if the document isn't in the index
+            vector<SQLValue>    values;
+        };
+
+        struct PreparedIndex {
+            string              indexTable, pendingTable, columns;
+            vector<PreparedDoc> docs;
+        };
+
+        class SQLiteDeferredIndexUpdate : public KeyStore::DeferredIndexUpdate {
+        public:
+            unsigned count() const override {
+                unsigned n = 0;
+                for (auto &index : indexes)
+                    n += unsigned(index.docs.size());
+                return n;
+            }
+
+            vector<PreparedIndex> indexes;
+        };
+    }
+
+
+    /*static*/ string SQLiteKeyStore::pendingTableName(const string &indexTableName) {
+        return indexTableName + ":pending";
+    }
+
+
+    vector<string> SQLiteKeyStore::pendingTables() const {
+        vector<string> tables;
+        SQLite::Statement stmt(db(), "SELECT name FROM sqlite_master "
+                                     "WHERE type='table' AND name GLOB ?");
+        stmt.bind(1, pendingTableName(tableName() + ":*"));
+        while (stmt.executeStep())
+            tables.push_back(stmt.getColumn(0).getString());
+        return tables;
+    }
+
+
+    bool SQLiteKeyStore::hasDeferredIndexes() const {
+        return !pendingTables().empty();
+    }
+
+
+    vector<SQLiteKeyStore::DeferredIndex> SQLiteKeyStore::deferredIndexes() const {
+        vector<DeferredIndex> result;
+        auto pendingTableNames = pendingTables();
+        if (pendingTableNames.empty())
+            return result;
+        auto specs = db().getIndexes(this);
+        for (auto &pendingTable : pendingTableNames) {
+            DeferredIndex index;
+            index.pendingTable = pendingTable;
+            index.indexTable = pendingTable.substr(0, pendingTable.size()
+                                                      - pendingTableName("").size());
+            auto spec = find_if(specs.begin(), specs.end(), [&](const SQLiteIndexSpec &s) {
+                return s.indexTableName == index.indexTable;
+            });
+            if (spec == specs.end())
+                continue;
+            switch (spec->type) {
+                case IndexSpec::kFullText:
+                    deferredFTSSQL(*spec, index);
+                    break;
+#ifdef COUCHBASE_ENTERPRISE
+                case IndexSpec::kPredictive:
+                    deferredPredictionSQL(*spec, index);
+                    break;
+#endif
+                default:
+                    continue;
+            }
+            result.push_back(move(index));
+        }
+        return result;
+    }
+
+
+    unique_ptr<KeyStore::DeferredIndexUpdate>
+    SQLiteKeyStore::prepareDeferredIndexUpdate(unsigned maxRecords) {
+        auto update = make_unique<SQLiteDeferredIndexUpdate>();
+        unsigned total = 0;
+        for (auto &index : deferredIndexes()) {
+            if (total >= maxRecords)
+                break;
+            // The index's expressions are only evaluated for documents that belong in it:
+            string indexed = CONCAT("doc.rowid NOT NULL AND (" << index.conditionSQL << ")");
+            stringstream sql;
+            sql << "SELECT p.docid, coalesce(doc.sequence, 0), " << indexed;
+            for (auto &value : index.valueSQL)
+                sql << ", CASE WHEN " << indexed << " THEN " << value << " END";
+            sql << " FROM \"" << index.pendingTable << "\" AS p "
+                   "LEFT JOIN " << tableName() << " AS doc ON doc.rowid = p.docid "
+                   "LIMIT " << (maxRecords - total);
+
+            PreparedIndex prepared {index.indexTable, index.pendingTable, index.columns, {}};
+            SQLite::Statement stmt(db(), sql.str());
+            LogStatement(stmt);
+            while (stmt.executeStep()) {
+                PreparedDoc doc {stmt.getColumn(0).getInt64(),
+                                 stmt.getColumn(1).getInt64(),
+                                 stmt.getColumn(2).getInt() != 0,
+                                 {}};
+                for (int i = 0; i < int(index.valueSQL.size()); ++i)
+                    doc.values.emplace_back(stmt.getColumn(3 + i));
+                prepared.docs.push_back(move(doc));
+            }
+            total += unsigned(prepared.docs.size());
+            if (!prepared.docs.empty())
+                update->indexes.push_back(move(prepared));
+        }
+        if (total == 0)
+            return nullptr;
+        return update;
+    }
+
+
+    unsigned SQLiteKeyStore::applyDeferredIndexUpdate(DeferredIndexUpdate &u) {
+        auto &update = dynamic_cast<SQLiteDeferredIndexUpdate&>(u);
+        SQLite::Statement getSequence(db(), CONCAT("SELECT sequence FROM " << tableName() <<
+                                                   " WHERE rowid=?"));
+        unsigned total = 0;
+        for (auto &index : update.indexes) {
+            size_t nValues = index.docs.front().values.size();
+            string params;
+            for (size_t i = 0; i < nValues; ++i)
+                params += ", ?";
+            SQLite::Statement deleteRow(db(), CONCAT("DELETE FROM \"" << index.indexTable <<
+                                                     "\" WHERE docid=?"));
+            SQLite::Statement insertRow(db(), CONCAT("INSERT INTO \"" << index.indexTable << "\" "
+                                                     "(docid, " << index.columns << ") "
+                                                     "VALUES (?" << params << ")"));
+            SQLite::Statement deletePending(db(), CONCAT("DELETE FROM \"" << index.pendingTable <<
+                                                         "\" WHERE docid=?"));
+            for (auto &doc : index.docs) {
+                getSequence.bind(1, (long long)doc.docid);
+                int64_t sequence = getSequence.executeStep() ? getSequence.getColumn(0).getInt64() : 0;
+                getSequence.reset();
+                if (sequence != doc.sequence)
+                    continue;       // Changed since it was prepared; leave it pending
+
+                deleteRow.bind(1, (long long)doc.docid);
+                deleteRow.exec();
+                deleteRow.reset();
+                if (doc.indexed) {
+                    insertRow.bind(1, (long long)doc.docid);
+                    for (size_t i = 0; i < doc.values.size(); ++i)
+                        doc.values[i].bind(insertRow, int(i + 2));
+                    insertRow.exec();
+                    insertRow.reset();
+                }
+                deletePending.bind(1, (long long)doc.docid);
+                deletePending.exec();
+                deletePending.reset();
+                ++total;
+            }
+        }
+        if (total > 0)
+            LogVerbose(QueryLog, "Updated deferred indexes of %u docs", total);
+        return total;
+    }
+
+
+    sequence_t SQLiteKeyStore::indexedSequence() const {
+        // The indexes are current up to (but not including) the oldest pending document:
+        sequence_t oldestPending = 0;
+        for (auto &pending : pendingTables()) {
+            auto seq = (sequence_t) db().intQuery(
+                                CONCAT("SELECT min(sequence) FROM " << tableName() <<
+                                       " JOIN \"" << pending << "\" ON rowid = docid").c_str());
+            if (seq > 0 && (oldestPending == 0 || seq < oldestPending))
+                oldestPending = seq;
+        }
+        return oldestPending ? oldestPending - 1 : lastSequence();
+    }
+
+
+#pragma mark - SPECIAL INDEXES:
+
+
     // Creates the special by-sequence index
     void SQLiteKeyStore::createSequenceIndex() {
         if (!_createdSeqIndex) {
@@ -26,6 +26,7 @@
 #include "StringUtil.hh"
 #include "MutableArray.hh"
 #include "SQLiteCpp/SQLiteCpp.h"
+#include <sstream>
 
 using namespace std;
 using namespace fleece;
@@ -46,7 +47,8 @@ namespace litecore {
         auto pred = MutableArray::newArray(expression);
         if (pred->count() > 3)
             pred->remove(3, pred->count() - 3);
-        string predTableName = createPredictionTable(pred, spec.optionsPtr());
+        bool modeChanged;
+        string predTableName = createPredictionTable(pred, spec.optionsPtr(), modeChanged);
 
         // The final parameters are the result properties to create a SQL index on:
         Array::iterator i(expression);
@@ -60,18 +62,22 @@ namespace litecore {
             return true;
         }
         
-        // Create value index on the specified result properties:
-        return createIndex(spec, predTableName, i);
+        // Create value index on the specified result properties. (Even if it already exists,
+        // switching the table between immediate and deferred updates is a change to commit.)
+        return createIndex(spec, predTableName, i) || modeChanged;
     }
 
 
     string SQLiteKeyStore::createPredictionTable(const Value *expression,
-                                                 const IndexSpec::Options *options)
+                                                 const IndexSpec::Options *options,
+                                                 bool &outModeChanged)
     {
         // Derive the table name from the expression (path) it unnests:
         QueryParser qp(*this);
         auto kvTableName = tableName();
         auto predTableName = qp.predictiveTableName(expression);
+        bool deferred = options && options->deferUpdates;
+        outModeChanged = false;
 
         // Create the index table, unless an identical one already exists:
         string sql = CONCAT("CREATE TABLE \"" << predTableName << "\" "
@@ -83,46 +89,134 @@ namespace litecore {
                   expression->toJSONString().c_str());
             db().exec(sql);
 
-            // Populate the index-table with data from existing documents:
-            string predictExpr = qp.expressionSQL(expression);
-            db().exec(CONCAT("INSERT INTO \"" << predTableName << "\" (docid, body) "
-                             "SELECT rowid, " << predictExpr <<
-                             "FROM " << kvTableName << " WHERE (flags & 1) = 0"));
-
-            // Set up triggers to keep the index-table up to date
-            // ...on insertion:
-            qp.setBodyColumnName("new.body");
-            predictExpr = qp.expressionSQL(expression);
-            string insertTriggerExpr = CONCAT("INSERT INTO \"" << predTableName <<
-                                              "\" (docid, body) "
-                                              "VALUES (new.rowid, " << predictExpr << ")");
-            createTrigger(predTableName, "ins",
-                          "AFTER INSERT",
-                          "WHEN (new.flags & 1) = 0",
-                          insertTriggerExpr);
-
-            // ...on delete:
-            string deleteTriggerExpr = CONCAT("DELETE FROM \"" << predTableName << "\" "
-                                              "WHERE docid = old.rowid");
-            createTrigger(predTableName, "del",
-                          "BEFORE DELETE",
-                          "WHEN (old.flags & 1) = 0",
-                          deleteTriggerExpr);
-
-            // ...on update:
-            createTrigger(predTableName, "preupdate",
-                          "BEFORE UPDATE OF body, flags",
-                          "WHEN (old.flags & 1) = 0",
-                          deleteTriggerExpr);
-            createTrigger(predTableName, "postupdate",
-                          "AFTER UPDATE OF body, flags",
-                          "WHEN (new.flags) & 1 = 0",
-                          insertTriggerExpr);
+            if (deferred) {
+                createDeferredPredictionTriggers(predTableName);
+                // All existing documents are pending:
+                db().exec(CONCAT("INSERT INTO \"" << pendingTableName(predTableName) << "\" "
+                                 "(docid) SELECT rowid FROM " << kvTableName <<
+                                 " WHERE (flags & 1) = 0"));
+            } else {
+                createPredictionTriggers(expression, predTableName);
+            }
+
+        } else if (deferred != db().tableExists(pendingTableName(predTableName))) {
+            // The table exists but is updated the other way, so switch it over:
+            LogTo(QueryLog, "Switching predictive table '%s' to %s updates",
+                  predTableName.c_str(), (deferred ? "deferred" : "immediate"));
+            dropPredictionTriggers(predTableName);
+            if (deferred) {
+                // The existing predictions are current, so nothing is pending yet:
+                createDeferredPredictionTriggers(predTableName);
+            } else {
+                db().exec(CONCAT("DROP TABLE \"" << pendingTableName(predTableName) << "\""));
+                db().exec(CONCAT("DELETE FROM \"" << predTableName << "\""));
+                createPredictionTriggers(expression, predTableName);
+            }
+            outModeChanged = true;
         }
         return predTableName;
     }
 
 
+    // Populates a prediction table, and creates triggers that keep it up to date by calling the
+    // model whenever a document is saved.
+    void SQLiteKeyStore::createPredictionTriggers(const Value *expression,
+                                                  const string &predTableName)
+    {
+        QueryParser qp(*this);
+        auto kvTableName = tableName();
+
+        // Populate the index-table with data from existing documents:
+        string predictExpr = qp.expressionSQL(expression);
+        db().exec(CONCAT("INSERT INTO \"" << predTableName << "\" (docid, body) "
+                         "SELECT rowid, " << predictExpr <<
+                         "FROM " << kvTableName << " WHERE (flags & 1) = 0"));
+
+        // Set up triggers to keep the index-table up to date
+        // ...on insertion:
+        qp.setBodyColumnName("new.body");
+        predictExpr = qp.expressionSQL(expression);
+        string insertTriggerExpr = CONCAT("INSERT INTO \"" << predTableName <<
+                                          "\" (docid, body) "
+                                          "VALUES (new.rowid, " << predictExpr << ")");
+        createTrigger(predTableName, "ins",
+                      "AFTER INSERT",
+                      "WHEN (new.flags & 1) = 0",
+                      insertTriggerExpr);
+
+        // ...on delete:
+        string deleteTriggerExpr = CONCAT("DELETE FROM \"" << predTableName << "\" "
+                                          "WHERE docid = old.rowid");
+        createTrigger(predTableName, "del",
+                      "BEFORE DELETE",
+                      "WHEN (old.flags & 1) = 0",
+                      deleteTriggerExpr);
+
+        // ...on update:
+        createTrigger(predTableName, "preupdate",
+                      "BEFORE UPDATE OF body, flags",
+                      "WHEN (old.flags & 1) = 0",
+                      deleteTriggerExpr);
+        createTrigger(predTableName, "postupdate",
+                      "AFTER UPDATE OF body, flags",
+                      "WHEN (new.flags) & 1 = 0",
+                      insertTriggerExpr);
+    }
+
+
+    // Creates a "pending" table for a prediction table, and triggers that add documents to it
+    // when they're saved, instead of calling the model. The model is called later, outside the
+    // writer's transaction, by prepareDeferredIndexUpdate.
+    void SQLiteKeyStore::createDeferredPredictionTriggers(const string &predTableName) {
+        string pendingTable = pendingTableName(predTableName);
+        LogTo(QueryLog, "Creating pending table '%s' for deferred updates", pendingTable.c_str());
+        db().exec(CONCAT("CREATE TABLE \"" << pendingTable << "\" "
+                         "(docid INTEGER PRIMARY KEY) WITHOUT ROWID"));
+
+        // Set up triggers to add changed documents to the pending table
+        // ...on insertion or update:
+        string pendingTriggerExpr = CONCAT("INSERT OR IGNORE INTO \"" << pendingTable << "\" "
+                                           "(docid) VALUES (new.rowid)");
+        createTrigger(predTableName, "ins",
+                      "AFTER INSERT",
+                      "WHEN (new.flags & 1) = 0",
+                      pendingTriggerExpr);
+        createTrigger(predTableName, "postupdate",
+                      "AFTER UPDATE OF body, flags",
+                      "",
+                      pendingTriggerExpr);
+
+        // ...on delete, remove the prediction right away, since it's cheap:
+        createTrigger(predTableName, "del",
+                      "BEFORE DELETE",
+                      "WHEN (old.flags & 1) = 0",
+                      CONCAT("DELETE FROM \"" << predTableName << "\" "
+                             "WHERE docid = old.rowid"));
+    }
+
+
+    void SQLiteKeyStore::dropPredictionTriggers(const string &predTableName) {
+        stringstream sql;
+        for (const char *suffix : {"ins", "del", "preupdate", "postupdate"})
+            sql << "DROP TRIGGER IF EXISTS \"" << predTableName << "::" << suffix << "\";";
+        db().exec(sql.str());
+    }
+
+
+    // Gets the SQL that prepareDeferredIndexUpdate uses to recompute a document's prediction.
+    void SQLiteKeyStore::deferredPredictionSQL(const IndexSpec &spec, DeferredIndex &index) const {
+        // The prediction table's expression is the first three items of the PREDICTION() call:
+        auto pred = MutableArray::newArray(spec.what()->get(0)->asArray());
+        if (pred->count() > 3)
+            pred->remove(3, pred->count() - 3);
+        QueryParser qp(*this);
+        qp.setBodyColumnName("doc.body");
+        index.columns = "body";
+        index.valueSQL = {qp.expressionSQL(pred)};
+        index.conditionSQL = "(doc.flags & 1) = 0";
+    }
+
+
     string SQLiteKeyStore::predictiveTableName(const std::string &property) const {
         return tableName() + ":predict:" + property;
     }
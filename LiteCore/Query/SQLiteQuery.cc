@@ -18,6 +18,7 @@
 
 #include "SQLiteKeyStore.hh"
 #include "SQLiteDataFile.hh"
+#include "CompiledQueryCache.hh"
 #include "SQLite_Internal.hh"
 #include "Logging.hh"
 #include "Query.hh"
@@ -57,52 +58,87 @@ namespace litecore {
     public:
         SQLiteQuery(SQLiteKeyStore &keyStore, slice queryStr, QueryLanguage language)
         :Query(keyStore, queryStr, language)
+        {
+            // Look for an already-compiled query in the DataFile's cache:
+            auto &cache = keyStore.db().queryCache();
+            shared_ptr<const CompiledQuery> compiled = cache.lookup(keyStore.name(), language,
+                                                                    queryStr,
+                                                                    keyStore.db().sqliteSchemaVersion(),
+                                                                    _statement);
+            if (compiled) {
+                logVerbose("Using cached compiled query");
+                if (compiled->usesExpiration)
+                    keyStore.addExpiration();
+                if (!_statement)
+                    _statement.reset(keyStore.compile(compiled->sql));   // cached one is in use
+            } else {
+                compiled = compile(keyStore, queryStr, language);
+                _statement = compiled->statement;
+                cache.insert(keyStore.name(), language, queryStr, compiled);
+            }
+
+            _compiled = compiled;
+            _json = compiled->json;
+            _parameters = compiled->parameters;
+            _ftsTables = compiled->ftsTables;
+            _1stCustomResultColumn = compiled->firstCustomResultColumn;
+            _columnTitles = compiled->columnTitles;
+        }
+
+
+        shared_ptr<const CompiledQuery> compile(SQLiteKeyStore &keyStore,
+                                                slice queryStr,
+                                                QueryLanguage language)
         {
             static constexpr const char* kLanguageName[] = {"JSON", "N1QL"};
             logInfo("Compiling %s query: %.*s", kLanguageName[(int)language], SPLAT(queryStr));
 
+            auto compiled = make_shared<CompiledQuery>();
             switch (language) {
                 case QueryLanguage::kJSON:
-                    _json = queryStr;
+                    compiled->json = queryStr;
                     break;
                 case QueryLanguage::kN1QL: {
                     unsigned errPos;
                     FLMutableDict result = n1ql::parse(string(queryStr), &errPos);
                     if (!result)
                         throw Query::parseError("N1QL syntax error", errPos);
-                    _json = ((MutableDict*)result)->toJSON(true);
+                    compiled->json = ((MutableDict*)result)->toJSON(true);
                     FLMutableDict_Release(result);
                     break;
                 }
             }
 
             QueryParser qp(keyStore);
-            qp.parseJSON(_json);
+            qp.parseJSON(compiled->json);
 
-            _parameters = qp.parameters();
-            for (auto p = _parameters.begin(); p != _parameters.end();) {
+            compiled->parameters = qp.parameters();
+            auto &params = compiled->parameters;
+            for (auto p = params.begin(); p != params.end();) {
                 if (hasPrefix(*p, "opt_"))
-                    p = _parameters.erase(p);       // Optional param, don't warn if it's unbound
+                    p = params.erase(p);            // Optional param, don't warn if it's unbound
                 else
                     ++p;
             }
 
-            _ftsTables = qp.ftsTablesUsed();
-            for (auto &ftsTable : _ftsTables) {
+            compiled->ftsTables = qp.ftsTablesUsed();
+            for (auto &ftsTable : compiled->ftsTables) {
                 if (!keyStore.db().tableExists(ftsTable))
                     error::_throw(error::NoSuchIndex, "'match' test requires a full-text index");
             }
 
-            if (qp.usesExpiration())
+            compiled->usesExpiration = qp.usesExpiration();
+            if (compiled->usesExpiration)
                 keyStore.addExpiration();
 
-            string sql = qp.SQL();
-            logInfo("Compiled as %s", sql.c_str());
-            LogTo(SQL, "Compiled {Query#%u}: %s", getObjectRef(), sql.c_str());
-            _statement.reset(keyStore.compile(sql));
-            
-            _1stCustomResultColumn = qp.firstCustomResultColumn();
-            _columnTitles = qp.columnTitles();
+            compiled->sql = qp.SQL();
+            logInfo("Compiled as %s", compiled->sql.c_str());
+            LogTo(SQL, "Compiled {Query#%u}: %s", getObjectRef(), compiled->sql.c_str());
+            compiled->statement.reset(keyStore.compile(compiled->sql));
+
+            compiled->firstCustomResultColumn = qp.firstCustomResultColumn();
+            compiled->columnTitles = qp.columnTitles();
+            return compiled;
         }
 
 
@@ -184,6 +220,24 @@ namespace litecore {
             return _statement;
         }
 
+        // Returns a statement that runs this query on another connection to the same file
+        // (a pooled reader), using and updating that connection's compiled-query cache.
+        shared_ptr<SQLite::Statement> statementOn(SQLiteKeyStore &otherStore) const {
+            auto &cache = otherStore.db().queryCache();
+            shared_ptr<SQLite::Statement> statement;
+            auto compiled = cache.lookup(otherStore.name(), language(), expression(),
+                                         otherStore.db().sqliteSchemaVersion(), statement);
+            if (!compiled) {
+                auto copy = make_shared<CompiledQuery>(*_compiled);
+                copy->statement.reset(otherStore.compile(copy->sql));
+                statement = copy->statement;
+                cache.insert(otherStore.name(), language(), expression(), move(copy));
+            } else if (!statement) {
+                statement.reset(otherStore.compile(compiled->sql));
+            }
+            return statement;
+        }
+
         unsigned objectRef() const                  {return getObjectRef();}   // (for logging)
 
         set<string> _parameters;            // Names of the bindable parameters
@@ -195,6 +249,7 @@ namespace litecore {
         string loggingClassName() const override    {return "Query";}
 
     private:
+        shared_ptr<const CompiledQuery> _compiled;          // Result of compiling the query
         alloc_slice _json;                                  // Original JSON form of the query
         shared_ptr<SQLite::Statement> _statement;           // Compiled SQLite statement
         unique_ptr<SQLite::Statement> _matchedTextStatement;// Gets the matched text
@@ -351,12 +406,17 @@ namespace litecore {
     // which is then used as the data source of a SQLiteQueryEnum.
     class SQLiteQueryRunner {
     public:
-        SQLiteQueryRunner(SQLiteQuery *query, const Query::Options *options, sequence_t lastSequence, uint64_t purgeCount)
+        SQLiteQueryRunner(SQLiteQuery *query,
+                          shared_ptr<SQLite::Statement> statement,
+                          SharedKeys *documentKeys,
+                          const Query::Options *options,
+                          sequence_t lastSequence,
+                          uint64_t purgeCount)
         :_query(query)
         ,_lastSequence(lastSequence)
         ,_purgeCount(purgeCount)
-        ,_statement(query->statement())
-        ,_sk(query->keyStore().dataFile().documentKeys())
+        ,_statement(move(statement))
+        ,_sk(documentKeys)
         ,_options(options ? *options : Query::Options())
         {
             _statement->clearBindings();
@@ -521,15 +581,34 @@ namespace litecore {
     // The factory method that creates a SQLite QueryEnumerator, but only if the database has
     // changed since lastSeq.
     QueryEnumerator* SQLiteQuery::createEnumerator(const Options *options) {
+        DataFile &dataFile = keyStore().dataFile();
+        if (dataFile.canReadFromPool()) {
+            // Run the query on a pooled reader connection, so queries on different threads run
+            // in parallel instead of serializing on this DataFile's connection:
+            auto conn = dataFile.readConnectionPool().borrow();
+            auto &store = (SQLiteKeyStore&)conn->getKeyStore(keyStore().name(),
+                                                             keyStore().capabilities());
+            ReadOnlyTransaction t(*conn);
+            sequence_t curSeq = store.lastSequence();
+            uint64_t purgeCnt = store.purgeCount();
+            if(options && options->notOlderThan(curSeq, purgeCnt))
+                return nullptr;
+            SQLiteQueryRunner recorder(this, statementOn(store), conn->documentKeys(),
+                                       options, curSeq, purgeCnt);
+            return recorder.fastForward();
+        }
+
+        // Otherwise use my own connection, so the query sees the caller's transaction.
         // Start a read-only transaction, to ensure that the result of lastSequence() and purgeCount() will be
         // consistent with the query results.
-        ReadOnlyTransaction t(keyStore().dataFile());
+        ReadOnlyTransaction t(dataFile);
 
         sequence_t curSeq = lastSequence();
         uint64_t purgeCnt = purgeCount();
         if(options && options->notOlderThan(curSeq, purgeCnt))
             return nullptr;
-        SQLiteQueryRunner recorder(this, options, curSeq, purgeCnt);
+        SQLiteQueryRunner recorder(this, statement(), dataFile.documentKeys(),
+                                   options, curSeq, purgeCnt);
         return recorder.fastForward();
     }
 
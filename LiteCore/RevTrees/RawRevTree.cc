@@ -73,6 +73,38 @@ namespace litecore {
     }
 
 
+    void RawRevision::scanTree(slice raw_tree,
+                               vector<Scanned> &outRevs,
+                               vector<ScannedRemote> &outRemotes)
+    {
+        outRevs.clear();
+        outRemotes.clear();
+        const RawRevision *rawRev = (const RawRevision*)raw_tree.buf;
+        if (raw_tree.size < sizeof(uint32_t)
+                || fleece::endian::dec32(rawRev->size_BE) > raw_tree.size)
+            error::_throw(error::CorruptRevisionData);
+        for (; rawRev->isValid(); rawRev = rawRev->next()) {
+            auto parentIndex = endian::dec16(rawRev->parentIndex_BE);
+            outRevs.push_back({revid(rawRev->revID, rawRev->revIDLen),
+                               (Rev::Flags)(rawRev->flags & ~kPersistentOnlyFlags),
+                               (parentIndex == kNoParent) ? -1 : int(parentIndex),
+                               (rawRev->flags & kHasData) != 0});
+        }
+
+        auto entry = (const RemoteEntry*)offsetby(rawRev, sizeof(uint32_t));
+        while (entry < raw_tree.end()) {
+            RevTree::RemoteID remoteID = endian::dec16(entry->remoteDBID_BE);
+            auto revIndex = endian::dec16(entry->revIndex_BE);
+            if (remoteID == 0 || revIndex >= outRevs.size())
+                error::_throw(error::CorruptRevisionData);
+            outRemotes.emplace_back(remoteID, revIndex);
+            ++entry;
+        }
+        if ((uint8_t*)entry != (uint8_t*)raw_tree.end())
+            error::_throw(error::CorruptRevisionData);
+    }
+
+
     alloc_slice RawRevision::encodeTree(const vector<Rev*> &revs,
                                         const RevTree::RemoteRevMap &remoteMap)
     {
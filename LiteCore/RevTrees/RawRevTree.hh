@@ -44,6 +44,23 @@ namespace litecore {
         static alloc_slice encodeTree(const std::vector<Rev*> &revs,
                                       const RevTree::RemoteRevMap &remoteMap);
 
+        /** A revision's metadata, as read from an encoded tree by `scanTree`. */
+        struct Scanned {
+            revid       revID;
+            Rev::Flags  flags;
+            int         parentIndex;    // Index of the parent revision, or -1 if none
+            bool        hasBody;        // Is the body stored in the tree?
+        };
+
+        using ScannedRemote = std::pair<RevTree::RemoteID, unsigned>;  // remote ID, rev index
+
+        /** Reads the revisions of an encoded tree, and which one is current for each remote,
+            without decoding it into Revs. Replaces the vectors' contents; by reusing the vectors
+            the caller can scan many trees without allocating. The revIDs point into `raw_tree`. */
+        static void scanTree(slice raw_tree,
+                             std::vector<Scanned> &outRevs,
+                             std::vector<ScannedRemote> &outRemotes);
+
     private:
         static const uint16_t kNoParent = UINT16_MAX;
 
@@ -17,6 +17,7 @@
 //
 #include "DataFile.hh"
 #include "DataFile+Shared.hh"
+#include "ReadConnectionPool.hh"
 #include "Query.hh"
 #include "Record.hh"
 #include "DocumentKeys.hh"
@@ -99,6 +100,31 @@ namespace litecore {
 #pragma mark - DATAFILE:
 
 
+    DataFile::Tuning DataFile::Tuning::resolved() const {
+        static constexpr int64_t MB = 1024 * 1024;
+        // Preset values for each Profile, indexed by Profile:
+        static const Tuning kPresets[3] = {
+            //          pageSize  cacheSize  mmapSize    journalSizeLimit  walAutoCheckpoint
+            {kBalanced, 4096,      10 * MB,    50 * MB,    5 * MB,          1000},
+            {kEmbedded, 4096,       2 * MB,    -1,         1 * MB,           250},
+            {kServer,   8192,     256 * MB,  1024 * MB,   64 * MB,         10000},
+        };
+        if (profile > kServer)
+            error::_throw(error::InvalidParameter, "Invalid storage profile %d", int(profile));
+        if (pageSize != 0 && (pageSize < 512 || pageSize > 65536 || (pageSize & (pageSize-1))))
+            error::_throw(error::InvalidParameter, "Invalid page size %u", pageSize);
+
+        const Tuning &preset = kPresets[profile];
+        Tuning t = *this;
+        if (!t.pageSize)            t.pageSize = preset.pageSize;
+        if (!t.cacheSize)           t.cacheSize = preset.cacheSize;
+        if (!t.mmapSize)            t.mmapSize = preset.mmapSize;
+        if (!t.journalSizeLimit)    t.journalSizeLimit = preset.journalSizeLimit;
+        if (!t.walAutoCheckpoint)   t.walAutoCheckpoint = preset.walAutoCheckpoint;
+        return t;
+    }
+
+
     const DataFile::Options DataFile::Options::defaults = {
         {true},                 // sequences
         true, true, true, true  // create, writeable, useDocumentKeys, upgradeable
@@ -144,6 +170,7 @@ namespace litecore {
         //    other classes with interest in the data file do not continue to
         //    operate on it
         _closeSignaled = true;
+        closeReadConnectionPool();
         for (auto &query : _queries)
             query->close();
         _queries.clear();
@@ -203,6 +230,26 @@ namespace litecore {
     }
 
 
+    ReadConnectionPool& DataFile::readConnectionPool() {
+        checkOpen();
+        lock_guard<mutex> lock(_readPoolMutex);
+        if (!_readPool)
+            _readPool = new ReadConnectionPool(*this);
+        return *_readPool;
+    }
+
+
+    void DataFile::closeReadConnectionPool() {
+        Retained<ReadConnectionPool> pool;
+        {
+            lock_guard<mutex> lock(_readPoolMutex);
+            pool = move(_readPool);
+        }
+        if (pool)
+            pool->close();
+    }
+
+
 #pragma mark - DELETION:
 
 
@@ -220,6 +267,10 @@ namespace litecore {
     {
         shared->condemn(true);
         try {
+            // My own pooled reader connections would otherwise count as other connections:
+            if (file)
+                file->closeReadConnectionPool();
+
             // Wait for other connections to close -- in multithreaded setups there may be races where
             // another thread takes a bit longer to close its connection.
             int n = 0;
@@ -430,10 +481,12 @@ namespace litecore {
     ReadOnlyTransaction::ReadOnlyTransaction(DataFile *db) {
         db->beginReadOnlyTransaction();
         _db = db;
+        ++_db->_readOnlyTransactionLevel;
     }
 
     ReadOnlyTransaction::~ReadOnlyTransaction() {
         if (_db) {
+            --_db->_readOnlyTransactionLevel;
             try {
                 _db->endReadOnlyTransaction();
             } catch (...) {
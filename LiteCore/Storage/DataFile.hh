@@ -26,6 +26,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <atomic> // for std::atomic_uint
+#include <mutex>
 #ifdef check
 #undef check
 #endif
@@ -41,6 +42,7 @@ namespace litecore {
     class Query;
     class Transaction;
     class SequenceTracker;
+    class ReadConnectionPool;
 
 
     /** A database file, primarily a container of KeyStores which store the actual data.
@@ -57,6 +59,26 @@ namespace litecore {
             virtual void externalTransactionCommitted(const SequenceTracker &sourceTracker) { }
         };
 
+        /** Storage-engine tuning parameters. A zero value means "use the profile's default".
+            NOTE: The Profile values must match C4StorageProfile in c4Database.h. */
+        struct Tuning {
+            enum Profile : uint8_t {
+                kBalanced,                  ///< Default; suits typical mobile/desktop apps
+                kEmbedded,                  ///< Minimizes memory use, for constrained devices
+                kServer,                    ///< Uses lots of RAM, for large databases
+            };
+
+            Profile  profile            {kBalanced};
+            uint32_t pageSize           {0};    ///< Page size in bytes (only for new files)
+            int64_t  cacheSize          {0};    ///< Page cache size in bytes, per connection
+            int64_t  mmapSize           {0};    ///< Bytes of file to memory-map; < 0 disables
+            int64_t  journalSizeLimit   {0};    ///< Max bytes WAL is left at after a checkpoint
+            uint32_t walAutoCheckpoint  {0};    ///< WAL size in pages that triggers a checkpoint
+
+            /** Returns a copy with all zero values replaced by the profile's defaults. */
+            Tuning resolved() const;
+        };
+
         struct Options {
             KeyStore::Capabilities keyStores;
             bool                create         :1;      ///< Should the db be created if it doesn't exist?
@@ -65,6 +87,7 @@ namespace litecore {
             bool                upgradeable    :1;      ///< DB schema can be upgraded
             EncryptionAlgorithm encryptionAlgorithm;    ///< What encryption (if any)
             alloc_slice         encryptionKey;          ///< Encryption key, if encrypting
+            Tuning              tuning;                 ///< Storage-engine tuning
             static const Options defaults;
         };
 
@@ -156,6 +179,21 @@ namespace litecore {
         Retained<RefCounted> sharedObject(const std::string &key);
         Retained<RefCounted> addSharedObject(const std::string &key, RefCounted*);
 
+        //////// READ CONNECTION POOL:
+
+        /** Returns this DataFile's pool of read-only connections to the same file, creating it
+            on the first call. Borrowing a pooled connection lets other threads read a consistent
+            snapshot without serializing on this DataFile's connection. */
+        ReadConnectionPool& readConnectionPool();
+
+        /** True if a read that only needs committed data may use a pooled connection instead of
+            this one: i.e. this isn't itself a pooled connection, and it's not inside a Transaction
+            or ReadOnlyTransaction (whose state or snapshot the caller expects to see.)
+            Thread-safe: the transaction state it checks is atomic. */
+        bool canReadFromPool() const {
+            return !_isPooledConnection && !_inTransaction && _readOnlyTransactionLevel == 0;
+        }
+
         //////// FACTORY:
 
         /** Abstract factory for creating/managing DataFiles. */
@@ -229,6 +267,9 @@ namespace litecore {
 
         void forOpenKeyStores(function_ref<void(KeyStore&)> fn);
 
+        /** Closes the pool of read connections, if any; a new one is created on demand. */
+        void closeReadConnectionPool();
+
         virtual Factory& factory() const =0;
 
     private:
@@ -237,6 +278,7 @@ namespace litecore {
         friend class Transaction;
         friend class ReadOnlyTransaction;
         friend class DocumentKeys;
+        friend class ReadConnectionPool;
 
         static bool deleteDataFile(DataFile *file, const Options *options,
                                    Shared *shared, Factory &factory);
@@ -259,7 +301,11 @@ namespace litecore {
         std::unordered_map<std::string, unique_ptr<KeyStore>> _keyStores;// Opened KeyStores
         mutable Retained<fleece::impl::PersistentSharedKeys> _documentKeys;
         std::unordered_set<Query*> _queries;                    // Query objects
-        bool                    _inTransaction {false};         // Am I in a Transaction?
+        Retained<ReadConnectionPool> _readPool;                 // Pool of reader connections
+        std::mutex              _readPoolMutex;                 // Guards _readPool
+        std::atomic_bool        _inTransaction {false};         // Am I in a Transaction?
+        std::atomic<unsigned>   _readOnlyTransactionLevel {0};  // Nesting of ReadOnlyTransactions
+        bool                    _isPooledConnection {false};    // Do I belong to a ReadConnectionPool?
         std::atomic_bool        _closeSignaled {false};         // Have I been asked to close?
     };
 
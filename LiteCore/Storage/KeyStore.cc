@@ -45,6 +45,15 @@ namespace litecore {
         fn(rec);
     }
 
+    vector<Record> KeyStore::getMany(const vector<slice> &keys, ContentOption option) const {
+        // Subclasses can implement this more efficiently.
+        vector<Record> recs;
+        recs.reserve(keys.size());
+        for (slice key : keys)
+            recs.push_back(get(key, option));
+        return recs;
+    }
+
 #if ENABLE_DELETE_KEY_STORES
     void KeyStore::deleteKeyStore(Transaction& trans) {
         trans.dataFile().deleteKeyStore(name());
@@ -66,6 +75,33 @@ namespace litecore {
         return seq;
     }
 
+    vector<sequence_t> KeyStore::setMany(const vector<RecordLite> &recs, Transaction &t) {
+        // Subclasses can implement this more efficiently.
+        vector<sequence_t> seqs;
+        seqs.reserve(recs.size());
+        for (auto &rec : recs)
+            seqs.push_back(set(rec, t));
+        return seqs;
+    }
+
+
+    KeyStore::InsertBatch::InsertBatch(KeyStore &store, Transaction &t)
+    :_store(store)
+    ,_transaction(t)
+    {
+        _store.beginInsertBatch();
+    }
+
+    KeyStore::InsertBatch::~InsertBatch() {
+        _store.endInsertBatch(_transaction, false);
+    }
+
+    void KeyStore::InsertBatch::flush() {
+        _store.endInsertBatch(_transaction, true);
+        _store.beginInsertBatch();
+    }
+
+
     bool KeyStore::createIndex(slice name,
                                slice expressionJSON,
                                IndexSpec::Type type,
@@ -74,6 +110,12 @@ namespace litecore {
         return createIndex({string(name), type, alloc_slice(expressionJSON), options});
     }
 
+
+    unsigned KeyStore::updateDeferredIndexes(unsigned maxRecords) {
+        auto update = prepareDeferredIndexUpdate(maxRecords);
+        return update ? applyDeferredIndexUpdate(*update) : 0;
+    }
+
     expiration_t KeyStore::now() noexcept {
         return std::chrono::duration_cast<std::chrono::milliseconds>
                 (std::chrono::system_clock::now().time_since_epoch()).count();
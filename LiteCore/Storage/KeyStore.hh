@@ -21,6 +21,7 @@
 #include "RefCounted.hh"
 #include "RecordEnumerator.hh"
 #include "function_ref.hh"
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -79,6 +80,18 @@ namespace litecore {
         /** Reads a record whose key() is already set. */
         virtual bool read(Record &rec, ContentOption = kEntireBody) const =0;
 
+        /** Reads many records at once. The result has one Record per key, in the same order;
+            a Record whose key wasn't found has `exists()` false.
+            This is much faster than calling get() repeatedly. */
+        virtual std::vector<Record> getMany(const std::vector<slice> &keys,
+                                            ContentOption = kEntireBody) const;
+
+        /** Returns up to `n - 1` keys, in ascending order, that split the records into `n` key
+            ranges of roughly equal size. They're estimated from a sample of the records, so the
+            sizes are only approximate, and there may be fewer keys if there are few records.
+            (Used by PartitionedEnumerator.) The default implementation returns no keys. */
+        virtual std::vector<alloc_slice> partitionKeys(unsigned n) const    {return {};}
+
         /** Creates a database query object. */
         virtual Retained<Query> compileQuery(slice expr, QueryLanguage =QueryLanguage::kJSON) =0;
 
@@ -86,9 +99,12 @@ namespace litecore {
 
         /** Invokes the callback once for each document found in the database.
             The callback is given the docID, body and sequence, and returns a string.
-            The return value is the collected strings, in the same order as the docIDs. */
+            The return value is the collected strings, in the same order as the docIDs.
+            If `readBodies` is false, the (possibly large) `body` column isn't read: the callback
+            gets an empty `body`, whose `buf` is non-null only if the record has a body. */
         virtual std::vector<alloc_slice> withDocBodies(const std::vector<slice> &docIDs,
-                                                       WithDocBodyCallback callback) =0;
+                                                       WithDocBodyCallback callback,
+                                                       bool readBodies =true) =0;
 
         //////// Writing:
 
@@ -101,6 +117,31 @@ namespace litecore {
             conflict. */
         virtual sequence_t set(const RecordLite &rec, Transaction&) =0;
 
+        /** Writes multiple records, in order. The outcome is the same as calling set() on each
+            one, but a storage engine may do it in far fewer operations.
+            Returns the new sequence of each record (0 for a sequence conflict), in order. */
+        virtual std::vector<sequence_t> setMany(const std::vector<RecordLite>&, Transaction&);
+
+        /** While an InsertBatch is in scope, calls to set() that insert a new record
+            (`rec.sequence == 0` and `rec.updateSequence`) assign it a sequence as usual, but
+            buffer it instead of writing it; flush() then writes all the buffered records at once.
+            The caller must guarantee that none of those records already exist, and that they
+            won't be read until the batch is flushed. (A violation causes flush() to throw.)
+            If the batch exits scope with unflushed records, they're discarded; that should only
+            happen when an exception is aborting the transaction. */
+        class InsertBatch {
+        public:
+            InsertBatch(KeyStore&, Transaction&);
+            ~InsertBatch();
+            void flush();
+        private:
+            InsertBatch(const InsertBatch&) =delete;
+            InsertBatch& operator=(const InsertBatch&) =delete;
+
+            KeyStore&    _store;
+            Transaction& _transaction;
+        };
+
         // Convenience wrappers for set():
 
         sequence_t set(slice key, slice version, slice value,
@@ -169,6 +210,41 @@ namespace litecore {
         virtual void deleteIndex(slice name) =0;
         virtual std::vector<IndexSpec> getIndexes() const =0;
 
+        /** Index rows computed by `prepareDeferredIndexUpdate`, to be stored by
+            `applyDeferredIndexUpdate`. */
+        class DeferredIndexUpdate {
+        public:
+            virtual ~DeferredIndexUpdate() =default;
+            /// The number of records reindexed.
+            virtual unsigned count() const =0;
+        };
+
+        /** True if there are indexes created with the `deferUpdates` option. */
+        virtual bool hasDeferredIndexes() const                         {return false;}
+
+        /** First step of updating indexes created with the `deferUpdates` option: computes the
+            index rows of up to `maxRecords` of the records that have changed since the indexes
+            were last updated. This only reads the database, so it should be called outside a
+            transaction; that way a slow prediction model doesn't hold the write lock. (A FTS
+            index's text is only tokenized when it's stored, by `applyDeferredIndexUpdate`.)
+            @return  The computed rows, or null if the indexes are up to date. */
+        virtual std::unique_ptr<DeferredIndexUpdate> prepareDeferredIndexUpdate(unsigned maxRecords)
+                                                                        {return nullptr;}
+
+        /** Second step of updating deferred-update indexes: stores the rows computed by
+            `prepareDeferredIndexUpdate`. Records that changed in the meantime are skipped, and
+            remain to be reindexed. Must be called in a transaction.
+            @return  The number of records reindexed. */
+        virtual unsigned applyDeferredIndexUpdate(DeferredIndexUpdate&)  {return 0;}
+
+        /** Prepares and applies a deferred index update. Must be called in a transaction.
+            @return  The number of records reindexed; 0 if the indexes are up to date. */
+        unsigned updateDeferredIndexes(unsigned maxRecords);
+
+        /** Returns the sequence through which all indexes are up to date. This is less than
+            `lastSequence` if deferred-update indexes haven't caught up yet. */
+        virtual sequence_t indexedSequence() const                      {return lastSequence();}
+
         // public for complicated reasons; clients should never call it
         virtual ~KeyStore()                             { }
 
@@ -179,6 +255,10 @@ namespace litecore {
         virtual void reopen()                           { }
         virtual void close()                            { }
 
+        // InsertBatch support; the default implementation doesn't buffer anything.
+        virtual void beginInsertBatch()                 { }
+        virtual void endInsertBatch(Transaction&, bool write) { }
+
         virtual RecordEnumerator::Impl* newEnumeratorImpl(bool bySequence,
                                                           sequence_t since,
                                                           RecordEnumerator::Options) =0;
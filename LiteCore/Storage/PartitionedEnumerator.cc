@@ -0,0 +1,104 @@
+//
+// PartitionedEnumerator.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#include "PartitionedEnumerator.hh"
+#include "KeyStore.hh"
+#include "DataFile.hh"
+#include "ReadConnectionPool.hh"
+#include "Error.hh"
+#include "Logging.hh"
+#include "ThreadUtil.hh"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+namespace litecore {
+
+    PartitionedEnumerator::PartitionedEnumerator(KeyStore &store,
+                                                 unsigned nPartitions,
+                                                 RecordEnumerator::Options options)
+    :_store(store)
+    ,_options(options)
+    {
+        if (options.limit != UINT64_MAX)
+            error::_throw(error::InvalidParameter, "PartitionedEnumerator doesn't support a limit");
+        _boundaries = store.partitionKeys(max(nPartitions, 1u));
+    }
+
+
+    bool PartitionedEnumerator::run(const Callback &callback) {
+        unsigned n = partitionCount();
+        LogVerbose(DBLog, "PartitionedEnumerator %p: enumerating '%s' in %u partitions",
+              this, _store.name().c_str(), n);
+        _stop = false;
+        Retained<ReadConnectionPool> pool = &_store.dataFile().readConnectionPool();
+        mutex errorMutex;
+        exception_ptr error;
+
+        // Each worker thread enumerates partitions until there are none left; there's no point
+        // in having more workers than pooled connections.
+        atomic<unsigned> nextPartition {0};
+        unsigned nThreads = min(n, pool->capacity());
+        vector<thread> threads;
+        threads.reserve(nThreads);
+        for (unsigned t = 0; t < nThreads; ++t) {
+            threads.emplace_back([&] {
+                SetThreadName("Partitioned Enumerator (CBL)");
+                try {
+                    for (unsigned p; !_stop && (p = nextPartition++) < n; )
+                        enumeratePartition(p, *pool, callback);
+                } catch (...) {
+                    lock_guard<mutex> lock(errorMutex);
+                    if (!error)
+                        error = current_exception();
+                    _stop = true;
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+
+        if (error)
+            rethrow_exception(error);
+        return !_stop;
+    }
+
+
+    void PartitionedEnumerator::enumeratePartition(unsigned p,
+                                                   ReadConnectionPool &pool,
+                                                   const Callback &callback)
+    {
+        // Narrow the options' key range to the partition's:
+        RecordEnumerator::Options options = _options;
+        if (p > 0) {
+            slice lower = _boundaries[p - 1];
+            if (!options.minKey || lower.compare(options.minKey) > 0) {
+                options.minKey = lower;
+                options.minKeyInclusive = true;
+            }
+        }
+        if (p + 1 < partitionCount()) {
+            slice upper = _boundaries[p];
+            if (!options.maxKey || upper.compare(options.maxKey) <= 0) {
+                options.maxKey = upper;
+                options.maxKeyInclusive = false;
+            }
+        }
+
+        pool.withSnapshot([&](DataFile &df) {
+            KeyStore &store = df.getKeyStore(_store.name(), _store.capabilities());
+            for (RecordEnumerator e(store, options); !_stop && e.next(); ) {
+                if (!callback(e.record(), p))
+                    _stop = true;
+            }
+        });
+    }
+
+}
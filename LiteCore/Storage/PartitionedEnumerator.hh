@@ -0,0 +1,67 @@
+//
+// PartitionedEnumerator.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "RecordEnumerator.hh"
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace litecore {
+
+    class KeyStore;
+    class ReadConnectionPool;
+
+    /** Enumerates all the records of a KeyStore on several threads at once, for jobs like bulk
+        export or reindexing that would otherwise be limited to one core.
+
+        The keys are split into disjoint ranges ("partitions") of roughly equal size, using
+        KeyStore::partitionKeys. Partitions are enumerated in parallel on worker threads, each
+        using a read-only connection borrowed from the DataFile's ReadConnectionPool; so the
+        parallelism is limited by the pool's capacity as well as by the number of partitions.
+
+        Each partition reads its own snapshot of the database, so a record changed during the
+        enumeration may appear in either its old or new state; but since partitions are key
+        ranges, no record is delivered twice or skipped. */
+    class PartitionedEnumerator {
+    public:
+        /** Called with each record and the number of its partition. It's called on multiple
+            threads at once, so it must be thread-safe. Returning false stops the enumeration. */
+        using Callback = std::function<bool(const Record&, unsigned partition)>;
+
+        /** Splits `store` into (up to) `nPartitions` partitions. Within each partition, records
+            are enumerated according to `options`, which can further limit the key range.
+            The `limit` option isn't supported. The options' key slices must remain valid until
+            `run` returns. */
+        PartitionedEnumerator(KeyStore &store,
+                              unsigned nPartitions,
+                              RecordEnumerator::Options options = RecordEnumerator::Options());
+
+        /** The number of partitions; fewer than requested if the KeyStore has too few records. */
+        unsigned partitionCount() const                 {return unsigned(_boundaries.size()) + 1;}
+
+        /** The keys dividing the partitions: partition `i` contains the keys greater than or equal
+            to `boundaries()[i-1]` and less than `boundaries()[i]`. */
+        const std::vector<alloc_slice>& boundaries() const  {return _boundaries;}
+
+        /** Enumerates the partitions in parallel, calling `callback` with every record, and
+            returns once all are done. Returns false if the callback stopped the enumeration.
+            An exception thrown on any partition's thread, including by the callback, stops the
+            enumeration and is rethrown here.
+            @warning  Don't call this while in a Transaction on the same file, since opening
+                      pooled connections takes the file lock. */
+        bool run(const Callback &callback);
+
+    private:
+        void enumeratePartition(unsigned partition, ReadConnectionPool&, const Callback&);
+
+        KeyStore&                   _store;
+        RecordEnumerator::Options   _options;
+        std::vector<alloc_slice>    _boundaries;        // Keys dividing the partitions
+        std::atomic<bool>           _stop {false};      // Set when the enumeration should stop
+    };
+
+}
@@ -0,0 +1,192 @@
+//
+// ReadConnectionPool.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#include "ReadConnectionPool.hh"
+#include "Error.hh"
+#include "Logging.hh"
+#include "Stopwatch.hh"
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+namespace litecore {
+
+    // Limits on the default pool capacity, regardless of the number of CPU cores.
+    static constexpr unsigned kMinDefaultCapacity = 2, kMaxDefaultCapacity = 8;
+
+
+    /*static*/ unsigned ReadConnectionPool::defaultCapacity() {
+        unsigned cores = thread::hardware_concurrency();
+        return max(kMinDefaultCapacity, min(cores, kMaxDefaultCapacity));
+    }
+
+
+    ReadConnectionPool::ReadConnectionPool(DataFile &primary, unsigned capacity)
+    :_primaryDelegate(primary.delegate())
+    ,_factory(primary.factory())
+    ,_path(primary.filePath())
+    ,_options(primary.options())
+    ,_capacity(max(capacity, 1u))
+    {
+        _options.create = false;
+        _options.writeable = false;
+        _options.upgradeable = false;
+        LogVerbose(DBLog, "ReadConnectionPool %p: capacity %u, on %s",
+                   this, _capacity, _path.path().c_str());
+    }
+
+
+    ReadConnectionPool::~ReadConnectionPool() {
+        close();
+    }
+
+
+    unique_ptr<DataFile> ReadConnectionPool::openConnection() {
+        unique_ptr<DataFile> df(_factory.openFile(_path, this, &_options));
+        df->_isPooledConnection = true;
+        LogVerbose(DBLog, "ReadConnectionPool %p: opened connection %p", this, df.get());
+        return df;
+    }
+
+
+    ReadConnectionPool::Borrowed ReadConnectionPool::borrow() {
+        fleece::Stopwatch st;
+        unique_lock<mutex> lock(_mutex);
+        bool waited = false;
+        for (;;) {
+            if (_closed)
+                error::_throw(error::NotOpen, "ReadConnectionPool is closed");
+            if (!_idle.empty()) {
+                // Reuse an idle connection:
+                DataFile *df = _idle.back();
+                _idle.pop_back();
+                countCheckout(st.elapsed(), waited, false);
+                return Borrowed(this, df);
+            } else if (_connections.size() + _opening < _capacity) {
+                // Open a new connection, without holding the lock:
+                ++_opening;
+                lock.unlock();
+                unique_ptr<DataFile> df;
+                try {
+                    df = openConnection();
+                } catch (...) {
+                    lock.lock();
+                    --_opening;
+                    _cond.notify_one();
+                    throw;
+                }
+                lock.lock();
+                --_opening;
+                DataFile *dfPtr = df.get();
+                _connections.push_back(move(df));
+                countCheckout(st.elapsed(), waited, true);
+                return Borrowed(this, dfPtr);
+            } else {
+                // Pool is exhausted; wait for a connection to be returned:
+                waited = true;
+                _cond.wait(lock);
+            }
+        }
+    }
+
+
+    // Updates the stats for a checkout; must be called with the mutex locked.
+    void ReadConnectionPool::countCheckout(double elapsed, bool waited, bool opened) {
+        ++_stats.checkouts;
+        if (waited)
+            ++_stats.waits;
+        else if (opened)
+            ++_stats.opens;
+        else
+            ++_stats.hits;
+        _stats.totalCheckoutTime += elapsed;
+        _stats.maxCheckoutTime = max(_stats.maxCheckoutTime, elapsed);
+    }
+
+
+    void ReadConnectionPool::giveBack(DataFile *df) noexcept {
+        unique_ptr<DataFile> toClose;
+        {
+            lock_guard<mutex> lock(_mutex);
+            if (_closed) {
+                // Pool was closed while this connection was borrowed, so close it now:
+                auto i = find_if(_connections.begin(), _connections.end(),
+                                 [&](const unique_ptr<DataFile> &c) {return c.get() == df;});
+                if (i != _connections.end()) {
+                    toClose = move(*i);
+                    _connections.erase(i);
+                }
+            } else {
+                _idle.push_back(df);
+                _cond.notify_one();
+            }
+        }
+        // (Deleting the DataFile closes it; do that outside the lock.)
+    }
+
+
+    void ReadConnectionPool::Borrowed::release() noexcept {
+        if (_dataFile) {
+            _pool->giveBack(_dataFile);
+            _dataFile = nullptr;
+            _pool = nullptr;
+        }
+    }
+
+
+    void ReadConnectionPool::withSnapshot(function_ref<void(DataFile&)> fn) {
+        Borrowed conn = borrow();
+        ReadOnlyTransaction t(conn.dataFile());
+        fn(conn.dataFile());
+    }
+
+
+    ReadConnectionPool::Stats ReadConnectionPool::stats() const {
+        lock_guard<mutex> lock(_mutex);
+        return _stats;
+    }
+
+
+    void ReadConnectionPool::close() {
+        {
+            // The primary DataFile (and its delegate) may be gone after this returns:
+            lock_guard<mutex> lock(_delegateMutex);
+            _primaryDelegate = nullptr;
+        }
+        vector<unique_ptr<DataFile>> toClose;
+        {
+            lock_guard<mutex> lock(_mutex);
+            if (_closed)
+                return;
+            _closed = true;
+            // Detach the idle connections; borrowed ones stay in _connections until returned.
+            for (DataFile *df : _idle) {
+                auto i = find_if(_connections.begin(), _connections.end(),
+                                 [&](const unique_ptr<DataFile> &c) {return c.get() == df;});
+                toClose.push_back(move(*i));
+                _connections.erase(i);
+            }
+            _idle.clear();
+            _cond.notify_all();
+            LogVerbose(DBLog, "ReadConnectionPool %p: closing (%zu idle, %zu borrowed); "
+                       "%llu checkouts, %llu hits, %llu waits",
+                       this, toClose.size(), _connections.size(),
+                       (unsigned long long)_stats.checkouts, (unsigned long long)_stats.hits,
+                       (unsigned long long)_stats.waits);
+        }
+        // The DataFiles are closed when `toClose` is destructed, after the mutex is released.
+    }
+
+
+    alloc_slice ReadConnectionPool::blobAccessor(const fleece::impl::Dict *dict) const {
+        lock_guard<mutex> lock(_delegateMutex);
+        if (!_primaryDelegate)
+            error::_throw(error::UnsupportedOperation, "No blob accessor available");
+        return _primaryDelegate->blobAccessor(dict);
+    }
+
+}
@@ -0,0 +1,122 @@
+//
+// ReadConnectionPool.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "DataFile.hh"
+#include "RefCounted.hh"
+#include "function_ref.hh"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace litecore {
+
+    /** A pool of read-only DataFile connections to the same file as a "primary" DataFile.
+        Borrowing a connection lets a thread read without contending for the primary's SQLite
+        handle, so any number of readers (up to the pool's capacity) can run in parallel with
+        each other and with a single writer. Since the file is in WAL mode, a connection used
+        inside a ReadOnlyTransaction sees a stable snapshot and is never blocked by a commit.
+
+        Pooled connections are registered with the file's DataFile::Shared like any other
+        DataFile, but they ignore `externalTransactionCommitted` notifications, and they
+        forward `blobAccessor` calls to the primary's delegate.
+
+        Get the pool by calling DataFile::readConnectionPool(). */
+    class ReadConnectionPool : public RefCounted, private DataFile::Delegate {
+    public:
+
+        struct Stats {
+            // Every checkout is counted in exactly one of `hits`, `opens` or `waits`.
+            uint64_t checkouts {0};      ///< Total number of connections borrowed
+            uint64_t hits {0};           ///< Checkouts satisfied immediately by an idle connection
+            uint64_t opens {0};          ///< Checkouts that opened a new connection without waiting
+            uint64_t waits {0};          ///< Checkouts that blocked until a connection was available
+            double   totalCheckoutTime {0}; ///< Total seconds spent waiting in borrow()
+            double   maxCheckoutTime {0};   ///< Longest time (seconds) spent in a borrow() call
+        };
+
+        /** A borrowed connection. Returns the connection to the pool when it exits scope.
+            Must not be used on more than one thread at once. */
+        class Borrowed {
+        public:
+            Borrowed(Borrowed &&other) noexcept
+            :_pool(std::move(other._pool)), _dataFile(other._dataFile)
+            {other._dataFile = nullptr;}
+
+            ~Borrowed()                                 {release();}
+
+            DataFile& dataFile() const                  {return *_dataFile;}
+            DataFile* operator-> () const               {return _dataFile;}
+            DataFile& operator* () const                {return *_dataFile;}
+
+            /** Returns the connection to the pool early. */
+            void release() noexcept;
+
+        private:
+            friend class ReadConnectionPool;
+            Borrowed(ReadConnectionPool *pool, DataFile *df)    :_pool(pool), _dataFile(df) { }
+            Borrowed(const Borrowed&) =delete;
+            Borrowed& operator=(const Borrowed&) =delete;
+
+            Retained<ReadConnectionPool> _pool;
+            DataFile*                    _dataFile;
+        };
+
+        /** The default maximum number of connections: the number of CPU cores, within limits. */
+        static unsigned defaultCapacity();
+
+        ReadConnectionPool(DataFile &primary, unsigned capacity =defaultCapacity());
+
+        unsigned capacity() const                       {return _capacity;}
+
+        /** Borrows a connection, opening a new one if none are idle and the pool isn't full;
+            otherwise blocks until another thread returns one.
+            @warning  Opening a connection takes the file lock briefly, so don't call this on a
+                      thread that's inside a Transaction on the same file. */
+        Borrowed borrow();
+
+        /** Borrows a connection, and calls the function with it inside a ReadOnlyTransaction,
+            so that all reads made by the function see the same snapshot of the database. */
+        void withSnapshot(function_ref<void(DataFile&)>);
+
+        /** A copy of the current statistics. */
+        Stats stats() const;
+
+        /** Closes all idle connections; borrowed ones will be closed when they're returned.
+            Any further call to borrow() will throw a NotOpen error, and blob access through the
+            primary's delegate stops working, since the primary may be about to be destructed.
+            Called by DataFile::close(). */
+        void close();
+
+    protected:
+        ~ReadConnectionPool();
+
+    private:
+        void giveBack(DataFile*) noexcept;
+        void countCheckout(double elapsed, bool waited, bool opened);
+        unique_ptr<DataFile> openConnection();
+
+        // DataFile::Delegate:
+        alloc_slice blobAccessor(const fleece::impl::Dict*) const override;
+        void externalTransactionCommitted(const SequenceTracker&) override { }
+
+        DataFile::Delegate*                 _primaryDelegate;   // Primary's delegate, till close
+        mutable std::mutex                  _delegateMutex;     // Guards _primaryDelegate
+        DataFile::Factory&                  _factory;           // Factory to open connections
+        FilePath const                      _path;              // Path of the file
+        DataFile::Options                   _options;           // Options for opening connections
+        unsigned const                      _capacity;          // Max number of connections
+        std::vector<unique_ptr<DataFile>>   _connections;       // All open connections
+        std::vector<DataFile*>              _idle;              // Connections not borrowed
+        unsigned                            _opening {0};       // # of connections being opened
+        Stats                               _stats;             // Statistics
+        bool                                _closed {false};    // Has close() been called?
+        mutable std::mutex                  _mutex;             // Guards all of the above
+        std::condition_variable             _cond;              // Signals a returned connection
+    };
+
+}
@@ -50,6 +50,15 @@ namespace litecore {
             SortOption     sortOption     = kAscending;    ///< Sort order, or unsorted
             ContentOption  contentOption  = kEntireBody;       ///< Load record bodies?
 
+            // Key range. (These slices only need to remain valid until the enumerator's created.)
+            slice          minKey;                   ///< If non-null, skip keys less than this
+            slice          maxKey;                   ///< If non-null, skip keys greater than this
+            bool           minKeyInclusive = true;   ///< Include a key equal to minKey?
+            bool           maxKeyInclusive = true;   ///< Include a key equal to maxKey?
+            slice          keyPrefix;                ///< If non-null, only keys with this prefix
+
+            uint64_t       limit          = UINT64_MAX;     ///< Max number of records to return
+
             Options() { }
         };
 
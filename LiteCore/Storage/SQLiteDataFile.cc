@@ -79,20 +79,14 @@ namespace litecore {
 
     static const int64_t MB = 1024 * 1024;
 
-    // SQLite page size
-    static const int64_t kPageSize = 4096;
+    // The page size, cache size, mmap size and WAL limits come from DataFile::Options::tuning;
+    // see DataFile::Tuning::resolved() for the defaults of each profile.
 
-    // SQLite cache size (per connection)
-    static const size_t kCacheSize = 10 * MB;
-
-    // Maximum size WAL journal will be left at after a commit
-    static const int64_t kJournalSize = 5 * MB;
-
-    // Amount of file to memory-map
+    // Whether memory-mapping may be used at all
 #if TARGET_OS_OSX || TARGET_OS_SIMULATOR
-    static const int kMMapSize =  -1;    // Avoid possible file corruption hazard on macOS
+    static const bool kMMapAllowed = false;     // Avoid possible file corruption hazard on macOS
 #else
-    static const int kMMapSize = 50 * MB;
+    static const bool kMMapAllowed = true;
 #endif
 
     // If this fraction of the database is composed of free pages, vacuum it on close
@@ -202,7 +196,9 @@ namespace litecore {
         reopenSQLiteHandle();
         decrypt();
 
-        withFileLock([this]{
+        const Tuning tuning = options().tuning.resolved();
+
+        withFileLock([&]{
             // http://www.sqlite.org/pragma.html
             _schemaVersion = SchemaVersion((int)_sqlDb->execAndGet("PRAGMA user_version"));
             bool isNew = false;
@@ -211,7 +207,9 @@ namespace litecore {
                 // Configure persistent db settings, and create the schema.
                 // `auto_vacuum` has to be enabled ASAP, before anything's written to the db!
                 // (even setting `auto_vacuum` writes to the db, it turns out! See CBSE-7971.)
-                _exec("PRAGMA auto_vacuum=incremental; "
+                // `page_size` likewise has to be set before the database is first written to.
+                _exec(format("PRAGMA page_size=%u; ", tuning.pageSize) +
+                      "PRAGMA auto_vacuum=incremental; "
                       "PRAGMA journal_mode=WAL; "
                       "BEGIN; "
                       "CREATE TABLE IF NOT EXISTS "      // Table of metadata about KeyStores
@@ -265,12 +263,20 @@ namespace litecore {
             }
         });
 
-        _exec(format("PRAGMA cache_size=%d; "            // Memory cache
-                     "PRAGMA mmap_size=%d; "             // Memory-mapped reads
+        int64_t mmapSize = (kMMapAllowed && tuning.mmapSize > 0) ? tuning.mmapSize : 0;
+        _exec(format("PRAGMA cache_size=%lld; "          // Memory cache
+                     "PRAGMA mmap_size=%lld; "           // Memory-mapped reads
                      "PRAGMA synchronous=normal; "       // Speeds up commits
                      "PRAGMA journal_size_limit=%lld; "  // Limit WAL disk usage
+                     "PRAGMA wal_autocheckpoint=%u; "    // WAL size that triggers a checkpoint
                      "PRAGMA case_sensitive_like=true",  // Case sensitive LIKE, for N1QL compat
-                     -(int)kCacheSize/1024, kMMapSize, (long long)kJournalSize));
+                     -(long long)(tuning.cacheSize / 1024), (long long)mmapSize,
+                     (long long)tuning.journalSizeLimit, tuning.walAutoCheckpoint));
+        _pageSize = intQuery("PRAGMA page_size");
+        logVerbose("Storage: page size %lld, cache %lldKB, mmap %lldKB, WAL limit %lldKB / %u pages",
+                   (long long)_pageSize, (long long)(tuning.cacheSize / 1024),
+                   (long long)(mmapSize / 1024), (long long)(tuning.journalSizeLimit / 1024),
+                   tuning.walAutoCheckpoint);
 
 #if DEBUG
         // Deliberately make unordered queries unpredictable, to expose any LiteCore code that
@@ -305,6 +311,8 @@ namespace litecore {
         _setLastSeqStmt.reset();
         _getPurgeCntStmt.reset();
         _setPurgeCntStmt.reset();
+        _schemaVersionStmt.reset();
+        _queryCache.clear();
         
         int sqlFlags = options().writeable ? SQLite::OPEN_READWRITE : SQLite::OPEN_READONLY;
         if (options().create)
@@ -335,6 +343,8 @@ namespace litecore {
         _setLastSeqStmt.reset();
         _getPurgeCntStmt.reset();
         _setPurgeCntStmt.reset();
+        _schemaVersionStmt.reset();
+        _queryCache.clear();
         if (_sqlDb) {
             if (options().writeable) {
                 optimize();
@@ -457,6 +467,10 @@ namespace litecore {
         
         if (newKey.size != kEncryptionKeySize[alg])
             error::_throw(error::InvalidParameter);
+
+        // Pooled connections were opened with the old key:
+        closeReadConnectionPool();
+
         int rekeyResult = 0;
         if(alg == kNoEncryption) {
             rekeyResult = sqlite3_rekey_v2(_sqlDb->getHandle(), nullptr, nullptr, 0);
@@ -538,6 +552,13 @@ namespace litecore {
     }
 
 
+    int64_t SQLiteDataFile::sqliteSchemaVersion() const {
+        auto &stmt = compile(_schemaVersionStmt, "PRAGMA schema_version");
+        UsingStatement u(stmt);
+        return stmt.executeStep() ? stmt.getColumn(0).getInt64() : 0;
+    }
+
+
     int64_t SQLiteDataFile::intQuery(const char *query) {
         SQLite::Statement st(*_sqlDb, query);
         LogStatement(st);
@@ -697,11 +718,11 @@ namespace litecore {
                        100.0 * freePages / pageCount);
 
             if (!always && (pageCount == 0 || (float)freePages / pageCount < kVacuumFractionThreshold)
-                        && (freePages * kPageSize < kVacuumSizeThreshold))
+                        && (freePages * _pageSize < kVacuumSizeThreshold))
                 return;
 
             string sql;
-            bool fixAutoVacuum = (always || (pageCount * kPageSize) < 10*MB)
+            bool fixAutoVacuum = (always || (pageCount * _pageSize) < 10*MB)
                                     && (intQuery("PRAGMA auto_vacuum") == 0);
             if (fixAutoVacuum) {
                 // Due to issue CBL-707, auto-vacuum did not take effect when creating databases.
@@ -724,7 +745,7 @@ namespace litecore {
 
             int64_t shrunk = pageCount - intQuery("PRAGMA page_count");
             logInfo("    ...removed %" PRIi64 " pages (%" PRIi64 "KB) in %.3f sec",
-                    shrunk, shrunk * kPageSize / 1024, elapsed);
+                    shrunk, shrunk * _pageSize / 1024, elapsed);
 
             if (fixAutoVacuum && intQuery("PRAGMA auto_vacuum") == 0)
                 warn("auto_vacuum mode did not take effect after running full VACUUM!");
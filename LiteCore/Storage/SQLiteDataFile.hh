@@ -19,6 +19,7 @@
 #pragma once
 
 #include "DataFile.hh"
+#include "CompiledQueryCache.hh"
 #include "IndexSpec.hh"
 #include "UnicodeCollator.hh"
 #include <optional>
@@ -68,6 +69,12 @@ namespace litecore {
 
         fleece::alloc_slice rawQuery(const std::string &query) override;
 
+        /** The cache of compiled queries, used by SQLiteQuery. */
+        CompiledQueryCache& queryCache()                    {return _queryCache;}
+
+        /** SQLite's schema version, which changes whenever the schema does. */
+        int64_t sqliteSchemaVersion() const;
+
         class Factory : public DataFile::Factory {
         public:
             Factory();
@@ -159,8 +166,11 @@ namespace litecore {
         unique_ptr<SQLite::Database>    _sqlDb;         // SQLite database object
         unique_ptr<SQLite::Statement>   _getLastSeqStmt, _setLastSeqStmt;
         unique_ptr<SQLite::Statement>   _getPurgeCntStmt, _setPurgeCntStmt;
+        unique_ptr<SQLite::Statement>   _schemaVersionStmt;
+        CompiledQueryCache              _queryCache;    // Compiled queries, for SQLiteQuery
         CollationContextVector          _collationContexts;
         SchemaVersion                   _schemaVersion {SchemaVersion::None};
+        int64_t                         _pageSize {4096};   // Actual page size of the file
     };
 
 
@@ -75,25 +75,52 @@ namespace litecore {
                 createBlobsIndex();
         }
 
+        // The key range is bounded by both the min/max keys and the prefix, if any:
+        slice minKey = options.minKey, maxKey = options.maxKey;
+        bool minInclusive = options.minKeyInclusive, maxInclusive = options.maxKeyInclusive;
+        alloc_slice prefixEnd;
+        if (options.keyPrefix) {
+            if (!minKey || options.keyPrefix.compare(minKey) > 0) {
+                minKey = options.keyPrefix;
+                minInclusive = true;
+            }
+            // The keys with the prefix are those less than the prefix with its last byte
+            // incremented (after removing any trailing 0xFF bytes, which can't be incremented):
+            prefixEnd = options.keyPrefix;
+            while (prefixEnd.size > 0 && prefixEnd[prefixEnd.size - 1] == 0xFF)
+                prefixEnd.shorten(prefixEnd.size - 1);
+            if (prefixEnd.size > 0) {
+                ++((uint8_t*)prefixEnd.buf)[prefixEnd.size - 1];
+                if (!maxKey || prefixEnd.compare(maxKey) <= 0) {
+                    maxKey = prefixEnd;
+                    maxInclusive = false;
+                }
+            }
+        }
+
         stringstream sql;
         sql << "SELECT sequence, flags, key, version";
         sql << (options.contentOption >= kCurrentRevOnly ? ", body"  : ", length(body)");
         sql << (options.contentOption >= kEntireBody     ? ", extra" : ", length(extra)");
         sql << (mayHaveExpiration() ? ", expiration" : ", 0");
         sql << " FROM kv_" << name();
-        
+
         bool writeAnd = false;
-        if (bySequence) {
-            sql << " WHERE sequence > ?";
+        auto writeCondition = [&]() -> stringstream& {
+            sql << (writeAnd ? " AND " : " WHERE ");
             writeAnd = true;
-        } else {
-            if (!options.includeDeleted || options.onlyBlobs || options.onlyConflicts)
-                sql << " WHERE ";
-        }
+            return sql;
+        };
+
+        if (bySequence)
+            writeCondition() << "sequence > ?";
+        if (minKey)
+            writeCondition() << (minInclusive ? "key >= ?" : "key > ?");
+        if (maxKey)
+            writeCondition() << (maxInclusive ? "key <= ?" : "key < ?");
 
         auto writeFlagTest = [&](DocumentFlags flag, const char *test) {
-            if (writeAnd) sql << " AND "; else writeAnd = true;
-            sql << "(flags & " << int(flag) << ") " << test;
+            writeCondition() << "(flags & " << int(flag) << ") " << test;
         };
         
         if (!options.includeDeleted)
@@ -108,6 +135,8 @@ namespace litecore {
             if (options.sortOption == kDescending)
                 sql << " DESC";
         }
+        if (options.limit < UINT64_MAX)
+            sql << " LIMIT " << min(options.limit, uint64_t(INT64_MAX));
 
         auto sqlStr = sql.str();
         auto stmt = new SQLite::Statement(db(), sqlStr);        // TODO: Cache a statement
@@ -125,8 +154,13 @@ namespace litecore {
         }
 
 
+        int param = 1;
         if (bySequence)
-            stmt->bind(1, (long long)since);
+            stmt->bind(param++, (long long)since);
+        if (minKey)
+            stmt->bind(param++, string(minKey));
+        if (maxKey)
+            stmt->bind(param++, string(maxKey));
         return new SQLiteEnumerator(stmt, options.contentOption);
     }
 
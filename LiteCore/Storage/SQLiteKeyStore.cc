@@ -24,7 +24,9 @@
 #include "StringUtil.hh"
 #include "SQLiteCpp/SQLiteCpp.h"
 #include "FleeceImpl.hh"
+#include <algorithm>
 #include <sstream>
+#include <unordered_map>
 
 using namespace std;
 using namespace fleece;
@@ -98,7 +100,11 @@ namespace litecore {
         _getExpStmt.reset();
         _nextExpStmt.reset();
         _findExpStmt.reset();
-        _withDocBodiesStmt.reset();
+        _setManyStmt.reset();
+        _insertManyStmt.reset();
+        for (auto &stmt : _getManyStmt)
+            stmt.reset();
+        _insertBatch.reset();
         KeyStore::close();
     }
 
@@ -328,6 +334,17 @@ namespace litecore {
     sequence_t SQLiteKeyStore::set(const RecordLite &rec, Transaction&) {
         enum { VersionCol = 1, BodyCol, ExtraCol, FlagsCol, SequenceCol, KeyCol, OldSequenceCol };
 
+        if (_insertBatch && rec.sequence == 0 && rec.updateSequence) {
+            // Inside an InsertBatch: assign the sequence now, but write the record later:
+            sequence_t seq = _capabilities.sequences ? lastSequence() + 1 : 1;
+            _insertBatch->push_back({alloc_slice(rec.key), alloc_slice(rec.version),
+                                     alloc_slice(rec.body), alloc_slice(rec.extra),
+                                     rec.flags, seq});
+            if (_capabilities.sequences)
+                setLastSequence(seq);
+            return seq;
+        }
+
         const char *opName;
         SQLite::Statement *stmt;
         if (!rec.sequence) {
@@ -387,6 +404,124 @@ namespace litecore {
     }
 
 
+    // Max number of rows written by a single multi-row INSERT statement. Each row has 6
+    // parameters, which keeps us below SQLite's default limit of 999 parameters.
+    static constexpr size_t kMaxRowsPerInsert = 100;
+
+
+    // Writes records with multi-row INSERT statements, using the given sequences.
+    // If `replace` is true, existing records with the same keys are replaced; if not, it's an
+    // error (SQLITE_CONSTRAINT) for any of the records to exist already.
+    void SQLiteKeyStore::writeRows(const RecordLite recs[], const sequence_t seqs[], size_t n,
+                                   bool replace)
+    {
+        while (n > 0) {
+            size_t nRows = min(n, kMaxRowsPerInsert);
+            stringstream sql;
+            sql << (replace ? "INSERT OR REPLACE" : "INSERT")
+                << " INTO kv_@ (version, body, extra, flags, sequence, key) VALUES ";
+            for (size_t i = 0; i < nRows; ++i)
+                sql << (i ? ",(?,?,?,?,?,?)" : "(?,?,?,?,?,?)");
+
+            // Full-size statements are cached; the last partial one isn't.
+            unique_ptr<SQLite::Statement> partialStmt;
+            SQLite::Statement *stmt;
+            if (nRows == kMaxRowsPerInsert) {
+                stmt = &compile((replace ? _setManyStmt : _insertManyStmt), sql.str().c_str());
+            } else {
+                partialStmt.reset(compile(subst(sql.str().c_str())));
+                stmt = partialStmt.get();
+            }
+
+            int col = 1;
+            for (size_t i = 0; i < nRows; ++i) {
+                const RecordLite &rec = recs[i];
+                stmt->bindNoCopy(col++, rec.version.buf, (int)rec.version.size);
+                stmt->bindNoCopy(col++, rec.body.buf, (int)rec.body.size);
+                stmt->bindNoCopy(col++, rec.extra.buf, (int)rec.extra.size);
+                stmt->bind      (col++, (int)rec.flags);
+                if (_capabilities.sequences)
+                    stmt->bind  (col++, (long long)seqs[i]);
+                else
+                    stmt->bind  (col++); // null
+                stmt->bindNoCopy(col++, (const char*)rec.key.buf, (int)rec.key.size);
+            }
+            UsingStatement u(*stmt);
+            stmt->exec();
+
+            recs += nRows;
+            seqs += nRows;
+            n -= nRows;
+        }
+    }
+
+
+    vector<sequence_t> SQLiteKeyStore::setMany(const vector<RecordLite> &recs, Transaction &t) {
+        vector<sequence_t> seqs(recs.size());
+        size_t n = recs.size(), start = 0;
+        while (start < n) {
+            // Find the next run of unconditional writes (no `sequence`), which can be batched:
+            size_t end = start;
+            while (end < n && !recs[end].sequence && recs[end].updateSequence && !_insertBatch)
+                ++end;
+            if (end - start >= 2) {
+                // Allocate a range of sequences, then write the run with multi-row INSERTs:
+                sequence_t seq = _capabilities.sequences ? lastSequence() : 0;
+                for (size_t i = start; i < end; ++i)
+                    seqs[i] = _capabilities.sequences ? ++seq : 1;
+                if (db().willLog(LogLevel::Verbose) && name() != "default")
+                    db()._logVerbose("KeyStore(%-s) setMany %zu records", name().c_str(), end - start);
+                writeRows(&recs[start], &seqs[start], end - start, true);
+                if (_capabilities.sequences)
+                    setLastSequence(seq);
+                start = end;
+            } else {
+                // Conditional writes have to be done one at a time:
+                seqs[start] = set(recs[start], t);
+                ++start;
+            }
+        }
+        return seqs;
+    }
+
+
+    void SQLiteKeyStore::beginInsertBatch() {
+        Assert(!_insertBatch, "InsertBatches can't be nested");
+        _insertBatch.emplace();
+    }
+
+
+    void SQLiteKeyStore::endInsertBatch(Transaction&, bool write) {
+        if (!_insertBatch)
+            return;
+        auto batch = move(*_insertBatch);
+        _insertBatch.reset();
+        if (!write || batch.empty())
+            return;
+
+        vector<RecordLite> recs;
+        vector<sequence_t> seqs;
+        recs.reserve(batch.size());
+        seqs.reserve(batch.size());
+        for (auto &b : batch) {
+            recs.push_back({b.key, b.version, b.body, b.extra, 0, true, b.flags});
+            seqs.push_back(b.sequence);
+        }
+        if (db().willLog(LogLevel::Verbose) && name() != "default")
+            db()._logVerbose("KeyStore(%-s) insert batch of %zu records", name().c_str(), recs.size());
+        // Use a savepoint so that if any of the INSERTs fails, none of the records are written:
+        db().exec("SAVEPOINT insertBatch");
+        try {
+            writeRows(recs.data(), seqs.data(), recs.size(), false);
+        } catch (...) {
+            db().exec("ROLLBACK TO SAVEPOINT insertBatch");
+            db().exec("RELEASE SAVEPOINT insertBatch");
+            throw;
+        }
+        db().exec("RELEASE SAVEPOINT insertBatch");
+    }
+
+
     bool SQLiteKeyStore::del(slice key, Transaction&, sequence_t seq) {
         Assert(key);
         SQLite::Statement *stmt;
@@ -444,50 +579,191 @@ namespace litecore {
     }
 
 
-    vector<alloc_slice> SQLiteKeyStore::withDocBodies(const vector<slice> &docIDs,
-                                                      WithDocBodyCallback callback)
+    // Max number of keys bound to a single "key IN (...)" query. Well below SQLite's default
+    // limit of 999 parameters.
+    static constexpr size_t kMaxKeysPerQuery = 200;
+
+
+    // Looks up all the keys, with as few "key IN (?,?,...)" queries as possible. Calls the
+    // callback for each record found, with the index of its key in `keys` and the statement,
+    // whose columns are the same as in `read`/`get`, plus the key in column 2.
+    // If a key appears more than once in `keys`, only its first index is passed.
+    // The callback runs while `_stmtMutex` is locked, so it must only copy data out.
+    void SQLiteKeyStore::readMany(const vector<slice> &keys,
+                                  ContentOption content,
+                                  function_ref<void(size_t,SQLite::Statement&)> callback) const
     {
-        if (docIDs.empty())
-            return {};
-
-        unordered_map<slice,size_t> docIndices; // maps docID -> index in docIDs[]
-        docIndices.reserve(docIDs.size());
-
-        // Construct SQL query with a big "IN (...)" clause for all the docIDs:
-        stringstream sql;
-        sql << "SELECT key, fl_callback(key, version, body, extra, sequence, ?) FROM kv_" << name()
-            << " WHERE key IN ('";
-        unsigned n = 0;
-        for (slice docID : docIDs) {
-            docIndices.insert({docID, n});
-            if (n++ > 0)
-                sql << "','";
-            if (docID.findByte('\'')) {
-                string escaped(docID);
-                replace(escaped, "'", "''");
-                sql << escaped;
+        static const char* const kColumns[4] = {
+            "SELECT sequence, flags, key, version, length(body), length(extra) FROM kv_@",
+            "SELECT sequence, flags, key, version, body, length(extra) FROM kv_@",
+            "SELECT sequence, flags, key, version, body, extra FROM kv_@",
+            "SELECT sequence, flags, key, version, length(body), extra FROM kv_@", // kMetaAndExtra
+        };
+        if (content < kMetaOnly || content > kMetaAndExtra)
+            error::_throw(error::InvalidParameter);
+
+        unordered_map<slice,size_t> keyIndices;   // maps key -> index in keys[]
+        keyIndices.reserve(keys.size());
+        vector<slice> uniqueKeys;
+        uniqueKeys.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (keyIndices.insert({keys[i], i}).second)
+                uniqueKeys.push_back(keys[i]);
+        }
+
+        for (size_t start = 0; start < uniqueKeys.size(); start += kMaxKeysPerQuery) {
+            size_t nKeys = min(uniqueKeys.size() - start, kMaxKeysPerQuery);
+            stringstream sql;
+            sql << kColumns[content] << " WHERE key IN (";
+            for (size_t i = 0; i < nKeys; ++i)
+                sql << (i ? ",?" : "?");
+            sql << ")";
+
+            // Full-size statements are cached; a smaller one isn't.
+            unique_ptr<SQLite::Statement> partialStmt;
+            SQLite::Statement *stmt;
+            if (nKeys == kMaxKeysPerQuery) {
+                stmt = &compile(_getManyStmt[content], sql.str().c_str());
             } else {
-                sql << docID;
+                partialStmt.reset(compile(subst(sql.str().c_str())));
+                stmt = partialStmt.get();
+            }
+
+            lock_guard<mutex> lock(_stmtMutex);
+            for (size_t i = 0; i < nKeys; ++i) {
+                slice key = uniqueKeys[start + i];
+                stmt->bindNoCopy(int(i + 1), (const char*)key.buf, (int)key.size);
+            }
+            UsingStatement u(*stmt);
+            while (stmt->executeStep()) {
+                slice key = textColumnAsSlice(stmt->getColumn(2));
+                callback(keyIndices[key], *stmt);
             }
         }
-        sql << "')";
+    }
 
-        SQLite::Statement stmt(db(), sql.str());
-        LogStatement(stmt);
-        stmt.bindPointer(1, &callback, kWithDocBodiesCallbackPointerType);
 
-        // Run the statement and put the results into an array in the same order as docIDs:
+    vector<Record> SQLiteKeyStore::getMany(const vector<slice> &keys, ContentOption content) const {
+        vector<Record> recs;
+        recs.reserve(keys.size());
+        for (slice key : keys)
+            recs.emplace_back(key);
+        readMany(keys, content, [&](size_t i, SQLite::Statement &stmt) {
+            Record &rec = recs[i];
+            rec.updateSequence((int64_t)stmt.getColumn(0));
+            setRecordMetaAndBody(rec, stmt, content);
+        });
+        // Fill in duplicate keys, which readMany only reports once:
+        if (keys.size() > 1) {
+            unordered_map<slice,size_t> first;
+            for (size_t i = 0; i < keys.size(); ++i) {
+                auto [it, inserted] = first.insert({keys[i], i});
+                if (!inserted)
+                    recs[i] = recs[it->second];
+            }
+        }
+        return recs;
+    }
+
+
+    // Number of keys sampled per partition by partitionKeys.
+    static constexpr unsigned kSamplesPerPartition = 32;
+
+
+    vector<alloc_slice> SQLiteKeyStore::partitionKeys(unsigned n) const {
+        vector<alloc_slice> keys;
+        if (n < 2)
+            return keys;
+        // Rowids are assigned in increasing order and looked up in O(log n), so sampling the
+        // keys at evenly spaced rowids is cheap, and approximates a random sample of the keys.
+        // The partition keys are then the quantiles of the sorted sample.
+        unique_ptr<SQLite::Statement> stmt(compile(subst("SELECT min(rowid), max(rowid) FROM kv_@")));
+        if (!stmt->executeStep() || stmt->getColumn(0).isNull())
+            return keys;
+        int64_t minRowid = stmt->getColumn(0).getInt64(), maxRowid = stmt->getColumn(1).getInt64();
+
+        stmt.reset(compile(subst("SELECT key FROM kv_@ WHERE rowid >= ? ORDER BY rowid LIMIT 1")));
+        unsigned nSamples = n * kSamplesPerPartition;
+        vector<alloc_slice> samples;
+        samples.reserve(nSamples);
+        for (unsigned i = 0; i < nSamples; ++i) {
+            auto rowid = minRowid + int64_t(double(maxRowid - minRowid) * i / nSamples);
+            stmt->bind(1, (long long)rowid);
+            if (stmt->executeStep())
+                samples.emplace_back(columnAsSlice(stmt->getColumn(0)));
+            stmt->reset();
+        }
+        sort(samples.begin(), samples.end());
+        samples.erase(unique(samples.begin(), samples.end()), samples.end());
+
+        for (unsigned p = 1; p < n; ++p) {
+            auto &key = samples[samples.size() * p / n];
+            if (key != samples.front() && (keys.empty() || key != keys.back()))
+                keys.push_back(key);
+        }
+        return keys;
+    }
+
+
+    vector<alloc_slice> SQLiteKeyStore::withDocBodies(const vector<slice> &docIDs,
+                                                      WithDocBodyCallback callback,
+                                                      bool readBodies)
+    {
+        // Copy the rows out first: the callback may use this KeyStore, which would deadlock if
+        // it were called while readMany holds the statement lock.
+        struct Row {
+            size_t      index;
+            sequence_t  sequence;
+            DocumentFlags flags;
+            alloc_slice version, body, extra;
+            bool        hasBody;
+        };
+        vector<Row> rows;
+        rows.reserve(docIDs.size());
+        readMany(docIDs, (readBodies ? kEntireBody : kMetaAndExtra),
+                 [&](size_t i, SQLite::Statement &stmt) {
+            Row &row = rows.emplace_back();
+            row.index = i;
+            row.sequence = (int64_t)stmt.getColumn(0);
+            row.flags = (DocumentFlags)(int)stmt.getColumn(1);
+            row.version = alloc_slice(columnAsSlice(stmt.getColumn(3)));
+            if (readBodies) {
+                slice body = columnAsSlice(stmt.getColumn(4));
+                row.body = alloc_slice(body);
+                row.hasBody = (body.buf != nullptr);
+            } else {
+                row.hasBody = stmt.getColumn(4).getInt64() > 0;
+            }
+            row.extra = alloc_slice(columnAsSlice(stmt.getColumn(5)));
+        });
+
         alloc_slice empty(size_t(0));
         vector<alloc_slice> results(docIDs.size());
-        while (stmt.executeStep()) {
-            slice docID = columnAsSlice(stmt.getColumn(0));
-            slice value = textColumnAsSlice(stmt.getColumn(1));
-            size_t i = docIndices[docID];
-            //Log("    -- %zu: %.*s --> '%.*s'", i, SPLAT(docID), SPLAT(revs));
+        for (Row &row : rows) {
+            RecordLite rec;
+            rec.sequence = row.sequence;
+            rec.flags = row.flags;
+            rec.key = docIDs[row.index];
+            rec.version = row.version;
+            if (row.body.size > 0)
+                rec.body = row.body;
+            else if (row.hasBody)
+                rec.body = slice(empty.buf, size_t(0));      // empty but non-null: has a body
+            rec.extra = row.extra;
+            alloc_slice value = callback(rec);
             if (value.size == 0 && value.buf != 0)
-                results[i] = empty;     // reuse one empty slice instead of creating one per row
+                results[row.index] = empty;     // reuse one empty slice instead of creating one per row
             else
-                results[i] = alloc_slice(value);
+                results[row.index] = move(value);
+        }
+        // Copy results to any duplicate docIDs:
+        if (docIDs.size() > 1) {
+            unordered_map<slice,size_t> first;
+            for (size_t i = 0; i < docIDs.size(); ++i) {
+                auto [it, inserted] = first.insert({docIDs[i], i});
+                if (!inserted)
+                    results[i] = results[it->second];
+            }
         }
         return results;
     }
@@ -51,8 +51,11 @@ namespace litecore {
 
         Record get(sequence_t, ContentOption) const override;
         bool read(Record &rec, ContentOption) const override;
+        std::vector<Record> getMany(const std::vector<slice> &keys, ContentOption) const override;
+        std::vector<alloc_slice> partitionKeys(unsigned n) const override;
 
         sequence_t set(const RecordLite&, Transaction&) override;
+        std::vector<sequence_t> setMany(const std::vector<RecordLite>&, Transaction&) override;
 
         bool del(slice key, Transaction&, sequence_t s) override;
 
@@ -70,9 +73,14 @@ namespace litecore {
 
         void deleteIndex(slice name) override;
         std::vector<IndexSpec> getIndexes() const override;
+        bool hasDeferredIndexes() const override;
+        std::unique_ptr<DeferredIndexUpdate> prepareDeferredIndexUpdate(unsigned maxRecords) override;
+        unsigned applyDeferredIndexUpdate(DeferredIndexUpdate&) override;
+        sequence_t indexedSequence() const override;
 
         virtual std::vector<alloc_slice> withDocBodies(const std::vector<slice> &docIDs,
-                                                       WithDocBodyCallback callback) override;
+                                                       WithDocBodyCallback callback,
+                                                       bool readBodies =true) override;
 
         void createSequenceIndex();
         void createConflictsIndex();
@@ -102,6 +110,8 @@ namespace litecore {
 
         void close() override;
         void reopen() override;
+        void beginInsertBatch() override;
+        void endInsertBatch(Transaction&, bool write) override;
 
         static slice columnAsSlice(const SQLite::Column &col);
         static void setRecordMetaAndBody(Record &rec,
@@ -119,6 +129,15 @@ namespace litecore {
         SQLiteDataFile& db() const                    {return (SQLiteDataFile&)dataFile();}
         std::string subst(const char *sqlTemplate) const;
         void setLastSequence(sequence_t seq);
+        void writeRows(const RecordLite recs[], const sequence_t seqs[], size_t n, bool replace);
+        // Extra ContentOption for readMany only: reads `extra` but not `body`
+        static constexpr ContentOption kMetaAndExtra = ContentOption(kEntireBody + 1);
+
+        // The readMany callback is called with the statement lock held, so it mustn't call
+        // back into this KeyStore.
+        void readMany(const std::vector<slice> &keys,
+                      ContentOption,
+                      function_ref<void(size_t,SQLite::Statement&)> callback) const;
         void incrementPurgeCount();
         void createTrigger(std::string_view triggerName,
                            std::string_view triggerSuffix,
@@ -131,13 +150,34 @@ namespace litecore {
                               fleece::impl::ArrayIterator &expressions);
         void _createFlagsIndex(const char *indexName NONNULL, DocumentFlags flag, bool &created);
         bool createFTSIndex(const IndexSpec&);
+        void createDeferredFTSTriggers(const std::string &ftsTableName);
+        void dropFTSTriggers(const std::string &ftsTableName);
         bool createArrayIndex(const IndexSpec&);
         std::string createUnnestedTable(const fleece::impl::Value *arrayPath, const IndexSpec::Options*);
+        static std::string pendingTableName(const std::string &indexTableName);
+        std::vector<std::string> pendingTables() const;
+        // How to reindex a document for an index with deferred updates:
+        struct DeferredIndex {
+            std::string indexTable;                 // Table of index rows, keyed by docid
+            std::string pendingTable;               // Table of rowids of docs to reindex
+            std::string columns;                    // Index table's columns, besides docid
+            std::vector<std::string> valueSQL;      // Computes each column from kv table `doc`
+            std::string conditionSQL {"1"};         // Is `doc` indexed at all?
+        };
+        std::vector<DeferredIndex> deferredIndexes() const;
+        void deferredFTSSQL(const IndexSpec&, DeferredIndex&) const;
         void addExpiration();
 
 #ifdef COUCHBASE_ENTERPRISE
         bool createPredictiveIndex(const IndexSpec&);
-        std::string createPredictionTable(const fleece::impl::Value *arrayPath, const IndexSpec::Options*);
+        std::string createPredictionTable(const fleece::impl::Value *arrayPath,
+                                          const IndexSpec::Options*,
+                                          bool &outModeChanged);
+        void createPredictionTriggers(const fleece::impl::Value *expression,
+                                      const std::string &predTableName);
+        void createDeferredPredictionTriggers(const std::string &predTableName);
+        void dropPredictionTriggers(const std::string &predTableName);
+        void deferredPredictionSQL(const IndexSpec&, DeferredIndex&) const;
         void garbageCollectPredictiveIndexes();
 #endif
 
@@ -147,8 +187,18 @@ namespace litecore {
         unique_ptr<SQLite::Statement> _getBySeqStmt, _getCurBySeqStmt, _getMetaBySeqStmt;
         unique_ptr<SQLite::Statement> _setStmt, _insertStmt, _replaceStmt, _updateBodyStmt;
         unique_ptr<SQLite::Statement> _delByKeyStmt, _delBySeqStmt, _delByBothStmt;
-        unique_ptr<SQLite::Statement> _setFlagStmt, _withDocBodiesStmt;
+        unique_ptr<SQLite::Statement> _setFlagStmt;
         unique_ptr<SQLite::Statement> _setExpStmt, _getExpStmt, _nextExpStmt, _findExpStmt;
+        unique_ptr<SQLite::Statement> _setManyStmt, _insertManyStmt;
+        unique_ptr<SQLite::Statement> _getManyStmt[4];     // indexed by ContentOption
+
+        // A record buffered by an InsertBatch:
+        struct BufferedInsert {
+            alloc_slice key, version, body, extra;
+            DocumentFlags flags;
+            sequence_t sequence;
+        };
+        std::optional<std::vector<BufferedInsert>> _insertBatch;
 
         enum Existence : uint8_t { kNonexistent, kUncommitted, kCommitted };
 
@@ -30,10 +30,6 @@
 #include "GCDMailbox.hh"
 #endif
 
-#ifdef ACTORS_TRACK_STATS
-#include "Stopwatch.hh"
-#endif
-
 #ifdef ACTORS_SUPPORT_ASYNC
 #include "Async.hh"
 #endif
@@ -63,9 +59,10 @@ namespace litecore { namespace actor {
     #define ACTOR_BIND_FN(FN, ARGS)                 ^{ FN(ARGS...); }
 #else
     using Mailbox = ThreadedMailbox;
-    #define ACTOR_BIND_METHOD0(RCVR, METHOD)        std::bind(METHOD, RCVR)
-    #define ACTOR_BIND_METHOD(RCVR, METHOD, ARGS)   std::bind(METHOD, RCVR, ARGS...)
-    #define ACTOR_BIND_FN(FN, ARGS)                 std::bind(FN, ARGS...)
+    // (Lambdas instead of std::bind, so the Closure can usually store them inline.)
+    #define ACTOR_BIND_METHOD0(RCVR, METHOD)        [=]() mutable { ((RCVR)->*METHOD)(); }
+    #define ACTOR_BIND_METHOD(RCVR, METHOD, ARGS)   [=]() mutable { ((RCVR)->*METHOD)(ARGS...); }
+    #define ACTOR_BIND_FN(FN, ARGS)                 [=]() mutable { FN(ARGS...); }
 #endif
 
     #define FUNCTION_TO_QUEUE(METHOD) #METHOD, &METHOD
@@ -89,6 +86,9 @@ namespace litecore { namespace actor {
 
         std::string actorName() const                       {return _mailbox.name();}
 
+        /** A snapshot of the Actor's runtime statistics. */
+        ActorStats stats() const                            {return _mailbox.stats();}
+
         /** The Actor that's currently running, else nullptr */
         static Actor* currentActor()                        {return Mailbox::currentActor();}
 
@@ -0,0 +1,149 @@
+//
+// ActorStats.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#include "ActorStats.hh"
+#include "Logging.hh"
+#include "Stopwatch.hh"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <unordered_set>
+
+using namespace std;
+
+namespace litecore { namespace actor {
+
+    static constexpr auto kRelaxed = memory_order_relaxed;
+
+    // The registry of live MailboxStats. (Pointers, so they can be leaked at exit.)
+    static mutex* sRegistryMutex = new mutex;
+    static unordered_set<const MailboxStats*>* sRegistry = new unordered_set<const MailboxStats*>;
+
+
+    MailboxStats::MailboxStats(const string &name)
+    :_name(name)
+    ,_createdAt(clock::now())
+    {
+        lock_guard<mutex> lock(*sRegistryMutex);
+        sRegistry->insert(this);
+    }
+
+
+    MailboxStats::~MailboxStats() {
+        lock_guard<mutex> lock(*sRegistryMutex);
+        sRegistry->erase(this);
+    }
+
+
+    MailboxStats::clock::time_point MailboxStats::enqueued() noexcept {
+        uint64_t enqueued = _enqueued.fetch_add(1, kRelaxed) + 1;
+        auto depth = uint32_t(enqueued - _handled.load(kRelaxed));
+        auto maxDepth = _maxQueueDepth.load(kRelaxed);
+        while (depth > maxDepth && !_maxQueueDepth.compare_exchange_weak(maxDepth, depth, kRelaxed))
+            ;
+        return clock::now();
+    }
+
+
+    MailboxStats::clock::time_point MailboxStats::started(clock::time_point enqueuedAt) noexcept {
+        auto now = clock::now();
+        double latency = chrono::duration<double>(now - enqueuedAt).count();
+        _latencyBuckets[bucketForLatency(latency)].fetch_add(1, kRelaxed);
+        return now;
+    }
+
+
+    void MailboxStats::finished(clock::time_point startedAt) noexcept {
+        auto busy = chrono::duration_cast<chrono::nanoseconds>(clock::now() - startedAt);
+        _busyNanos.fetch_add(uint64_t(busy.count()), kRelaxed);
+        _handled.fetch_add(1, kRelaxed);
+    }
+
+
+    uint32_t MailboxStats::queueDepth() const noexcept {
+        auto handled = _handled.load(kRelaxed);
+        auto enqueued = _enqueued.load(kRelaxed);
+        return enqueued > handled ? uint32_t(enqueued - handled) : 0;
+    }
+
+
+    // Bucket `i` holds latencies from 2^(i/2) to 2^((i+1)/2) microseconds; bucket 0 also holds
+    // anything shorter, and the last bucket anything longer.
+    unsigned MailboxStats::bucketForLatency(double seconds) noexcept {
+        double micros = seconds * 1.0e6;
+        if (micros <= 1.0)
+            return 0;
+        double bucket = floor(2.0 * log2(micros));
+        return unsigned(min(bucket, double(kNumBuckets - 1)));
+    }
+
+
+    double MailboxStats::latencyPercentile(double p, const uint64_t counts[kNumBuckets],
+                                           uint64_t total) const noexcept
+    {
+        if (total == 0)
+            return 0.0;
+        auto target = uint64_t(ceil(p * double(total)));
+        uint64_t sum = 0;
+        for (unsigned i = 0; i < kNumBuckets; ++i) {
+            sum += counts[i];
+            if (sum >= target) {
+                // Return the geometric midpoint of the bucket:
+                return pow(2.0, (i + 0.5) / 2.0) * 1.0e-6;
+            }
+        }
+        return pow(2.0, kNumBuckets / 2.0) * 1.0e-6;
+    }
+
+
+    ActorStats MailboxStats::snapshot() const {
+        ActorStats stats;
+        stats.name = _name;
+        stats.handled = _handled.load(kRelaxed);
+        stats.enqueued = max(_enqueued.load(kRelaxed), stats.handled);
+        stats.queueDepth = uint32_t(stats.enqueued - stats.handled);
+        stats.maxQueueDepth = max(_maxQueueDepth.load(kRelaxed), stats.queueDepth);
+        stats.busyTime = double(_busyNanos.load(kRelaxed)) * 1.0e-9;
+        stats.lifetime = chrono::duration<double>(clock::now() - _createdAt).count();
+
+        uint64_t counts[kNumBuckets], total = 0;
+        for (unsigned i = 0; i < kNumBuckets; ++i) {
+            counts[i] = _latencyBuckets[i].load(kRelaxed);
+            total += counts[i];
+        }
+        stats.latencyP50 = latencyPercentile(0.50, counts, total);
+        stats.latencyP99 = latencyPercentile(0.99, counts, total);
+        return stats;
+    }
+
+
+    /*static*/ vector<ActorStats> MailboxStats::snapshotAll() {
+        vector<ActorStats> all;
+        {
+            lock_guard<mutex> lock(*sRegistryMutex);
+            all.reserve(sRegistry->size());
+            for (const MailboxStats *stats : *sRegistry)
+                all.push_back(stats->snapshot());
+        }
+        sort(all.begin(), all.end(), [](const ActorStats &a, const ActorStats &b) {
+            return a.name < b.name;
+        });
+        return all;
+    }
+
+
+    void MailboxStats::log() const {
+        ActorStats s = snapshot();
+        LogTo(ActorLog, "%s handled %llu events; max queue depth was %u; latency p50 %s, p99 %s; "
+                        "busy %s (%.1f%%)",
+              s.name.c_str(), (unsigned long long)s.handled, s.maxQueueDepth,
+              fleece::Stopwatch::formatTime(s.latencyP50).c_str(),
+              fleece::Stopwatch::formatTime(s.latencyP99).c_str(),
+              fleece::Stopwatch::formatTime(s.busyTime).c_str(),
+              s.lifetime > 0 ? (s.busyTime / s.lifetime) * 100.0 : 0.0);
+    }
+
+} }
@@ -0,0 +1,101 @@
+//
+// ActorStats.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "fleece/slice.hh"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace litecore { namespace actor {
+
+    /** A snapshot of an Actor's runtime statistics. Times are in seconds. */
+    struct ActorStats {
+        std::string name;               ///< The Actor's name
+        uint64_t    enqueued {0};       ///< Number of messages enqueued
+        uint64_t    handled {0};        ///< Number of messages handled
+        uint32_t    queueDepth {0};     ///< Messages currently queued or running
+        uint32_t    maxQueueDepth {0};  ///< Highest value of queueDepth
+        double      latencyP50 {0};     ///< Median time from enqueue to start of handling
+        double      latencyP99 {0};     ///< 99th percentile of that time
+        double      busyTime {0};       ///< Total time spent handling messages
+        double      lifetime {0};       ///< Time since the Actor was created
+
+        /** Writes the stats as a dictionary to a Fleece Encoder or JSONEncoder. */
+        template <class ENCODER>
+        void writeTo(ENCODER &enc) const {
+            using fleece::slice;
+            enc.beginDict();
+            enc.writeKey(slice("name"));              enc.writeString(slice(name));
+            enc.writeKey(slice("enqueued"));          enc.writeUInt(enqueued);
+            enc.writeKey(slice("handled"));           enc.writeUInt(handled);
+            enc.writeKey(slice("queue_depth"));       enc.writeUInt(queueDepth);
+            enc.writeKey(slice("max_queue_depth"));   enc.writeUInt(maxQueueDepth);
+            enc.writeKey(slice("latency_p50"));       enc.writeDouble(latencyP50);
+            enc.writeKey(slice("latency_p99"));       enc.writeDouble(latencyP99);
+            enc.writeKey(slice("busy_time"));         enc.writeDouble(busyTime);
+            enc.writeKey(slice("lifetime"));          enc.writeDouble(lifetime);
+            enc.endDict();
+        }
+    };
+
+
+    /** Collects the runtime statistics of an Actor's mailbox. Every mailbox has one.
+        Updates use relaxed atomic operations, with no locks, so they're cheap enough to be
+        left on all the time. Queue latencies go into a histogram with logarithmic buckets,
+        from which the percentiles are estimated.
+
+        All live instances are registered in a global list, so they can be snapshotted all at
+        once by snapshotAll(). */
+    class MailboxStats {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        explicit MailboxStats(const std::string &name);
+        ~MailboxStats();
+
+        /** Call when a message is added to the queue. Returns the current time. */
+        clock::time_point enqueued() noexcept;
+
+        /** Call just before handling a message. Returns the current time. */
+        clock::time_point started(clock::time_point enqueuedAt) noexcept;
+
+        /** Call just after handling a message. */
+        void finished(clock::time_point startedAt) noexcept;
+
+        /** Current number of messages queued or running. */
+        uint32_t queueDepth() const noexcept;
+
+        ActorStats snapshot() const;
+
+        /** Returns the stats of every live mailbox. */
+        static std::vector<ActorStats> snapshotAll();
+
+        /** Writes the stats to the log. */
+        void log() const;
+
+    private:
+        static constexpr unsigned kNumBuckets = 64;     // Each bucket is sqrt(2)x wider
+
+        static unsigned bucketForLatency(double seconds) noexcept;
+        double latencyPercentile(double p, const uint64_t counts[kNumBuckets],
+                                 uint64_t total) const noexcept;
+
+        MailboxStats(const MailboxStats&) =delete;
+        MailboxStats& operator=(const MailboxStats&) =delete;
+
+        std::string const           _name;
+        clock::time_point const     _createdAt;
+        std::atomic<uint64_t>       _enqueued {0};
+        std::atomic<uint64_t>       _handled {0};
+        std::atomic<uint32_t>       _maxQueueDepth {0};
+        std::atomic<uint64_t>       _busyNanos {0};
+        std::atomic<uint64_t>       _latencyBuckets[kNumBuckets] {};
+    };
+
+} }
@@ -28,10 +28,6 @@
 #define ACTORS_USE_GCD
 #endif
 
-// TODO: Add developer switch / debug mode to enable these options at runtime
-// Set to 1 to have Actor object report performance statistics in their destructors
-#define ACTORS_TRACK_STATS  0
-
 // Set to 1 to have Actor objects track their calls through manifests to provide an
 // async stack trace on exception
 #define ACTORS_USE_MANIFESTS 0
@@ -43,9 +39,9 @@ namespace litecore { namespace actor {
     class Channel {
     public:
 
-        /** Pushes a new value to the front of the queue.
+        /** Pushes a new value to the front of the queue. (T may be a move-only type.)
             @return  True if the queue was empty before the push. */
-        bool push(const T &t);
+        bool push(T t);
 
         /** Pops the next value from the end of the queue.
             If the queue is empty, blocks until another thread adds something to the queue.
@@ -90,11 +86,11 @@ namespace litecore { namespace actor {
 
 
     template <class T>
-    bool Channel<T>::push(const T &t) {
+    bool Channel<T>::push(T t) {
         std::unique_lock<std::mutex> lock(_mutex);
         bool wasEmpty = _queue.empty();
         if (!_closed) {
-            _queue.push(t);
+            _queue.push(std::move(t));
         }
         lock.unlock();
 
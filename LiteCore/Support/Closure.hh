@@ -0,0 +1,120 @@
+//
+// Closure.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace litecore { namespace actor {
+
+    /** A move-only callable taking no arguments and returning nothing; like
+        `std::function<void()>` but without the copying. A callable whose size is up to
+        `kInlineSize` bytes (and which is nothrow-movable) is stored inline, so creating the
+        Closure doesn't allocate memory; larger ones are allocated on the heap.
+        Actor messages are queued as Closures. */
+    class Closure {
+    public:
+        static constexpr size_t kInlineSize = 8 * sizeof(void*);
+
+        Closure() noexcept                              { }
+        Closure(std::nullptr_t) noexcept                { }
+
+        template <class F,
+                  class = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Closure>>>
+        Closure(F &&f) {
+            using Fn = std::decay_t<F>;
+            if constexpr (isInline<Fn>()) {
+                new (_storage) Fn(std::forward<F>(f));
+                _ops = &InlineOps<Fn>::kOps;
+            } else {
+                *reinterpret_cast<Fn**>(_storage) = new Fn(std::forward<F>(f));
+                _ops = &HeapOps<Fn>::kOps;
+            }
+        }
+
+        Closure(Closure &&other) noexcept               {moveFrom(other);}
+
+        Closure& operator= (Closure &&other) noexcept {
+            if (&other != this) {
+                reset();
+                moveFrom(other);
+            }
+            return *this;
+        }
+
+        ~Closure()                                      {reset();}
+
+        explicit operator bool() const noexcept         {return _ops != nullptr;}
+
+        /** Calls the callable. The Closure must not be empty. */
+        void operator() () const                        {_ops->call(_storage);}
+
+        /** True if the callable is stored inline (for tests.) */
+        bool isInline() const noexcept                  {return _ops && _ops->isInline;}
+
+    private:
+        struct Ops {
+            void (*call)(void *storage);
+            void (*move)(void *dst, void *src) noexcept;    // also destroys src
+            void (*destroy)(void *storage) noexcept;
+            bool isInline;
+        };
+
+        template <class Fn>
+        static constexpr bool isInline() {
+            return sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(std::max_align_t)
+                && std::is_nothrow_move_constructible_v<Fn>;
+        }
+
+        template <class Fn>
+        struct InlineOps {
+            static Fn* get(void *s)                     {return std::launder(reinterpret_cast<Fn*>(s));}
+            static void call(void *s)                   {(*get(s))();}
+            static void move(void *dst, void *src) noexcept {
+                new (dst) Fn(std::move(*get(src)));
+                get(src)->~Fn();
+            }
+            static void destroy(void *s) noexcept       {get(s)->~Fn();}
+            static constexpr Ops kOps = {&call, &move, &destroy, true};
+        };
+
+        template <class Fn>
+        struct HeapOps {
+            static Fn*& get(void *s)                    {return *reinterpret_cast<Fn**>(s);}
+            static void call(void *s)                   {(*get(s))();}
+            static void move(void *dst, void *src) noexcept {
+                *reinterpret_cast<Fn**>(dst) = get(src);
+                get(src) = nullptr;
+            }
+            static void destroy(void *s) noexcept       {delete get(s);}
+            static constexpr Ops kOps = {&call, &move, &destroy, false};
+        };
+
+        void moveFrom(Closure &other) noexcept {
+            if (other._ops) {
+                other._ops->move(_storage, other._storage);
+                _ops = other._ops;
+                other._ops = nullptr;
+            }
+        }
+
+        void reset() noexcept {
+            if (_ops) {
+                _ops->destroy(_storage);
+                _ops = nullptr;
+            }
+        }
+
+        Closure(const Closure&) =delete;
+        Closure& operator= (const Closure&) =delete;
+
+        alignas(std::max_align_t) mutable unsigned char _storage[kInlineSize];
+        const Ops* _ops {nullptr};
+    };
+
+} }
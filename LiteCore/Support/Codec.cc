@@ -21,12 +21,15 @@
 
 
 #include "Codec.hh"
+#include "Snappy.hh"
 #include "Error.hh"
 #include "Logging.hh"
 #include "Endian.hh"
+#include "varint.hh"
 #include <algorithm>
 #include <mutex>
 
+
 namespace litecore { namespace blip {
     using namespace fleece;
 
@@ -74,6 +77,68 @@ namespace litecore { namespace blip {
     }
 
 
+    const char* Codec::algorithmName(Algorithm alg) {
+        switch (alg) {
+            case Algorithm::Deflate:    return "deflate";
+            case Algorithm::Snappy:     return "snappy";
+        }
+        return "?";
+    }
+
+
+    bool Codec::algorithmNamed(slice name, Algorithm &outAlgorithm) {
+        for (auto alg : {Algorithm::Deflate, Algorithm::Snappy}) {
+            if (name.caseEquivalent(slice(algorithmName(alg)))) {
+                outAlgorithm = alg;
+                return true;
+            }
+        }
+        return false;
+    }
+
+
+    bool Codec::algorithmAvailable(Algorithm alg) {
+        switch (alg) {
+            case Algorithm::Deflate:    return true;
+            case Algorithm::Snappy:     return true;
+        }
+        return false;
+    }
+
+
+    std::vector<Codec::Algorithm> Codec::availableAlgorithms() {
+        std::vector<Algorithm> algs;
+        for (auto alg : {Algorithm::Snappy, Algorithm::Deflate}) {
+            if (algorithmAvailable(alg))
+                algs.push_back(alg);
+        }
+        return algs;
+    }
+
+
+    std::unique_ptr<Codec> Codec::newCompressor(Algorithm alg, int level) {
+        if (!algorithmAvailable(alg))
+            error::_throw(error::Unimplemented, "%s compression is not available",
+                          algorithmName(alg));
+        switch (alg) {
+            case Algorithm::Snappy:     return std::make_unique<SnappyCompressor>();
+            default:                    return std::make_unique<Deflater>(
+                                                            Deflater::CompressionLevel(level));
+        }
+    }
+
+
+    std::unique_ptr<Codec> Codec::newDecompressor(Algorithm alg) {
+        if (!algorithmAvailable(alg))
+            error::_throw(error::Unimplemented, "%s compression is not available",
+                          algorithmName(alg));
+        switch (alg) {
+            case Algorithm::Snappy:     return std::make_unique<SnappyDecompressor>();
+            default:                    return std::make_unique<Inflater>();
+        }
+    }
+
+
     // Uncompressed write: just copies input bytes to output (updating checksum)
     void Codec::_writeRaw(slice &input, slice &output) {
         logInfo("Copying %zu bytes into %zu-byte buf (no compression)", input.size, output.size);
@@ -191,6 +256,11 @@ namespace litecore { namespace blip {
     }
 
 
+    slice Deflater::flushTrailer() const {
+        return "\x00\x00\xFF\xFF"_sl;
+    }
+
+
     unsigned Deflater::unflushedBytes() const {
 #ifdef __APPLE__
         // zlib's deflatePending() is only available in iOS 10+ / macOS 10.12+,
@@ -239,4 +309,86 @@ namespace litecore { namespace blip {
                    (int)((uint8_t*)output.buf - outStart), outStart);
     }
 
+
+    slice Inflater::flushTrailer() const {
+        return "\x00\x00\xFF\xFF"_sl;
+    }
+
+
+#pragma mark - SNAPPY:
+
+
+    // Largest amount of data the compressor puts in one block. (Limits the decoder's buffer.)
+    static constexpr size_t kMaxSnappyBlockSize = 64 * 1024;
+
+
+    void SnappyCompressor::write(slice &input, slice &output, Mode mode) {
+        if (mode == Mode::Raw)
+            return _writeRaw(input, output);
+
+        logInfo("Compressing %zu bytes into %zu-byte buf", input.size, output.size);
+        while (input.size > 0) {
+            // Snappy needs room for the worst case, so find how much input is guaranteed to fit:
+            if (output.size <= kMaxVarintLen32)
+                break;
+            size_t room = output.size - kMaxVarintLen32;
+            size_t n = std::min(input.size, kMaxSnappyBlockSize);
+            while (n > 0 && snappy::MaxCompressedLength(n) > room)
+                n = std::min(n - 1, (room > 32) ? (room - 32) * 6 / 7 : 0);
+            if (n == 0)
+                break;
+
+            char *dst = (char*)output.buf + kMaxVarintLen32;
+            size_t compressedSize;
+            snappy::RawCompress((const char*)input.buf, n, dst, &compressedSize);
+            // Write the length prefix, then slide the compressed data down to follow it:
+            size_t prefixSize = PutUVarInt((void*)output.buf, compressedSize);
+            memmove((char*)output.buf + prefixSize, dst, compressedSize);
+
+            addToChecksum({input.buf, n});
+            input.moveStart(n);
+            output.moveStart(prefixSize + compressedSize);
+            logInfo("    compressed %zu bytes to %zu (%.0f%%)",
+                    n, compressedSize, compressedSize * 100.0 / n);
+        }
+    }
+
+
+    void SnappyDecompressor::write(slice &input, slice &output, Mode mode) {
+        if (mode == Mode::Raw)
+            return _writeRaw(input, output);
+
+        for (;;) {
+            // Copy as much buffered data as possible to the output:
+            if (_pending.size > 0) {
+                size_t n = std::min(_pending.size, output.size);
+                addToChecksum({_pending.buf, n});
+                output.writeFrom(slice(_pending.buf, n));
+                _pending.moveStart(n);
+                if (_pending.size > 0)
+                    break;              // Output is full
+            }
+            if (input.size == 0 || output.size == 0)
+                break;
+
+            // Decode the next block into the buffer:
+            uint32_t blockSize;
+            if (!ReadUVarInt32(&input, &blockSize) || blockSize > input.size)
+                error::_throw(error::CorruptData, "Invalid Snappy block in BLIP frame");
+            size_t decodedSize;
+            if (!snappy::GetUncompressedLength((const char*)input.buf, blockSize, &decodedSize)
+                    || decodedSize > kMaxSnappyBlockSize)
+                error::_throw(error::CorruptData, "Invalid Snappy block in BLIP frame");
+            if (!_buffer) {
+                _bufferSize = kMaxSnappyBlockSize;
+                _buffer.reset(new char[_bufferSize]);
+            }
+            if (!snappy::RawUncompress((const char*)input.buf, blockSize, _buffer.get()))
+                error::_throw(error::CorruptData, "Invalid Snappy block in BLIP frame");
+            input.moveStart(blockSize);
+            _pending = slice(_buffer.get(), decodedSize);
+            logInfo("    decompressed %u bytes to %zu", blockSize, decodedSize);
+        }
+    }
+
 } }
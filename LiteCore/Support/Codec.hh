@@ -20,6 +20,8 @@
 #include "fleece/slice.hh"
 #include "fleece/Fleece.hh"
 #include "Logging.hh"
+#include <memory>
+#include <vector>
 #include <zlib.h>
 
 namespace litecore { namespace blip {
@@ -57,6 +59,10 @@ namespace litecore { namespace blip {
             the output yet for lack of space. */
         virtual unsigned unflushedBytes() const         {return 0;}
 
+        /** If every flushed write ends with the same bytes, returns them; BLIP omits them from
+            frames, and adds them back before decoding. (Deflate's is `00 00 FF FF`.) */
+        virtual slice flushTrailer() const              {return fleece::nullslice;}
+
         static constexpr size_t kChecksumSize = 4;
 
         /** Writes the codec's current checksum to the output slice.
@@ -67,8 +73,36 @@ namespace litecore { namespace blip {
             If they aren't equal, throws an exception. */
         void readAndVerifyChecksum(slice &input) const;
 
-    protected:
+        /** Adds data to the checksum without writing it anywhere. Equivalent to a Raw-mode
+            `write`, for a caller that sends the data itself instead of copying it. */
         void addToChecksum(slice data);
+
+        /** Compression algorithms. Both peers of a connection must use the same one. */
+        enum class Algorithm : uint8_t {
+            Deflate,        // zlib 'deflate'; always available, and the default
+            Snappy,         // Google's Snappy; much faster, but compresses less
+        };
+
+        /** The algorithm's name, as used in option values and protocol names. */
+        static const char* algorithmName(Algorithm);
+
+        /** Looks up an algorithm by name (case-insensitive); returns false if unknown. */
+        static bool algorithmNamed(slice name, Algorithm &outAlgorithm);
+
+        /** True if support for the algorithm is compiled in. */
+        static bool algorithmAvailable(Algorithm);
+
+        /** The available algorithms, most preferred first. */
+        static std::vector<Algorithm> availableAlgorithms();
+
+        /** Creates a compressing Codec. `level` is a Deflater::CompressionLevel; it's ignored
+            by algorithms that don't have levels. */
+        static std::unique_ptr<Codec> newCompressor(Algorithm, int level);
+
+        /** Creates a decompressing Codec. */
+        static std::unique_ptr<Codec> newDecompressor(Algorithm);
+
+    protected:
         void _writeRaw(slice &input, slice &output);
 
         uint32_t _checksum {0};
@@ -107,6 +141,7 @@ namespace litecore { namespace blip {
 
         void write(slice &input, slice &output, Mode =Mode::Default) override;
         unsigned unflushedBytes() const override;
+        slice flushTrailer() const override;
 
     private:
         void _writeAndFlush(slice &input, slice &output);
@@ -120,6 +155,31 @@ namespace litecore { namespace blip {
         ~Inflater();
 
         void write(slice &input, slice &output, Mode =Mode::Default) override;
+        slice flushTrailer() const override;
+    };
+
+
+    /** Compressing codec that uses Snappy. The output is a series of blocks, each consisting
+        of a varint giving its length followed by raw Snappy-compressed data. Every write
+        produces whole blocks, so nothing is ever left unflushed. (See Snappy.hh.) */
+    class SnappyCompressor : public Codec {
+    public:
+        void write(slice &input, slice &output, Mode =Mode::Default) override;
+    };
+
+
+    /** Decompressing codec that reads the output of SnappyCompressor. Each block is decoded
+        all at once into an internal buffer, which is then copied to the output as space
+        allows; unflushedBytes() returns the amount still buffered. */
+    class SnappyDecompressor : public Codec {
+    public:
+        void write(slice &input, slice &output, Mode =Mode::Default) override;
+        unsigned unflushedBytes() const override        {return unsigned(_pending.size);}
+
+    private:
+        std::unique_ptr<char[]> _buffer;
+        size_t                  _bufferSize {0};
+        slice                   _pending;           // Decoded data not yet output
     };
 
 } }
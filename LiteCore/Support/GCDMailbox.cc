@@ -27,20 +27,6 @@ using namespace std;
 
 namespace litecore { namespace actor {
 
-
-#if ACTORS_TRACK_STATS
-#define beginLatency()  fleece::Stopwatch st
-#define endLatency()    _maxLatency = max(_maxLatency, (double)st.elapsed())
-#define beginBusy()     _busy.start()
-#define endBusy()       _maxBusy = max(_maxBusy, _busy.lap())
-#else
-#define beginLatency()  ({})
-#define endLatency()    ({})
-#define beginBusy()     ({})
-#define endBusy()       ({})
-#endif
-
-    
     static char kQueueMailboxSpecificKey;
 
     static const qos_class_t kQOS = QOS_CLASS_UTILITY;
@@ -51,6 +37,7 @@ namespace litecore { namespace actor {
 
     GCDMailbox::GCDMailbox(Actor *a, const std::string &name, GCDMailbox *parentMailbox)
     :_actor(a)
+    ,_stats(name)
     {
         dispatch_queue_t targetQueue;
         if (parentMailbox)
@@ -106,9 +93,9 @@ namespace litecore { namespace actor {
 
     
     void GCDMailbox::enqueue(const char* name, void (^block)()) {
-        beginLatency();
         ++_eventCount;
         retain(_actor);
+        auto enqueuedAt = _stats.enqueued();
 
 #if ACTORS_USE_MANIFESTS
         auto queueManifest = sQueueManifest ? sQueueManifest : make_shared<ChannelManifest>();
@@ -122,10 +109,7 @@ namespace litecore { namespace actor {
             sQueueManifest = queueManifest;
             _localManifest.addExecution(_actor, name);
 #endif
-            endLatency();
-            beginBusy();
-            safelyCall(block);
-            afterEvent();
+            runEvent(block, enqueuedAt);
 #if ACTORS_USE_MANIFESTS
             sQueueManifest.reset();
 #endif
@@ -135,9 +119,11 @@ namespace litecore { namespace actor {
 
 
     void GCDMailbox::enqueueAfter(delay_t delay, const char* name, void (^block)()) {
-        beginLatency();
         ++_eventCount;
         retain(_actor);
+        // Latency is measured from when the delay expires:
+        auto enqueuedAt = _stats.enqueued()
+                        + std::chrono::duration_cast<MailboxStats::clock::duration>(delay);
 
 #if ACTORS_USE_MANIFESTS
         auto queueManifest = sQueueManifest ? sQueueManifest : make_shared<ChannelManifest>();
@@ -151,10 +137,7 @@ namespace litecore { namespace actor {
             sQueueManifest = queueManifest;
             _localManifest.addExecution(_actor, name);
 #endif
-            endLatency();
-            beginBusy();
-            safelyCall(block);
-            afterEvent();
+            runEvent(block, enqueuedAt);
 #if ACTORS_USE_MANIFESTS
             sQueueManifest.reset();
 #endif
@@ -166,29 +149,18 @@ namespace litecore { namespace actor {
             dispatch_async(_queue, wrappedBlock);
     }
 
-    void GCDMailbox::afterEvent() {
-        _actor->afterEvent();
-        endBusy();
-#if ACTORS_TRACK_STATS
-        ++_callCount;
-        if (_eventCount > _maxEventCount) {
-            _maxEventCount = _eventCount;
-        }
-#endif
+    void GCDMailbox::runEvent(void (^block)(), MailboxStats::clock::time_point enqueuedAt) {
+        auto startedAt = _stats.started(enqueuedAt);
+        safelyCall(block);
+        afterEvent();
+        _stats.finished(startedAt);
         --_eventCount;
         release(_actor);
     }
 
 
-    void GCDMailbox::logStats() const {
-#if ACTORS_TRACK_STATS
-        printf("%-25s handled %5d events; max queue depth was %3d; max latency was %10s; busy total %10s (%4.1f%%), max %10s\n",
-              _actor->actorName().c_str(), _callCount, _maxEventCount,
-              fleece::Stopwatch::formatTime(_maxLatency).c_str(),
-              fleece::Stopwatch::formatTime(_busy.elapsed()).c_str(),
-              (_busy.elapsed() / _createdAt.elapsed())*100.0,
-              fleece::Stopwatch::formatTime(_maxBusy).c_str());
-#endif
+    void GCDMailbox::afterEvent() {
+        _actor->afterEvent();
     }
 
 
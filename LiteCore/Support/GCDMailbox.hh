@@ -18,7 +18,7 @@
 
 #pragma once
 #include "ThreadedMailbox.hh"
-#include "Stopwatch.hh"
+#include "ActorStats.hh"
 #include "ChannelManifest.hh"
 #include <atomic>
 #include <functional>
@@ -49,34 +49,28 @@ namespace litecore { namespace actor {
 
         static void startScheduler(Scheduler *)             { }
 
-        void logStats() const;
+        ActorStats stats() const                            {return _stats.snapshot();}
+
+        void logStats() const                               {_stats.log();}
 
         static Actor* currentActor();
 
         static void runAsyncTask(void (*task)(void*), void *context);
 
     private:
-        void runEvent(void (^block)());
+        void runEvent(void (^block)(), MailboxStats::clock::time_point enqueuedAt);
         void afterEvent();
         void safelyCall(void (^block)()) const;
         
         Actor *_actor;
         dispatch_queue_t _queue;
         std::atomic<int32_t> _eventCount {0};
+        MailboxStats _stats;
         
 #if ACTORS_USE_MANIFESTS
         mutable ChannelManifest _localManifest;
         static thread_local std::shared_ptr<ChannelManifest> sQueueManifest;
 #endif
-        
-#if ACTORS_TRACK_STATS
-        int32_t _callCount {0};
-        int32_t _maxEventCount {0};
-        double _maxLatency {0};
-        double _maxBusy {0};
-        fleece::Stopwatch _createdAt {true};
-        fleece::Stopwatch _busy {false};
-#endif
     };
 
 } }
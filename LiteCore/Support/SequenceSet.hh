@@ -17,9 +17,10 @@
 //
 
 #pragma once
-#include <map>
+#include <algorithm>
 #include <string>
 #include <utility>
+#include <vector>
 #include "betterassert.hh"
 
 namespace litecore {
@@ -28,48 +29,54 @@ namespace litecore {
         This is used by the replicator to keep track of which revisions are being pushed.
 
         \note The implementation is optimized for consecutive ranges of sequences: it stores
-        ranges using a std::map that maps the first sequence in a range to the end of the range. */
+        ranges as a sorted vector of [start, end) pairs. Ranges removed from the front aren't
+        erased right away; the live ranges just start later in the vector, and the dead slots
+        are reused or compacted away when a range is inserted. So the common cases -- adding
+        sequences in increasing order at the end, and removing or merging the earliest ones
+        at the front -- are O(1) amortized and don't allocate per sequence. Changes in the
+        middle are O(ranges). */
     class SequenceSet {
     public:
         using sequence = uint64_t;
-        using Map = std::map<sequence, sequence>;
+        using Range = std::pair<sequence, sequence>;
 
         SequenceSet() { }
 
         /** Empties the set. */
-        void clear()                            {_sequences.clear();}
+        void clear()                            {_ranges.clear(); _start = 0;}
 
         /** Is the set empty? (This is faster than `size() == 0`.) */
-        bool empty() const                      {return _sequences.empty();}
+        bool empty() const                      {return _start == _ranges.size();}
 
         /** The number of sequences in the set. */
         size_t size() const {
             size_t total = 0;
-            for (auto &range : _sequences)
+            for (auto &range : *this)
                 total += range.second - range.first;
             return total;
         }
 
         /** The number of ranges of consecutive sequences in the set. */
-        size_t rangesCount() const              {return _sequences.size();}
+        size_t rangesCount() const              {return _ranges.size() - _start;}
 
         /** Returns the lowest sequence in the set. If the set is empty, returns 0. */
-        sequence first() const                  {return empty() ? 0 : _sequences.begin()->first;}
+        sequence first() const                  {return empty() ? 0 : _ranges[_start].first;}
 
         /** Returns the highest sequence in the set. If the set is empty, returns 0. */
-        sequence last() const                   {return empty() ? 0 : prev(_sequences.end())->second - 1;}
+        sequence last() const                   {return empty() ? 0 : _ranges.back().second - 1;}
 
         /** Is the sequence in the set? */
         bool contains(sequence s) const {
-            auto i = _sequences.upper_bound(s); // first range with start > s
-            if (i == _sequences.begin())
+            size_t i = upperBound(s); // first range with start > s
+            if (i == _start)
                 return false;
-            i = prev(i);
-            return s < i->second;
+            return s < _ranges[i - 1].second;
         }
 
-        bool operator== (const SequenceSet &other) const  {return _sequences == other._sequences;}
-        bool operator!= (const SequenceSet &other) const  {return _sequences != other._sequences;}
+        bool operator== (const SequenceSet &other) const {
+            return std::equal(begin(), end(), other.begin(), other.end());
+        }
+        bool operator!= (const SequenceSet &other) const  {return !(*this == other);}
 
         /** Adds a sequence. */
         void add(sequence s) {
@@ -80,14 +87,12 @@ namespace litecore {
         void add(sequence s0, sequence s1) {
             assert (s1 >= s0);
             if (s1 > s0) {
-                auto lower = _add(s0);
+                _add(s0);
                 if (s1 > s0 + 1) {
-                    auto upper = _add(s1 - 1);
-                    if (upper != lower) {
-                        // Merge lower and upper, discarding any ranges in between:
-                        lower->second = upper->second;
-                        _sequences.erase(next(lower), next(upper));
-                    }
+                    size_t upper = _add(s1 - 1);
+                    size_t lower = upperBound(s0) - 1;   // (_add may have moved it)
+                    if (upper != lower)
+                        mergeRanges(lower, upper);
                 }
             }
         }
@@ -101,30 +106,31 @@ namespace litecore {
             // * s is at the end of a range, so decrement its end
             // * s is in the middle of a range, so split the range
 
-            auto i = _sequences.upper_bound(s); // first range with start > s
-            if (i == _sequences.begin())
+            size_t i = upperBound(s); // first range with start > s
+            if (i == _start)
                 return false;
-            i = prev(i);
-            
-            if (s >= i->second) {
+            --i;
+            Range &range = _ranges[i];
+
+            if (s >= range.second) {
                 // * not contained in a range
                 return false;
-            } else if (s == i->first) {
-                if (s == i->second - 1) {
+            } else if (s == range.first) {
+                if (s == range.second - 1) {
                     // * at the start & end: remove the range
-                    _sequences.erase(i);
+                    eraseRanges(i, i + 1);
                 } else {
                     // * at the start of a range
-                    _sequences.emplace_hint(next(i), s + 1, i->second);
-                    _sequences.erase(i);
+                    range.first = s + 1;
                 }
-            } else if (s == i->second - 1) {
+            } else if (s == range.second - 1) {
                 // * at the end of a range
-                i->second = s;
+                range.second = s;
             } else {
                 // * split the range:
-                _sequences.emplace_hint(next(i), s + 1, i->second);
-                i->second = s;
+                Range upper {s + 1, range.second};
+                range.second = s;
+                insertRange(i + 1, upper);
             }
             return true;
         }
@@ -139,11 +145,11 @@ namespace litecore {
                     remove(s1 - 1);
                     if (s1 > s0 + 2) {
                         // Remove any remaining ranges between s0 and s1:
-                        auto begin = _sequences.upper_bound(s0); // first range with start > s0
-                        auto end = begin;
-                        while (end != _sequences.end() && end->second <= s1)
+                        size_t begin = upperBound(s0); // first range with start > s0
+                        size_t end = begin;
+                        while (end != _ranges.size() && _ranges[end].second <= s1)
                             ++end;
-                        _sequences.erase(begin, end);
+                        eraseRanges(begin, end);
                     }
                 }
             }
@@ -153,16 +159,73 @@ namespace litecore {
         /** Iteration is over pair<sequence,sequence> values, where the first sequence is the
             start of a consecutive range, and the second sequence is the end of the range
             (one past the last sequence in the range.) */
-        using const_iterator = Map::const_iterator;
-        const_iterator begin() const                  {return _sequences.begin();}
-        const_iterator end() const                    {return _sequences.end();}
+        using const_iterator = std::vector<Range>::const_iterator;
+        const_iterator begin() const                  {return _ranges.begin() + _start;}
+        const_iterator end() const                    {return _ranges.end();}
 
         /** Returns a human-readable description, like "{1, 4, 7-9}". */
         std::string to_string() const;
 
     private:
-        // Implementation of add; returns an iterator pointing to the range containing `s`
-        Map::iterator _add(sequence s) {
+        // Index of the first range whose start is > s (or _ranges.size() if none.)
+        // Checks the ends first, since that's where most activity is.
+        size_t upperBound(sequence s) const {
+            size_t end = _ranges.size();
+            if (_start == end || s >= _ranges[end - 1].first)
+                return end;
+            if (s < _ranges[_start].first)
+                return _start;
+            if (s < _ranges[_start + 1].first)
+                return _start + 1;
+            auto i = std::upper_bound(_ranges.begin() + _start + 2, _ranges.end() - 1, s,
+                                      [](sequence s, const Range &r) {return s < r.first;});
+            return i - _ranges.begin();
+        }
+
+        // Inserts a range before index i; returns the index it's now at.
+        size_t insertRange(size_t i, Range range) {
+            if (i == _start && _start > 0) {
+                _ranges[--_start] = range;      // Reuse a dead slot in front
+                return _start;
+            }
+            if (_start >= kMinCompaction && 2 * _start >= _ranges.size()) {
+                // Erase the dead slots in front, before the vector grows:
+                _ranges.erase(_ranges.begin(), _ranges.begin() + _start);
+                i -= _start;
+                _start = 0;
+            }
+            _ranges.insert(_ranges.begin() + i, range);
+            return i;
+        }
+
+        // Removes the ranges with indexes in [i, j).
+        void eraseRanges(size_t i, size_t j) {
+            if (i == _start) {
+                _start = j;
+                if (_start == _ranges.size())
+                    clear();
+            } else {
+                _ranges.erase(_ranges.begin() + i, _ranges.begin() + j);
+            }
+        }
+
+        // Merges the ranges from index `lower` to `upper` (inclusive) into one, discarding
+        // any in between. Returns the index of the merged range.
+        size_t mergeRanges(size_t lower, size_t upper) {
+            if (lower == _start) {
+                // At the front it's cheaper to keep the upper range and drop the lower ones:
+                _ranges[upper].first = _ranges[lower].first;
+                eraseRanges(lower, upper);
+                return upper;
+            } else {
+                _ranges[lower].second = _ranges[upper].second;
+                eraseRanges(lower + 1, upper + 1);
+                return lower;
+            }
+        }
+
+        // Implementation of add; returns the index of the range containing `s`
+        size_t _add(sequence s) {
             // Possibilities:
             // * s is already contained within a range
             // * s is just before a range, so prepend it
@@ -170,41 +233,41 @@ namespace litecore {
             // * s fills a crack between two ranges (i.e. both of the above), so merge them
             // * s creates a new range of length 1
 
-            auto upper = _sequences.upper_bound(s); // first range with start > s
-            if (upper != _sequences.end() && s == upper->first - 1) {
+            size_t upper = upperBound(s); // first range with start > s
+            if (upper != _ranges.size() && s == _ranges[upper].first - 1) {
                 // s is just before upper; extend it or merge:
-                if (upper != _sequences.begin()) {
-                    auto lower = prev(upper);
-                    if (lower->second == s) {
+                if (upper != _start) {
+                    size_t lower = upper - 1;
+                    if (_ranges[lower].second == s) {
                         // * Merge upper and lower
-                        lower->second = upper->second;
-                        _sequences.erase(upper);
-                        return lower;
+                        return mergeRanges(lower, upper);
                     }
                 }
                 // * Prepend s to upper:
-                auto newUpper = _sequences.emplace_hint(upper, s, upper->second);
-                _sequences.erase(upper);
-                return newUpper;
+                _ranges[upper].first = s;
+                return upper;
             }
 
-            if (upper != _sequences.begin()) {
-                auto lower = prev(upper);
-                if (s < lower->second) {
+            if (upper != _start) {
+                size_t lower = upper - 1;
+                if (s < _ranges[lower].second) {
                     // * Already contained
                     return lower;
-                } else if (s == lower->second) {
+                } else if (s == _ranges[lower].second) {
                     // * Append s to lower:
-                    ++lower->second;
+                    ++_ranges[lower].second;
                     return lower;
                 }
             }
 
             // * Insert a singleton
-            return _sequences.emplace_hint(upper, s, s + 1);
+            return insertRange(upper, {s, s + 1});
         }
 
-        Map _sequences;    // Maps start of range --> end of range (exclusive)
+        static constexpr size_t kMinCompaction = 16;  // Min dead ranges before compacting
+
+        std::vector<Range> _ranges;     // Ranges [start, end), sorted; those before _start are dead
+        size_t _start {0};              // Index of first live range in _ranges
     };
 
 }
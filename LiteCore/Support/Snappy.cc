@@ -0,0 +1,223 @@
+//
+// Snappy.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// A compressed block is the uncompressed length as a varint, followed by a series of elements.
+// The low two bits of each element's tag byte give its type:
+//   00: literal; the length-1 is in the upper six bits, or if those are 60..63, in the
+//       following 1..4 bytes (little-endian).
+//   01: copy of 4..11 bytes with an 11-bit offset (three bits in the tag, then one byte.)
+//   10: copy of 1..64 bytes with a 16-bit little-endian offset.
+//   11: copy of 1..64 bytes with a 32-bit little-endian offset.
+// A copy repeats `length` bytes starting `offset` bytes back in the output; they may overlap.
+
+#include "Snappy.hh"
+#include "varint.hh"
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+
+namespace litecore { namespace snappy {
+    using namespace fleece;
+
+
+    // Input is compressed in independent fragments of this size, so that offsets within a
+    // fragment fit in the 16-bit hash table.
+    static constexpr size_t kFragmentSize = 64 * 1024;
+
+    static constexpr unsigned kHashBits = 14;
+    static constexpr size_t kHashTableSize = size_t(1) << kHashBits;
+
+
+    static inline uint32_t load32(const uint8_t *p) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+
+    static inline uint32_t hash(uint32_t v) {
+        return (v * 0x1e35a7bd) >> (32 - kHashBits);
+    }
+
+
+    static uint8_t* emitLiteral(uint8_t *op, const uint8_t *literal, size_t len) {
+        if (len == 0)
+            return op;
+        size_t n = len - 1;
+        if (n < 60) {
+            *op++ = uint8_t(n << 2);
+        } else {
+            uint8_t *tag = op++;
+            unsigned count = 0;
+            for (; n > 0; n >>= 8, ++count)
+                *op++ = uint8_t(n & 0xFF);
+            *tag = uint8_t((59 + count) << 2);
+        }
+        memcpy(op, literal, len);
+        return op + len;
+    }
+
+
+    // Emits a copy of 4..64 bytes.
+    static uint8_t* emitCopyAtMost64(uint8_t *op, size_t offset, size_t len) {
+        if (len < 12 && offset < 2048) {
+            *op++ = uint8_t(1 | ((len - 4) << 2) | ((offset >> 8) << 5));
+            *op++ = uint8_t(offset & 0xFF);
+        } else {
+            *op++ = uint8_t(2 | ((len - 1) << 2));
+            *op++ = uint8_t(offset & 0xFF);
+            *op++ = uint8_t(offset >> 8);
+        }
+        return op;
+    }
+
+
+    static uint8_t* emitCopy(uint8_t *op, size_t offset, size_t len) {
+        // Emit 64-byte copies, leaving at least 4 bytes for the last one:
+        while (len >= 68) {
+            op = emitCopyAtMost64(op, offset, 64);
+            len -= 64;
+        }
+        if (len > 64) {
+            op = emitCopyAtMost64(op, offset, 60);
+            len -= 60;
+        }
+        return emitCopyAtMost64(op, offset, len);
+    }
+
+
+    static uint8_t* compressFragment(const uint8_t *src, size_t n, uint8_t *op, uint16_t *table) {
+        memset(table, 0, kHashTableSize * sizeof(uint16_t));
+        size_t pos = 0, literalStart = 0;
+        uint32_t skip = 32;
+        while (pos + 4 <= n) {
+            uint32_t v = load32(src + pos);
+            uint16_t &slot = table[hash(v)];
+            size_t candidate = slot;
+            slot = uint16_t(pos);
+            if (candidate < pos && load32(src + candidate) == v) {
+                op = emitLiteral(op, src + literalStart, pos - literalStart);
+                size_t len = 4;
+                while (pos + len < n && src[candidate + len] == src[pos + len])
+                    ++len;
+                op = emitCopy(op, pos - candidate, len);
+                pos += len;
+                literalStart = pos;
+                skip = 32;
+            } else {
+                // The longer we go without a match, the faster we skip ahead:
+                pos += skip++ >> 5;
+            }
+        }
+        return emitLiteral(op, src + literalStart, n - literalStart);
+    }
+
+
+    size_t MaxCompressedLength(size_t inputSize) {
+        return 32 + inputSize + inputSize / 6;
+    }
+
+
+    void RawCompress(const char *input, size_t inputSize, char *output, size_t *compressedSize) {
+        auto op = (uint8_t*)output;
+        op += PutUVarInt(op, inputSize);
+        uint16_t table[kHashTableSize];
+        for (size_t start = 0; start < inputSize; start += kFragmentSize) {
+            size_t n = std::min(kFragmentSize, inputSize - start);
+            op = compressFragment((const uint8_t*)input + start, n, op, table);
+        }
+        *compressedSize = op - (uint8_t*)output;
+    }
+
+
+    bool GetUncompressedLength(const char *compressed, size_t compressedSize, size_t *result) {
+        slice in(compressed, compressedSize);
+        uint32_t len;
+        if (!ReadUVarInt32(&in, &len))
+            return false;
+        *result = len;
+        return true;
+    }
+
+
+    bool RawUncompress(const char *compressed, size_t compressedSize, char *output) {
+        slice in(compressed, compressedSize);
+        uint32_t outputSize;
+        if (!ReadUVarInt32(&in, &outputSize))
+            return false;
+        auto ip = (const uint8_t*)in.buf, end = ip + in.size;
+        auto start = (uint8_t*)output, op = start, opEnd = start + outputSize;
+
+        while (ip < end) {
+            uint8_t tag = *ip++;
+            size_t len, offset;
+            switch (tag & 3) {
+                case 0: {
+                    len = (tag >> 2) + 1;
+                    if (len > 60) {
+                        size_t nBytes = len - 60;
+                        if (size_t(end - ip) < nBytes)
+                            return false;
+                        len = 0;
+                        for (size_t i = 0; i < nBytes; ++i)
+                            len |= size_t(ip[i]) << (8 * i);
+                        len += 1;
+                        ip += nBytes;
+                    }
+                    if (size_t(end - ip) < len || size_t(opEnd - op) < len)
+                        return false;
+                    memcpy(op, ip, len);
+                    ip += len;
+                    op += len;
+                    continue;
+                }
+                case 1:
+                    if (end - ip < 1)
+                        return false;
+                    len = 4 + ((tag >> 2) & 7);
+                    offset = (size_t(tag >> 5) << 8) | ip[0];
+                    ip += 1;
+                    break;
+                case 2:
+                    if (end - ip < 2)
+                        return false;
+                    len = (tag >> 2) + 1;
+                    offset = ip[0] | (size_t(ip[1]) << 8);
+                    ip += 2;
+                    break;
+                default:
+                    if (end - ip < 4)
+                        return false;
+                    len = (tag >> 2) + 1;
+                    offset = ip[0] | (size_t(ip[1]) << 8) | (size_t(ip[2]) << 16)
+                                    | (size_t(ip[3]) << 24);
+                    ip += 4;
+                    break;
+            }
+            if (offset == 0 || offset > size_t(op - start) || size_t(opEnd - op) < len)
+                return false;
+            // The source and destination may overlap, so copy byte by byte:
+            const uint8_t *from = op - offset;
+            for (size_t i = 0; i < len; ++i)
+                op[i] = from[i];
+            op += len;
+        }
+        return op == opEnd;
+    }
+
+} }
@@ -0,0 +1,43 @@
+//
+// Snappy.hh
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include <stddef.h>
+
+/** A compact encoder and decoder for the raw (unframed) block format of Google's Snappy:
+    https://github.com/google/snappy/blob/master/format_description.txt
+    The output is readable by any Snappy implementation, and vice versa. The function names
+    and semantics match the ones in snappy.h. */
+namespace litecore { namespace snappy {
+
+    /** The largest possible compressed size of `inputSize` bytes. */
+    size_t MaxCompressedLength(size_t inputSize);
+
+    /** Compresses `inputSize` bytes at `input` into `output`, which must have room for
+        `MaxCompressedLength(inputSize)` bytes, and stores the compressed size. */
+    void RawCompress(const char *input, size_t inputSize, char *output, size_t *compressedSize);
+
+    /** Reads the uncompressed size from the header of a compressed block.
+        Returns false if the header is invalid. */
+    bool GetUncompressedLength(const char *compressed, size_t compressedSize, size_t *result);
+
+    /** Decompresses a block into `output`, which must have room for the size returned by
+        `GetUncompressedLength`. Returns false if the data is corrupt. */
+    bool RawUncompress(const char *compressed, size_t compressedSize, char *output);
+
+} }
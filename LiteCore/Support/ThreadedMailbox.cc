@@ -32,20 +32,6 @@ using namespace std;
 
 namespace litecore { namespace actor {
 
-#if ACTORS_TRACK_STATS
-#define beginLatency()  fleece::Stopwatch st
-#define endLatency()    _maxLatency = max(_maxLatency, (double)st.elapsed())
-#define beginBusy()     _busy.start()
-#define endBusy()       _busy.stop()
-#define SELF            this, st
-#else
-#define beginLatency()
-#define endLatency()
-#define beginBusy()
-#define endBusy()
-#define SELF            this
-#endif
-
 #pragma mark - SCHEDULER:
 
     struct RunAsyncActor : Actor
@@ -77,6 +63,10 @@ namespace litecore { namespace actor {
     }
 
 
+    thread_local Scheduler* Scheduler::sCurrentScheduler;
+    thread_local unsigned Scheduler::sCurrentQueue;
+
+
     void Scheduler::start() {
         if (!_started.test_and_set()) {
             if (_numThreads == 0) {
@@ -85,6 +75,12 @@ namespace litecore { namespace actor {
                     _numThreads = 2;
             }
             LogTo(ActorLog, "Starting Scheduler<%p> with %u threads", this, _numThreads);
+            _stopping = false;
+            // The queues are created only once, since other threads may push to them anytime:
+            if (_queues.empty()) {
+                for (unsigned i = 0; i < _numThreads; i++)
+                    _queues.emplace_back(new WorkQueue);
+            }
             for (unsigned id = 1; id <= _numThreads; id++)
                 _threadPool.emplace_back([this,id]{task(id);});
         }
@@ -93,10 +89,24 @@ namespace litecore { namespace actor {
 
     void Scheduler::stop() {
         LogTo(ActorLog, "Stopping Scheduler<%p>...", this);
-        _queue.close();
+        {
+            unique_lock<mutex> lock(_idleMutex);
+            _stopping = true;
+            _idleCond.notify_all();
+        }
         for (auto &t : _threadPool) {
             t.join();
         }
+        _threadPool.clear();
+        {
+            // Discard any mailboxes pushed while the threads were exiting:
+            unique_lock<mutex> lock(_idleMutex);
+            for (auto &queue : _queues) {
+                lock_guard<mutex> queueLock(queue->mutex);
+                _pending -= queue->mailboxes.size();
+                queue->mailboxes.clear();
+            }
+        }
         LogTo(ActorLog, "Scheduler<%p> has stopped", this);
         _started.clear();
     }
@@ -104,28 +114,88 @@ namespace litecore { namespace actor {
 
     void Scheduler::task(unsigned taskID) {
         LogVerbose(ActorLog, "   task %d starting", taskID);
-        char name[100];
-        sprintf(name, "CBL Scheduler#%u", taskID);
-        SetThreadName(name);
-        ThreadedMailbox *mailbox;
-        while ((mailbox = _queue.pop()) != nullptr) {
-            LogVerbose(ActorLog, "   task %d calling Actor<%p>", taskID, mailbox);
-            mailbox->performNextMessage();
-            mailbox = nullptr;
+        unsigned queueIndex = 0;
+        if (taskID > 0) {
+            char name[100];
+            sprintf(name, "CBL Scheduler#%u", taskID);
+            SetThreadName(name);
+            queueIndex = taskID - 1;
+            sCurrentScheduler = this;
+            sCurrentQueue = queueIndex;
+        }
+        for (;;) {
+            if (ThreadedMailbox *mailbox = pop(queueIndex); mailbox) {
+                LogVerbose(ActorLog, "   task %d calling Actor<%p>", taskID, mailbox);
+                mailbox->performNextMessage();
+            } else if (taskID == 0 || !waitForWork()) {
+                break;
+            }
         }
         LogTo(ActorLog, "   task %d finished", taskID);
     }
 
 
+    // Pops the next mailbox from the given queue, or if it's empty, steals one from another.
+    ThreadedMailbox* Scheduler::pop(unsigned queueIndex) {
+        if (_pending.load() == 0)
+            return nullptr;
+        size_t n = _queues.size();
+        for (size_t i = 0; i < n; ++i) {
+            WorkQueue &queue = *_queues[(queueIndex + i) % n];
+            lock_guard<mutex> lock(queue.mutex);
+            if (!queue.mailboxes.empty()) {
+                ThreadedMailbox *mailbox = queue.mailboxes.front();
+                queue.mailboxes.pop_front();
+                --_pending;
+                return mailbox;
+            }
+        }
+        return nullptr;
+    }
+
+
+    // Blocks until there may be work to do. Returns false if the Scheduler is stopping and
+    // there's no more work.
+    bool Scheduler::waitForWork() {
+        unique_lock<mutex> lock(_idleMutex);
+        ++_idleThreads;
+        _idleCond.wait(lock, [&]{return _pending.load() > 0 || _stopping;});
+        --_idleThreads;
+        return _pending.load() > 0 || !_stopping;
+    }
+
+
+    void Scheduler::push(ThreadedMailbox *mbox) {
+        if (_stopping)
+            return;
+        unsigned queueIndex;
+        if (sCurrentScheduler == this)
+            queueIndex = sCurrentQueue;
+        else
+            queueIndex = _nextQueue++ % unsigned(_queues.size());
+        {
+            WorkQueue &queue = *_queues[queueIndex];
+            lock_guard<mutex> lock(queue.mutex);
+            queue.mailboxes.push_back(mbox);
+            ++_pending;
+        }
+        // Wake a sleeping thread, if any. (Checking _idleThreads after incrementing _pending,
+        // which a thread does in the opposite order before sleeping, ensures no wakeup is lost.)
+        if (_idleThreads.load() > 0) {
+            lock_guard<mutex> lock(_idleMutex);
+            _idleCond.notify_one();
+        }
+    }
+
+
     void Scheduler::schedule(ThreadedMailbox *mbox) {
-        sScheduler->_queue.push(mbox);
+        sScheduler->push(mbox);
     }
 
 
-    // Explicitly instantiate the Channel specializations we need; this corresponds to the
-    // "extern template..." declarations at the bottom of Actor.hh
-    template class Channel<ThreadedMailbox*>;
-    template class Channel<std::function<void()>>;
+    // Explicitly instantiate the Channel specialization we need; this corresponds to the
+    // "extern template..." declaration at the bottom of ThreadedMailbox.hh
+    template class Channel<MailboxMessage>;
 
 
 #pragma mark - MAILBOX:
@@ -139,85 +209,55 @@ namespace litecore { namespace actor {
     ThreadedMailbox::ThreadedMailbox(Actor *a, const std::string &name, ThreadedMailbox *parent)
     :_actor(a)
     ,_name(name)
+    ,_stats(name)
     {
         Scheduler::sharedScheduler()->start();
     }
 
-    void ThreadedMailbox::enqueue(const char* name, const std::function<void()> &f) {
-        beginLatency();
+    void ThreadedMailbox::enqueue(const char* name, Closure f) {
         retain(_actor);
 
 #if ACTORS_USE_MANIFESTS
         auto threadManifest = sThreadManifest ? sThreadManifest : make_shared<ChannelManifest>();
         threadManifest->addEnqueueCall(_actor, name);
         _localManifest.addEnqueueCall(_actor, name);
-        const auto wrappedBlock = [f, threadManifest, name, SELF]
+        f = [f = move(f), threadManifest, name, this]
         {
             threadManifest->addExecution(_actor, name);
             sThreadManifest = threadManifest;
             _localManifest.addExecution(_actor, name);
-#else
-        const auto wrappedBlock = [f, SELF]
-        {
-#endif
-            endLatency();
-            beginBusy();
-            safelyCall(f);
-            afterEvent();
-
-#if ACTORS_USE_MANIFESTS
+            f();
             sThreadManifest.reset();
-#endif
         };
+#endif
 
-        if (push(wrappedBlock))
+        if (push({move(f), _stats.enqueued()}))
             reschedule();
     }
 
-    void ThreadedMailbox::enqueueAfter(delay_t delay, const char* name, const std::function<void()> &f) {
+    void ThreadedMailbox::enqueueAfter(delay_t delay, const char* name, Closure f) {
         if (delay <= delay_t::zero())
-            return enqueue(name, f);
+            return enqueue(name, move(f));
 
-        beginLatency();
         _delayedEventCount++;
-        retain(_actor);
 
-#if ACTORS_USE_MANIFESTS
-        auto threadManifest = sThreadManifest ? sThreadManifest : make_shared<ChannelManifest>();
-        threadManifest->addEnqueueCall(_actor, name, delay.count());
-        _localManifest.addEnqueueCall(_actor, name, delay.count());
-        auto timer = new Timer([f, threadManifest, name, this]
-        {
-            const auto wrappedBlock = [f, threadManifest, name, SELF]
-            {
-                threadManifest->addExecution(_actor, name);
-                sThreadManifest = threadManifest;
-                _localManifest.addExecution(_actor, name);
-#else
-        auto timer = new Timer([f, this]
+        // Timer needs a copyable function, so hold the Closure in a shared_ptr:
+        auto fp = make_shared<Closure>(move(f));
+        auto timer = new Timer([fp, name, this]
         {
-             const auto wrappedBlock = [f, SELF]
-             {
-#endif
-                endLatency();
-                beginBusy();
-                safelyCall(f);
+            enqueue(name, [fp, this] {
+                safelyCall(*fp);
                 --_delayedEventCount;
-                afterEvent();
-#if ACTORS_USE_MANIFESTS
-                sThreadManifest.reset();
-#endif
-            };
-            
-            if (push(wrappedBlock))
-                reschedule();
+            });
+            release(_actor);    // balances the retain below; enqueue() retained it again
         });
+        retain(_actor);
 
         timer->autoDelete();
         timer->fireAfter(chrono::duration_cast<Timer::duration>(delay));
     }
 
-    void ThreadedMailbox::safelyCall(const std::function<void()>& f) const
+    void ThreadedMailbox::safelyCall(const Closure &f) const
     {
         try {
             f();
@@ -238,14 +278,6 @@ namespace litecore { namespace actor {
     void ThreadedMailbox::afterEvent()
     {
         _actor->afterEvent();
-        endBusy();
-
-#if ACTORS_TRACK_STATS
-        ++_callCount;
-        if(eventCount() > _maxEventCount) {
-            _maxEventCount = eventCount();
-        }
-#endif
     }
 
 
@@ -258,8 +290,11 @@ namespace litecore { namespace actor {
         LogVerbose(ActorLog, "%s performNextMessage", _actor->actorName().c_str());
         DebugAssert(++_active == 1);     // Fail-safe check to detect 'impossible' re-entrant call
         sCurrentActor = _actor;
-        auto &fn = front();
-        fn();
+        const MailboxMessage &message = front();
+        auto startedAt = _stats.started(message.enqueuedAt);
+        safelyCall(message.fn);
+        afterEvent();
+        _stats.finished(startedAt);
         sCurrentActor = nullptr;
         
         DebugAssert(--_active == 0);
@@ -271,18 +306,6 @@ namespace litecore { namespace actor {
             reschedule();
     }
 
-    void ThreadedMailbox::logStats() const
-    {
-#if ACTORS_TRACK_STATS
-        LogTo(ActorLog, "%s handled %d events; max queue depth was %d; max latency was %s; busy %s (%.1f%%)",
-            _actor->actorName().c_str(), _callCount, _maxEventCount,
-            fleece::Stopwatch::formatTime(_maxLatency).c_str(),
-            fleece::Stopwatch::formatTime(_busy.elapsed()).c_str(),
-            (_busy.elapsed() / _createdAt.elapsed()) * 100.0);
-#endif
-    }
-
-
     void ThreadedMailbox::runAsyncTask(void (*task)(void*), void *context) {
         static RunAsyncActor* sRunAsyncActor = retain(new RunAsyncActor()); // I grant unto thee the gift of eternal life
         sRunAsyncActor->runAsync(task, context);
@@ -17,16 +17,20 @@
 //
 
 #pragma once
+#include "ActorStats.hh"
 #include "Channel.hh"
 #include "ChannelManifest.hh"
+#include "Closure.hh"
 #include "RefCounted.hh"
 #include "Stopwatch.hh"
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
-#include <functional>
 #include <vector>
 
 namespace litecore { namespace actor {
@@ -43,8 +47,15 @@ namespace litecore { namespace actor {
 
 
     #ifndef ACTORS_USE_GCD
+    /** An item in a ThreadedMailbox's queue: a message, and the time it was enqueued. */
+    struct MailboxMessage {
+        Closure                         fn;
+        MailboxStats::clock::time_point enqueuedAt;
+    };
+
+
     /** Default Actor mailbox implementation that uses a thread pool run by a Scheduler. */
-    class ThreadedMailbox : Channel<std::function<void()>> {
+    class ThreadedMailbox : Channel<MailboxMessage> {
     public:
         ThreadedMailbox(Actor*, const std::string &name ="", ThreadedMailbox *parentMailbox =nullptr);
 
@@ -52,14 +63,16 @@ namespace litecore { namespace actor {
 
         unsigned eventCount() const                         {return (unsigned)size() + (unsigned)_delayedEventCount;}
 
-        void enqueue(const char* name, const std::function<void()>&);
-        void enqueueAfter(delay_t delay, const char* name, const std::function<void()>&);
+        void enqueue(const char* name, Closure);
+        void enqueueAfter(delay_t delay, const char* name, Closure);
 
         static Actor* currentActor()                        {return sCurrentActor;}
 
         static void runAsyncTask(void (*task)(void*), void *context);
 
-        void logStats() const;
+        ActorStats stats() const                            {return _stats.snapshot();}
+
+        void logStats() const                               {_stats.log();}
 
     private:
         friend class Scheduler;
@@ -67,23 +80,16 @@ namespace litecore { namespace actor {
         void reschedule();
         void performNextMessage();
         void afterEvent();
-        void safelyCall(const std::function<void()> &f) const;
+        void safelyCall(const Closure &f) const;
 
         Actor* const _actor;
         std::string const _name;
 
         int _delayedEventCount {0};
+        MailboxStats _stats;
 #if DEBUG
         std::atomic_int _active {0};
 #endif
-
-#if ACTORS_TRACK_STATS
-        int32_t _callCount {0};
-        int32_t _maxEventCount {0};
-        double _maxLatency {0};
-        fleece::Stopwatch _createdAt {true};
-        fleece::Stopwatch _busy {false};
-#endif
         
         static thread_local Actor* sCurrentActor;
 
@@ -94,7 +100,15 @@ namespace litecore { namespace actor {
     };
 
     /** The Scheduler is reponsible for calling ThreadedMailboxes to run their Actor methods.
-        It managers a thread pool on which Mailboxes and Actors will run. */
+        It managers a thread pool on which Mailboxes and Actors will run.
+
+        Each thread has its own queue of Mailboxes that are ready to run. A Mailbox scheduled
+        by a Scheduler thread (typically an Actor enqueuing a message to another Actor, or
+        rescheduling itself) goes on that thread's queue; one scheduled by any other thread is
+        assigned to a queue round-robin. A thread whose queue is empty steals work from the
+        others before going to sleep. So there's no single lock that every thread contends for.
+        A Mailbox is never in more than one queue at once, so its messages still run one at a
+        time, in order. */
     class Scheduler {
     public:
         Scheduler(unsigned numThreads =0)
@@ -121,19 +135,34 @@ namespace litecore { namespace actor {
         static void schedule(ThreadedMailbox* mbox);
 
     private:
+        // A per-thread queue of mailboxes ready to run.
+        struct WorkQueue {
+            std::mutex                   mutex;
+            std::deque<ThreadedMailbox*> mailboxes;
+        };
+
         void task(unsigned taskID);
+        void push(ThreadedMailbox*);
+        ThreadedMailbox* pop(unsigned queueIndex);
+        bool waitForWork();
 
         unsigned _numThreads;
-        Channel<ThreadedMailbox*> _queue;
+        std::vector<std::unique_ptr<WorkQueue>> _queues;    // One per thread
+        std::atomic<unsigned> _nextQueue {0};       // Round-robin index for outside pushes
+        std::atomic<size_t> _pending {0};           // Total # of mailboxes in all queues
+        std::atomic<unsigned> _idleThreads {0};     // # of threads waiting on _idleCond
+        std::mutex _idleMutex;
+        std::condition_variable _idleCond;
+        std::atomic<bool> _stopping {false};
         std::vector<std::thread> _threadPool;
         std::atomic_flag _started = ATOMIC_FLAG_INIT;
 
-
+        static thread_local Scheduler* sCurrentScheduler;   // Scheduler owning current thread
+        static thread_local unsigned sCurrentQueue;         // Current thread's queue index
     };
 
     // This prevents the compiler from specializing Channel in every compilation unit:
-    extern template class Channel<ThreadedMailbox*>;
-    extern template class Channel<std::function<void()>>;
+    extern template class Channel<MailboxMessage>;
 #endif
 
 } }
@@ -17,7 +17,9 @@
 //
 
 #include "DataFile.hh"
+#include "ReadConnectionPool.hh"
 #include "RecordEnumerator.hh"
+#include "PartitionedEnumerator.hh"
 #include "Error.hh"
 #include "FilePath.hh"
 #include "FleeceImpl.hh"
@@ -30,6 +32,10 @@
 #include "LiteCoreTest.hh"
 #include <sstream>
 #include <cinttypes>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
 
 using namespace litecore;
 using namespace fleece::impl;
@@ -159,6 +165,85 @@ N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile SaveDocs", "[DataFile]")
     REQUIRE(aliased_db->defaultKeyStore().get("rec"_sl).sequence() == 3);
 }
 
+N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile SetMany", "[DataFile]") {
+    {
+        Transaction t(db);
+        store->set("a"_sl, "A"_sl, t);
+        t.commit();
+    }
+
+    // Enough records to need more than one multi-row statement:
+    constexpr size_t kCount = 250;
+    vector<string> keys;
+    for (size_t i = 0; i < kCount; ++i)
+        keys.push_back(stringWithFormat("rec-%03zu", i));
+
+    vector<sequence_t> seqs;
+    {
+        Transaction t(db);
+        vector<RecordLite> recs;
+        for (size_t i = 0; i < kCount; ++i) {
+            RecordLite rec;
+            rec.key = slice(keys[i]);
+            rec.version = "vers"_sl;
+            rec.body = slice(keys[i]);
+            recs.push_back(rec);
+        }
+        // A conditional write in the middle, which will fail (wrong sequence):
+        RecordLite cond;
+        cond.key = "a"_sl;
+        cond.body = "nope"_sl;
+        cond.sequence = 99;
+        recs.insert(recs.begin() + 100, cond);
+
+        seqs = store->setMany(recs, t);
+        t.commit();
+    }
+
+    REQUIRE(seqs.size() == kCount + 1);
+    CHECK(seqs[100] == 0);
+    sequence_t expectedSeq = 2;
+    for (size_t i = 0; i < kCount; ++i) {
+        size_t j = (i < 100) ? i : i + 1;
+        CHECK(seqs[j] == expectedSeq++);
+        Record rec = store->get(slice(keys[i]));
+        REQUIRE(rec.exists());
+        CHECK(rec.body() == slice(keys[i]));
+        CHECK(rec.version() == "vers"_sl);
+        CHECK(rec.sequence() == seqs[j]);
+    }
+    CHECK(store->lastSequence() == kCount + 1);
+    CHECK(store->get("a"_sl).body() == "A"_sl);
+}
+
+
+N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile InsertBatch", "[DataFile][!throws]") {
+    {
+        Transaction t(db);
+        KeyStore::InsertBatch batch(*store, t);
+        CHECK(store->set("x"_sl, "vers"_sl, "X"_sl, DocumentFlags::kNone, t, 0) == 1);
+        CHECK(store->set("y"_sl, "vers"_sl, "Y"_sl, DocumentFlags::kNone, t, 0) == 2);
+        // Not written yet:
+        CHECK(!store->get("x"_sl).exists());
+        batch.flush();
+        CHECK(store->get("x"_sl).sequence() == 1);
+        CHECK(store->get("y"_sl).body() == "Y"_sl);
+        t.commit();
+    }
+    CHECK(store->lastSequence() == 2);
+
+    {
+        // Inserting an existing record in a batch is an error:
+        Transaction t(db);
+        KeyStore::InsertBatch batch(*store, t);
+        store->set("x"_sl, "vers"_sl, "X2"_sl, DocumentFlags::kNone, t, 0);
+        CHECK_THROWS(batch.flush());
+        t.abort();
+    }
+    CHECK(store->get("x"_sl).body() == "X"_sl);
+}
+
+
 static void createNumberedDocs(KeyStore *store, int n =100, bool withAssertions =true) {
     Transaction t(store->dataFile());
     for (int i = 1; i <= n; i++) {
@@ -173,6 +258,54 @@ static void createNumberedDocs(KeyStore *store, int n =100, bool withAssertions
 }
 
 
+N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile GetMany", "[DataFile]") {
+    createNumberedDocs(store, 500);
+
+    vector<string> keyStrs;
+    for (int i = 500; i >= 1; i -= 2)
+        keyStrs.push_back(stringWithFormat("rec-%03d", i));
+    keyStrs.push_back("rec-777");       // missing
+    keyStrs.push_back("rec-101");       // duplicate
+    vector<slice> keys(keyStrs.begin(), keyStrs.end());
+
+    for (ContentOption content : {kMetaOnly, kCurrentRevOnly, kEntireBody}) {
+        vector<Record> recs = store->getMany(keys, content);
+        REQUIRE(recs.size() == keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            INFO("key " << keyStrs[i]);
+            CHECK(recs[i].key() == keys[i]);
+            if (keys[i] == "rec-777"_sl) {
+                CHECK(!recs[i].exists());
+                continue;
+            }
+            REQUIRE(recs[i].exists());
+            Record expected = store->get(keys[i], content);
+            CHECK(recs[i].sequence() == expected.sequence());
+            CHECK(recs[i].bodySize() == expected.bodySize());
+            if (content != kMetaOnly)
+                CHECK(recs[i].body() == keys[i]);
+        }
+    }
+    CHECK(store->getMany({}, kEntireBody).empty());
+}
+
+
+N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile WithDocBodies Reentrant", "[DataFile]") {
+    createNumberedDocs(store, 10);
+    vector<slice> keys = {"rec-001"_sl, "rec-005"_sl, "rec-777"_sl};
+    // The callback reads from the same KeyStore, which must not deadlock:
+    auto results = store->withDocBodies(keys, [&](const RecordLite &rec) {
+        Record again = store->get(rec.key);
+        CHECK(again.sequence() == *rec.sequence);
+        return alloc_slice(again.body());
+    });
+    REQUIRE(results.size() == 3);
+    CHECK(results[0] == "rec-001"_sl);
+    CHECK(results[1] == "rec-005"_sl);
+    CHECK(!results[2]);
+}
+
+
 N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile EnumerateDocs", "[DataFile]") {
     {
         INFO("Enumerate empty db");
@@ -226,6 +359,118 @@ N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile EnumerateDocsDescending",
 }
 
 
+N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile EnumerateDocs Key Range", "[DataFile]") {
+    createNumberedDocs(store);
+
+    auto keys = [&](const RecordEnumerator::Options &opts) {
+        vector<string> result;
+        for (RecordEnumerator e(*store, opts); e.next(); )
+            result.push_back(string(e->key()));
+        return result;
+    };
+
+    RecordEnumerator::Options opts;
+    opts.minKey = "rec-010"_sl;
+    opts.maxKey = "rec-020"_sl;
+    auto result = keys(opts);
+    REQUIRE(result.size() == 11);
+    CHECK(result.front() == "rec-010");
+    CHECK(result.back() == "rec-020");
+
+    opts.minKeyInclusive = opts.maxKeyInclusive = false;
+    result = keys(opts);
+    REQUIRE(result.size() == 9);
+    CHECK(result.front() == "rec-011");
+    CHECK(result.back() == "rec-019");
+
+    opts = {};
+    opts.keyPrefix = "rec-05"_sl;
+    result = keys(opts);
+    REQUIRE(result.size() == 10);
+    CHECK(result.front() == "rec-050");
+    CHECK(result.back() == "rec-059");
+
+    opts.minKey = "rec-055"_sl;
+    CHECK(keys(opts) == (vector<string>{"rec-055", "rec-056", "rec-057", "rec-058", "rec-059"}));
+
+    opts.minKey = nullslice;
+    opts.sortOption = kDescending;
+    opts.limit = 3;
+    CHECK(keys(opts) == (vector<string>{"rec-059", "rec-058", "rec-057"}));
+
+    opts = {};
+    opts.keyPrefix = "rec-1"_sl;
+    opts.maxKey = "rec-099"_sl;
+    CHECK(keys(opts).empty());
+
+    // Sequence enumeration is limited by key range too:
+    opts = {};
+    opts.maxKey = "rec-003"_sl;
+    vector<string> bySeq;
+    for (RecordEnumerator e(*store, 1, opts); e.next(); )
+        bySeq.push_back(string(e->key()));
+    CHECK(bySeq == (vector<string>{"rec-002", "rec-003"}));
+}
+
+
+N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile Partitioned Enumeration", "[DataFile]") {
+    createNumberedDocs(store, 500);
+
+    PartitionedEnumerator pe(*store, 4);
+    unsigned nPartitions = pe.partitionCount();
+    CHECK(nPartitions >= 2);
+    CHECK(nPartitions <= 4);
+    for (size_t i = 1; i < pe.boundaries().size(); ++i)
+        CHECK(pe.boundaries()[i-1].compare(pe.boundaries()[i]) < 0);
+
+    mutex m;
+    map<string, unsigned> seen;
+    CHECK(pe.run([&](const Record &rec, unsigned partition) {
+        lock_guard<mutex> lock(m);
+        seen[string(rec.key())]++;
+        CHECK(partition < nPartitions);
+        if (partition > 0)
+            CHECK(rec.key().compare(pe.boundaries()[partition-1]) >= 0);
+        if (partition + 1 < nPartitions)
+            CHECK(rec.key().compare(pe.boundaries()[partition]) < 0);
+        return true;
+    }));
+    REQUIRE(seen.size() == 500);
+    for (auto &entry : seen)
+        CHECK(entry.second == 1);
+
+    // Options further restrict the key range:
+    RecordEnumerator::Options opts;
+    opts.minKey = "rec-100"_sl;
+    opts.maxKey = "rec-199"_sl;
+    PartitionedEnumerator ranged(*store, 8, opts);
+    atomic<unsigned> count {0}, outOfRange {0};
+    CHECK(ranged.run([&](const Record &rec, unsigned) {
+        if (rec.key().compare("rec-100"_sl) < 0 || rec.key().compare("rec-199"_sl) > 0)
+            ++outOfRange;
+        ++count;
+        return true;
+    }));
+    CHECK(count == 100);
+    CHECK(outOfRange == 0);
+
+    // Stopping early:
+    count = 0;
+    CHECK(!pe.run([&](const Record&, unsigned) {
+        return ++count < 10;
+    }));
+    CHECK(count < 500);
+
+    // Fewer records than partitions:
+    KeyStore &empty = db->getKeyStore("empty");
+    PartitionedEnumerator none(empty, 4);
+    CHECK(none.partitionCount() == 1);
+    count = 0;
+    CHECK(none.run([&](const Record&, unsigned) {++count; return true;}));
+    CHECK(count == 0);
+}
+
+
 N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile AbortTransaction", "[DataFile]") {
     // Initial record:
     {
@@ -275,6 +520,65 @@ N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile TransactionsThenIterate",
 }
 
 
+N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile ReadConnectionPool", "[DataFile]") {
+    createNumberedDocs(store);
+    Retained<ReadConnectionPool> pool = &db->readConnectionPool();
+    REQUIRE(pool->capacity() >= 1);
+
+    {
+        INFO("A snapshot doesn't see a concurrent commit");
+        auto conn = pool->borrow();
+        ReadOnlyTransaction rt(*conn);
+        KeyStore &ks = conn->defaultKeyStore();
+        CHECK(ks.recordCount() == 100);
+        {
+            Transaction t(db);
+            store->set("extra"_sl, "body"_sl, t);
+            t.commit();
+        }
+        CHECK(ks.recordCount() == 100);
+        CHECK(!ks.get("extra"_sl).exists());
+    }
+    pool->withSnapshot([&](DataFile &df) {
+        INFO("A new snapshot does see the commit");
+        CHECK(df.defaultKeyStore().recordCount() == 101);
+        CHECK(df.defaultKeyStore().get("extra"_sl).exists());
+    });
+
+    // Read on several threads at once:
+    constexpr unsigned kNThreads = 4, kNReads = 50;
+    atomic<unsigned> found {0};
+    vector<thread> threads;
+    for (unsigned t = 0; t < kNThreads; ++t) {
+        threads.emplace_back([&] {
+            for (unsigned i = 1; i <= kNReads; ++i) {
+                pool->withSnapshot([&](DataFile &df) {
+                    string docID = stringWithFormat("rec-%03u", i);
+                    if (df.defaultKeyStore().get(slice(docID)).exists())
+                        ++found;
+                });
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    CHECK(found == kNThreads * kNReads);
+
+    auto stats = pool->stats();
+    CHECK(stats.checkouts == 2 + kNThreads * kNReads);
+    CHECK(stats.opens >= 1);
+    CHECK(stats.opens <= pool->capacity());
+    CHECK(stats.hits + stats.opens + stats.waits == stats.checkouts);
+    CHECK(stats.maxCheckoutTime <= stats.totalCheckoutTime);
+
+    // Closing the DataFile closes the pool:
+    reopenDatabase();
+    ExpectException(error::LiteCore, error::NotOpen, [&]{
+        pool->borrow();
+    });
+}
+
+
 N_WAY_TEST_CASE_METHOD (DataFileTestFixture, "DataFile DeleteKey", "[DataFile]") {
     slice key("a");
     {
@@ -721,3 +1025,198 @@ N_WAY_TEST_CASE_METHOD(DataFileTestFixture, "Index table creation", "[Upgrade]")
     // Before the fix, this would throw
     reopenDatabase();
 }
+
+
+N_WAY_TEST_CASE_METHOD(DataFileTestFixture, "DataFile Storage Profiles Benchmark", "[DataFile][Perf][.slow]") {
+    static constexpr unsigned kNumDocs = 100000, kNumOpens = 20, kNumReads = 10000;
+    static const char* const kProfileNames[] = {"balanced", "embedded", "server"};
+
+    for (int p = DataFile::Tuning::kBalanced; p <= DataFile::Tuning::kServer; ++p) {
+        DataFile::Options options = db->options();
+        options.tuning = {};
+        options.tuning.profile = DataFile::Tuning::Profile(p);
+        FilePath path = databasePath(string("profile_") + kProfileNames[p]);
+        deleteDatabase(path);
+
+        {
+            unique_ptr<DataFile> pdb(newDatabase(path, &options));
+            KeyStore &ks = pdb->defaultKeyStore();
+            string body(200, 'x');
+            Transaction t(*pdb);
+            for (unsigned i = 1; i <= kNumDocs; ++i) {
+                string docID = stringWithFormat("rec-%07u", i);
+                ks.set(slice(docID), slice(body), t);
+            }
+            t.commit();
+        }
+
+        // First opens, each of a fresh copy of the file, so no open of that file has warmed up
+        // SQLite's state for it. (The OS may still have the file's pages cached; this process
+        // can't portably drop that cache.)
+        string label = string("Profile '") + kProfileNames[p] + "': ";
+        vector<FilePath> copies;
+        for (unsigned i = 0; i < kNumOpens; ++i) {
+            copies.push_back(databasePath(stringWithFormat("profile_%s_copy%u",
+                                                           kProfileNames[p], i)));
+            deleteDatabase(copies.back());
+            path.copyTo(copies.back());
+        }
+        fleece::Stopwatch firstOpen;
+        for (auto &copy : copies) {
+            unique_ptr<DataFile> pdb(newDatabase(copy, &options));
+            (void)pdb->defaultKeyStore().get("rec-0000001"_sl);
+        }
+        firstOpen.stop();
+        firstOpen.printReport((label + "First open of a copy").c_str(), kNumOpens, "open");
+        for (auto &copy : copies)
+            deleteDatabase(copy);
+
+        // Reopening the same file:
+        fleece::Stopwatch st;
+        for (unsigned i = 0; i < kNumOpens; ++i) {
+            unique_ptr<DataFile> pdb(newDatabase(path, &options));
+            (void)pdb->defaultKeyStore().get("rec-0000001"_sl);
+        }
+        st.stop();
+        st.printReport((label + "Reopening").c_str(), kNumOpens, "open");
+
+        unique_ptr<DataFile> pdb(newDatabase(path, &options));
+        KeyStore &ks = pdb->defaultKeyStore();
+        fleece::Stopwatch st2;
+        for (unsigned i = 0; i < kNumReads; ++i) {
+            string docID = stringWithFormat("rec-%07u", RandomNumber(kNumDocs) + 1);
+            Record rec = ks.get(slice(docID));
+            REQUIRE(rec.exists());
+        }
+        st2.stop();
+        st2.printReport((label + "Random get").c_str(), kNumReads, "doc");
+
+        static constexpr unsigned kNumScans = 5;
+        fleece::Stopwatch st3;
+        for (unsigned pass = 0; pass < kNumScans; ++pass) {
+            unsigned n = 0;
+            for (RecordEnumerator e(ks); e.next(); )
+                ++n;
+            REQUIRE(n == kNumDocs);
+        }
+        st3.stop();
+        st3.printReport((label + "Full scan").c_str(), kNumScans * kNumDocs, "doc");
+
+        pdb.reset();
+        deleteDatabase(path);
+    }
+}
+
+
+N_WAY_TEST_CASE_METHOD(DataFileTestFixture, "DataFile GetMany Benchmark", "[DataFile][Perf][.slow]") {
+    static constexpr unsigned kNumDocs = 100000;
+    {
+        string body(200, 'x');
+        Transaction t(db);
+        for (unsigned i = 1; i <= kNumDocs; ++i) {
+            string docID = stringWithFormat("rec-%07u", i);
+            store->set(slice(docID), slice(body), t);
+        }
+        t.commit();
+    }
+
+    for (unsigned numKeys : {10, 100, 1000, 10000}) {
+        unsigned reps = max(10000 / numKeys, 5u);
+        vector<vector<string>> keyStrs(reps);
+        vector<vector<slice>> keys(reps);
+        for (unsigned rep = 0; rep < reps; ++rep) {
+            for (unsigned i = 0; i < numKeys; ++i)
+                keyStrs[rep].push_back(stringWithFormat("rec-%07u", RandomNumber(kNumDocs) + 1));
+            keys[rep].assign(keyStrs[rep].begin(), keyStrs[rep].end());
+        }
+
+        string label = stringWithFormat("%u keys, ", numKeys);
+        fleece::Stopwatch st;
+        for (unsigned rep = 0; rep < reps; ++rep) {
+            for (slice key : keys[rep]) {
+                Record rec = store->get(key);
+                REQUIRE(rec.exists());
+            }
+        }
+        st.stop();
+        st.printReport((label + "looped get").c_str(), reps * numKeys, "key");
+
+        fleece::Stopwatch st2;
+        for (unsigned rep = 0; rep < reps; ++rep) {
+            vector<Record> recs = store->getMany(keys[rep]);
+            REQUIRE(recs.size() == numKeys);
+        }
+        st2.stop();
+        st2.printReport((label + "getMany").c_str(), reps * numKeys, "key");
+    }
+}
+
+
+N_WAY_TEST_CASE_METHOD(DataFileTestFixture, "DataFile Key Range Paging Benchmark", "[DataFile][Perf][.slow]") {
+    static constexpr unsigned kNumDocs = 1000000, kPageSize = 100;
+    createRecords(kNumDocs);
+
+    RecordEnumerator::Options opts;
+    opts.contentOption = kMetaOnly;
+    for (unsigned startRow : {0u, 1000u, 10000u, 100000u, 500000u, 900000u}) {
+        // The old way: enumerate from the start, skipping rows before the page:
+        fleece::Stopwatch skipTime;
+        unsigned row = 0, n = 0;
+        for (RecordEnumerator e(*store, opts); e.next() && n < kPageSize; ++row) {
+            if (row >= startRow)
+                ++n;
+        }
+        skipTime.stop();
+        CHECK(n == kPageSize);
+
+        // Seek to the page's first key, with a limit:
+        fleece::Stopwatch seekTime;
+        string startKey = stringWithFormat("rec-%07u", startRow);
+        RecordEnumerator::Options rangeOpts = opts;
+        rangeOpts.minKey = slice(startKey);
+        rangeOpts.limit = kPageSize;
+        n = 0;
+        for (RecordEnumerator e(*store, rangeOpts); e.next(); )
+            ++n;
+        seekTime.stop();
+        CHECK(n == kPageSize);
+
+        char label[100];
+        sprintf(label, "Paging to row %u by skipping", startRow);
+        skipTime.printReport(label, 1, "page");
+        sprintf(label, "Paging to row %u by seeking", startRow);
+        seekTime.printReport(label, 1, "page");
+        Log("Seeking is %.0fx as fast as skipping", skipTime.elapsed() / seekTime.elapsed());
+    }
+}
+
+
+N_WAY_TEST_CASE_METHOD(DataFileTestFixture, "DataFile Partitioned Enumeration Benchmark", "[DataFile][Perf][.slow]") {
+    static constexpr unsigned kNumDocs = 1000000;
+    createRecords(kNumDocs);
+
+    // PartitionedEnumerator::run reads on connections borrowed from the DataFile's
+    // ReadConnectionPool, using no more threads than the pool's capacity:
+    unsigned poolCapacity = db->readConnectionPool().capacity();
+    double baseTime = 0;
+    for (unsigned nThreads : {1u, 2u, 4u, 8u, 16u}) {
+        PartitionedEnumerator pe(*store, nThreads);
+        atomic<uint64_t> count {0}, bytes {0};
+        fleece::Stopwatch st;
+        pe.run([&](const Record &rec, unsigned) {
+            ++count;
+            bytes += rec.body().size;       // touch the body, as an export would
+            return true;
+        });
+        st.stop();
+        CHECK(count == kNumDocs);
+        if (nThreads == 1)
+            baseTime = st.elapsed();
+
+        char label[100];
+        sprintf(label, "Enumerating in %u partitions on %u threads",
+                pe.partitionCount(), min(pe.partitionCount(), poolCapacity));
+        st.printReport(label, kNumDocs, "record");
+        Log("%u partitions are %.2fx as fast as 1", pe.partitionCount(), baseTime / st.elapsed());
+    }
+}
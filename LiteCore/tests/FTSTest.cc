@@ -21,6 +21,7 @@
 #include "Error.hh"
 #include "StringUtil.hh"
 #include "FleeceImpl.hh"
+#include "Stopwatch.hh"
 
 #include "LiteCoreTest.hh"
 
@@ -522,3 +523,105 @@ TEST_CASE_METHOD(FTSTest, "Missing FTS columns", "[FTS][Query]") {
         expectedMissing = 0;
     }
 }
+
+
+TEST_CASE_METHOD(FTSTest, "Query Full-Text Deferred Index", "[Query][FTS]") {
+    createIndex({"english", true, false, nullptr, true});
+    const char* queryStr = "['SELECT', {'WHERE': ['MATCH()', 'sentence', 'search'],\
+                                        ORDER_BY: [['DESC', ['rank()', 'sentence']]],\
+                                        WHAT: [['.sentence']]}]";
+    // The existing docs haven't been indexed yet:
+    CHECK(store->indexedSequence() == 0);
+    testQuery(queryStr, {}, {});
+
+    {
+        Transaction t(store->dataFile());
+        CHECK(store->updateDeferredIndexes(100) == 5);
+        CHECK(store->updateDeferredIndexes(100) == 0);
+        t.commit();
+    }
+    CHECK(store->indexedSequence() == store->lastSequence());
+    testQuery(queryStr, {1, 2, 0, 4}, {3, 3, 1, 1});
+
+    // Update a doc; the index is stale until it's updated again:
+    const char* unicornQueryStr = "['SELECT', {'WHERE': ['MATCH()', 'sentence', 'unicorns'],\
+                                               WHAT: [['.sentence']]}]";
+    {
+        Transaction t(store->dataFile());
+        createDoc(t, 3, "Unicorns prefer rainbows.");
+        t.commit();
+    }
+    CHECK(store->indexedSequence() == store->lastSequence() - 1);
+    testQuery(unicornQueryStr, {}, {});
+    {
+        Transaction t(store->dataFile());
+        CHECK(store->updateDeferredIndexes(100) == 1);
+        t.commit();
+    }
+    CHECK(store->indexedSequence() == store->lastSequence());
+    testQuery(unicornQueryStr, {3}, {1});
+    testQuery(queryStr, {1, 2, 0, 4}, {3, 3, 1, 1});
+
+    // Recreating the index without deferUpdates switches it to immediate updates:
+    const char* dragonQueryStr = "['SELECT', {'WHERE': ['MATCH()', 'sentence', 'dragons'],\
+                                              WHAT: [['.sentence']]}]";
+    createIndex({"english", true, false, nullptr, false});
+    CHECK(!store->hasDeferredIndexes());
+    {
+        Transaction t(store->dataFile());
+        createDoc(t, 3, "Dragons prefer gold.");
+        t.commit();
+    }
+    CHECK(store->indexedSequence() == store->lastSequence());
+    testQuery(dragonQueryStr, {3}, {1});
+    testQuery(queryStr, {1, 2, 0, 4}, {3, 3, 1, 1});
+
+    // ...and recreating it with deferUpdates switches it back:
+    createIndex({"english", true, false, nullptr, true});
+    CHECK(store->hasDeferredIndexes());
+    CHECK(store->indexedSequence() == store->lastSequence());
+    testQuery(dragonQueryStr, {3}, {1});
+
+    // Deleting the index also deletes its pending table:
+    store->deleteIndex("sentence"_sl);
+    CHECK(store->indexedSequence() == store->lastSequence());
+}
+
+
+TEST_CASE_METHOD(FTSTest, "Full-Text Deferred Index Benchmark", "[FTS][Perf][.slow]") {
+    static constexpr int kNumDocs = 100000, kDocsPerTransaction = 100;
+    static constexpr unsigned kBatchSize = 10000;
+
+    for (bool deferred : {false, true}) {
+        createIndex({"english", true, false, nullptr, deferred});
+
+        // Write the docs in small transactions, like a typical app would:
+        int firstDoc = deferred ? 2 * kNumDocs : kNumDocs;
+        fleece::Stopwatch st;
+        for (int i = 0; i < kNumDocs; i += kDocsPerTransaction) {
+            Transaction t(store->dataFile());
+            for (int j = i; j < i + kDocsPerTransaction; ++j)
+                createDoc(t, firstDoc + j, kStrings[j % 5]);
+            t.commit();
+        }
+        st.stop();
+        st.printReport(deferred ? "Writing docs, deferred FTS index"
+                                : "Writing docs, immediate FTS index", kNumDocs, "doc");
+
+        // Then catch up the index in big batches, each in one transaction:
+        if (deferred) {
+            fleece::Stopwatch catchUp;
+            while (auto update = store->prepareDeferredIndexUpdate(kBatchSize)) {
+                Transaction t(store->dataFile());
+                store->applyDeferredIndexUpdate(*update);
+                t.commit();
+            }
+            catchUp.stop();
+            catchUp.printReport("Catching up deferred FTS index", kNumDocs, "doc");
+            CHECK(store->indexedSequence() == store->lastSequence());
+        }
+
+        store->deleteIndex("sentence"_sl);
+        _stringsInDB.resize(5);
+    }
+}
@@ -233,6 +233,17 @@ sequence_t DataFileTestFixture::writeDoc(slice docID,
 }
 
 
+void DataFileTestFixture::createRecords(unsigned count, size_t bodySize) {
+    string body(bodySize, 'x');
+    Transaction t(db);
+    for (unsigned i = 0; i < count; ++i) {
+        string docID = stringWithFormat("rec-%07u", i);
+        store->set(slice(docID), slice(body), t);
+    }
+    t.commit();
+}
+
+
 alloc_slice DataFileTestFixture::blobAccessor(const fleece::impl::Dict*) const {
     return {};
 }
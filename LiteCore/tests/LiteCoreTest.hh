@@ -96,6 +96,10 @@ public:
     sequence_t writeDoc(slice docID, DocumentFlags, Transaction&,
                         std::function<void(fleece::impl::Encoder&)>);
 
+    /** Adds `count` records with IDs "rec-0000000", "rec-0000001", ... and bodies of `bodySize`
+        bytes, in one transaction. */
+    void createRecords(unsigned count, size_t bodySize =100);
+
     virtual alloc_slice blobAccessor(const fleece::impl::Dict*) const override;
 };
 
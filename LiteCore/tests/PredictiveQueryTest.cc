@@ -300,4 +300,129 @@ TEST_CASE_METHOD(QueryTest, "Predictive Query cached only", "[Query][Predict]")
     PredictiveModel::unregister("8ball");
 }
 
+
+TEST_CASE_METHOD(QueryTest, "Predictive Query deferred index", "[Query][Predict]") {
+    addNumberedDocs(1, 100);
+
+    Retained<EightBall> model = new EightBall(db.get());
+    model->registerAs("8ball");
+
+    // Creating a deferred index shouldn't call the model:
+    model->allowCalls = false;
+    IndexSpec::Options options {nullptr, false, false, nullptr, true};
+    string prediction = "['PREDICTION()', '8ball', {number: ['.num']}, '.square']";
+    store->createIndex("nums"_sl, json5("["+prediction+"]"), IndexSpec::kPredictive, &options);
+    CHECK(store->indexedSequence() == 0);
+
+    Retained<Query> query{ store->compileQuery(json5(
+        "{'WHAT': [['.num']], 'WHERE': ['>=', "+prediction+", 1], 'ORDER_BY': [['.num']]}")) };
+    auto runQuery = [&] {
+        vector<int64_t> results;
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        while (e->next())
+            results.push_back( e->columns()[0]->asInt() );
+        return results;
+    };
+    // The index hasn't been updated yet, so the query sees nothing:
+    CHECK(runQuery().empty());
+
+    // The model is called while preparing the update, not inside the transaction:
+    model->allowCalls = true;
+    CHECK(store->hasDeferredIndexes());
+    auto update = store->prepareDeferredIndexUpdate(60);
+    REQUIRE(update);
+    CHECK(update->count() == 60);
+    model->allowCalls = false;
+    {
+        Transaction t(db);
+        CHECK(store->applyDeferredIndexUpdate(*update) == 60);
+        CHECK(store->indexedSequence() == 60);
+        model->allowCalls = true;
+        CHECK(store->updateDeferredIndexes(60) == 40);
+        CHECK(store->updateDeferredIndexes(60) == 0);
+        t.commit();
+    }
+    CHECK(store->indexedSequence() == 100);
+    CHECK(runQuery() == (vector<int64_t>({ 1, 4, 9, 16, 25, 36, 49, 64, 81, 100 })));
+
+    // Saving a document shouldn't call the model either:
+    model->allowCalls = false;
+    {
+        Transaction t(db);
+        writeNumberedDoc(121, nullslice, t);
+        t.commit();
+    }
+    CHECK(store->lastSequence() == 101);
+    CHECK(store->indexedSequence() == 100);
+    CHECK(runQuery() == (vector<int64_t>({ 1, 4, 9, 16, 25, 36, 49, 64, 81, 100 })));
+
+    model->allowCalls = true;
+    {
+        Transaction t(db);
+        CHECK(store->updateDeferredIndexes(60) == 1);
+        t.commit();
+    }
+    CHECK(store->indexedSequence() == 101);
+    CHECK(runQuery() == (vector<int64_t>({ 1, 4, 9, 16, 25, 36, 49, 64, 81, 100, 121 })));
+
+    // A document changed after its update was prepared stays pending:
+    update = store->prepareDeferredIndexUpdate(60);
+    CHECK(!update);
+    {
+        Transaction t(db);
+        writeNumberedDoc(122, nullslice, t);
+        t.commit();
+    }
+    update = store->prepareDeferredIndexUpdate(60);
+    REQUIRE(update);
+    {
+        Transaction t(db);
+        writeNumberedDoc(122, "changed"_sl, t);
+        CHECK(store->applyDeferredIndexUpdate(*update) == 0);
+        t.commit();
+    }
+    CHECK(store->indexedSequence() == 101);
+    {
+        Transaction t(db);
+        CHECK(store->updateDeferredIndexes(60) == 1);
+        t.commit();
+    }
+    CHECK(store->indexedSequence() == 103);
+    CHECK(runQuery() == (vector<int64_t>({ 1, 4, 9, 16, 25, 36, 49, 64, 81, 100, 121 })));
+
+    // Recreating the index without deferUpdates switches it to immediate updates:
+    IndexSpec::Options immediate {nullptr, false, false, nullptr, false};
+    {
+        Transaction t(db);
+        CHECK(store->createIndex("nums"_sl, json5("["+prediction+"]"), IndexSpec::kPredictive,
+                                 &immediate));
+        t.commit();
+    }
+    CHECK(!store->hasDeferredIndexes());
+    {
+        Transaction t(db);
+        writeNumberedDoc(144, nullslice, t);
+        t.commit();
+    }
+    CHECK(store->indexedSequence() == 104);
+    CHECK(runQuery() == (vector<int64_t>({ 1, 4, 9, 16, 25, 36, 49, 64, 81, 100, 121, 144 })));
+
+    // ...and recreating it with deferUpdates switches it back:
+    {
+        Transaction t(db);
+        CHECK(store->createIndex("nums"_sl, json5("["+prediction+"]"), IndexSpec::kPredictive,
+                                 &options));
+        t.commit();
+    }
+    CHECK(store->hasDeferredIndexes());
+    CHECK(store->indexedSequence() == 104);
+
+    // Deleting the index removes the pending table:
+    store->deleteIndex("nums"_sl);
+    CHECK(!store->hasDeferredIndexes());
+    CHECK(store->indexedSequence() == 104);
+
+    PredictiveModel::unregister("8ball");
+}
+
 #endif // COUCHBASE_ENTERPRISE
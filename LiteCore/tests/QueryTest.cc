@@ -18,6 +18,7 @@
 
 #include "QueryTest.hh"
 #include "SQLiteDataFile.hh"
+#include "ReadConnectionPool.hh"
 #include <ctime>
 #include <cfloat>
 #include <cinttypes>
@@ -131,6 +132,71 @@ TEST_CASE_METHOD(QueryTest, "Partial Index with NOT MISSING", "[Query]") {
 }
 
 
+TEST_CASE_METHOD(QueryTest, "Compiled Query Cache", "[Query]") {
+    addNumberedDocs(1, 10);
+    CompiledQueryCache &cache = ((SQLiteDataFile*)db.get())->queryCache();
+    auto queryStr = json5("{WHAT: [['.num']], WHERE: ['>', ['.num'], 5], ORDER_BY: [['.num']]}");
+    auto check = [&](Query *query) {
+        CHECK(query->columnTitles() == vector<string>{"num"});
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        CHECK(e->getRowCount() == 5);
+    };
+
+    auto before = cache.stats();
+    Retained<Query> query1 = store->compileQuery(queryStr);
+    CHECK(cache.stats().misses == before.misses + 1);
+    CHECK(cache.stats().hits == before.hits);
+
+    // A second identical query is a cache hit. It can't share the first one's statement while
+    // that's still alive, but they must both work:
+    Retained<Query> query2 = store->compileQuery(queryStr);
+    CHECK(cache.stats().hits == before.hits + 1);
+    check(query1);
+    check(query2);
+    query1 = nullptr;
+    query2 = nullptr;
+
+    // Now a new query can use the cached statement:
+    Retained<Query> query3 = store->compileQuery(queryStr);
+    CHECK(cache.stats().hits == before.hits + 2);
+    check(query3);
+
+    // Creating an index invalidates the cache, and the recompiled query uses the index:
+    store->createIndex("num"_sl, "[[\".num\"]]"_sl);
+    CHECK(cache.stats().count == 0);
+    Retained<Query> query4 = store->compileQuery(queryStr);
+    CHECK(cache.stats().misses == before.misses + 2);
+    CHECK(query4->explain().find("USING INDEX num") != string::npos);
+    check(query4);
+    check(query3);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Uses Read Connection Pool", "[Query]") {
+    addNumberedDocs(1, 10);
+    Retained<Query> query = store->compileQuery(json5("{WHAT: [['.num']]}"));
+    ReadConnectionPool &pool = db->readConnectionPool();
+
+    // Outside a transaction the query runs on a pooled connection:
+    auto checkouts = pool.stats().checkouts;
+    Retained<QueryEnumerator> e(query->createEnumerator());
+    CHECK(e->getRowCount() == 10);
+    CHECK(pool.stats().checkouts == checkouts + 1);
+
+    // Inside a transaction it has to use the DataFile's own connection, to see uncommitted docs:
+    {
+        Transaction t(db);
+        writeNumberedDoc(11, nullslice, t);
+        e = query->createEnumerator();
+        CHECK(e->getRowCount() == 11);
+        CHECK(pool.stats().checkouts == checkouts + 1);
+        t.abort();
+    }
+    e = query->createEnumerator();
+    CHECK(e->getRowCount() == 10);
+}
+
+
 TEST_CASE_METHOD(QueryTest, "Query SELECT", "[Query]") {
     addNumberedDocs();
     // Use a (SQL) query based on the Fleece "num" property:
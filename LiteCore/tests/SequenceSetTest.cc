@@ -18,11 +18,15 @@
 
 #include "LiteCoreTest.hh"
 #include "SequenceSet.hh"
+#include "RemoteSequenceSet.hh"
 #include "SecureRandomize.hh"
+#include "Stopwatch.hh"
 #include <sstream>
 
 using namespace std;
+using namespace fleece;
 using namespace litecore;
+using namespace litecore::repl;
 
 
 static void checkEmpty(const SequenceSet &s) {
@@ -287,3 +291,147 @@ TEST_CASE("SequenceSet: stress test", "[SequenceSet]") {
 
     checkEmpty(s);
 }
+
+
+TEST_CASE("SequenceSet: many ranges", "[SequenceSet]") {
+    // Enough ranges that the dead slots at the front get reused and compacted:
+    static constexpr SequenceSet::sequence N = 1000;
+    SequenceSet s;
+    s.add(1, N + 1);
+    for (SequenceSet::sequence i = 1; i <= N; i += 2)
+        CHECK(s.remove(i));
+    CHECK(s.rangesCount() == N / 2);
+    CHECK(s.first() == 2);
+    CHECK(s.last() == N);
+    for (SequenceSet::sequence i = 1; i <= N / 2; i += 2)
+        s.add(i);
+    CHECK(s.rangesCount() == N / 4 + 1);
+    CHECK(s.first() == 1);
+    CHECK(s.begin()->second == N / 2 + 1);
+    CHECK(!s.contains(N / 2 + 1));
+    CHECK(s.contains(N / 2 + 2));
+    s.add(N / 2, N + 1);
+    CHECK(s.to_string() == stringWithFormat("{1-%d}", int(N)));
+}
+
+
+static RemoteSequence remoteSeq(uint64_t n) {
+    return RemoteSequence(slice(to_string(n)));
+}
+
+
+TEST_CASE("RemoteSequenceSet", "[SequenceSet]") {
+    RemoteSequenceSet s;
+    s.clear(remoteSeq(10));
+    CHECK(s.empty());
+    CHECK(s.since() == remoteSeq(10));
+
+    bool outOfOrder = GENERATE(false, true);
+    vector<uint64_t> seqs {11, 12, 15, 20, 21};
+    if (outOfOrder)
+        seqs = {11, 15, 12, 21, 20};
+    for (auto n : seqs)
+        s.add(remoteSeq(n), n * 100);
+    CHECK(s.size() == 5);
+    CHECK(s.since() == remoteSeq(10));
+    CHECK(s.bodySizeOfSequence(remoteSeq(15)) == 1500);
+    CHECK(s.bodySizeOfSequence(remoteSeq(16)) == 0);
+
+    bool wasEarliest;
+    uint64_t bodySize;
+    s.remove(remoteSeq(seqs[1]), wasEarliest, bodySize);
+    CHECK(!wasEarliest);
+    CHECK(bodySize == seqs[1] * 100);
+    s.remove(remoteSeq(16), wasEarliest, bodySize);
+    CHECK(!wasEarliest);
+    CHECK(bodySize == 0);
+    s.remove(remoteSeq(11), wasEarliest, bodySize);
+    CHECK(wasEarliest);
+    CHECK(s.since() == remoteSeq(seqs[1]));     // Skips the one already removed
+    CHECK(s.size() == 3);
+
+    for (size_t i = 2; i < seqs.size(); ++i)
+        s.remove(remoteSeq(seqs[i]), wasEarliest, bodySize);
+    CHECK(s.empty());
+    CHECK(s.since() == remoteSeq(seqs.back()));
+}
+
+
+// Shuffles the items within consecutive windows of the given size, to simulate revisions
+// completing almost, but not quite, in order.
+template <class T>
+static void shuffleWithinWindows(vector<T> &items, size_t window) {
+    for (size_t start = 0; start < items.size(); start += window) {
+        size_t end = min(start + window, items.size());
+        for (size_t i = end - 1; i > start; --i)
+            swap(items[i], items[start + RandomNumber(uint32_t(i - start + 1))]);
+    }
+}
+
+
+TEST_CASE("SequenceSet Benchmark", "[SequenceSet][Perf][.slow]") {
+    static constexpr uint64_t N = 1000000;
+    using seq = SequenceSet::sequence;
+    vector<seq> order(N);
+    for (seq i = 0; i < N; ++i)
+        order[i] = i + 1;
+
+    for (size_t window : {1, 100}) {
+        shuffleWithinWindows(order, window);
+        // Like Checkpoint: the changes are all completed, except for those being pushed,
+        // which complete as they're acknowledged.
+        SequenceSet s;
+        char label[100];
+        Stopwatch removeTime;
+        s.add(1, N + 1);
+        for (seq i = 1; i <= N; ++i)
+            s.remove(i);
+        removeTime.stop();
+        sprintf(label, "SequenceSet, window %zu, removing", window);
+        removeTime.printReport(label, N, "sequence");
+
+        Stopwatch addTime;
+        for (seq i : order)
+            s.add(i);
+        addTime.stop();
+        sprintf(label, "SequenceSet, window %zu, adding", window);
+        addTime.printReport(label, N, "sequence");
+        CHECK(s.rangesCount() == 1);
+        CHECK(s.size() == N);
+    }
+}
+
+
+TEST_CASE("RemoteSequenceSet Benchmark", "[SequenceSet][Perf][.slow]") {
+    static constexpr uint64_t N = 1000000;
+    vector<RemoteSequence> seqs;
+    seqs.reserve(N);
+    for (uint64_t i = 1; i <= N; ++i)
+        seqs.push_back(remoteSeq(i));
+
+    for (size_t window : {1, 100}) {
+        // Like the Puller: sequences are added as changes arrive, and removed as revs do.
+        vector<RemoteSequence> order = seqs;
+        shuffleWithinWindows(order, window);
+        RemoteSequenceSet s;
+        s.clear(RemoteSequence());
+        char label[100];
+        Stopwatch addTime;
+        for (auto &seq : seqs)
+            s.add(seq, 100);
+        addTime.stop();
+        sprintf(label, "RemoteSequenceSet, window %zu, adding", window);
+        addTime.printReport(label, N, "sequence");
+
+        bool wasEarliest;
+        uint64_t bodySize;
+        Stopwatch removeTime;
+        for (auto &seq : order)
+            s.remove(seq, wasEarliest, bodySize);
+        removeTime.stop();
+        sprintf(label, "RemoteSequenceSet, window %zu, removing", window);
+        removeTime.printReport(label, N, "sequence");
+        CHECK(s.empty());
+        CHECK(s.since() == seqs.back());
+    }
+}
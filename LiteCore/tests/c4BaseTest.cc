@@ -23,11 +23,22 @@
 #include "NumConversion.hh"
 #include "Actor.hh"
 #include "URLTransformer.hh"
+#include "Poller.hh"
+#include "Stopwatch.hh"
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <exception>
 #include <chrono>
+#include <mutex>
 #include <thread>
 #ifdef WIN32
 #include <winerror.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
 #endif
 
 using namespace fleece;
@@ -280,6 +291,317 @@ namespace {
         this_thread::sleep_for(2s);
     }
 
+    // Records the order in which its messages arrive, per sender.
+    class OrderActor : public litecore::actor::Actor {
+    public:
+        OrderActor()
+            :Actor(kC4Cpp_DefaultLog, "OrderActor")
+        {}
+
+        void record(unsigned sender, unsigned n) {
+            enqueue(FUNCTION_TO_QUEUE(OrderActor::_record), sender, n);
+        }
+
+        void forward(Retained<OrderActor> to, unsigned n) {
+            enqueue(FUNCTION_TO_QUEUE(OrderActor::_forward), to, n);
+        }
+
+        vector<vector<unsigned>> received = vector<vector<unsigned>>(8);
+        atomic<unsigned> count {0};
+        atomic<int> concurrent {0};
+        bool overlapped {false};
+
+    private:
+        void _record(unsigned sender, unsigned n) {
+            if (++concurrent > 1)
+                overlapped = true;
+            received[sender].push_back(n);
+            --concurrent;
+            ++count;
+        }
+
+        void _forward(Retained<OrderActor> to, unsigned n) {
+            to->record(0, n);
+        }
+    };
+
+    TEST_CASE("Actor Closure") {
+        using litecore::actor::Closure;
+        int calls = 0;
+        Closure small([&]{ ++calls; });
+        CHECK(small.isInline());
+        small();
+        CHECK(calls == 1);
+
+        std::array<char, Closure::kInlineSize + 1> big {};
+        big[0] = 1;
+        Closure large([&calls, big]{ calls += big[0]; });
+        CHECK(!large.isInline());
+
+        Closure moved(std::move(large));
+        CHECK(!large);
+        moved();
+        CHECK(calls == 2);
+
+        auto counter = make_shared<int>(0);
+        {
+            Closure holder([counter]{ ++*counter; });
+            CHECK(counter.use_count() == 2);
+            Closure other;
+            other = std::move(holder);
+            other();
+            CHECK(counter.use_count() == 2);
+        }
+        CHECK(counter.use_count() == 1);
+        CHECK(*counter == 1);
+    }
+
+    TEST_CASE("Actor Message Ordering") {
+        constexpr unsigned kSenders = 8, kMessages = 5000;
+        auto actor = retained(new OrderActor());
+        vector<thread> senders;
+        for (unsigned s = 0; s < kSenders; ++s) {
+            senders.emplace_back([&, s] {
+                for (unsigned n = 0; n < kMessages; ++n)
+                    actor->record(s, n);
+            });
+        }
+        for (auto &t : senders)
+            t.join();
+        actor->waitTillCaughtUp();
+
+        CHECK(actor->count == kSenders * kMessages);
+        CHECK(!actor->overlapped);
+        for (unsigned s = 0; s < kSenders; ++s) {
+            auto &received = actor->received[s];
+            REQUIRE(received.size() == kMessages);
+            for (unsigned n = 0; n < kMessages; ++n)
+                REQUIRE(received[n] == n);
+        }
+    }
+
+    TEST_CASE("Actor Stats") {
+        constexpr unsigned kMessages = 1000;
+        auto actor = retained(new OrderActor());
+        for (unsigned n = 0; n < kMessages; ++n)
+            actor->record(0, n);
+        actor->waitTillCaughtUp();
+
+        litecore::actor::ActorStats stats = actor->stats();
+        CHECK(stats.name == "OrderActor");
+        CHECK(stats.enqueued >= kMessages + 1);      // +1 for waitTillCaughtUp's message
+        CHECK(stats.handled >= kMessages);
+        CHECK(stats.handled <= stats.enqueued);
+        CHECK(stats.maxQueueDepth >= 1);
+        CHECK(stats.maxQueueDepth <= stats.enqueued);
+        CHECK(stats.latencyP50 > 0.0);
+        CHECK(stats.latencyP99 >= stats.latencyP50);
+        CHECK(stats.busyTime > 0.0);
+        CHECK(stats.busyTime <= stats.lifetime);
+
+        alloc_slice json(c4_getActorStats());
+        Doc doc = Doc::fromJSON(json);
+        Array all = doc.asArray();
+        REQUIRE(all);
+        bool found = false;
+        for (Array::iterator i(all); i; ++i) {
+            Dict item = i.value().asDict();
+            if (item["name"].asString() == "OrderActor"_sl && item["handled"].asUnsigned() >= kMessages) {
+                CHECK(item["latency_p99"].asDouble() >= item["latency_p50"].asDouble());
+                found = true;
+            }
+        }
+        CHECK(found);
+    }
+
+    TEST_CASE("Actor Dispatch Benchmark", "[Perf][.slow]") {
+        // Many actors each forwarding messages to a common sink, exercising cross-thread
+        // scheduling; then many independent actors, exercising parallelism.
+        constexpr unsigned kActors = 64, kMessages = 20000;
+        Stopwatch fanIn, independent;
+        fanIn.stop();
+        independent.stop();
+        for (int pass = 0; pass < 5; ++pass) {
+            auto sink = retained(new OrderActor());
+            vector<Retained<OrderActor>> actors;
+            for (unsigned i = 0; i < kActors; ++i)
+                actors.push_back(retained(new OrderActor()));
+
+            fanIn.start();
+            for (unsigned n = 0; n < kMessages; ++n)
+                actors[n % kActors]->forward(sink, n);
+            for (auto &a : actors)
+                a->waitTillCaughtUp();
+            sink->waitTillCaughtUp();
+            fanIn.stop();
+            CHECK(sink->count == kMessages);
+
+            independent.start();
+            for (unsigned n = 0; n < kMessages; ++n)
+                actors[n % kActors]->record(1, n);
+            for (auto &a : actors)
+                a->waitTillCaughtUp();
+            independent.stop();
+        }
+        fanIn.printReport("Fan-in dispatch", 5 * kMessages, "message");
+        independent.printReport("Independent dispatch", 5 * kMessages, "message");
+    }
+
+#ifndef _WIN32
+    // A connected pair of non-blocking Unix-domain sockets.
+    struct SocketPair {
+        int fd[2] {-1, -1};
+
+        SocketPair() {
+            REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fd) == 0);
+            for (int f : fd)
+                ::fcntl(f, F_SETFL, ::fcntl(f, F_GETFL) | O_NONBLOCK);
+        }
+        ~SocketPair() {
+            for (int f : fd)
+                ::close(f);
+        }
+        void send(int side)     {char c = 'x'; REQUIRE(::write(fd[side], &c, 1) == 1);}
+        void drain(int side)    {char buf[64]; while (::read(fd[side], buf, sizeof(buf)) > 0) { }}
+    };
+
+    // Waits until a counter reaches a value.
+    struct Countdown {
+        mutex m;
+        condition_variable cond;
+        unsigned count = 0;
+
+        void increment()  {
+            lock_guard<mutex> lock(m);
+            ++count;
+            cond.notify_all();
+        }
+        bool waitFor(unsigned n, chrono::seconds timeout = 10s) {
+            unique_lock<mutex> lock(m);
+            return cond.wait_for(lock, timeout, [&]{return count >= n;});
+        }
+    };
+
+    TEST_CASE("Poller") {
+        using litecore::net::Poller;
+        unsigned threads = GENERATE(1, 3);
+        Poller poller(threads);
+        poller.start();
+        CHECK(poller.threadCount() == threads);
+
+        SocketPair sp;
+        Countdown readable;
+        SECTION("Data arrives after listening") {
+            poller.addListener(sp.fd[0], Poller::kReadable, [&] {readable.increment();});
+            sp.send(1);
+        }
+        SECTION("Data already waiting") {
+            // Even if the edge happened before the listener was added, it has to be notified:
+            sp.send(1);
+            this_thread::sleep_for(50ms);
+            poller.addListener(sp.fd[0], Poller::kReadable, [&] {readable.increment();});
+        }
+        REQUIRE(readable.waitFor(1));
+
+        // Unread data that's still there triggers the next listener too:
+        poller.addListener(sp.fd[0], Poller::kReadable, [&] {readable.increment();});
+        REQUIRE(readable.waitFor(2));
+
+        // A writeable socket notifies right away:
+        Countdown writeable;
+        poller.addListener(sp.fd[1], Poller::kWriteable, [&] {writeable.increment();});
+        REQUIRE(writeable.waitFor(1));
+
+        // Interrupting calls the listeners immediately:
+        sp.drain(0);
+        poller.addListener(sp.fd[0], Poller::kReadable, [&] {readable.increment();});
+        poller.interrupt(sp.fd[0]);
+        REQUIRE(readable.waitFor(3));
+
+        // Removed listeners aren't called:
+        poller.addListener(sp.fd[0], Poller::kReadable, [&] {readable.increment();});
+        poller.removeListeners(sp.fd[0]);
+        sp.send(1);
+        this_thread::sleep_for(100ms);
+        CHECK(readable.count == 3);
+        poller.stop();
+    }
+
+    TEST_CASE("Poller Connection Scaling Benchmark", "[Perf][.slow]") {
+        // Measures ping latency on one socket while the rest are idle, and total throughput when
+        // all the sockets are busy, for increasing numbers of sockets.
+        using litecore::net::Poller;
+        constexpr unsigned kPings = 2000, kActiveRounds = 100;
+
+        struct rlimit limit;
+        if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            ::setrlimit(RLIMIT_NOFILE, &limit);
+        }
+
+        for (unsigned threads : {1u, 4u}) {
+            for (unsigned n : {10u, 100u, 1000u}) {
+                if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < 2*n + 100) {
+                    WARN("Skipping " << n << " sockets; too few file descriptors allowed");
+                    continue;
+                }
+                Poller poller(threads);
+                poller.start();
+                vector<unique_ptr<SocketPair>> pairs;
+                for (unsigned i = 0; i < n; ++i)
+                    pairs.emplace_back(new SocketPair());
+
+                // Idle: every socket has a listener, but only one gets traffic:
+                Countdown pings;
+                for (unsigned i = 1; i < n; ++i)
+                    poller.addListener(pairs[i]->fd[0], Poller::kReadable, [] { });
+                SocketPair &busy = *pairs[0];
+                function<void()> onPing = [&] {
+                    busy.drain(0);
+                    pings.increment();
+                    poller.addListener(busy.fd[0], Poller::kReadable, onPing);
+                };
+                poller.addListener(busy.fd[0], Poller::kReadable, onPing);
+                char label[100];
+                Stopwatch idle;
+                for (unsigned p = 1; p <= kPings; ++p) {
+                    busy.send(1);
+                    REQUIRE(pings.waitFor(p));
+                }
+                idle.stop();
+                sprintf(label, "Poller, %u thread(s), %u sockets, idle", threads, n);
+                idle.printReport(label, kPings, "ping");
+                for (auto &pair : pairs)
+                    poller.removeListeners(pair->fd[0]);
+
+                // Active: every socket bounces messages as fast as it can:
+                Countdown bounces;
+                vector<function<void()>> onBounce(n);
+                vector<unsigned> rounds(n, 0);
+                for (unsigned i = 0; i < n; ++i) {
+                    onBounce[i] = [&, i] {
+                        pairs[i]->drain(0);
+                        bounces.increment();
+                        if (++rounds[i] < kActiveRounds) {
+                            poller.addListener(pairs[i]->fd[0], Poller::kReadable, onBounce[i]);
+                            pairs[i]->send(1);
+                        }
+                    };
+                    poller.addListener(pairs[i]->fd[0], Poller::kReadable, onBounce[i]);
+                }
+                Stopwatch active;
+                for (auto &pair : pairs)
+                    pair->send(1);
+                REQUIRE(bounces.waitFor(n * kActiveRounds, 60s));
+                active.stop();
+                poller.stop();
+                sprintf(label, "Poller, %u thread(s), %u sockets, active", threads, n);
+                active.printReport(label, n * kActiveRounds, "event");
+            }
+        }
+    }
+#endif
+
     TEST_CASE("URL Transformation") {
         slice withPort, unaffected;
         alloc_slice withoutPort;
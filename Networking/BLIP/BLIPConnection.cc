@@ -45,6 +45,7 @@ namespace litecore { namespace blip {
 
     static const size_t kDefaultFrameSize = 4096;       // Default size of frame
     static const size_t kBigFrameSize = 16384;          // Max size of frame
+    static const size_t kFrameBufSize = 65536;          // Size of frame scratch buffer
 
     static const auto kDefaultCompressionLevel = (Deflater::CompressionLevel)6;
 
@@ -107,25 +108,34 @@ namespace litecore { namespace blip {
         bool                    _writeable {true};
         MessageMap              _pendingRequests, _pendingResponses;
         atomic<MessageNo>       _lastMessageNo {0};
-        MessageNo               _numRequestsReceived {0};
-        Deflater                _outputCodec;
-        Inflater                _inputCodec;
-        unique_ptr<uint8_t[]>   _frameBuf;
+        atomic<MessageNo>       _numRequestsReceived {0};
+        int const               _compressionLevel;
+        Codec::Algorithm        _compression;
+        unique_ptr<Codec>       _outputCodec;
+        unique_ptr<Codec>       _inputCodec;
         RequestHandlers         _requestHandlers;
         size_t                  _maxOutboxDepth {0}, _totalOutboxDepth {0}, _countOutboxDepth {0};
-        uint64_t                _totalBytesWritten {0}, _totalBytesRead {0};
+        atomic<uint64_t>        _numMessagesSent {0};       // Messages completely sent
+        atomic<uint64_t>        _totalBytesWritten {0}, _totalBytesRead {0};
+        atomic<uint64_t>        _totalBytesCopied {0};      // Message bytes copied into frames
+        alloc_slice             _frameBuf;                  // Scratch space for frames
+        size_t                  _frameBufUsed {0};          // Bytes of _frameBuf in use
         Stopwatch               _timeOpen;
         atomic_flag             _connectedWebSocket = ATOMIC_FLAG_INIT;
 
     public:
 
-        BLIPIO(Connection *connection, WebSocket *webSocket, Deflater::CompressionLevel compressionLevel)
+        BLIPIO(Connection *connection, WebSocket *webSocket,
+               Codec::Algorithm compression, int compressionLevel)
         :Actor(BLIPLog, string("BLIP[") + connection->name() + "]")
         ,_connection(connection)
         ,_webSocket(webSocket)
         ,_incomingFrames(this, "incomingFrames", &BLIPIO::_onWebSocketMessages)
         ,_outbox(10)
-        ,_outputCodec(compressionLevel)
+        ,_compressionLevel(compressionLevel)
+        ,_compression(compression)
+        ,_outputCodec(Codec::newCompressor(compression, compressionLevel))
+        ,_inputCodec(Codec::newDecompressor(compression))
         {
             _pendingRequests.reserve(10);
             _pendingResponses.reserve(10);
@@ -160,6 +170,11 @@ namespace litecore { namespace blip {
             return _webSocket;
         }
 
+        Connection::Stats stats() const {
+            return {_numMessagesSent, _totalBytesWritten, _totalBytesCopied,
+                    _numRequestsReceived, _totalBytesRead};
+        }
+
         virtual std::string loggingIdentifier() const override {
             return _connection ? _connection->name() : Logging::loggingIdentifier();
         }
@@ -168,17 +183,27 @@ namespace litecore { namespace blip {
     protected:
 
         ~BLIPIO() {
-            LogTo(SyncLog, "BLIP sent %zu msgs (%" PRIu64 " bytes), rcvd %" PRIu64 " msgs (%" PRIu64 " bytes) in %.3f sec. Max outbox depth was %zu, avg %.2f",
-                  _countOutboxDepth, _totalBytesWritten,
-                  _numRequestsReceived, _totalBytesRead,
+            LogTo(SyncLog, "BLIP sent %" PRIu64 " msgs (%" PRIu64 " bytes), rcvd %" PRIu64 " msgs (%" PRIu64 " bytes) in %.3f sec. Max outbox depth was %zu, avg %.2f",
+                  _numMessagesSent.load(), _totalBytesWritten.load(),
+                  _numRequestsReceived.load(), _totalBytesRead.load(),
                   _timeOpen.elapsed(),
                   _maxOutboxDepth, _totalOutboxDepth/(double)_countOutboxDepth);
+            LogTo(SyncLog, "BLIP copied %" PRIu64 " bytes into frames (%.0f per msg sent)",
+                  _totalBytesCopied.load(), _totalBytesCopied/(double)_numMessagesSent);
             logStats();
         }
 
         virtual void onWebSocketGotHTTPResponse(int status,
                                                 const websocket::Headers &headers) override
         {
+            // The accepted subprotocol determines the compression algorithm. (This is called
+            // before the connection opens, so no frames have been sent or received yet.)
+            if (slice protocol = headers["Sec-WebSocket-Protocol"_sl]; protocol) {
+                Codec::Algorithm compression;
+                if (Codec::algorithmNamed(slice(Connection::compressionForWebSocketProtocol(protocol)),
+                                          compression))
+                    enqueue(FUNCTION_TO_QUEUE(BLIPIO::_setCompression), compression);
+            }
             _connection->gotHTTPResponse(status, headers);
         }
 
@@ -215,6 +240,20 @@ namespace litecore { namespace blip {
             _webSocket->connect(this);
         }
 
+        void _setCompression(Codec::Algorithm compression) {
+            if (compression == _compression)
+                return;
+            if (!Codec::algorithmAvailable(compression)) {
+                // We never offer an unavailable algorithm, so the peer shouldn't have chosen it
+                warn("Peer chose unavailable %s compression", Codec::algorithmName(compression));
+                return _close(kCodeProtocolError, "Unsupported compression"_sl);
+            }
+            logInfo("Using %s compression", Codec::algorithmName(compression));
+            _compression = compression;
+            _outputCodec = Codec::newCompressor(compression, _compressionLevel);
+            _inputCodec = Codec::newDecompressor(compression);
+        }
+
         /** Implementation of public close() method. Closes the WebSocket. */
         void _close(CloseCode closeCode, alloc_slice message) {
             if (_webSocket && !_closingWithError) {
@@ -330,6 +369,19 @@ namespace litecore { namespace blip {
         }
 
 
+        /** Returns `size` bytes of room at the unused end of the frame scratch buffer.
+            The caller adds the number of bytes it keeps to _frameBufUsed. The WebSocket retains
+            the buffer until it's written those bytes, so a full buffer is simply replaced. */
+        slice frameSpace(size_t size) {
+            DebugAssert(size <= kFrameBufSize);
+            if (!_frameBuf || _frameBufUsed + size > _frameBuf.size) {
+                _frameBuf = alloc_slice(kFrameBufSize);
+                _frameBufUsed = 0;
+            }
+            return slice((uint8_t*)_frameBuf.buf + _frameBufUsed, size);
+        }
+
+
         /** Sends the next frame. */
         void writeToWebSocket() {
             if (!_writeable)
@@ -345,24 +397,55 @@ namespace litecore { namespace blip {
 
                 FrameFlags frameFlags;
                 {
-                    // Set up a buffer for the frame contents:
                     size_t maxSize = kDefaultFrameSize;
                     if (msg->urgent() || _outbox.empty() || !_outbox.front()->urgent())
                         maxSize = kBigFrameSize;
 
-                    if (!_frameBuf)
-                        _frameBuf.reset(new uint8_t[kMaxVarintLen64 + 1 + 4 + kBigFrameSize]);
-                    slice out(_frameBuf.get(), maxSize);
+                    // Write the frame header (message number and flags) to the scratch buffer,
+                    // leaving room for the checksum:
+                    static constexpr size_t kHeaderSpace = kMaxVarintLen64 + 1
+                                                         + Codec::kChecksumSize;
+                    slice out = frameSpace(kHeaderSpace);
+                    slice header = out;
+                    alloc_slice headerOwner = _frameBuf;
                     WriteUVarInt(&out, msg->_number);
                     auto flagsPos = (FrameFlags*)out.buf;
                     out.moveStart(1);
+                    slice headerBytes(header.buf, out.buf);
+                    maxSize -= headerBytes.size;
 
-                    // Ask the MessageOut to write data to fill the buffer:
                     auto prevBytesSent = msg->_bytesSent;
-                    msg->nextFrameToSend(_outputCodec, out, frameFlags);
-                    *flagsPos = frameFlags;
-                    slice frame(_frameBuf.get(), out.buf);
-                    bytesWritten += frame.size;
+                    vector<websocket::SharedSlice> pieces;
+                    size_t frameSize;
+                    alloc_slice payload;
+                    slice data;
+                    if (msg->nextFrameToSendInPlace(*_outputCodec, maxSize, payload, data,
+                                                    frameFlags)) {
+                        // The frame's data is just a range of the message's payload, so the
+                        // frame goes to the WebSocket as pieces -- header, data, checksum --
+                        // without being copied:
+                        *flagsPos = frameFlags;
+                        _outputCodec->writeChecksum(out);
+                        slice checksum(headerBytes.end(), out.buf);
+                        _frameBufUsed += slice(header.buf, out.buf).size;
+                        pieces = {{headerOwner, headerBytes, true}, {payload, data},
+                                  {headerOwner, checksum, true}};
+                        frameSize = headerBytes.size + data.size + checksum.size;
+                    } else {
+                        // Otherwise ask the MessageOut to write (and maybe compress) the data
+                        // into the scratch buffer, and send that after the header:
+                        _frameBufUsed += headerBytes.size;
+                        slice frameOut = frameSpace(maxSize);
+                        const void *frameStart = frameOut.buf;
+                        msg->nextFrameToSend(*_outputCodec, frameOut, frameFlags);
+                        *flagsPos = frameFlags;
+                        slice frameData(frameStart, frameOut.buf);
+                        _frameBufUsed += frameData.size;
+                        _totalBytesCopied += frameData.size;
+                        frameSize = headerBytes.size + frameData.size;
+                        pieces = {{headerOwner, headerBytes, true}, {_frameBuf, frameData, true}};
+                    }
+                    bytesWritten += frameSize;
 
                     logVerbose("    Sending frame: %s #%" PRIu64 " %c%c%c%c, bytes %u--%u",
                                kMessageTypeNames[frameFlags & kTypeMask], msg->number(),
@@ -371,11 +454,10 @@ namespace litecore { namespace blip {
                                (frameFlags & kNoReply ? 'N' : '-'),
                                (frameFlags & kCompressed ? 'C' : '-'),
                                prevBytesSent, msg->_bytesSent - 1);
-                    //logVerbose("    %s", frame.hexString().c_str());
                     // Write it to the WebSocket:
-                    _writeable = _webSocket->send(frame);
+                    _writeable = _webSocket->sendPieces(move(pieces));
                 }
-                
+
                 // Return message to the queue if it has more frames left to send:
                 if (frameFlags & kMoreComing) {
                     if (msg->needsAck())
@@ -384,6 +466,7 @@ namespace litecore { namespace blip {
                         requeue(msg);
                 } else {
                     if (!msg->isAck()) {
+                        ++_numMessagesSent;
                         logVerbose("Finished sending %s", msg->description().c_str());
                         // Add its response message to _pendingResponses:
                         MessageIn* response = msg->createResponse();
@@ -451,7 +534,7 @@ namespace litecore { namespace blip {
                     if (msg) {
                         MessageIn::ReceiveState state;
                         try {
-                            state = msg->receivedFrame(_inputCodec, payload, flags);
+                            state = msg->receivedFrame(*_inputCodec, payload, flags);
                         } catch (...) {
                             // If this is the final frame, then msg may not be in either pending list
                             // anymore. But on an exception we need to call its progress handler to
@@ -637,8 +720,67 @@ namespace litecore { namespace blip {
         if (levelP.isInteger())
             _compressionLevel = (int8_t)levelP.asInt();
 
+        auto compression = Codec::Algorithm::Deflate;
+        slice algName = options.get(kCompressionAlgorithmOption).asString();
+        if (algName && !(Codec::algorithmNamed(algName, compression)
+                                && Codec::algorithmAvailable(compression))) {
+            warn("Compression algorithm '%.*s' is unavailable; using deflate", SPLAT(algName));
+            compression = Codec::Algorithm::Deflate;
+        }
+
         // Now connect the websocket:
-        _io = new BLIPIO(this, webSocket, (Deflater::CompressionLevel)_compressionLevel);
+        _io = new BLIPIO(this, webSocket, compression, _compressionLevel);
+    }
+
+
+    // Returns the WebSocket subprotocol denoting a compression algorithm
+    static string webSocketProtocol(Codec::Algorithm compression, const string &appProtocol) {
+        string protocol = Connection::kWSProtocolName;
+        if (compression != Codec::Algorithm::Deflate)
+            (protocol += '-') += Codec::algorithmName(compression);
+        return protocol + appProtocol;
+    }
+
+
+    string Connection::webSocketProtocols(const string &appProtocol) {
+        vector<string> protocols;
+        for (auto compression : Codec::availableAlgorithms())
+            protocols.push_back(webSocketProtocol(compression, appProtocol));
+        return join(protocols, ",");
+    }
+
+
+    string Connection::selectWebSocketProtocol(slice offered, const string &appProtocol) {
+        vector<string> offers;
+        split(string_view((const char*)offered.buf, offered.size), ",", [&](string_view item) {
+            while (!item.empty() && item.front() == ' ')
+                item.remove_prefix(1);
+            while (!item.empty() && item.back() == ' ')
+                item.remove_suffix(1);
+            offers.emplace_back(item);
+        });
+        // Our preference order wins:
+        for (auto compression : Codec::availableAlgorithms()) {
+            string protocol = webSocketProtocol(compression, appProtocol);
+            if (find(offers.begin(), offers.end(), protocol) != offers.end())
+                return protocol;
+        }
+        return "";
+    }
+
+
+    const char* Connection::compressionForWebSocketProtocol(slice protocol) {
+        // The protocol looks like "BLIP_3-snappy+CBMobile_2"; no suffix means deflate.
+        slice prefix(kWSProtocolName);
+        if (protocol.hasPrefix(prefix) && protocol.size > prefix.size && protocol[prefix.size] == '-') {
+            slice name = protocol.from(prefix.size + 1);
+            if (auto plus = name.findByte('+'); plus)
+                name = name.upTo(plus);
+            Codec::Algorithm compression;
+            if (Codec::algorithmNamed(name, compression))
+                return Codec::algorithmName(compression);
+        }
+        return Codec::algorithmName(Codec::Algorithm::Deflate);
     }
 
 
@@ -728,4 +870,10 @@ namespace litecore { namespace blip {
         return _io->webSocket();
     }
 
+
+    Connection::Stats Connection::stats() const {
+        Retained<BLIPIO> io = _io;
+        return io ? io->stats() : Stats{};
+    }
+
 } }
@@ -52,6 +52,27 @@ namespace litecore { namespace blip {
             0 (no compression) to 9 (best compression). */
         static constexpr const char *kCompressionLevelOption = "BLIPCompressionLevel";
 
+        /** Option to set the compression algorithm: "deflate" (the default) or "snappy".
+            A client needn't set this, since the algorithm is negotiated through the WebSocket
+            subprotocol (see webSocketProtocols); a server should set it to match the
+            subprotocol it accepted (see selectWebSocketProtocol.) */
+        static constexpr const char *kCompressionAlgorithmOption = "BLIPCompressionAlgorithm";
+
+        /** Returns the WebSocket subprotocols a client should offer, most preferred first,
+            as a comma-separated list to use as the Sec-WebSocket-Protocol header value.
+            There's one for each available compression algorithm: kWSProtocolName, with a
+            suffix naming the algorithm unless it's deflate, then `appProtocol`. Servers that
+            don't know about compression negotiation will choose the plain (deflate) one. */
+        static std::string webSocketProtocols(const std::string &appProtocol);
+
+        /** For use by a server: given the client's Sec-WebSocket-Protocol header value, returns
+            the subprotocol to accept, or an empty string if none is acceptable. */
+        static std::string selectWebSocketProtocol(fleece::slice offered,
+                                                   const std::string &appProtocol);
+
+        /** Returns the name of the compression algorithm a subprotocol denotes. */
+        static const char* compressionForWebSocketProtocol(fleece::slice protocol);
+
         /** Creates a BLIP connection on a WebSocket. */
         Connection(websocket::WebSocket*,
                    const fleece::AllocedDict &options,
@@ -85,6 +106,18 @@ namespace litecore { namespace blip {
 
         virtual std::string loggingIdentifier() const override  {return _name;}
         
+        /** Cumulative statistics of a connection. */
+        struct Stats {
+            uint64_t messagesSent;      ///< Messages sent (not counting acks)
+            uint64_t bytesSent;         ///< Bytes of frames sent
+            uint64_t bytesCopied;       ///< Message bytes copied into frame buffers, not sent in place
+            uint64_t requestsReceived;  ///< Requests received
+            uint64_t bytesReceived;     ///< Bytes of frames received
+        };
+
+        /** Returns the connection's statistics so far. */
+        Stats stats() const;
+
         /** Exposed only for testing. */
         websocket::WebSocket* webSocket() const;
 
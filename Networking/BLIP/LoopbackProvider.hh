@@ -44,14 +44,20 @@ namespace litecore { namespace websocket {
     private:
         Retained<Driver> _driver;
         actor::delay_t _latency;
+        size_t _bandwidth;
 
     public:
 
+        /** Constructor. `latency` is the simulated one-way network delay. A nonzero `bandwidth`
+            (in bytes/sec) simulates a slow link, on which each message is delayed further by the
+            time needed to transmit it and the messages queued ahead of it. */
         LoopbackWebSocket(const fleece::alloc_slice &url,
                           Role role,
-                          actor::delay_t latency =actor::delay_t::zero())
+                          actor::delay_t latency =actor::delay_t::zero(),
+                          size_t bandwidth =0)
         :WebSocket(url, role)
         ,_latency(latency)
+        ,_bandwidth(bandwidth)
         { }
 
         /** Binds two LoopbackWebSocket objects to each other, so after they open, each will
@@ -78,6 +84,13 @@ namespace litecore { namespace websocket {
             return newValue <= kSendBufferSize;
         }
 
+        virtual bool sendPieces(std::vector<SharedSlice> pieces, bool binary) override {
+            fleece::alloc_slice msg = SharedSlice::join(pieces);
+            auto newValue = (_driver->_bufferedBytes += msg.size);
+            _driver->enqueue(FUNCTION_TO_QUEUE(Driver::_send), msg, binary);
+            return newValue <= kSendBufferSize;
+        }
+
         virtual void close(int status =1000, fleece::slice message =fleece::nullslice) override {
             _driver->enqueue(FUNCTION_TO_QUEUE(Driver::_close), status, fleece::alloc_slice(message));
         }
@@ -92,7 +105,7 @@ namespace litecore { namespace websocket {
         }
 
         virtual Driver* createDriver() {
-            return new Driver(this, _latency);
+            return new Driver(this, _latency, _bandwidth);
         }
 
         Driver* driver() const    {return _driver;}
@@ -145,10 +158,11 @@ namespace litecore { namespace websocket {
         class Driver : public actor::Actor {
         public:
 
-            Driver(LoopbackWebSocket *ws, actor::delay_t latency)
+            Driver(LoopbackWebSocket *ws, actor::delay_t latency, size_t bandwidth =0)
             :Actor(WSLogDomain)
             ,_webSocket(ws)
             ,_latency(latency)
+            ,_bandwidth(bandwidth)
             { }
 
             virtual std::string loggingIdentifier() const override {
@@ -227,12 +241,24 @@ namespace litecore { namespace websocket {
                     Assert(_state == State::connected);
                     logDebug("SEND: %s", formatMsg(msg, binary).c_str());
                     Retained<Message> message(new LoopbackMessage(_webSocket, msg, binary));
-                    _peer->received(message, _latency);
+                    _peer->received(message, _latency + transmissionDelay(msg.size));
                 } else {
                     logInfo("SEND: Failed, socket is closed");
                 }
             }
 
+            // Simulates limited bandwidth: returns how long until the link has finished sending
+            // this message along with everything queued before it.
+            actor::delay_t transmissionDelay(size_t size) {
+                if (_bandwidth == 0)
+                    return actor::delay_t::zero();
+                auto now = std::chrono::steady_clock::now();
+                _linkFreeAt = std::max(_linkFreeAt, now)
+                    + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                actor::delay_t(double(size) / _bandwidth));
+                return _linkFreeAt - now;
+            }
+
             virtual void _received(Retained<Message> message) {
                 if (!connected())
                     return;
@@ -310,6 +336,8 @@ namespace litecore { namespace websocket {
 
             Retained<LoopbackWebSocket> _webSocket;
             actor::delay_t _latency {0.0};
+            size_t _bandwidth {0};                              // Simulated bytes/sec, or 0
+            std::chrono::steady_clock::time_point _linkFreeAt;  // When simulated link is idle
             Retained<LoopbackWebSocket> _peer;
             websocket::Headers _responseHeaders;
             std::atomic<size_t> _bufferedBytes {0};
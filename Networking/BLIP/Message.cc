@@ -167,14 +167,16 @@ namespace litecore { namespace blip {
             uint8_t checksum[Codec::kChecksumSize];
             auto trailer = (void*)&frame[frame.size - Codec::kChecksumSize];
             memcpy(checksum, trailer, Codec::kChecksumSize);
-            if (mode == Codec::Mode::SyncFlush) {
+            slice flushTrailer = (mode == Codec::Mode::SyncFlush) ? codec.flushTrailer()
+                                                                  : nullslice;
+            if (flushTrailer.size > 0) {
                 // Replace checksum with the untransmitted deflate empty-block trailer,
                 // which is conveniently the same size:
-                static_assert(Codec::kChecksumSize == 4,
-                              "Checksum not same size as deflate trailer");
-                memcpy(trailer, "\x00\x00\xFF\xFF", 4);
+                Assert(flushTrailer.size == Codec::kChecksumSize,
+                       "Checksum not same size as codec's trailer");
+                memcpy(trailer, flushTrailer.buf, Codec::kChecksumSize);
             } else {
-                // In uncompressed message, just trim off the checksum:
+                // Otherwise just trim off the checksum:
                 frame.setSize(frame.size - Codec::kChecksumSize);
             }
 
@@ -290,7 +292,8 @@ namespace litecore { namespace blip {
 
     void MessageIn::readFrame(Codec &codec, int mode, slice &frame, bool finalFrame) {
         uint8_t buffer[4096];
-        while (frame.size > 0) {
+        // (Some codecs buffer decoded data, so keep going till that's been written too.)
+        while (frame.size > 0 || codec.unflushedBytes() > 0) {
             slice output {buffer, sizeof(buffer)};
             codec.write(frame, output, Codec::Mode(mode));
             if (output.buf > buffer)
@@ -71,12 +71,13 @@ namespace litecore { namespace blip {
 
         if (mode == Codec::Mode::SyncFlush) {
             size_t bytesWritten = (frameSize - Codec::kChecksumSize) - dst.size;
-            if (bytesWritten > 0) {
-                // SyncFlush always ends the output with the 4 bytes 00 00 FF FF.
+            slice trailer = codec.flushTrailer();
+            if (bytesWritten > 0 && trailer.size > 0) {
+                // With deflate, SyncFlush always ends the output with the 4 bytes 00 00 FF FF.
                 // We can remove those, then add them when reading the data back in.
-                Assert(bytesWritten >= 4 &&
-                       memcmp((const char*)dst.buf - 4, "\x00\x00\xFF\xFF", 4) == 0);
-                dst.moveStart(-4);
+                Assert(bytesWritten >= trailer.size &&
+                       memcmp((const char*)dst.buf - trailer.size, trailer.buf, trailer.size) == 0);
+                dst.moveStart(-(ptrdiff_t)trailer.size);
             }
         }
 
@@ -84,12 +85,37 @@ namespace litecore { namespace blip {
         dst.setSize(dst.size + Codec::kChecksumSize);           // Undo "Reserve room..." above
         codec.writeChecksum(dst);
 
-        // Compute the (compressed) frame size, and update running totals:
+        // Compute the (compressed) frame size:
         frameSize -= dst.size;
+        frameSent(frameSize, outFlags);
+    }
+
+
+    // Alternative to nextFrameToSend that doesn't copy the data: if the frame would just be an
+    // uncompressed range of the payload, returns that range (and the payload, which owns it)
+    // after adding it to the checksum; the caller sends it followed by the checksum.
+    // Otherwise returns false and does nothing.
+    bool MessageOut::nextFrameToSendInPlace(Codec &codec, size_t maxSize,
+                                            alloc_slice &outOwner, slice &outData,
+                                            FrameFlags &outFlags)
+    {
+        if (isAck() || hasFlag(kCompressed) || maxSize <= Codec::kChecksumSize)
+            return false;
+        if (!_contents.payloadToSend(maxSize - Codec::kChecksumSize, outOwner, outData))
+            return false;
+        outFlags = flags();
+        codec.addToChecksum(outData);
+        _uncompressedBytesSent += (uint32_t)outData.size;
+        frameSent(outData.size + Codec::kChecksumSize, outFlags);
+        return true;
+    }
+
+
+    // Updates running totals, flags & state after a frame's been written.
+    void MessageOut::frameSent(size_t frameSize, FrameFlags &outFlags) {
         _bytesSent += (uint32_t)frameSize;
         _unackedBytes += (uint32_t)frameSize;
 
-        // Update flags & state:
         MessageProgress::State state;
         if (_contents.hasMoreDataToSend()) {
             outFlags = (FrameFlags)(outFlags | kMoreComing);
@@ -179,6 +205,19 @@ namespace litecore { namespace blip {
     }
 
 
+    // Takes up to `maxSize` bytes of the unsent payload, if there is any, without copying it.
+    bool MessageOut::Contents::payloadToSend(size_t maxSize,
+                                             alloc_slice &outOwner, slice &outData)
+    {
+        if (_unsentPayload.size == 0)
+            return false;
+        outOwner = _payload;
+        outData = slice(_unsentPayload.buf, min(maxSize, _unsentPayload.size));
+        _unsentPayload.moveStart(outData.size);
+        return true;
+    }
+
+
     // Is there more data to send?
     bool MessageOut::Contents::hasMoreDataToSend() const {
         return _unsentPayload.size > 0 || _unsentDataBuffer.size > 0 || _dataSource != nullptr;
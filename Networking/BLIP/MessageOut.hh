@@ -48,6 +48,9 @@ namespace litecore { namespace blip {
 
         void dontCompress()                     {_flags = (FrameFlags)(_flags & ~kCompressed);}
         void nextFrameToSend(Codec &codec, slice &dst, FrameFlags &outFlags);
+        bool nextFrameToSendInPlace(Codec &codec, size_t maxSize,
+                                    alloc_slice &outOwner, slice &outData,
+                                    FrameFlags &outFlags);
         void receivedAck(uint32_t byteCount);
         bool needsAck()                         {return _unackedBytes >= kMaxUnackedBytes;}
         MessageIn* createResponse();
@@ -61,11 +64,14 @@ namespace litecore { namespace blip {
     private:
         static const uint32_t kMaxUnackedBytes = 128000;
 
+        void frameSent(size_t frameSize, FrameFlags &outFlags);
+
         /** Manages the data (properties, body, data source) of a MessageOut. */
         class Contents {
         public:
             Contents(alloc_slice payload, MessageDataSource dataSource);
             slice& dataToSend();
+            bool payloadToSend(size_t maxSize, alloc_slice &outOwner, slice &outData);
             bool hasMoreDataToSend() const;
             void getPropsAndBody(slice &props, slice &body) const;
         private:
@@ -16,9 +16,11 @@ function(set_source_files_base)
         ${WEBSOCKETS_LOCATION}/WebSocketInterface.cc
         ${SUPPORT_LOCATION}/Actor.cc
         ${SUPPORT_LOCATION}/ActorProperty.cc
+        ${SUPPORT_LOCATION}/ActorStats.cc
 #       ${SUPPORT_LOCATION}/Async.cc
         ${SUPPORT_LOCATION}/Channel.cc
         ${SUPPORT_LOCATION}/Codec.cc
+        ${SUPPORT_LOCATION}/Snappy.cc
         ${SUPPORT_LOCATION}/Timer.cc
         PARENT_SCOPE
     )
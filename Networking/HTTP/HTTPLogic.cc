@@ -318,8 +318,19 @@ namespace litecore { namespace net {
                          "Server failed to upgrade connection"_sl);
         }
 
-        if (_webSocketProtocol && _responseHeaders["Sec-Websocket-Protocol"_sl] != _webSocketProtocol) {
-            return failure(WebSocketDomain, 403, "Server did not accept protocol"_sl);
+        if (_webSocketProtocol) {
+            // The server must have accepted one of the (comma-separated) protocols we offered:
+            slice accepted = _responseHeaders["Sec-Websocket-Protocol"_sl];
+            bool ok = false;
+            split(string_view((const char*)_webSocketProtocol.buf, _webSocketProtocol.size), ",",
+                  [&](string_view offer) {
+                while (!offer.empty() && offer.front() == ' ')
+                    offer.remove_prefix(1);
+                if (accepted && accepted == slice(offer.data(), offer.size()))
+                    ok = true;
+            });
+            if (!ok)
+                return failure(WebSocketDomain, 403, "Server did not accept protocol"_sl);
         }
 
         // Check the returned nonce:
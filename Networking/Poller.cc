@@ -25,14 +25,26 @@
 #include "sockpp/platform.h"
 #include "sockpp/tcp_acceptor.h"
 #include "sockpp/tcp_connector.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <errno.h>
 
 #ifndef _WIN32
+#include <fcntl.h>
 #include <unistd.h>
 #include <poll.h>
 #endif
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
 #define WSLog (*(LogDomain*)kC4WebSocketLog)
 
 namespace litecore { namespace net {
@@ -50,7 +62,36 @@ namespace litecore { namespace net {
     }
 
 
-    Poller::Poller() {
+    // One event-loop thread, and the Listeners of the file descriptors assigned to it.
+    class Poller::Loop {
+    public:
+        Loop();
+        ~Loop();
+        void addListener(int fd, Event, Listener);
+        void removeListeners(int fd);
+        void interrupt(int message);
+        void start(unsigned index);
+        void stop();
+
+    private:
+        bool poll();
+        void handleInterrupt(int message, bool &result);
+        void callAndRemoveListener(int fd, Event);
+
+        std::mutex _mutex;
+        std::unordered_map<socket_t, std::array<Listener,2>> _listeners;
+        std::thread _thread;
+        std::atomic_bool _waiting {false};
+
+        socket_t _interruptReadFD  {INVALID_SOCKET}; // Pipe used to interrupt poll()
+        socket_t _interruptWriteFD {INVALID_SOCKET}; // Other end of the pipe
+#ifdef __linux__
+        int _epollFD {-1};                           // The epoll instance
+#endif
+    };
+
+
+    Poller::Loop::Loop() {
         // To allow poll() system calls to be interrupted, we create a pipe and have poll()
         // watch its read end. Then writing to the pipe will cause poll() to return. As a bonus,
         // we can use the data written to the pipe as a message, to let waitForIO know what happened.
@@ -75,10 +116,26 @@ namespace litecore { namespace net {
         _interruptReadFD = readSock.release();
         _interruptWriteFD = writeSock.release();
 #endif
+
+#ifdef __linux__
+        // The pipe is edge-triggered like everything else, so its read end has to be
+        // non-blocking, to let it be drained completely after each event.
+        ::fcntl(_interruptReadFD, F_SETFL, ::fcntl(_interruptReadFD, F_GETFL) | O_NONBLOCK);
+        _epollFD = ::epoll_create1(EPOLL_CLOEXEC);
+        if (_epollFD < 0)
+            throwSocketError();
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.fd = _interruptReadFD;
+        if (::epoll_ctl(_epollFD, EPOLL_CTL_ADD, _interruptReadFD, &ev) < 0)
+            throwSocketError();
+#endif
     }
 
 
-    Poller::~Poller() {
+    Poller::Loop::~Loop() {
+        if (_thread.joinable())
+            stop();
         if (_interruptReadFD >= 0) {
 #ifndef _WIN32
             ::close(_interruptReadFD);
@@ -88,34 +145,44 @@ namespace litecore { namespace net {
             ::closesocket(_interruptWriteFD);
 #endif
         }
+#ifdef __linux__
+        if (_epollFD >= 0)
+            ::close(_epollFD);
+#endif
     }
 
 
-    /*static*/ Poller& Poller::instance() {
-        static Poller* sInstance = new Poller(true);
-        return *sInstance;
+    void Poller::Loop::start(unsigned index) {
+        _thread = thread([=] {
+            string name = "CBL Networking";
+            if (index > 0)
+                name += " " + to_string(index + 1);
+            SetThreadName(name.c_str());
+            while (poll())
+                ;
+        });
     }
 
 
-    void Poller::addListener(int fd, Event event, Listener listener) {
-        Assert(fd >= 0);
-        lock_guard<mutex> lock(_mutex);
-        _listeners[fd][event] = move(listener);
-        if (_waiting)
-            interrupt(0);
+    void Poller::Loop::stop() {
+        interrupt(-1);
+        _thread.join();
     }
 
 
-    void Poller::removeListeners(int fd) {
-        Assert(fd >= 0);
+    void Poller::Loop::removeListeners(int fd) {
         lock_guard<mutex> lock(_mutex);
         if (auto i = _listeners.find(fd); i != _listeners.end())
             _listeners.erase(i);
+#ifdef __linux__
+        // (The fd may already have been closed, which removes it from the epoll set)
+        ::epoll_ctl(_epollFD, EPOLL_CTL_DEL, fd, nullptr);
+#endif
         // no need to interrupt the poll thread
     }
 
 
-    void Poller::callAndRemoveListener(int fd, Event event) {
+    void Poller::Loop::callAndRemoveListener(int fd, Event event) {
         Listener listener;
         {
             lock_guard<mutex> lock(_mutex);
@@ -133,7 +200,7 @@ namespace litecore { namespace net {
     }
 
 
-    void Poller::interrupt(int message) {
+    void Poller::Loop::interrupt(int message) {
 #ifdef WIN32
         if(::send(_interruptWriteFD, (const char *)&message, sizeof(message), 0) < 0)
 #else
@@ -143,26 +210,86 @@ namespace litecore { namespace net {
     }
 
 
-    Poller& Poller::start() {
-        _thread = thread([=] {
-            SetThreadName("CBL Networking");
-            while (poll())
-                ;
-        });
-        _thread.detach();
-        return *this;
+    void Poller::Loop::handleInterrupt(int message, bool &result) {
+        LogDebug(WSLog, "Poller: interruption %d", message);
+        if (message < 0) {
+            // Receiving a negative message aborts the loop
+            result = false;
+        } else if (message > 0) {
+            // A positive message is a file descriptor to call:
+            callAndRemoveListener(message, kReadable);
+            callAndRemoveListener(message, kWriteable);
+        }
     }
 
 
-    void Poller::stop() {
-        interrupt(-1);
-        _thread.join();
+#ifdef __linux__
+
+    // Each fd stays in the epoll set, edge-triggered, for as long as it has Listeners, so
+    // there's nothing to rebuild per iteration. Registering a Listener re-arms the fd with
+    // EPOLL_CTL_MOD, which makes the kernel re-check its readiness; that way an edge that
+    // happened while there was no Listener isn't lost.
+    void Poller::Loop::addListener(int fd, Event event, Listener listener) {
+        lock_guard<mutex> lock(_mutex);
+        auto &listeners = _listeners[fd];
+        listeners[event] = move(listener);
+
+        epoll_event ev = {};
+        ev.events = EPOLLET;
+        if (listeners[kReadable])
+            ev.events |= EPOLLIN;
+        if (listeners[kWriteable])
+            ev.events |= EPOLLOUT;
+        ev.data.fd = fd;
+        if (::epoll_ctl(_epollFD, EPOLL_CTL_MOD, fd, &ev) < 0) {
+            if (errno != ENOENT || ::epoll_ctl(_epollFD, EPOLL_CTL_ADD, fd, &ev) < 0)
+                throwSocketError();
+        }
+    }
+
+
+    bool Poller::Loop::poll() {
+        static constexpr int kMaxEvents = 64;
+        epoll_event events[kMaxEvents];
+        int n;
+        while ((n = ::epoll_wait(_epollFD, events, kMaxEvents, -1)) < 0) {
+            if (errno != EINTR)
+                return false;
+        }
+
+        bool result = true;
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            uint32_t revents = events[i].events;
+            if (fd == _interruptReadFD) {
+                // Interrupts -- read all the messages from the pipe:
+                int message;
+                while (::read(_interruptReadFD, &message, sizeof(message)) == sizeof(message))
+                    handleInterrupt(message, result);
+            } else {
+                LogDebug(WSLog, "Poller: fd %d got event 0x%02x", fd, revents);
+                if (revents & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                    callAndRemoveListener(fd, kReadable);
+                if (revents & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                    callAndRemoveListener(fd, kWriteable);
+            }
+        }
+        return result;
+    }
+
+#else
+
+    void Poller::Loop::addListener(int fd, Event event, Listener listener) {
+        lock_guard<mutex> lock(_mutex);
+        _listeners[fd][event] = move(listener);
+        if (_waiting)
+            interrupt(0);
     }
 
 #ifdef WIN32
     // WSAPoll has proven to be weirdly unreliable, so fall back
     // to a select based implementation
-    bool Poller::poll() {
+    bool Poller::Loop::poll() {
         fd_set fds_read, fds_write, fds_err;
         SOCKET maxfd = -1;
         vector<SOCKET> all_fds;
@@ -216,15 +343,7 @@ namespace litecore { namespace net {
         if(FD_ISSET(_interruptReadFD, &fds_read)) {
             int message;
             ::recv(_interruptReadFD, (char *)&message, sizeof(message), 0);
-            LogDebug(WSLog, "Poller: interruption %d", message);
-            if (message < 0) {
-                // Receiving a negative message aborts the loop
-                result = false;
-            } else if (message > 0) {
-                // A positive message is a file descriptor to call:
-                callAndRemoveListener(message, kReadable);
-                callAndRemoveListener(message, kWriteable);
-            }
+            handleInterrupt(message, result);
         }
 
         for (SOCKET s : all_fds) {
@@ -246,7 +365,7 @@ namespace litecore { namespace net {
 
 #else
 
-    bool Poller::poll() {
+    bool Poller::Loop::poll() {
         // Create the pollfd vector:
         vector<pollfd> pollfds;
         {
@@ -281,15 +400,7 @@ namespace litecore { namespace net {
                     // This is an interrupt -- read the byte from the pipe:
                     int message;
                     ::read(_interruptReadFD, &message, sizeof(message));
-                    LogDebug(WSLog, "Poller: interruption %d", message);
-                    if (message < 0) {
-                        // Receiving a negative message aborts the loop
-                        result = false;
-                    } else if (message > 0) {
-                        // A positive message is a file descriptor to call:
-                        callAndRemoveListener(message, kReadable);
-                        callAndRemoveListener(message, kWriteable);
-                    }
+                    handleInterrupt(message, result);
                 } else {
                     LogDebug(WSLog, "Poller: fd %d got event 0x%02x", fd, entry.revents);
                     if (entry.revents & (POLLIN | POLLERR | POLLHUP))
@@ -305,6 +416,72 @@ namespace litecore { namespace net {
         return result;
     }
 
+#endif // WIN32
+
+#endif // __linux__
+
+
+#pragma mark - POLLER:
+
+
+    static unsigned defaultThreadCount() {
+#ifdef __linux__
+        return max(1u, min(4u, thread::hardware_concurrency()));
+#else
+        return 1;
 #endif
+    }
+
+
+    Poller::Poller(unsigned threadCount) {
+        Assert(threadCount > 0);
+        for (unsigned i = 0; i < threadCount; ++i)
+            _loops.emplace_back(new Loop());
+    }
+
+
+    Poller::~Poller() = default;
+
+
+    /*static*/ Poller& Poller::instance() {
+        static Poller* sInstance = &(new Poller(defaultThreadCount()))->start();
+        return *sInstance;
+    }
+
+
+    // All the Listeners of an fd go to the same Loop, so they're called in order.
+    Poller::Loop& Poller::loopFor(int fd) {
+        return *_loops[unsigned(fd) % _loops.size()];
+    }
+
+
+    void Poller::addListener(int fd, Event event, Listener listener) {
+        Assert(fd >= 0);
+        loopFor(fd).addListener(fd, event, move(listener));
+    }
+
+
+    void Poller::removeListeners(int fd) {
+        Assert(fd >= 0);
+        loopFor(fd).removeListeners(fd);
+    }
+
+
+    void Poller::interrupt(int fd) {
+        loopFor(fd).interrupt(fd);
+    }
+
+
+    Poller& Poller::start() {
+        for (unsigned i = 0; i < _loops.size(); ++i)
+            _loops[i]->start(i);
+        return *this;
+    }
+
+
+    void Poller::stop() {
+        for (auto &loop : _loops)
+            loop->stop();
+    }
 
 } }
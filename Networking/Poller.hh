@@ -5,12 +5,9 @@
 //
 
 #pragma once
-#include <array>
-#include <atomic>
 #include <functional>
-#include <mutex>
-#include <thread>
-#include <unordered_map>
+#include <memory>
+#include <vector>
 #include "sockpp/platform.h"
 #include "sockpp/socket.h"
 
@@ -20,10 +17,14 @@ namespace litecore { namespace net {
 	// Unix has them in this namespace)
 	using namespace sockpp; 
 	
-    /** Enables async I/O by running `poll` on a background thread. */
+    /** Enables async I/O by watching file descriptors on background threads.
+        On Linux it uses edge-triggered `epoll`, and file descriptors are sharded (by number)
+        across several event-loop threads; all the Listeners of a file descriptor are called
+        on the same thread. Other platforms use `poll` or `select`, by default on one thread. */
     class Poller {
     public:
-        /// The single shared instance (all that's necessary in normal use)
+        /// The single shared instance (all that's necessary in normal use.) On Linux it has one
+        /// event-loop thread per CPU core, up to 4.
         static Poller& instance();
 
         enum Event {
@@ -44,24 +45,21 @@ namespace litecore { namespace net {
         /// Removes all Listeners for this file descriptor.
         void removeListeners(int fd);
 
+        /// The number of event-loop threads.
+        unsigned threadCount() const        {return unsigned(_loops.size());}
+
         // Manual controls over instances, starting and stopping -- for testing
-        Poller();
+        explicit Poller(unsigned threadCount =1);
         ~Poller();
         Poller& start();
         void stop();
 
     private:
-        Poller(bool startNow)               :Poller() {if (startNow) start();}
-        bool poll();
-        void callAndRemoveListener(int fd, Event);
-        
-        std::mutex _mutex;
-        std::unordered_map<socket_t, std::array<Listener,2>> _listeners;
-        std::thread _thread;
-        std::atomic_bool _waiting {false};
+        class Loop;
+
+        Loop& loopFor(int fd);
 
-        socket_t _interruptReadFD  {INVALID_SOCKET}; // Pipe used to interrupt poll()
-        socket_t _interruptWriteFD {INVALID_SOCKET}; // Other end of the pipe
+        std::vector<std::unique_ptr<Loop>> _loops;  // Event loops, each with its own thread
     };
 
 } }
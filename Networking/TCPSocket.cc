@@ -297,7 +297,7 @@ namespace litecore { namespace net {
             return;
         if (_usuallyTrue(_unreadLen + data.size > _unread.size))
             _unread.resize(_unreadLen + data.size);
-        memcpy((void*)&_unread[data.size], &_unread[0], _unreadLen);
+        memmove((void*)&_unread[data.size], &_unread[0], _unreadLen);
         memcpy((void*)&_unread[0], data.buf, data.size);
         _unreadLen += data.size;
     }
@@ -344,8 +344,8 @@ namespace litecore { namespace net {
         slice result(alloced.buf, size_t(0));
 
         while (true) {
-            // Read more bytes:
-            ssize_t n = _read((void*)result.end(), alloced.size - result.size);
+            // Read more bytes (starting with any that were read ahead):
+            ssize_t n = read((void*)result.end(), alloced.size - result.size);
             if (n < 0)
                 return nullslice;
             if (n == 0) {
@@ -379,7 +379,9 @@ namespace litecore { namespace net {
 
     bool TCPSocket::readHTTPBody(const Headers &headers, alloc_slice &body) {
         int64_t contentLength = headers.getInt("Content-Length"_sl, -1);
-        if (contentLength >= 0) {
+        if (headers["Transfer-Encoding"_sl].caseEquivalent("chunked"_sl)) {
+            return readChunkedHTTPBody(body);
+        } else if (contentLength >= 0) {
             // Read exactly Content-Length bytes:
             if (contentLength > 0) {
                 body.resize(size_t(contentLength));
@@ -409,6 +411,65 @@ namespace litecore { namespace net {
     }
 
 
+    // Reads a body with "Transfer-Encoding: chunked": each chunk is preceded by a line giving its
+    // size in hex, and followed by CRLF; a zero-size chunk (plus optional trailers) ends it.
+    bool TCPSocket::readChunkedHTTPBody(alloc_slice &body) {
+        body.resize(1024);
+        size_t length = 0;
+        while (true) {
+            alloc_slice sizeLine = readToDelimiter("\r\n"_sl);
+            if (!sizeLine) {
+                body.reset();
+                return false;
+            }
+            string sizeStr(sizeLine);
+            size_t chunkSize = strtoul(sizeStr.c_str(), nullptr, 16);    // (ignores extensions)
+            if (chunkSize == 0)
+                break;
+            if (length + chunkSize > body.size)
+                body.resize(max(2 * body.size, length + chunkSize));
+            alloc_slice crlf;
+            if (readExactly((void*)&body[length], chunkSize) < ssize_t(chunkSize)
+                    || !(crlf = readToDelimiter("\r\n"_sl)) || crlf.size != 2) {
+                body.reset();
+                return false;
+            }
+            length += chunkSize;
+        }
+        // Skip any trailer headers, up to the final empty line:
+        while (true) {
+            alloc_slice trailer = readToDelimiter("\r\n"_sl);
+            if (!trailer) {
+                body.reset();
+                return false;
+            } else if (trailer.size == 2) {
+                break;
+            }
+        }
+        body.resize(length);
+        return true;
+    }
+
+
+    bool TCPSocket::hasReadableData() {
+        if (_unreadLen > 0)
+            return true;
+        if (_eofOnRead)
+            return false;
+        bool wasNonBlocking = _nonBlocking;
+        if (!wasNonBlocking && !setNonBlocking(true))
+            return false;
+        uint8_t buf[4096];
+        ssize_t n = _read(buf, sizeof(buf));
+        if (!wasNonBlocking)
+            setNonBlocking(false);
+        if (n <= 0)
+            return false;
+        pushUnread(slice(buf, n));
+        return true;
+    }
+
+
 #pragma mark - NONBLOCKING / SELECT:
 
 
@@ -456,6 +517,12 @@ namespace litecore { namespace net {
     }
 
 
+    void TCPSocket::cancelCallbacks() {
+        if (fileDescriptor() >= 0)
+            Poller::instance().removeListeners(fileDescriptor());
+    }
+
+
     void TCPSocket::interrupt() {
         if(fileDescriptor() >= 0) {
             // If an interrupt is called with an invalid socket, the poller's
@@ -83,11 +83,17 @@ namespace litecore::net {
                                             size_t maxSize =kMaxDelimitedReadSize) MUST_USE_RESULT;
 
         /// Reads an HTTP body, given the headers.
-        /// If there's a Content-Length header, reads that many bytes, otherwise reads till EOF.
+        /// If the body has chunked transfer encoding, reads and decodes the chunks; else if
+        /// there's a Content-Length header, reads that many bytes, otherwise reads till EOF.
         bool readHTTPBody(const websocket::Headers &headers, fleece::alloc_slice &body) MUST_USE_RESULT;
 
         bool atReadEOF() const                          {return _eofOnRead;}
 
+        /// Returns true if data can be read without blocking: data already read ahead (like a
+        /// pipelined HTTP request), or data available right now from the socket or its TLS layer.
+        /// Returns false at EOF (see \ref atReadEOF) or on error.
+        bool hasReadableData();
+
         //-------- WRITING:
 
         /// Writes to the socket and returns the number of bytes written:
@@ -117,6 +123,9 @@ namespace litecore::net {
         void onWriteable(std::function<void()>);
         void interrupt();
 
+        /// Cancels any pending \ref onReadable or \ref onWriteable notifications.
+        void cancelCallbacks();
+
     protected:
         bool setSocket(std::unique_ptr<sockpp::stream_socket>);
         void setError(C4ErrorDomain, int code, slice message =fleece::nullslice);
@@ -129,6 +138,7 @@ namespace litecore::net {
 
     private:
         bool _setTimeout(double secs);
+        bool readChunkedHTTPBody(fleece::alloc_slice &body);
         sockpp::stream_socket* actualSocket() const;
 
         std::unique_ptr<sockpp::stream_socket> _socket;     // The TCP (or TLS) socket
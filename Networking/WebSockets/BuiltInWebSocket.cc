@@ -28,6 +28,7 @@
 #include "StringUtil.hh"
 #include "ThreadUtil.hh"
 #include "sockpp/exception.h"
+#include <algorithm>
 #include <string>
 
 using namespace litecore;
@@ -421,6 +422,22 @@ namespace litecore { namespace websocket {
     }
 
 
+    // Same, but the message is made of pieces of other buffers, which are written to the
+    // socket in place (with a vectored write) instead of being copied together.
+    void BuiltInWebSocket::sendByteRanges(vector<SharedSlice> pieces) {
+        unique_lock<mutex> lock(_outboxMutex);
+        bool first = _outbox.empty();
+        for (auto &piece : pieces) {
+            if (piece.bytes.size == 0)
+                continue;
+            _outbox.emplace_back(piece.bytes);
+            _outboxAlloced.emplace_back(move(piece.owner));
+        }
+        if (first && !_outbox.empty())
+            awaitWriteable();
+    }
+
+
     void BuiltInWebSocket::awaitWriteable() {
         logDebug("**** Waiting to write to socket");
         //DebugAssert(!_outbox.empty());            // can't do this safely (data race)
@@ -430,12 +447,14 @@ namespace litecore { namespace websocket {
 
     void BuiltInWebSocket::writeToSocket() {
         try {
-            // Copy the outbox -- it's just a vector of {ptr,size} pairs, no biggie -- so we don't have
-            // to hold the mutex while writing. (Even though the write won't actually block.)
-            vector<slice> outboxSnapshot;
+            // Copy (the start of) the outbox -- it's just a vector of {ptr,size} pairs, no biggie --
+            // so we don't have to hold the mutex while writing. (Even though the write won't
+            // actually block.) The snapshot vector is reused, to avoid allocating on every write.
+            vector<slice> &outboxSnapshot = _outboxSnapshot;
             {
                 unique_lock<mutex> lock(_outboxMutex);
-                outboxSnapshot = _outbox;
+                outboxSnapshot.assign(_outbox.begin(),
+                                      _outbox.begin() + min(_outbox.size(), kMaxWriteRanges));
             }
             size_t beforeSize = outboxSnapshot.size();
             logDebug("Socket is writeable now; I have %zu messages to write", beforeSize);
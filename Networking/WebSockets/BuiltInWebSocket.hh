@@ -52,6 +52,7 @@ namespace litecore { namespace websocket {
         // Implementations of WebSocketImpl abstract methods:
         virtual void closeSocket() override;
         virtual void sendBytes(fleece::alloc_slice) override;
+        virtual void sendByteRanges(std::vector<SharedSlice>) override;
         virtual void receiveComplete(size_t byteCount) override;
         virtual void requestClose(int status, fleece::slice message) override;
 
@@ -82,6 +83,10 @@ namespace litecore { namespace websocket {
         // Size of the buffer allocated for reading from the socket.
         static constexpr size_t kReadBufferSize = 32 * 1024;
 
+        // Max number of outbox ranges passed to one (vectored) socket write; must not exceed
+        // the platform's IOV_MAX.
+        static constexpr size_t kMaxWriteRanges = 256;
+
         c4::ref<C4Database> _database;                      // The database (used only for cookies)
         std::unique_ptr<net::TCPSocket> _socket;            // The TCP socket
         Retained<BuiltInWebSocket> _selfRetain;             // Keeps me alive while connected
@@ -91,6 +96,7 @@ namespace litecore { namespace websocket {
         std::vector<fleece::slice> _outbox;                 // Byte ranges to be sent by writer
         std::vector<fleece::alloc_slice> _outboxAlloced;    // Same, but retains the heap data
         std::mutex _outboxMutex;                            // Locking for outbox
+        std::vector<fleece::slice> _outboxSnapshot;         // Ranges being written (writer only)
 
         std::atomic<size_t> _curReadCapacity {kReadCapacity}; // # bytes I can read from socket
         fleece::alloc_slice _readBuffer;                    // Buffer used by readFromSocket().
@@ -33,6 +33,9 @@ namespace litecore { namespace websocket {
 
     static constexpr size_t kSendBufferSize = 64 * 1024;
 
+    // Maximum size of a frame header: 10 bytes, plus a 4-byte mask from a client
+    static constexpr size_t kMaxHeaderSize = 14;
+
     // Timeout for WebSocket connection (until HTTP response received)
     constexpr long WebSocketImpl::kConnectTimeoutSecs;
 
@@ -142,7 +145,7 @@ namespace litecore { namespace websocket {
             if (_closeSent && opcode != CLOSE)
                 return false;
             if (_framing) {
-                frame.resize(message.size + 10); // maximum space needed
+                frame.resize(message.size + kMaxHeaderSize);
                 size_t newSize;
                 if (role() == Role::Server) {
                     newSize = ServerProtocol::formatMessage((char*)frame.buf,
@@ -160,6 +163,7 @@ namespace litecore { namespace websocket {
                 DebugAssert(opcode == uWS::BINARY);
                 frame = message;
             }
+            _bytesCopied += message.size;
             _bufferedBytes += frame.size;
             writeable = (_bufferedBytes <= kSendBufferSize);
         }
@@ -170,6 +174,78 @@ namespace litecore { namespace websocket {
     }
 
 
+    bool WebSocketImpl::sendPieces(vector<SharedSlice> pieces, bool binary) {
+        size_t size = 0;
+        for (auto &piece : pieces)
+            size += piece.bytes.size;
+        logVerbose("Sending %zu-byte message in %zu pieces", size, pieces.size());
+        auto opcode = binary ? uWS::BINARY : uWS::TEXT;
+        bool writeable;
+        {
+            lock_guard<std::mutex> lock(_mutex);
+            if (_closeSent)
+                return false;
+            if (_framing) {
+                if (role() == Role::Server) {
+                    // A server doesn't mask its frames, so the pieces can be sent as-is after
+                    // a separate header:
+                    alloc_slice header(kMaxHeaderSize);
+                    header.shorten(ServerProtocol::formatMessage((char*)header.buf,
+                                                                 (const char*)header.buf, 0,
+                                                                 opcode, size, false));
+                    size += header.size;
+                    pieces.insert(pieces.begin(), SharedSlice{header, header});
+                } else {
+                    // A client has to mask the payload (RFC 6455 sec. 5.3). Scratch pieces are
+                    // masked in place; only the others have to be copied to do that:
+                    alloc_slice header(kMaxHeaderSize);
+                    header.shorten(ClientProtocol::formatMessage((char*)header.buf,
+                                                                 (const char*)header.buf, 0,
+                                                                 opcode, size, false));
+                    auto mask = (const uint8_t*)header.buf + header.size - 4;
+                    size_t copySize = 0;
+                    for (auto &piece : pieces) {
+                        if (!piece.scratch)
+                            copySize += piece.bytes.size;
+                    }
+                    alloc_slice copies;
+                    if (copySize > 0)
+                        copies = alloc_slice(copySize);
+                    auto copyDst = (uint8_t*)copies.buf;
+                    size_t i = 0;
+                    for (auto &piece : pieces) {
+                        auto src = (const uint8_t*)piece.bytes.buf;
+                        auto dst = (uint8_t*)src;
+                        if (!piece.scratch) {
+                            dst = copyDst;
+                            copyDst += piece.bytes.size;
+                            piece = {copies, slice(dst, piece.bytes.size), true};
+                        }
+                        for (size_t n = 0; n < piece.bytes.size; ++n)
+                            dst[n] = src[n] ^ mask[i++ & 3];
+                    }
+                    _bytesCopied += copySize;
+                    size += header.size;
+                    pieces.insert(pieces.begin(), SharedSlice{header, header});
+                }
+            }
+            _bufferedBytes += size;
+            writeable = (_bufferedBytes <= kSendBufferSize);
+        }
+        // Release the lock before calling sendByteRanges, as in sendOp.
+        sendByteRanges(move(pieces));
+        return writeable;
+    }
+
+
+    void WebSocketImpl::sendByteRanges(vector<SharedSlice> pieces) {
+        alloc_slice bytes = SharedSlice::join(pieces);
+        if (pieces.size() > 1)
+            _bytesCopied += bytes.size;
+        sendBytes(bytes);
+    }
+
+
     void WebSocketImpl::onWriteComplete(size_t size) {
         bool notify, disconnect;
         {
@@ -501,8 +577,8 @@ namespace litecore { namespace websocket {
 
                 _timeConnected.stop();
                 double t = _timeConnected.elapsed();
-                logInfo("sent %" PRIu64 " bytes, rcvd %" PRIu64 ", in %.3f sec (%.0f/sec, %.0f/sec)",
-                    _bytesSent, _bytesReceived, t,
+                logInfo("sent %" PRIu64 " bytes (%" PRIu64 " copied), rcvd %" PRIu64 ", in %.3f sec (%.0f/sec, %.0f/sec)",
+                    _bytesSent, uint64_t(_bytesCopied), _bytesReceived, t,
                     _bytesSent/t, _bytesReceived/t);
             } else {
                 logError("WebSocket failed to connect! (reason=%-s %d)",
@@ -55,6 +55,7 @@ namespace litecore { namespace websocket {
 
         virtual void connect() override;
         virtual bool send(fleece::slice message, bool binary =true) override;
+        virtual bool sendPieces(std::vector<SharedSlice>, bool binary =true) override;
         virtual void close(int status =kCodeNormal, fleece::slice message =fleece::nullslice) override;
 
         // Concrete socket implementation needs to call these:
@@ -79,6 +80,10 @@ namespace litecore { namespace websocket {
         // These methods have to be implemented in subclasses:
         virtual void closeSocket() =0;
         virtual void sendBytes(fleece::alloc_slice) =0;
+
+        /** Sends the concatenation of the pieces. The default implementation copies them into
+            one buffer and calls `sendBytes(alloc_slice)`; override it to write them directly. */
+        virtual void sendByteRanges(std::vector<SharedSlice>);
         virtual void receiveComplete(size_t byteCount) =0;
         virtual void requestClose(int status, fleece::slice message) =0;
 
@@ -131,6 +136,7 @@ namespace litecore { namespace websocket {
         // Connection diagnostics, logged on close:
         fleece::Stopwatch _timeConnected {false};           // Time since socket opened
         uint64_t _bytesSent {0}, _bytesReceived {0};// Total byte count sent/received
+        std::atomic<uint64_t> _bytesCopied {0};     // Total bytes of messages copied to send
     };
 
 } }
@@ -61,6 +61,27 @@ namespace litecore { namespace websocket {
     }
 
 
+    bool WebSocket::sendPieces(vector<SharedSlice> pieces, bool binary) {
+        return send(SharedSlice::join(pieces), binary);
+    }
+
+
+    alloc_slice SharedSlice::join(const vector<SharedSlice> &pieces) {
+        if (pieces.size() == 1 && pieces[0].owner == pieces[0].bytes)
+            return pieces[0].owner;
+        size_t size = 0;
+        for (auto &piece : pieces)
+            size += piece.bytes.size;
+        alloc_slice result(size);
+        uint8_t *dst = (uint8_t*)result.buf;
+        for (auto &piece : pieces) {
+            memcpy(dst, piece.bytes.buf, piece.bytes.size);
+            dst += piece.bytes.size;
+        }
+        return result;
+    }
+
+
     const char* CloseStatus::reasonName() const  {
         static const char* kReasonNames[] = {"WebSocket/HTTP status", "errno",
             "Network error", "Exception", "Unknown error"};
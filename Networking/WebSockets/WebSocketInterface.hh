@@ -25,6 +25,7 @@
 #include <atomic>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace litecore { namespace websocket {
     using fleece::RefCounted;
@@ -119,6 +120,19 @@ namespace litecore { namespace websocket {
     using URL = fleece::alloc_slice;
 
 
+    /** A range of bytes inside a heap block, which it retains. Lets a message be sent as a list
+        of pieces of existing buffers, without copying them into one. */
+    struct SharedSlice {
+        fleece::alloc_slice owner;              ///< The heap block containing `bytes`
+        fleece::slice       bytes;              ///< The bytes to send
+        bool                scratch {false};    ///< If true, the WebSocket may modify `bytes`
+
+        /** Concatenates the pieces into one heap block. If there's only one piece and it covers
+            its entire owner, returns the owner without copying. */
+        static fleece::alloc_slice join(const std::vector<SharedSlice>&);
+    };
+
+
     /** Abstract class representing a WebSocket connection. */
     class WebSocket : public RefCounted, public fleece::InstanceCounted {
     public:
@@ -139,6 +153,12 @@ namespace litecore { namespace websocket {
             then stop sending until it gets an onWebSocketWriteable delegate call. */
         virtual bool send(fleece::slice message, bool binary =true) =0;
 
+        /** Sends a message made of the concatenation of `pieces`; otherwise like `send`.
+            Implementations that can write the pieces to the network as-is (scatter/gather)
+            should override this; the default implementation concatenates them and calls
+            `send`. */
+        virtual bool sendPieces(std::vector<SharedSlice> pieces, bool binary =true);
+
         /** Closes the WebSocket. Callable from any thread. */
         virtual void close(int status =kCodeNormal, fleece::slice message =fleece::nullslice) =0;
         
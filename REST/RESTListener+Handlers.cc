@@ -21,9 +21,11 @@
 #include "c4Transaction.hh"
 #include "c4Private.h"
 #include "c4DocEnumerator.h"
+#include "c4Query.h"
 #include "c4Document+Fleece.h"
 #include "c4Replicator.h"
 #include "Server.hh"
+#include "ActorStats.hh"
 #include "StringUtil.hh"
 #include "c4ExceptionUtils.hh"
 #include <functional>
@@ -78,6 +80,16 @@ namespace litecore { namespace REST {
     }
 
 
+    void RESTListener::handleActorStats(RequestResponse &rq) {
+        // Runtime stats of all Actors (replicator workers, BLIP connections...):
+        auto &json = rq.jsonEncoder();
+        json.beginArray();
+        for (auto &stats : actor::MailboxStats::snapshotAll())
+            stats.writeTo(json);
+        json.endArray();
+    }
+
+
 #pragma mark - DATABASE HANDLERS:
 
     
@@ -91,7 +103,7 @@ namespace litecore { namespace REST {
         auto &json = rq.jsonEncoder();
         json.beginDict();
         json.writeKey("db_name"_sl);
-        json.writeString(rq.path(0));
+        json.writeString(rq.pathParam("db"));
         json.writeKey("db_uuid"_sl);
         json.writeString(uuidStr);
         json.writeKey("doc_count"_sl);
@@ -107,7 +119,7 @@ namespace litecore { namespace REST {
     void RESTListener::handleCreateDatabase(RequestResponse &rq) {
         if (!_allowCreateDB)
             return rq.respondWithStatus(HTTPStatus::Forbidden, "Cannot create databases");
-        string dbName = rq.path(0);
+        string dbName = rq.pathParam("db");
         if (databaseNamed(dbName))
             return rq.respondWithStatus(HTTPStatus::PreconditionFailed, "Database exists");
         FilePath path;
@@ -128,7 +140,7 @@ namespace litecore { namespace REST {
     void RESTListener::handleDeleteDatabase(RequestResponse &rq, C4Database *db) {
         if (!_allowDeleteDB)
             return rq.respondWithStatus(HTTPStatus::Forbidden, "Cannot delete databases");
-        string name = rq.path(0);
+        string name = rq.pathParam("db");
         if (!unregisterDatabase(name))
             return rq.respondWithStatus(HTTPStatus::NotFound);
         C4Error err;
@@ -142,37 +154,98 @@ namespace litecore { namespace REST {
 #pragma mark - DOCUMENT HANDLERS:
 
 
+    // Reads a key parameter like `startkey`, which CouchDB specifies as JSON, i.e. a quoted
+    // string; an unquoted value is taken literally. Returns false if the JSON is invalid.
+    static bool getKeyQuery(RequestResponse &rq, const char *param, const char *altParam,
+                            string &outKey)
+    {
+        outKey = rq.query(param);
+        if (outKey.empty())
+            outKey = rq.query(altParam);
+        if (hasPrefix(outKey, "\"")) {
+            Doc doc = Doc::fromJSON(outKey);
+            slice key = doc.root().asString();
+            if (!key)
+                return false;
+            outKey = string(key);
+        }
+        return true;
+    }
+
+
+    // Streams the rows written by `writeRow` as a JSON object `{"rows":[...]}`, sending them to
+    // the client as they're generated instead of buffering the whole response. `writeRow` is
+    // called repeatedly to encode the next row, until it returns false.
+    static void streamRows(RequestResponse &rq, function_ref<bool(JSONEncoder&)> writeRow) {
+        rq.setHeader("Content-Type", "application/json");
+        rq.beginStreaming();
+        rq.write("{\"rows\":[");
+        JSONEncoder json;
+        bool first = true;
+        while (!rq.sendFailed() && writeRow(json)) {
+            alloc_slice row = json.finish();
+            json.reset();
+            if (!first)
+                rq.write(",");
+            first = false;
+            rq.write(row);
+        }
+        rq.write("]}");
+    }
+
+
     void RESTListener::handleGetAllDocs(RequestResponse &rq, C4Database *db) {
         // Apply options:
-        C4EnumeratorOptions options;
+        C4EnumeratorOptions options = {};
+        C4DocIDRange range = {};
         options.flags = kC4IncludeNonConflicted;
-        if (rq.boolQuery("descending"))
+        bool descending = rq.boolQuery("descending");
+        if (descending)
             options.flags |= kC4Descending;
         bool includeDocs = rq.boolQuery("include_docs");
         if (includeDocs)
             options.flags |= kC4IncludeBodies;
-        int64_t skip = rq.intQuery("skip", 0);
+        int64_t skip = max(rq.intQuery("skip", 0), int64_t(0));
         int64_t limit = rq.intQuery("limit", INT64_MAX);
-        // TODO: Implement startkey, endkey, etc.
+        if (limit <= 0)
+            limit = 0;
+        else if (limit < INT64_MAX - skip)
+            range.limit = uint64_t(skip + limit);       // (skipped rows are enumerated too)
+
+        // The key range is found by the enumerator. When descending, it starts at the max key:
+        string startKey, endKey;
+        if (!getKeyQuery(rq, "startkey", "start_key", startKey)
+                || !getKeyQuery(rq, "endkey", "end_key", endKey))
+            return rq.respondWithStatus(HTTPStatus::BadRequest, "Invalid startkey or endkey");
+        C4String &startBound = descending ? range.maxDocID : range.minDocID;
+        C4String &endBound = descending ? range.minDocID : range.maxDocID;
+        if (!startKey.empty())
+            startBound = slice(startKey);
+        if (!endKey.empty()) {
+            endBound = slice(endKey);
+            bool &excludeEnd = descending ? range.excludeMinDocID : range.excludeMaxDocID;
+            excludeEnd = !rq.boolQuery("inclusive_end", true);
+        }
 
         // Create enumerator:
-        C4Error err;
-        c4::ref<C4DocEnumerator> e = c4db_enumerateAllDocs(db, &options, &err);
+        C4Error err = {};
+        c4::ref<C4DocEnumerator> e = c4db_enumerateDocIDRange(db, &range, &options, &err);
         if (!e)
             return rq.respondWithError(err);
 
-        // Enumerate, building JSON:
-        auto &json = rq.jsonEncoder();
-        json.beginDict();
-        json.writeKey("rows"_sl);
-        json.beginArray();
-        while (c4enum_next(e, &err)) {
-            if (skip-- > 0)
-                continue;
-            else if (limit-- <= 0)
-                break;
+        // Enumerate, streaming JSON rows:
+        streamRows(rq, [&](JSONEncoder &json) {
             C4DocumentInfo info;
+            while (true) {
+                if (limit <= 0 || !c4enum_next(e, &err))
+                    return false;
+                if (skip == 0)
+                    break;
+                --skip;
+            }
             c4enum_getDocumentInfo(e, &info);
+            --limit;
+
             json.beginDict();
             json.writeKey("key"_sl);
             json.writeString(info.docID);
@@ -187,22 +260,80 @@ namespace litecore { namespace REST {
             if (includeDocs) {
                 c4::ref<C4Document> doc = c4enum_getDocument(e, &err);
                 if (!doc)
-                    return rq.respondWithError(err);
+                    return false;
                 alloc_slice docBody = c4doc_bodyAsJSON(doc, false, &err);
                 if (!docBody)
-                    return rq.respondWithError(err);
+                    return false;
                 json.writeKey("doc"_sl);
                 json.writeRaw(docBody);
             }
             json.endDict();
+            return true;
+        });
+        if (err.code)
+            rq.respondWithError(err);       // (cuts off the response, since it's streaming)
+    }
+
+
+    // Runs a query given as `{"query": ..., "parameters": {...}}`, where the query is either a
+    // N1QL string or a JSON query, and streams the result rows as JSON objects whose keys are
+    // the column titles.
+    void RESTListener::handleQuery(RequestResponse &rq, C4Database *db) {
+        Dict body = rq.bodyAsJSON().asDict();
+        if (!body)
+            return rq.respondWithStatus(HTTPStatus::BadRequest, "Invalid JSON in request body");
+        Value queryValue = body["query"];
+        C4QueryLanguage language;
+        alloc_slice expression;
+        if (slice n1ql = queryValue.asString(); n1ql) {
+            language = kC4N1QLQuery;
+            expression = alloc_slice(n1ql);
+        } else if (queryValue.asDict() || queryValue.asArray()) {
+            language = kC4JSONQuery;
+            expression = queryValue.toJSON();
+        } else {
+            return rq.respondWithStatus(HTTPStatus::BadRequest, "Missing or invalid 'query'");
         }
-        json.endArray();
-        json.endDict();
+        alloc_slice parameters;
+        if (Value params = body["parameters"]; params) {
+            if (!params.asDict())
+                return rq.respondWithStatus(HTTPStatus::BadRequest, "Invalid 'parameters'");
+            parameters = params.toJSON();
+        }
+
+        C4Error err = {};
+        c4::ref<C4Query> query = c4query_new2(db, language, expression, nullptr, &err);
+        if (!query)
+            return rq.respondWithError(err);
+        c4::ref<C4QueryEnumerator> e = c4query_run(query, nullptr, parameters, &err);
+        if (!e)
+            return rq.respondWithError(err);
+
+        unsigned nCols = c4query_columnCount(query);
+        vector<slice> titles(nCols);
+        for (unsigned i = 0; i < nCols; ++i)
+            titles[i] = c4query_columnTitle(query, i);
+
+        streamRows(rq, [&](JSONEncoder &json) {
+            if (!c4queryenum_next(e, &err))
+                return false;
+            json.beginDict();
+            for (unsigned i = 0; i < nCols; ++i) {
+                if (i < 64 && (e->missingColumns & (1ull << i)))
+                    continue;
+                json.writeKey(titles[i]);
+                json.writeValue(Value(FLArrayIterator_GetValueAt(&e->columns, i)));
+            }
+            json.endDict();
+            return true;
+        });
+        if (err.code)
+            rq.respondWithError(err);       // (cuts off the response, since it's streaming)
     }
 
 
     void RESTListener::handleGetDoc(RequestResponse &rq, C4Database *db) {
-        string docID = rq.path(1);
+        string docID = rq.pathParam("docID");
         string revID = rq.query("rev");
         C4Error err;
         c4::ref<C4Document> doc = c4db_getDoc(db, slice(docID), true,
@@ -245,14 +376,16 @@ namespace litecore { namespace REST {
 
 
     // Core code for create/update/delete operation on a single doc.
-    bool RESTListener::modifyDoc(Dict body,
-                             string docID,
-                             string revIDQuery,
-                             bool deleting,
-                             bool newEdits,
-                             C4Database *db,
-                             fleece::JSONEncoder& json,
-                             C4Error *outError)
+    // Parses and validates a document update, and encodes its body. Must be called in a
+    // transaction, since the body is encoded with the database's shared keys.
+    bool RESTListener::prepareDocPut(Dict body,
+                                     string docID,
+                                     string revIDQuery,
+                                     bool deleting,
+                                     bool newEdits,
+                                     C4Database *db,
+                                     DocPut &put,
+                                     C4Error *outError)
     {
         if (!deleting && !body) {
             c4error_return(WebSocketDomain, (int)HTTPStatus::BadRequest,
@@ -291,54 +424,82 @@ namespace litecore { namespace REST {
         if (body["_deleted"_sl].asBool())
             deleting = true;
 
+        // Encode body as Fleece (and strip _id and _rev):
+        if (body) {
+            put.body = c4doc_encodeStrippingOldMetaProperties(body,
+                                                              c4db_getFLSharedKeys(db),
+                                                              outError);
+            if (!put.body)
+                return false;
+        }
+        put.docID = move(docID);
+        put.revID = revID;
+        put.deleting = deleting;
+        put.newEdits = newEdits;
+        return true;
+    }
+
+
+    C4DocPutRequest RESTListener::DocPut::request() {
+        history[0] = revID;
+        C4DocPutRequest put = {};
+        put.allocedBody = {(void*)body.buf, body.size};
+        if (!docID.empty())
+            put.docID = slice(docID);
+        put.revFlags = (deleting ? kRevDeleted : 0);
+        put.existingRevision = !newEdits;
+        put.allowConflict = false;
+        put.history = history;
+        put.historyCount = revID ? 1 : 0;
+        put.save = true;
+        return put;
+    }
+
+
+    void RESTListener::writeDocPutResult(C4Document *doc, JSONEncoder &json) {
+        json.writeKey("ok"_sl);
+        json.writeBool(true);
+        json.writeKey("id"_sl);
+        json.writeString(doc->docID);
+        json.writeKey("rev"_sl);
+        json.writeString(doc->selectedRev.revID);
+    }
+
+
+    bool RESTListener::modifyDoc(Dict body,
+                             string docID,
+                             string revIDQuery,
+                             bool deleting,
+                             bool newEdits,
+                             C4Database *db,
+                             fleece::JSONEncoder& json,
+                             C4Error *outError)
+    {
         c4::ref<C4Document> doc;
         {
             c4::Transaction t(db);
             if (!t.begin(outError))
                 return false;
 
-            // Encode body as Fleece (and strip _id and _rev):
-            alloc_slice encodedBody;
-            if (body) {
-                encodedBody = c4doc_encodeStrippingOldMetaProperties(body,
-                                                                     c4db_getFLSharedKeys(db),
-                                                                     outError);
-                if (!encodedBody)
-                    return false;
-            }
+            DocPut docPut;
+            if (!prepareDocPut(body, docID, revIDQuery, deleting, newEdits, db, docPut, outError))
+                return false;
 
             // Save the revision:
-            C4Slice history[1] = {revID};
-            C4DocPutRequest put = {};
-            put.allocedBody = {(void*)encodedBody.buf, encodedBody.size};
-            if (!docID.empty())
-                put.docID = slice(docID);
-            put.revFlags = (deleting ? kRevDeleted : 0);
-            put.existingRevision = !newEdits;
-            put.allowConflict = false;
-            put.history = history;
-            put.historyCount = revID ? 1 : 0;
-            put.save = true;
+            C4DocPutRequest put = docPut.request();
             doc = c4doc_put(db, &put, nullptr, outError);
 
             if (!doc || !t.commit(outError))
                 return false;
         }
-        revID = slice(doc->selectedRev.revID);
-
-        json.writeKey("ok"_sl);
-        json.writeBool(true);
-        json.writeKey("id"_sl);
-        json.writeString(doc->docID);
-        json.writeKey("rev"_sl);
-        json.writeString(doc->selectedRev.revID);
+        writeDocPutResult(doc, json);
         return true;
     }
 
 
     // This handles PUT and DELETE of a document, as well as POST to a database.
     void RESTListener::handleModifyDoc(RequestResponse &rq, C4Database *db) {
-        string docID = rq.path(1);                       // will be empty for POST
+        string docID = rq.pathParam("docID");            // will be empty for POST
 
         // Parse the body:
         bool deleting = (rq.method() == Method::DELETE);
@@ -378,13 +539,39 @@ namespace litecore { namespace REST {
         if (!t.begin(&error))
             return rq.respondWithStatus(HTTPStatus::BadRequest);
 
+        // Parse all the docs, then save them together with c4db_putDocs:
+        size_t count = docs.count();
+        vector<DocPut> puts(count);
+        vector<C4Error> errors(count);
+        vector<C4DocPutRequest> requests;
+        vector<size_t> requestIndex;                    // maps requests[] index to docs[] index
+        for (size_t i = 0; i < count; ++i) {
+            if (prepareDocPut(docs[uint32_t(i)].asDict(), "", "", false, newEdits, db,
+                              puts[i], &errors[i])) {
+                requests.push_back(puts[i].request());
+                requestIndex.push_back(i);
+            }
+        }
+
+        vector<C4Document*> savedDocs(requests.size());
+        vector<C4Error> saveErrors(requests.size());
+        if (c4db_putDocs(db, requests.data(), requests.size(), savedDocs.data(), saveErrors.data(),
+                         &error) < 0)
+            return rq.respondWithStatus(HTTPStatus::BadRequest);
+        vector<C4Document*> results(count, nullptr);
+        for (size_t r = 0; r < requests.size(); ++r) {
+            results[requestIndex[r]] = savedDocs[r];
+            errors[requestIndex[r]] = saveErrors[r];
+        }
+
         auto &json = rq.jsonEncoder();
         json.beginArray();
-        for (Array::iterator i(docs); i; ++i) {
+        for (size_t i = 0; i < count; ++i) {
             json.beginDict();
-            Dict doc = i.value().asDict();
-            if (!modifyDoc(doc, "", "", false, newEdits, db, json, &error))
-                rq.writeErrorJSON(error);
+            if (c4::ref<C4Document> doc = results[i]; doc)
+                writeDocPutResult(doc, json);
+            else
+                rq.writeErrorJSON(errors[i]);
             json.endDict();
         }
         json.endArray();
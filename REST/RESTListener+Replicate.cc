@@ -22,6 +22,7 @@
 #include "c4Document+Fleece.h"
 #include "c4ListenerInternal.hh"
 #include "Server.hh"
+#include "BLIPConnection.hh"
 #include "RefCounted.hh"
 #include "StringUtil.hh"
 #include "c4ExceptionUtils.hh"
@@ -325,8 +326,27 @@ namespace litecore { namespace REST {
 
 
     void RESTListener::handleSync(RequestResponse &rq, C4Database*) {
+        // Implemented by the Enterprise Edition's subclass, using acceptSyncWebSocket().
         rq.setStatus(HTTPStatus::NotImplemented, nullptr);
     }
 
 
+    const char* RESTListener::acceptSyncWebSocket(RequestResponse &rq) {
+        if (!rq.isValidWebSocketRequest()) {
+            rq.respondWithStatus(HTTPStatus::BadRequest, "Invalid WebSocket request");
+            return nullptr;
+        }
+        // The subprotocol we accept determines the compression algorithm BLIP uses:
+        string protocol = blip::Connection::selectWebSocketProtocol(
+                                                    rq.header("Sec-WebSocket-Protocol"),
+                                                    kSyncProtocolName);
+        if (protocol.empty()) {
+            rq.respondWithStatus(HTTPStatus::BadRequest, "Incompatible replication protocol");
+            return nullptr;
+        }
+        rq.sendWebSocketResponse(protocol);
+        return blip::Connection::compressionForWebSocketProtocol(slice(protocol));
+    }
+
+
 } }
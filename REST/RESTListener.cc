@@ -77,25 +77,27 @@ namespace litecore { namespace REST {
             // Top-level special handlers:
             addHandler(Method::GET,     "/_all_dbs",         &RESTListener::handleGetAllDBs);
             addHandler(Method::GET,     "/_active_tasks",    &RESTListener::handleActiveTasks);
+            addHandler(Method::GET,     "/_actor_stats",     &RESTListener::handleActorStats);
             addHandler(Method::POST,    "/_replicate",       &RESTListener::handleReplicate);
 
             // Database:
-            addDBHandler(Method::GET,   "/[^_][^/]*|/[^_][^/]*/",    &RESTListener::handleGetDatabase);
-            addHandler  (Method::PUT,   "/[^_][^/]*|/[^_][^/]*/",    &RESTListener::handleCreateDatabase);
-            addDBHandler(Method::DELETE,"/[^_][^/]*|/[^_][^/]*/",    &RESTListener::handleDeleteDatabase);
-            addDBHandler(Method::POST,  "/[^_][^/]*|/[^_][^/]*/",    &RESTListener::handleModifyDoc);
+            addDBHandler(Method::GET,   "/{db}|/{db}/",          &RESTListener::handleGetDatabase);
+            addHandler  (Method::PUT,   "/{db}|/{db}/",          &RESTListener::handleCreateDatabase);
+            addDBHandler(Method::DELETE,"/{db}|/{db}/",          &RESTListener::handleDeleteDatabase);
+            addDBHandler(Method::POST,  "/{db}|/{db}/",          &RESTListener::handleModifyDoc);
 
             // Database-level special handlers:
-            addDBHandler(Method::GET,   "/[^_][^/]*/_all_docs",  &RESTListener::handleGetAllDocs);
-            addDBHandler(Method::POST,  "/[^_][^/]*/_bulk_docs", &RESTListener::handleBulkDocs);
+            addDBHandler(Method::GET,   "/{db}/_all_docs",       &RESTListener::handleGetAllDocs);
+            addDBHandler(Method::POST,  "/{db}/_bulk_docs",      &RESTListener::handleBulkDocs);
+            addDBHandler(Method::POST,  "/{db}/_query",          &RESTListener::handleQuery);
 
             // Document:
-            addDBHandler(Method::GET,   "/[^_][^/]*/[^_].*",      &RESTListener::handleGetDoc);
-            addDBHandler(Method::PUT,   "/[^_][^/]*/[^_].*",      &RESTListener::handleModifyDoc);
-            addDBHandler(Method::DELETE,"/[^_][^/]*/[^_].*",      &RESTListener::handleModifyDoc);
+            addDBHandler(Method::GET,   "/{db}/{docID...}",      &RESTListener::handleGetDoc);
+            addDBHandler(Method::PUT,   "/{db}/{docID...}",      &RESTListener::handleModifyDoc);
+            addDBHandler(Method::DELETE,"/{db}/{docID...}",      &RESTListener::handleModifyDoc);
         }
         if (config.apis & kC4SyncAPI) {
-            addDBHandler(Method::UPGRADE, "/[^_][^/]*/_blipsync", &RESTListener::handleSync);
+            addDBHandler(Method::UPGRADE, "/{db}/_blipsync",     &RESTListener::handleSync);
         }
 
         _server->start(config.port,
@@ -349,7 +351,7 @@ namespace litecore { namespace REST {
 
     
     c4::ref<C4Database> RESTListener::databaseFor(RequestResponse &rq) {
-        string dbName = rq.path(0);
+        string dbName = rq.pathParam("db");
         if (dbName.empty()) {
             rq.respondWithStatus(HTTPStatus::BadRequest);
             return nullptr;
@@ -19,6 +19,7 @@
 #pragma once
 #include "c4.hh"
 #include "c4Database.h"
+#include "c4Document.h"
 #include "c4Listener.h"
 #include "Listener.hh"
 #include "Server.hh"
@@ -116,6 +117,16 @@ namespace litecore { namespace REST {
 
         virtual void handleSync(RequestResponse&, C4Database*);
 
+        /** Completes the WebSocket handshake of a `_blipsync` request, accepting the BLIP
+            subprotocol we prefer of those the client offered. Returns the compression algorithm
+            that subprotocol denotes, which the passive replicator must be given as its
+            kC4ReplicatorCompressionAlgorithm option. If the request can't be accepted, sends
+            an error response and returns nullptr. */
+        const char* acceptSyncWebSocket(RequestResponse&);
+
+        /** The application part of the sync subprotocol (Replicator::kReplicatorProtocolName.) */
+        static constexpr const char *kSyncProtocolName = "+CBMobile_2";
+
         static std::string serverNameAndVersion();
         static std::string kServerName;
 
@@ -124,6 +135,7 @@ namespace litecore { namespace REST {
         void handleGetAllDBs(RequestResponse&);
         void handleReplicate(RequestResponse&);
         void handleActiveTasks(RequestResponse&);
+        void handleActorStats(RequestResponse&);
 
         void handleGetDatabase(RequestResponse&, C4Database*);
         void handleCreateDatabase(RequestResponse&);
@@ -133,6 +145,28 @@ namespace litecore { namespace REST {
         void handleGetDoc(RequestResponse&, C4Database*);
         void handleModifyDoc(RequestResponse&, C4Database*);
         void handleBulkDocs(RequestResponse&, C4Database*);
+        void handleQuery(RequestResponse&, C4Database*);
+
+        // The parameters of a document update, parsed from a request by prepareDocPut().
+        struct DocPut {
+            std::string         docID;
+            fleece::alloc_slice revID;
+            fleece::alloc_slice body;         // Encoded Fleece body
+            bool                deleting {false};
+            bool                newEdits {true};
+            C4Slice             history[1] {};
+
+            C4DocPutRequest request();        // (Points into this object, so keep it in place)
+        };
+
+        bool prepareDocPut(fleece::Dict body,
+                           std::string docID,
+                           std::string revIDQuery,
+                           bool deleting,
+                           bool newEdits,
+                           C4Database *db,
+                           DocPut &outPut,
+                           C4Error *outError);
 
         bool modifyDoc(fleece::Dict body,
                        std::string docID,
@@ -143,6 +177,8 @@ namespace litecore { namespace REST {
                        fleece::JSONEncoder& json,
                        C4Error *outError);
 
+        static void writeDocPutResult(C4Document *doc, fleece::JSONEncoder &json);
+
         std::unique_ptr<FilePath> _directory;
         const bool _allowCreateDB, _allowDeleteDB;
         Retained<crypto::Identity> _identity;
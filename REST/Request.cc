@@ -68,6 +68,7 @@ namespace litecore { namespace REST {
             _queries.clear();
         }
         _path = string(uri);
+        _isHTTP11 = (version != "HTTP/1.0"_sl);
 
         if (!HTTPLogic::parseHeaders(httpData, _headers))
             return false;
@@ -94,6 +95,15 @@ namespace litecore { namespace REST {
         return URLDecode(component);
     }
 
+
+    string Request::pathParam(string_view name) const {
+        for (auto &param : _pathParams) {
+            if (param.first == name)
+                return param.second;
+        }
+        return "";
+    }
+
     
     string Request::query(const char *param) const {
         return getURLQueryParam(_queries, param);
@@ -119,10 +129,20 @@ namespace litecore { namespace REST {
 
 
 
+    bool Request::wantsKeepAlive() const {
+        slice connection = header("Connection");
+        if (_isHTTP11)
+            return !connection.caseEquivalent("close"_sl);
+        else
+            return connection.caseEquivalent("keep-alive"_sl);
+    }
+
+
 #pragma mark - RESPONSE STATUS LINE:
 
 
-    RequestResponse::RequestResponse(Server *server, std::unique_ptr<net::ResponderSocket> socket)
+    RequestResponse::RequestResponse(Server *server, std::unique_ptr<net::ResponderSocket> socket,
+                                     bool allowKeepAlive)
     :_server(server)
     ,_socket(move(socket))
     {
@@ -133,12 +153,22 @@ namespace litecore { namespace REST {
         }
         if (!readFromHTTP(request))
             return;
-        if (_method == Method::POST || _method == Method::PUT) {
+        // A body declared by any request has to be read, even if it's ignored, or it would be
+        // taken for the start of the next pipelined request:
+        slice transferEncoding = header("Transfer-Encoding");
+        bool delimited = header("Content-Length").size > 0
+                      || transferEncoding.caseEquivalent("chunked"_sl);
+        if (delimited || transferEncoding.size > 0
+                      || _method == Method::POST || _method == Method::PUT) {
+            // (Without a Content-Length the body ends at EOF, so the connection can't be reused.)
+            if (!delimited)
+                allowKeepAlive = false;
             if (!_socket->readHTTPBody(_headers, _body)) {
                 handleSocketError();
                 return;
             }
         }
+        _keepAlive = allowKeepAlive && wantsKeepAlive();
     }
 
 
@@ -159,7 +189,7 @@ namespace litecore { namespace REST {
             if (defaultMessage)
                 _statusMessage = defaultMessage;
         }
-        string statusLine = format("HTTP/1.0 %d %s\r\n", static_cast<int>(_status), _statusMessage.c_str());
+        string statusLine = format("HTTP/1.1 %d %s\r\n", static_cast<int>(_status), _statusMessage.c_str());
         _responseHeaderWriter.write(statusLine);
         _sentStatus = true;
 
@@ -200,6 +230,15 @@ namespace litecore { namespace REST {
 
 
     void RequestResponse::respondWithStatus(HTTPStatus status, const char *message) {
+        if (_streaming) {
+            // Too late to send a status; end the response abruptly, so the client can tell
+            // it's incomplete (there's no final chunk), and close the connection:
+            WarnError("Streamed response failed with status %d %s",
+                      int(status), (message ? message : ""));
+            _keepAlive = false;
+            _finished = true;
+            return;
+        }
         setStatus(status, message);
         uncacheable();
 
@@ -232,6 +271,8 @@ namespace litecore { namespace REST {
                 switch (err.code) {
                     case kC4ErrorInvalidParameter:
                     case kC4ErrorBadRevisionID:
+                    case kC4ErrorInvalidQuery:
+                    case kC4ErrorInvalidQueryParam:
                         status = HTTPStatus::BadRequest; break;
                     case kC4ErrorNotADatabaseFile:
                     case kC4ErrorCrypto:
@@ -262,6 +303,8 @@ namespace litecore { namespace REST {
 
 
     void RequestResponse::handleSocketError() {
+        _keepAlive = false;
+        _sendFailed = true;
         C4Error err = _socket->error();
         WarnError("Socket error sending response: %s", c4error_descriptionStr(err));
     }
@@ -300,6 +343,8 @@ namespace litecore { namespace REST {
     void RequestResponse::sendHeaders() {
         if (_jsonEncoder)
             setHeader("Content-Type", "application/json");
+        if (_status != HTTPStatus::Upgraded)
+            setHeader("Connection", _keepAlive ? "keep-alive" : "close");
         _responseHeaderWriter.write("\r\n"_sl);
         if (_socket->write_n(_responseHeaderWriter.finish()) < 0)
             handleSocketError();
@@ -320,6 +365,8 @@ namespace litecore { namespace REST {
     void RequestResponse::write(slice content) {
         Assert(!_finished);
         _responseWriter.write(content);
+        if (_streaming && _responseWriter.length() >= kStreamChunkSize)
+            flush();
     }
 
 
@@ -343,10 +390,53 @@ namespace litecore { namespace REST {
     }
 
 
+    void RequestResponse::beginStreaming() {
+        Assert(!_streaming && !_jsonEncoder && _contentLength < 0);
+        if (_isHTTP11) {
+            setHeader("Transfer-Encoding", "chunked");
+            _chunked = true;
+        } else {
+            _keepAlive = false;         // The client will read the body until EOF
+        }
+        sendHeaders();
+        _streaming = true;
+    }
+
+
+    void RequestResponse::flush() {
+        if (!_streaming || _responseWriter.length() == 0)
+            return;
+        alloc_slice data = _responseWriter.finish();
+        if (_chunked) {
+            char chunkHeader[20];
+            sprintf(chunkHeader, "%zx\r\n", data.size);
+            sendBodyData(slice(chunkHeader));
+            sendBodyData(data);
+            sendBodyData("\r\n"_sl);
+        } else {
+            sendBodyData(data);
+        }
+    }
+
+
+    void RequestResponse::sendBodyData(slice data) {
+        if (!_sendFailed && _socket->write_n(data) < 0)
+            handleSocketError();
+    }
+
+
     void RequestResponse::finish() {
         if (_finished)
             return;
 
+        if (_streaming) {
+            flush();
+            if (_chunked)
+                sendBodyData("0\r\n\r\n"_sl);      // The final, empty chunk
+            _finished = true;
+            return;
+        }
+
         if (_jsonEncoder) {
             alloc_slice json = _jsonEncoder->finish();
             write(json);
@@ -377,6 +467,7 @@ namespace litecore { namespace REST {
 
     void RequestResponse::sendWebSocketResponse(const string &protocol) {
         string nonce(header("Sec-WebSocket-Key"));
+        _keepAlive = false;         // the socket now belongs to the WebSocket
         setStatus(HTTPStatus::Upgraded, "Upgraded");
         setHeader("Connection", "Upgrade");
         setHeader("Upgrade", "websocket");
@@ -25,6 +25,8 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace litecore { namespace net {
@@ -49,10 +51,18 @@ namespace litecore { namespace REST {
         std::string path() const                {return _path;}
         std::string path(int i) const;
 
+        /** The URL-decoded value of a capture in the route that matched the path, such as the
+            "db" in "/{db}/_all_docs"; or an empty string if there's no such capture. */
+        std::string pathParam(std::string_view name) const;
+
         std::string query(const char *param) const;
         int64_t intQuery(const char *param, int64_t defaultValue =0) const;
         bool boolQuery(const char *param, bool defaultValue =false) const;
 
+        /** True if the client wants the connection kept open for more requests: it's using
+            HTTP/1.1 without "Connection: close", or HTTP/1.0 with "Connection: keep-alive". */
+        bool wantsKeepAlive() const;
+
     protected:
         friend class Server;
         
@@ -65,6 +75,8 @@ namespace litecore { namespace REST {
         Method _method {Method::None};
         std::string _path;
         std::string _queries;
+        bool _isHTTP11 {false};                     // Is the request HTTP/1.1 (or later)?
+        std::vector<std::pair<std::string,std::string>> _pathParams;   // Set by Server's router
     };
 
 
@@ -106,6 +118,25 @@ namespace litecore { namespace REST {
         void writeStatusJSON(HTTPStatus status, const char *message =nullptr);
         void writeErrorJSON(C4Error);
 
+        // Streamed response body:
+
+        /** Sends the status and headers now, so the body can be sent as it's written instead of
+            all at once by `finish`; it's buffered only until kStreamChunkSize bytes accumulate.
+            The body is sent with chunked transfer encoding, or to an HTTP/1.0 client, ends when
+            the connection closes. Set any headers (including Content-Type) first, and don't use
+            `jsonEncoder` or `setContentLength`. If `respondWithStatus` is called afterwards, it's
+            too late to change the status, so the response is cut off to show it failed. */
+        void beginStreaming();
+
+        /** When streaming, sends any body data written so far. */
+        void flush();
+
+        /** True if sending the response failed, e.g. because the client disconnected.
+            A handler that's streaming a long response can check this to stop early. */
+        bool sendFailed() const                             {return _sendFailed;}
+
+        static constexpr size_t kStreamChunkSize = 32 * 1024;
+
         // Must be called after everything's written:
         void finish();
 
@@ -121,11 +152,16 @@ namespace litecore { namespace REST {
 
         std::string peerAddress();
 
+        /** True if the connection can be used for another request after this one. */
+        bool keepAlive() const                              {return _keepAlive;}
+
     protected:
-        RequestResponse(Server *server, std::unique_ptr<net::ResponderSocket>);
+        RequestResponse(Server *server, std::unique_ptr<net::ResponderSocket>,
+                        bool allowKeepAlive =false);
         void sendStatus();
         void sendHeaders();
         void handleSocketError();
+        void sendBodyData(fleece::slice);
 
     private:
         friend class Server;
@@ -149,6 +185,10 @@ namespace litecore { namespace REST {
         fleece::alloc_slice _responseBody;          // Finished response body
         fleece::slice _unsentBody;                  // Unsent portion of _responseBody
         bool _finished {false};                     // Finished configuring the response?
+        bool _keepAlive {false};                    // Keep connection open after response?
+        bool _streaming {false};                    // Sending body as it's written?
+        bool _chunked {false};                      // Using chunked transfer encoding?
+        bool _sendFailed {false};                   // Has writing to the socket failed?
     };
 
 } }
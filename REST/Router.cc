@@ -0,0 +1,180 @@
+//
+// Router.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#include "Router.hh"
+#include "netUtils.hh"
+#include "Error.hh"
+#include <algorithm>
+#include <cctype>
+
+namespace litecore { namespace REST {
+    using namespace std;
+    using namespace litecore::net;
+
+
+    enum class SegmentType {Literal, Capture, RestCapture, Invalid};
+
+    // Classifies a route segment, setting `name` to the literal text or the capture's name.
+    static SegmentType parseSegment(string_view segment, string_view &name) {
+        if (segment.size() >= 2 && segment.front() == '{' && segment.back() == '}') {
+            name = segment.substr(1, segment.size() - 2);
+            auto type = SegmentType::Capture;
+            if (name.size() > 3 && name.substr(name.size() - 3) == "...") {
+                name.remove_suffix(3);
+                type = SegmentType::RestCapture;
+            }
+            bool validName = !name.empty() && all_of(name.begin(), name.end(), [](char c) {
+                return isalnum((unsigned char)c) || c == '_';
+            });
+            return validName ? type : SegmentType::Invalid;
+        } else {
+            name = segment;
+            // Regex metacharacters mean it's not a literal:
+            if (segment.find_first_of("\\^$.|?*+()[]{}") != string_view::npos)
+                return SegmentType::Invalid;
+            return SegmentType::Literal;
+        }
+    }
+
+
+    Router::Segments Router::splitPath(string_view path) {
+        Segments segments;
+        path.remove_prefix(1);          // skip the leading '/'
+        while (true) {
+            auto slash = path.find('/');
+            segments.push_back(path.substr(0, slash));
+            if (slash == string_view::npos)
+                break;
+            path.remove_prefix(slash + 1);
+        }
+        return segments;
+    }
+
+
+    bool Router::isRoute(string_view pattern) {
+        if (pattern.empty() || pattern[0] != '/')
+            return false;
+        Segments segments = splitPath(pattern);
+        for (size_t i = 0; i < segments.size(); ++i) {
+            string_view name;
+            switch (parseSegment(segments[i], name)) {
+                case SegmentType::Invalid:
+                    return false;
+                case SegmentType::RestCapture:
+                    if (i + 1 < segments.size())
+                        return false;
+                    break;
+                default:
+                    break;
+            }
+        }
+        return true;
+    }
+
+
+    void Router::add(string_view route, Methods methods, unsigned rule) {
+        if (!isRoute(route))
+            error::_throw(error::InvalidParameter, "Invalid route \"%.*s\"",
+                          int(route.size()), route.data());
+        Node *node = &_root;
+        for (string_view segment : splitPath(route)) {
+            string_view name;
+            switch (parseSegment(segment, name)) {
+                case SegmentType::Literal: {
+                    auto i = node->literals.find(name);
+                    if (i == node->literals.end())
+                        i = node->literals.emplace(name, make_unique<Node>()).first;
+                    node = i->second.get();
+                    break;
+                }
+                case SegmentType::Capture: {
+                    auto i = find_if(node->captures.begin(), node->captures.end(),
+                                     [&](auto &c) {return c.first == name;});
+                    if (i == node->captures.end()) {
+                        node->captures.emplace_back(name, make_unique<Node>());
+                        i = prev(node->captures.end());
+                    }
+                    node = i->second.get();
+                    break;
+                }
+                case SegmentType::RestCapture: {
+                    auto i = find_if(node->restCaptures.begin(), node->restCaptures.end(),
+                                     [&](auto &c) {return c.first == name;});
+                    if (i == node->restCaptures.end()) {
+                        node->restCaptures.emplace_back(name, vector<Endpoint>());
+                        i = prev(node->restCaptures.end());
+                    }
+                    i->second.push_back({methods, rule});
+                    return;                 // (isRoute ensured this is the last segment)
+                }
+                case SegmentType::Invalid:
+                    break;                  // (can't happen; isRoute checked)
+            }
+        }
+        node->endpoints.push_back({methods, rule});
+    }
+
+
+    bool Router::isCapturable(string_view segment) {
+        return !segment.empty() && segment[0] != '_';
+    }
+
+
+    int Router::find(Method method, string_view path, Captures &captures) const {
+        if (path.empty() || path[0] != '/')
+            return -1;
+        Search search {method, path, splitPath(path), {}, -1, &captures};
+        find(_root, 0, search);
+        return search.bestRule;
+    }
+
+
+    // Depth-first search of the trie. Every branch has to be followed, since a route registered
+    // earlier (with a lower rule number) takes priority regardless of which branch it's on.
+    void Router::find(const Node &node, size_t segIndex, Search &search) const {
+        if (segIndex == search.segments.size()) {
+            foundEndpoints(node.endpoints, search);
+            return;
+        }
+        string_view segment = search.segments[segIndex];
+
+        if (auto i = node.literals.find(segment); i != node.literals.end())
+            find(*i->second, segIndex + 1, search);
+
+        if (!isCapturable(segment))
+            return;
+        for (auto &[name, child] : node.captures) {
+            search.bindings.emplace_back(name, segment);
+            find(*child, segIndex + 1, search);
+            search.bindings.pop_back();
+        }
+        if (!node.restCaptures.empty()) {
+            // The rest of the path, starting at this segment:
+            string_view rest = search.path.substr(segment.data() - search.path.data());
+            for (auto &[name, endpoints] : node.restCaptures) {
+                search.bindings.emplace_back(name, rest);
+                foundEndpoints(endpoints, search);
+                search.bindings.pop_back();
+            }
+        }
+    }
+
+
+    void Router::foundEndpoints(const vector<Endpoint> &endpoints, Search &search) {
+        for (auto &endpoint : endpoints) {
+            if ((endpoint.methods & search.method)
+                    && (search.bestRule < 0 || endpoint.rule < unsigned(search.bestRule))) {
+                search.bestRule = int(endpoint.rule);
+                search.captures->clear();
+                for (auto &[name, value] : search.bindings)
+                    search.captures->emplace_back(string(name),
+                                                  URLDecode(fleece::slice(value.data(),
+                                                                          value.size())));
+            }
+        }
+    }
+
+} }
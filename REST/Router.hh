@@ -0,0 +1,76 @@
+//
+// Router.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "HTTPTypes.hh"
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace litecore { namespace REST {
+
+    /** Maps URL paths to numbered rules, using a trie of path segments, so that a path is matched
+        against all routes in a single pass, without regular expressions.
+
+        A route is a path like "/{db}/_all_docs", whose segments are either literals or captures:
+        - "{name}" matches one segment that's non-empty and doesn't start with "_" (which marks
+          special names like "_all_docs"), such as a database name.
+        - "{name...}" matches the rest of the path, one or more segments, which likewise can't
+          start with "_", such as a document ID. It must be the last segment of the route.
+        A trailing "/" is significant: "/{db}" and "/{db}/" are different routes. */
+    class Router {
+    public:
+        /** Captured path segments, as (name, URL-decoded value) pairs. */
+        using Captures = std::vector<std::pair<std::string, std::string>>;
+
+        /** True if `pattern` is a valid route. (Anything else is assumed to be a regex.) */
+        static bool isRoute(std::string_view pattern);
+
+        /** Adds a route, which matches requests with any of the given methods, as rule number
+            `rule`. Throws if the route is invalid. */
+        void add(std::string_view route, net::Methods, unsigned rule);
+
+        /** Finds the lowest-numbered rule whose route matches `path` and whose methods include
+            `method`, and stores its captures in `captures`. Returns -1 if there's no match. */
+        int find(net::Method method, std::string_view path, Captures &captures) const;
+
+    private:
+        struct Endpoint {
+            net::Methods methods;
+            unsigned     rule;
+        };
+
+        struct Node {
+            std::vector<Endpoint> endpoints;                // Routes ending at this node
+            std::map<std::string, std::unique_ptr<Node>, std::less<>> literals;
+            std::vector<std::pair<std::string, std::unique_ptr<Node>>> captures;   // {name}
+            std::vector<std::pair<std::string, std::vector<Endpoint>>> restCaptures; // {name...}
+        };
+
+        using Segments = std::vector<std::string_view>;
+        using Bindings = std::vector<std::pair<std::string_view, std::string_view>>;
+
+        struct Search {
+            net::Method      method;
+            std::string_view path;
+            Segments         segments;
+            Bindings         bindings;          // Captures along the current branch
+            int              bestRule {-1};
+            Captures*        captures;
+        };
+
+        static Segments splitPath(std::string_view path);
+        static bool isCapturable(std::string_view segment);
+        void find(const Node&, size_t segIndex, Search&) const;
+        static void foundEndpoints(const std::vector<Endpoint>&, Search&);
+
+        Node _root;
+    };
+
+} }
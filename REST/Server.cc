@@ -29,6 +29,7 @@
 #include "c4ExceptionUtils.hh"
 #include "c4ListenerInternal.hh"
 #include "PlatformCompat.hh"
+#include "ThreadUtil.hh"
 #include <mutex>
 
 // TODO: Remove these pragmas when doc-comments in sockpp are fixed
@@ -62,7 +63,15 @@ namespace litecore { namespace REST {
         error::_throw(error::LiteCoreError::Unimplemented);
     }
 
-    Server::Server()
+    static unsigned defaultWorkerCount() {
+        return max(4u, min(16u, 2 * thread::hardware_concurrency()));
+    }
+
+
+    Server::Server(unsigned workerCount)
+    :_connectionCount(make_shared<atomic<int>>(0))
+    ,_workerCount(workerCount ? workerCount : defaultWorkerCount())
+    ,_idleTimer([this] {closeIdleConnections(false);})
     {
         if (!ListenerLog)
             ListenerLog = c4log_getDomain("Listener", true);
@@ -138,24 +147,53 @@ namespace litecore { namespace REST {
         if (!*_acceptor)
             error::_throw(error::POSIX, _acceptor->last_error());
         _acceptor->set_non_blocking();
-        c4log(ListenerLog, kC4LogInfo,"Server listening on port %d", this->port());
+        c4log(ListenerLog, kC4LogInfo,"Server listening on port %d, with %u workers",
+              this->port(), _workerCount);
+        // (In case the server was stopped before:)
+        _stopping = false;
+        _workQueue.reopen();
+        for (unsigned i = 0; i < _workerCount; ++i)
+            _workers.emplace_back([this] {workerTask();});
         awaitConnection();
     }
 
 
+    // Set on a worker thread that was detached by a call to stop() from a handler.
+    static thread_local bool tWorkerDetached = false;
+
+
     void Server::stop() {
-        lock_guard<mutex> lock(_mutex);
-        
-        // Either we never had an acceptor, or the one we tried to create
-        // failed to become valid, either way don't continue
-        if (!_acceptor || !*_acceptor)
-            return;
+        {
+            lock_guard<mutex> lock(_mutex);
+
+            // Either we never had an acceptor, or the one we tried to create
+            // failed to become valid, either way don't continue
+            if (!_acceptor || !*_acceptor)
+                return;
+
+            c4log(ListenerLog, kC4LogInfo,"Stopping server");
+            _stopping = true;
+            Poller::instance().removeListeners(_acceptor->handle());
+            _acceptor->close();
+            _acceptor.reset();
+        }
+
+        // Let the workers finish the requests they're handling, then stop them:
+        _workQueue.close();
+        for (auto &worker : _workers) {
+            if (worker.get_id() == this_thread::get_id()) {
+                worker.detach();        // (stop was called by a handler)
+                tWorkerDetached = true;
+            } else
+                worker.join();
+        }
+        _workers.clear();
+        closeIdleConnections(true);
 
-        c4log(ListenerLog, kC4LogInfo,"Stopping server");
-        Poller::instance().removeListeners(_acceptor->handle());
-        _acceptor->close();
-        _acceptor.reset();
+        lock_guard<mutex> lock(_mutex);
         _rules.clear();
+        _router = Router();             // (its entries are indexes into _rules)
+        _regexRules.clear();
     }
 
 
@@ -187,22 +225,149 @@ namespace litecore { namespace REST {
             }
             if (sock) {
                 sock.set_non_blocking(false);
-                handleConnection(move(sock));
+                auto conn = make_unique<Connection>();
+                conn->socket = make_unique<ResponderSocket>(_tlsContext);
+                if (conn->socket->acceptSocket(move(sock))
+                        && conn->socket->setTimeout(kRequestTimeoutSecs)) {
+                    ++*_connectionCount;
+                    conn->socket->onClose([count = _connectionCount] { --*count; });
+                    _workQueue.push(move(conn));
+                } else {
+                    c4log(ListenerLog, kC4LogError, "Error accepting incoming connection: %s",
+                          c4error_descriptionStr(conn->socket->error()));
+                }
             }
         } catch (const std::exception &x) {
             c4log(ListenerLog, kC4LogWarning, "Caught C++ exception accepting connection: %s", x.what());
         }
-        // Start another async accept:
-        awaitConnection();
+
+        // Start another async accept, unless too many connections are waiting for a worker;
+        // in that case the next worker to free up will resume accepting.
+        if (_workQueue.size() < kMaxQueuedConnections) {
+            awaitConnection();
+        } else {
+            c4log(ListenerLog, kC4LogVerbose, "All workers busy; pausing accepting connections");
+            _acceptPaused = true;
+            resumeAccepting();      // in case the workers caught up in the meantime
+        }
+    }
+
+
+    // Resumes accepting connections if it was paused and the backlog is small enough.
+    void Server::resumeAccepting() {
+        if (_workQueue.size() < kMaxQueuedConnections && _acceptPaused.exchange(false))
+            awaitConnection();
+    }
+
+
+    void Server::ConnectionQueue::push(unique_ptr<Connection> conn) {
+        {
+            lock_guard<mutex> lock(_mutex);
+            if (_closed)
+                return;         // (the connection is closed when `conn` goes out of scope)
+            _queue.push_back(move(conn));
+        }
+        _cond.notify_one();
+    }
+
+
+    unique_ptr<Server::Connection> Server::ConnectionQueue::pop() {
+        unique_lock<mutex> lock(_mutex);
+        _cond.wait(lock, [&] {return !_queue.empty() || _closed;});
+        if (_queue.empty())
+            return nullptr;
+        unique_ptr<Connection> conn = move(_queue.front());
+        _queue.pop_front();
+        return conn;
+    }
+
+
+    size_t Server::ConnectionQueue::size() const {
+        lock_guard<mutex> lock(_mutex);
+        return _queue.size();
+    }
+
+
+    void Server::ConnectionQueue::close() {
+        {
+            lock_guard<mutex> lock(_mutex);
+            _closed = true;
+        }
+        _cond.notify_all();
     }
 
 
-    void Server::handleConnection(sockpp::stream_socket &&sock) {
-        auto responder = make_unique<ResponderSocket>(_tlsContext);
-        if (!responder->acceptSocket(move(sock)) || (_tlsContext && !responder->wrapTLS())) {
+    void Server::ConnectionQueue::reopen() {
+        lock_guard<mutex> lock(_mutex);
+        _closed = false;
+    }
+
+
+    // Body of each worker thread.
+    void Server::workerTask() {
+        SetThreadName("REST Worker (CBL)");
+        while (true) {
+            unique_ptr<Connection> conn = _workQueue.pop();
+            if (!conn)
+                break;          // queue has been closed
+            resumeAccepting();
+            if (_stopping)
+                continue;       // just close the connection
+            {
+                // A handler may stop and release the server, so keep it alive until it returns:
+                Retained<Server> retainSelf = this;
+                try {
+                    handleConnection(move(conn));
+                } catch (const std::exception &x) {
+                    c4log(ListenerLog, kC4LogWarning,
+                          "Caught C++ exception handling connection: %s", x.what());
+                }
+            }
+            if (tWorkerDetached)
+                break;          // stop() was called by the handler; `this` may be gone now
+        }
+    }
+
+
+    // Reads and responds to requests on a connection, until it's closed or has no more
+    // requests ready to read; then it's made idle.
+    void Server::handleConnection(unique_ptr<Connection> conn) {
+        auto &socket = conn->socket;
+        if (conn->requestCount == 0) {
+            if (!openConnection(*conn))
+                return;
+        } else if (!socket->hasReadableData()) {
+            // An idle connection woke up, but without a request; the client may have closed it:
+            if (!socket->atReadEOF() && socket->error().code == 0)
+                idleConnection(move(conn));
+            return;
+        }
+
+        do {
+            ++conn->requestCount;
+            bool allowKeepAlive = (conn->requestCount < kMaxRequestsPerConnection && !_stopping);
+            RequestResponse rq(this, move(socket), allowKeepAlive);
+            if (!rq.isValid())
+                return;
+            dispatchRequest(&rq);
+            rq.finish();
+            if (!rq.keepAlive())
+                return;
+            socket = rq.extractSocket();
+            if (!socket)
+                return;         // handler took the socket, e.g. for a WebSocket
+        } while (socket->hasReadableData());    // Handle pipelined requests right away
+        idleConnection(move(conn));
+    }
+
+
+    // Sets up a new connection, with a TLS handshake if necessary.
+    bool Server::openConnection(Connection &conn) {
+        auto &responder = conn.socket;
+        if (_tlsContext && !responder->wrapTLS()) {
             c4log(ListenerLog, kC4LogError, "Error accepting incoming connection: %s",
                   c4error_descriptionStr(responder->error()));
-            return;
+            return false;
         }
         if (c4log_willLog(ListenerLog, kC4LogVerbose)) {
             auto cert = responder->peerTLSCertificate();
@@ -213,11 +378,63 @@ namespace litecore { namespace REST {
                 c4log(ListenerLog, kC4LogVerbose, "Accepted connection from %s",
                       responder->peerAddress().c_str());
         }
-        RequestResponse rq(this, move(responder));
-        if (rq.isValid()) {
-            dispatchRequest(&rq);
-            rq.finish();
+        return true;
+    }
+
+
+    // Parks a kept-alive connection until the client sends another request.
+    void Server::idleConnection(unique_ptr<Connection> conn) {
+        Connection *connPtr = conn.get();
+        conn->idleSince = clock::now();
+        {
+            lock_guard<mutex> lock(_idleMutex);
+            if (_stopping)
+                return;         // (checked while locked, so closeIdleConnections can't miss it)
+            _idleConnections.emplace(connPtr, move(conn));
+            connPtr->socket->onReadable([this, connPtr] {connectionReadable(connPtr);});
         }
+        _idleTimer.fireEarlierAt(clock::now() + kKeepAliveTimeout);
+    }
+
+
+    // Called by the Poller when an idle connection has data (or EOF) to read.
+    void Server::connectionReadable(Connection *connPtr) {
+        unique_ptr<Connection> conn;
+        {
+            lock_guard<mutex> lock(_idleMutex);
+            auto i = _idleConnections.find(connPtr);
+            if (i == _idleConnections.end())
+                return;         // it's already been closed
+            conn = move(i->second);
+            _idleConnections.erase(i);
+        }
+        _workQueue.push(move(conn));
+    }
+
+
+    // Closes idle connections that have timed out, or all of them.
+    void Server::closeIdleConnections(bool all) {
+        vector<unique_ptr<Connection>> closing;
+        clock::time_point oldest = clock::time_point::max();
+        {
+            lock_guard<mutex> lock(_idleMutex);
+            auto expiration = clock::now() - kKeepAliveTimeout;
+            for (auto i = _idleConnections.begin(); i != _idleConnections.end();) {
+                if (all || i->second->idleSince <= expiration) {
+                    i->second->socket->cancelCallbacks();
+                    closing.push_back(move(i->second));
+                    i = _idleConnections.erase(i);
+                } else {
+                    oldest = min(oldest, i->second->idleSince);
+                    ++i;
+                }
+            }
+        }
+        if (!closing.empty())
+            c4log(ListenerLog, kC4LogVerbose, "Closing %zu idle connections", closing.size());
+        if (oldest != clock::time_point::max())
+            _idleTimer.fireAt(oldest + kKeepAliveTimeout);
+        // (The sockets are closed as `closing` goes out of scope, outside the lock.)
     }
 
 
@@ -230,22 +447,37 @@ namespace litecore { namespace REST {
     void Server::addHandler(Methods methods, const string &patterns, const Handler &handler) {
         lock_guard<mutex> lock(_mutex);
         split(patterns, "|", [&](string_view pattern) {
-            _rules.push_back({methods,
-                              string(pattern),
-                              regex(pattern.data(), pattern.size()),
-                              handler});
+            auto ruleIndex = unsigned(_rules.size());
+            if (Router::isRoute(pattern)) {
+                _router.add(pattern, methods, ruleIndex);
+                _rules.push_back({methods, string(pattern), {}, handler});
+            } else {
+                _rules.push_back({methods,
+                                  string(pattern),
+                                  regex(pattern.data(), pattern.size()),
+                                  handler});
+                _regexRules.push_back(ruleIndex);
+            }
         });
     }
 
 
-    Server::URIRule* Server::findRule(Method method, const string &path) {
-        //lock_guard<mutex> lock(_mutex);       // called from dispatchResponder which locks
-        for (auto &rule : _rules) {
-            if ((rule.methods & method)
-                    && regex_match(path.c_str(), rule.regex))
+    Server::URIRule* Server::findRule(Method method, const string &path,
+                                      Router::Captures &captures)
+    {
+        //lock_guard<mutex> lock(_mutex);       // called from dispatchRequest which locks
+        int routeRule = _router.find(method, path, captures);
+        // A regex rule added before the matching route takes priority over it:
+        for (unsigned i : _regexRules) {
+            if (routeRule >= 0 && i > unsigned(routeRule))
+                break;
+            auto &rule = _rules[i];
+            if ((rule.methods & method) && regex_match(path.c_str(), rule.regex)) {
+                captures.clear();
                 return &rule;
+            }
         }
-        return nullptr;
+        return (routeRule >= 0) ? &_rules[routeRule] : nullptr;
     }
 
 
@@ -265,23 +497,29 @@ namespace litecore { namespace REST {
             }
         }
 
-        lock_guard<mutex> lock(_mutex);
-
-        ++_connectionCount;
-        Retained<Server> retainedSelf = this;
-        rq->onClose([=] { --retainedSelf->_connectionCount; });
-
         try {
             string pathStr(rq->path());
-            auto rule = findRule(method, pathStr);
-            if (rule) {
-                c4log(ListenerLog, kC4LogInfo, "Matched rule %s for path %s", rule->pattern.c_str(), pathStr.c_str());
-                rule->handler(*rq);
-            } else if (nullptr == (rule = findRule(Methods::ALL, pathStr))) {
-                c4log(ListenerLog, kC4LogInfo, "No rule matched path %s", pathStr.c_str());
+            Handler handler;
+            bool pathMatched = false;
+            {
+                // Copy the handler, so other requests can be dispatched while it runs:
+                lock_guard<mutex> lock(_mutex);
+                auto rule = findRule(method, pathStr, rq->_pathParams);
+                if (rule) {
+                    c4log(ListenerLog, kC4LogInfo, "Matched rule %s for path %s", rule->pattern.c_str(), pathStr.c_str());
+                    handler = rule->handler;
+                } else if (nullptr == (rule = findRule(Methods::ALL, pathStr, rq->_pathParams))) {
+                    c4log(ListenerLog, kC4LogInfo, "No rule matched path %s", pathStr.c_str());
+                } else {
+                    c4log(ListenerLog, kC4LogInfo, "Wrong method for rule %s for path %s", rule->pattern.c_str(), pathStr.c_str());
+                    pathMatched = true;
+                }
+            }
+            if (handler) {
+                handler(*rq);
+            } else if (!pathMatched) {
                 rq->respondWithStatus(HTTPStatus::NotFound, "Not found");
             } else {
-                c4log(ListenerLog, kC4LogInfo, "Wrong method for rule %s for path %s", rule->pattern.c_str(), pathStr.c_str());
                 if (method == Method::UPGRADE)
                     rq->respondWithStatus(HTTPStatus::Forbidden, "No upgrade available");
                 else
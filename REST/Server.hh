@@ -20,13 +20,18 @@
 #include "RefCounted.hh"
 #include "InstanceCounted.hh"
 #include "Request.hh"
+#include "Router.hh"
+#include "Timer.hh"
 #include "c4Base.h"
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <mutex>
 #include <functional>
 #include <memory>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 #include <regex>
 
@@ -39,20 +44,45 @@ namespace litecore::crypto {
     struct Identity;
 }
 namespace litecore::net {
+    class ResponderSocket;
     class TLSContext;
 }
 
 namespace litecore { namespace REST {
 
-    /** HTTP server with configurable URI handlers. */
+    /** HTTP server with configurable URI handlers.
+
+        Requests are handled on a pool of worker threads, so a slow request doesn't hold up
+        others. Connections are kept alive (HTTP/1.1) for further requests, which may be
+        pipelined; between requests an idle connection doesn't occupy a worker, but waits for
+        the Poller to report it readable, and is closed after kKeepAliveTimeout. If too many
+        connections are waiting for a worker, the server stops accepting new ones until the
+        backlog shrinks, leaving them in the listen queue. */
     class Server : public fleece::RefCounted, public fleece::InstanceCountedIn<Server> {
     public:
-        Server();
+        /** Maximum number of connections waiting for a worker before accepting pauses. */
+        static constexpr size_t kMaxQueuedConnections = 64;
+
+        /** Maximum number of requests handled on one connection before it's closed. */
+        static constexpr unsigned kMaxRequestsPerConnection = 1000;
+
+        /** How long an idle kept-alive connection stays open. */
+        static constexpr auto kKeepAliveTimeout = std::chrono::seconds(15);
+
+        /** Socket read/write timeout while handling a request, so a stalled client can't tie
+            up a worker indefinitely. */
+        static constexpr double kRequestTimeoutSecs = 30.0;
+
+        /** Creates a server. `workerCount` is the maximum number of requests handled at once;
+            0 means the default, twice the number of CPU cores (at least 4, at most 16.) */
+        explicit Server(unsigned workerCount =0);
         
         void start(uint16_t port,
                    slice networkInterface =nullslice,
                    net::TLSContext* =nullptr);
 
+        /** Stops listening and closes all connections, once the requests being handled finish.
+            May be called by a handler. The server can be started again afterwards. */
         virtual void stop();
 
         /** The port the Server is listening on. */
@@ -75,40 +105,89 @@ namespace litecore { namespace REST {
         using Handler = std::function<void(RequestResponse&)>;
 
         /** Registers a handler function for a URI pattern.
-            Patterns use glob syntax: <http://man7.org/linux/man-pages/man7/glob.7.html>
+            A pattern is either a route like "/{db}/_all_docs", whose captured segments are
+            available from `Request::pathParam` (see \ref Router), or else a regular expression.
+            Routes are looked up in a trie in one pass; regexes are matched one at a time.
             Multiple patterns can be joined with a "|".
             Patterns are tested in the order the handlers are added, and the first match is used.*/
         void addHandler(net::Methods, const std::string &pattern, const Handler&);
 
-        int connectionCount()                           {return _connectionCount;}
+        /** The number of open connections, including those handed off to WebSockets. */
+        int connectionCount()                           {return *_connectionCount;}
+
+        unsigned workerCount() const                    {return _workerCount;}
 
     protected:
         struct URIRule {
             net::Methods methods;
             std::string pattern;
-            std::regex  regex;
+            std::regex  regex;              // (unused if pattern is a route)
             Handler     handler;
         };
 
-        URIRule* findRule(net::Method method, const std::string &path);
+        URIRule* findRule(net::Method method, const std::string &path, Router::Captures&);
         virtual ~Server() override;
 
         void dispatchRequest(RequestResponse*);
 
     private:
+        using clock = std::chrono::steady_clock;
+
+        /** A client connection, between requests. */
+        struct Connection {
+            std::unique_ptr<net::ResponderSocket> socket;
+            unsigned            requestCount {0};       // Requests handled so far
+            clock::time_point   idleSince;              // When it was last made idle
+        };
+
+        /** The queue of connections ready to read, from which the workers take them. Unlike
+            actor::Channel, every push wakes a waiting worker, so that connections pushed in a
+            burst are handled in parallel. */
+        class ConnectionQueue {
+        public:
+            void push(std::unique_ptr<Connection>);
+            /** Blocks until a connection is available; returns null once the queue is closed. */
+            std::unique_ptr<Connection> pop();
+            size_t size() const;
+            void close();
+            void reopen();
+        private:
+            mutable std::mutex _mutex;
+            std::condition_variable _cond;
+            std::deque<std::unique_ptr<Connection>> _queue;
+            bool _closed {false};
+        };
+
         void awaitConnection();
         void acceptConnection();
-        void handleConnection(sockpp::stream_socket&&);
+        void resumeAccepting();
+        void workerTask();
+        void handleConnection(std::unique_ptr<Connection>);
+        bool openConnection(Connection&);
+        void idleConnection(std::unique_ptr<Connection>);
+        void connectionReadable(Connection*);
+        void closeIdleConnections(bool all);
 
         fleece::Retained<crypto::Identity> _identity;
         fleece::Retained<net::TLSContext> _tlsContext;
         std::unique_ptr<sockpp::acceptor> _acceptor;
         std::mutex _mutex;
         std::vector<URIRule> _rules;
+        Router _router;                                         // Routes to indexes in _rules
+        std::vector<unsigned> _regexRules;                      // Indexes of non-route rules
         std::map<std::string, std::string> _extraHeaders;
         uint16_t _port;
-        std::atomic<int> _connectionCount {0};
+        std::shared_ptr<std::atomic<int>> _connectionCount;    // Shared with sockets' onClose
         Authenticator _authenticator;
+
+        unsigned const _workerCount;                            // Number of worker threads
+        std::vector<std::thread> _workers;                      // Worker threads
+        ConnectionQueue _workQueue;                             // Connections ready to read
+        std::atomic<bool> _acceptPaused {false};                // Stopped accepting (backlog)?
+        std::atomic<bool> _stopping {false};                    // Has stop() been called?
+        std::mutex _idleMutex;                                  // Guards _idleConnections
+        std::unordered_map<Connection*, std::unique_ptr<Connection>> _idleConnections;
+        actor::Timer _idleTimer;                                // Closes idle connections
     };
 
 } }
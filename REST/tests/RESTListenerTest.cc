@@ -21,10 +21,21 @@
 #include "ListenerHarness.hh"
 #include "FilePath.hh"
 #include "Response.hh"
+#include "Router.hh"
+#include "Server.hh"
 #include "NetworkInterfaces.hh"
+#include "TCPSocket.hh"
+#include "Address.hh"
+#include "Benchmark.hh"
 #include "c4Internal.hh"
 #include "fleece/Mutable.hh"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <optional>
+#include <regex>
+#include <thread>
 
 using namespace litecore::net;
 using namespace litecore::REST;
@@ -297,6 +308,19 @@ TEST_CASE_METHOD(C4RESTTest, "REST _all_databases", "[REST][Listener][C]") {
 }
 
 
+TEST_CASE_METHOD(C4RESTTest, "REST _active_tasks and _actor_stats", "[REST][Listener][C]") {
+    // _active_tasks keeps CouchDB's shape: only tasks, each with a "type".
+    auto r = request("GET", "/_active_tasks", HTTPStatus::OK);
+    auto tasks = r->bodyAsJSON().asArray();
+    REQUIRE(tasks);
+    for (Array::iterator i(tasks); i; ++i)
+        CHECK(i.value().asDict()["type"].asString() != "actors"_sl);
+
+    r = request("GET", "/_actor_stats", HTTPStatus::OK);
+    CHECK(r->bodyAsJSON().asArray());
+}
+
+
 TEST_CASE_METHOD(C4RESTTest, "REST unknown special top-level", "[REST][Listener][C]") {
     request("GET", "/_foo", HTTPStatus::NotFound);
     request("GET", "/_", HTTPStatus::NotFound);
@@ -467,6 +491,60 @@ TEST_CASE_METHOD(C4RESTTest, "REST _all_docs", "[REST][Listener][C]") {
     CHECK(row["key"].asString() == "foo"_sl);
     row = rows[1].asDict();
     CHECK(row["key"].asString() == "mydocument"_sl);
+    CHECK(r->header("Transfer-Encoding") == "chunked"_sl);
+
+    // Key ranges, skip and limit:
+    auto keysOf = [&](const char *query) {
+        auto r = request("GET", string("/db/_all_docs?") + query, HTTPStatus::OK);
+        vector<string> keys;
+        for (Array::iterator i(r->bodyAsJSON().asDict()["rows"].asArray()); i; ++i)
+            keys.push_back(to_str(i->asDict()["key"]));
+        return keys;
+    };
+    CHECK(keysOf("startkey=%22g%22") == vector<string>{"mydocument"});
+    CHECK(keysOf("endkey=%22foo%22") == vector<string>{"foo"});
+    CHECK(keysOf("endkey=%22foo%22&inclusive_end=false").empty());
+    CHECK(keysOf("start_key=foo&end_key=mydocument") == vector<string>{"foo", "mydocument"});
+    CHECK(keysOf("descending=true&startkey=%22g%22") == vector<string>{"foo"});
+    CHECK(keysOf("descending=true&limit=1") == vector<string>{"mydocument"});
+    CHECK(keysOf("skip=1&limit=5") == vector<string>{"mydocument"});
+    request("GET", "/db/_all_docs?startkey=%22nope", HTTPStatus::BadRequest);
+}
+
+
+TEST_CASE_METHOD(C4RESTTest, "REST _query", "[REST][Listener][C]") {
+    request("PUT", "/db/mydocument",
+            {{"Content-Type", "application/json"}},
+            "{\"year\": 1964}"_sl, HTTPStatus::Created);
+    request("PUT", "/db/foo",
+            {{"Content-Type", "application/json"}},
+            "{\"age\": 17}"_sl, HTTPStatus::Created);
+
+    auto r = request("POST", "/db/_query",
+                     {{"Content-Type", "application/json"}},
+                     json5("{query: 'SELECT meta(db).id AS id, year FROM db WHERE year > $min', "
+                           "parameters: {min: 1900}}"),
+                     HTTPStatus::OK);
+    Array rows = r->bodyAsJSON().asDict()["rows"].asArray();
+    REQUIRE(rows.count() == 1);
+    CHECK(to_str(rows[0].asDict()["id"]) == "mydocument");
+    CHECK(rows[0].asDict()["year"].asInt() == 1964);
+
+    // JSON query; a MISSING column is omitted from its row:
+    r = request("POST", "/db/_query",
+                {{"Content-Type", "application/json"}},
+                json5("{query: {WHAT: [['._id'], ['.age']], ORDER_BY: [['._id']]}}"),
+                HTTPStatus::OK);
+    rows = r->bodyAsJSON().asDict()["rows"].asArray();
+    REQUIRE(rows.count() == 2);
+    CHECK(rows[0].asDict().count() == 2);
+    CHECK(rows[0].asDict()["age"].asInt() == 17);
+    CHECK(rows[1].asDict().count() == 1);
+
+    request("POST", "/db/_query",
+            {{"Content-Type", "application/json"}},
+            json5("{query: 'SELECT nonsense FROM WHERE'}"),
+            HTTPStatus::BadRequest);
 }
 
 
@@ -503,6 +581,299 @@ TEST_CASE_METHOD(C4RESTTest, "REST _bulk_docs", "[REST][Listener][C]") {
 }
 
 
+#pragma mark - CONNECTIONS:
+
+
+// Opens a raw client connection to the listener, for sending hand-made HTTP requests.
+static unique_ptr<ClientSocket> connectTo(C4Listener *listener) {
+    auto socket = make_unique<ClientSocket>();
+    Address addr("http"_sl, "localhost"_sl, c4listener_getPort(listener), "/"_sl);
+    REQUIRE(socket->connect(addr));
+    return socket;
+}
+
+
+// Reads an HTTP response from a raw connection: the status line and headers, and the body.
+static bool readRawResponse(ClientSocket &socket, string &headers, string &body) {
+    alloc_slice headerData = socket.readToDelimiter("\r\n\r\n"_sl);
+    if (!headerData)
+        return false;
+    headers = string(headerData);
+    auto pos = headers.find("Content-Length: ");
+    if (pos == string::npos)
+        return false;
+    size_t length = stoul(headers.substr(pos + 16));
+    body.resize(length);
+    return length == 0 || socket.readExactly(body.data(), length) == length;
+}
+
+
+static string readResponse(ClientSocket &socket, string *body =nullptr) {
+    string headers, content;
+    REQUIRE(readRawResponse(socket, headers, content));
+    if (body)
+        *body = move(content);
+    return headers;
+}
+
+
+TEST_CASE("REST Router", "[REST]") {
+    CHECK(Router::isRoute("/"));
+    CHECK(Router::isRoute("/{db}/_all_docs"));
+    CHECK(Router::isRoute("/{db}/{docID...}"));
+    CHECK(!Router::isRoute("/[^_][^/]*"));
+    CHECK(!Router::isRoute("/{docID...}/x"));
+    CHECK(!Router::isRoute("/x{2}"));
+
+    Router router;
+    router.add("/",                  Method::GET, 0);
+    router.add("/_all_dbs",          Method::GET, 1);
+    router.add("/{db}",              Method::GET, 2);
+    router.add("/{db}/_all_docs",    Method::GET, 3);
+    router.add("/{db}/{docID...}",   Methods(Method::GET | Method::PUT), 4);
+    router.add("/{db}/_blipsync",    Method::UPGRADE, 5);
+    router.add("/{db}/{docID}",      Method::GET, 6);      // shadowed by rule 4
+
+    Router::Captures captures;
+    CHECK(router.find(Method::GET, "/", captures) == 0);
+    CHECK(captures.empty());
+    CHECK(router.find(Method::GET, "/_all_dbs", captures) == 1);
+    CHECK(router.find(Method::GET, "/_other", captures) == -1);
+    CHECK(router.find(Method::GET, "/db%20x", captures) == 2);
+    CHECK(captures == Router::Captures{{"db", "db x"}});
+    CHECK(router.find(Method::GET, "/db/", captures) == -1);
+    CHECK(router.find(Method::GET, "/db/_all_docs", captures) == 3);
+    CHECK(captures == Router::Captures{{"db", "db"}});
+    CHECK(router.find(Method::PUT, "/db/_all_docs", captures) == -1);
+    CHECK(router.find(Method::PUT, "/db/doc", captures) == 4);
+    CHECK(captures == Router::Captures{{"db", "db"}, {"docID", "doc"}});
+    CHECK(router.find(Method::GET, "/db/a%2Fb/c", captures) == 4);
+    CHECK(captures == Router::Captures{{"db", "db"}, {"docID", "a/b/c"}});
+    CHECK(router.find(Method::GET, "/db/_blipsync", captures) == -1);
+    CHECK(router.find(Method::UPGRADE, "/db/_blipsync", captures) == 5);
+    CHECK(router.find(Method::DELETE, "/db/doc", captures) == -1);
+
+    ExpectingExceptions x;
+    CHECK_THROWS(router.add("/[^_][^/]*", Method::GET, 7));
+}
+
+
+TEST_CASE("REST Router Performance", "[REST][Perf][.slow]") {
+    // Compares the Router with matching the regexes RESTListener used to register:
+    static const char* const kRegexes[] = {
+        "/", "/_all_dbs", "/_active_tasks", "/_replicate",
+        "/[^_][^/]*", "/[^_][^/]*/", "/[^_][^/]*/_all_docs", "/[^_][^/]*/_bulk_docs",
+        "/[^_][^/]*/[^_].*", "/[^_][^/]*/_blipsync"};
+    static const char* const kRoutes[] = {
+        "/", "/_all_dbs", "/_active_tasks", "/_replicate",
+        "/{db}", "/{db}/", "/{db}/_all_docs", "/{db}/_bulk_docs",
+        "/{db}/{docID...}", "/{db}/_blipsync"};
+    static const char* const kPaths[] = {
+        "/", "/db", "/db/_all_docs", "/db/some-document-id", "/db/_blipsync", "/_nope"};
+    constexpr int kRepeats = 100000;
+
+    vector<regex> regexes;
+    Router router;
+    for (unsigned i = 0; i < size(kRoutes); ++i) {
+        regexes.emplace_back(kRegexes[i]);
+        router.add(kRoutes[i], Method::ALL, i);
+    }
+
+    for (auto path : kPaths) {
+        int regexRule = -1, routeRule = -1;
+        fleece::Stopwatch regexTime;
+        for (int n = 0; n < kRepeats; ++n) {
+            regexRule = -1;
+            for (unsigned i = 0; i < regexes.size(); ++i) {
+                if (regex_match(path, regexes[i])) {
+                    regexRule = i;
+                    break;
+                }
+            }
+        }
+        regexTime.stop();
+
+        fleece::Stopwatch routeTime;
+        Router::Captures captures;
+        for (int n = 0; n < kRepeats; ++n)
+            routeRule = router.find(Method::GET, path, captures);
+        routeTime.stop();
+        CHECK(routeRule == regexRule);
+
+        char label[100];
+        sprintf(label, "Matching %s with regexes", path);
+        regexTime.printReport(label, kRepeats, "lookup");
+        sprintf(label, "Matching %s with Router", path);
+        routeTime.printReport(label, kRepeats, "lookup");
+        C4Log("Router is %.1fx as fast as regexes on %s",
+              regexTime.elapsed() / routeTime.elapsed(), path);
+    }
+}
+
+
+TEST_CASE_METHOD(C4RESTTest, "REST keep-alive and pipelining", "[REST][Listener][C]") {
+    share(db, "db"_sl);
+    auto socket = connectTo(listener());
+
+    // Two pipelined requests, sent at once, get two responses on the same connection:
+    REQUIRE(socket->write_n("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                            "GET /db HTTP/1.1\r\nHost: localhost\r\n\r\n"_sl) > 0);
+    string body;
+    string headers = readResponse(*socket, &body);
+    CHECK(hasPrefix(headers, "HTTP/1.1 200 "));
+    CHECK(headers.find("Connection: keep-alive\r\n") != string::npos);
+    CHECK(body.find("\"couchdb\":\"Welcome\"") != string::npos);
+    headers = readResponse(*socket, &body);
+    CHECK(hasPrefix(headers, "HTTP/1.1 200 "));
+    CHECK(body.find("\"db_name\":\"db\"") != string::npos);
+
+    // A body sent with a GET is skipped, not mistaken for the start of the next request:
+    REQUIRE(socket->write_n("GET /db HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"
+                            "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"_sl) > 0);
+    headers = readResponse(*socket, &body);
+    CHECK(hasPrefix(headers, "HTTP/1.1 200 "));
+    CHECK(body.find("\"db_name\":\"db\"") != string::npos);
+    headers = readResponse(*socket, &body);
+    CHECK(hasPrefix(headers, "HTTP/1.1 200 "));
+    CHECK(body.find("\"couchdb\":\"Welcome\"") != string::npos);
+
+    // Another request after the connection's been idle:
+    this_thread::sleep_for(100ms);
+    REQUIRE(socket->write_n("PUT /db/doc HTTP/1.1\r\nContent-Type: application/json\r\n"
+                            "Content-Length: 2\r\n\r\n{}"_sl) > 0);
+    headers = readResponse(*socket);
+    CHECK(hasPrefix(headers, "HTTP/1.1 201 "));
+
+    // The server closes the connection after a request with "Connection: close":
+    REQUIRE(socket->write_n("GET /db/doc HTTP/1.1\r\nConnection: close\r\n\r\n"_sl) > 0);
+    headers = readResponse(*socket);
+    CHECK(hasPrefix(headers, "HTTP/1.1 200 "));
+    CHECK(headers.find("Connection: close\r\n") != string::npos);
+    char c;
+    CHECK(socket->read(&c, 1) == 0);
+    CHECK(socket->atReadEOF());
+}
+
+
+TEST_CASE("REST concurrent slow requests", "[REST]") {
+    // Requests arriving at once are handled by separate workers at the same time. Each handler
+    // waits until all of them are running, which they can only do if they run concurrently:
+    static constexpr unsigned kClients = 4;
+    fleece::Retained<Server> server(new Server(kClients));
+    mutex m;
+    condition_variable cond;
+    unsigned running = 0, sawAllRunning = 0;
+    Server::Handler slowHandler = [&](RequestResponse &rq) {
+        unique_lock<mutex> lock(m);
+        ++running;
+        cond.notify_all();
+        if (cond.wait_for(lock, 10s, [&] {return running >= kClients;}))
+            ++sawAllRunning;
+        lock.unlock();
+        rq.respondWithStatus(HTTPStatus::OK);
+    };
+
+    auto runClients = [&] {
+        atomic<unsigned> successes {0};
+        vector<thread> clients;
+        for (unsigned c = 0; c < kClients; ++c) {
+            clients.emplace_back([&] {
+                ClientSocket socket;
+                Address addr("http"_sl, "localhost"_sl, server->port(), "/slow"_sl);
+                string headers, body;
+                if (socket.connect(addr)
+                        && socket.write_n("GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n"_sl) > 0
+                        && readRawResponse(socket, headers, body)
+                        && hasPrefix(headers, "HTTP/1.1 200 "))
+                    ++successes;
+            });
+        }
+        for (auto &client : clients)
+            client.join();
+        return unsigned(successes);
+    };
+
+    server->addHandler(Method::GET, "/slow", slowHandler);
+    server->start(0);
+    CHECK(runClients() == kClients);
+    CHECK(sawAllRunning == kClients);
+    server->stop();
+
+    // A stopped server can be started again (stopping it removed its handlers):
+    running = sawAllRunning = 0;
+    server->addHandler(Method::GET, "/slow", slowHandler);
+    server->start(0);
+    CHECK(runClients() == kClients);
+    CHECK(sawAllRunning == kClients);
+    server->stop();
+}
+
+
+TEST_CASE_METHOD(C4RESTTest, "REST Server Load", "[REST][Listener][C][Perf][.slow]") {
+    static constexpr unsigned kRequestsPerClient = 200;
+    share(db, "db"_sl);
+    {
+        TransactionHelper t(db);
+        char docID[20];
+        for (unsigned i = 0; i < 100; ++i) {
+            sprintf(docID, "doc-%03u", i);
+            createRev(slice(docID), kRevID, kFleeceBody);
+        }
+    }
+
+    for (unsigned nClients : {1, 10, 50, 100, 250, 500}) {
+        // Each client sends requests one at a time on a kept-alive connection, timing each:
+        vector<vector<double>> latencies(nClients);
+        atomic<unsigned> failures {0};
+        fleece::Stopwatch st;
+        vector<thread> clients;
+        for (unsigned c = 0; c < nClients; ++c) {
+            clients.emplace_back([&, c] {
+                ClientSocket socket;
+                Address addr("http"_sl, "localhost"_sl, c4listener_getPort(listener()), "/"_sl);
+                if (!socket.connect(addr)) {
+                    ++failures;
+                    return;
+                }
+                auto &times = latencies[c];
+                times.reserve(kRequestsPerClient);
+                char request[100];
+                for (unsigned i = 0; i < kRequestsPerClient; ++i) {
+                    sprintf(request, "GET /db/doc-%03u HTTP/1.1\r\nHost: localhost\r\n\r\n", i % 100);
+                    fleece::Stopwatch rt;
+                    if (socket.write_n(slice(request)) <= 0) {
+                        ++failures;
+                        return;
+                    }
+                    string headers, body;
+                    if (!readRawResponse(socket, headers, body)) {
+                        ++failures;
+                        return;
+                    }
+                    times.push_back(rt.elapsed());
+                }
+            });
+        }
+        for (auto &client : clients)
+            client.join();
+        st.stop();
+
+        vector<double> all;
+        for (auto &times : latencies)
+            all.insert(all.end(), times.begin(), times.end());
+        sort(all.begin(), all.end());
+        CHECK(failures == 0);
+        REQUIRE(!all.empty());
+        double p99 = all[min(all.size() - 1, all.size() * 99 / 100)];
+        char label[100];
+        sprintf(label, "REST requests from %u clients", nClients);
+        st.printReport(label, unsigned(all.size()), "request");
+        C4Log("%s: median latency %.2fms, p99 %.2fms",
+              label, all[all.size() / 2] * 1000, p99 * 1000);
+    }
+}
+
+
 #pragma mark - HTTP AUTH:
 
 
@@ -0,0 +1,85 @@
+//
+// BlobTransferBudget.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#include "BlobTransferBudget.hh"
+#include "Error.hh"
+#include <algorithm>
+
+using namespace std;
+
+namespace litecore { namespace repl {
+
+    BlobTransferBudget::BlobTransferBudget(uint64_t maxBytes)
+    :_maxBytes(max(maxBytes, uint64_t(1)))
+    { }
+
+
+    bool BlobTransferBudget::reserve(uint64_t bytes, function<void()> onAvailable) {
+        lock_guard<mutex> lock(_mutex);
+        bytes = reservationFor(bytes);
+        if (_reservations > 0 && _reserved + bytes > _maxBytes) {
+            _waiters.push_back(move(onAvailable));
+            return false;
+        }
+        if (_reservations++ == 0)
+            _activeSince = clock::now();
+        _reserved += bytes;
+        _stats.maxBlobsPulling = max(_stats.maxBlobsPulling, uint32_t(_reservations));
+        _stats.peakBytesReserved = max(_stats.peakBytesReserved, _reserved);
+        return true;
+    }
+
+
+    void BlobTransferBudget::release(uint64_t bytes) {
+        vector<function<void()>> waiters;
+        {
+            lock_guard<mutex> lock(_mutex);
+            bytes = reservationFor(bytes);
+            DebugAssert(_reservations > 0 && _reserved >= bytes);
+            _reserved -= bytes;
+            if (--_reservations == 0)
+                _activeTime += clock::now() - _activeSince;
+            swap(waiters, _waiters);
+        }
+        // Call the waiters outside the lock, since they may try to reserve right away:
+        for (auto &waiter : waiters)
+            waiter();
+    }
+
+
+    void BlobTransferBudget::received(uint64_t bytes) {
+        lock_guard<mutex> lock(_mutex);
+        _stats.bytesPulled += bytes;
+    }
+
+
+    void BlobTransferBudget::pulledBlob() {
+        lock_guard<mutex> lock(_mutex);
+        ++_stats.blobsPulled;
+    }
+
+
+    void BlobTransferBudget::pushed(uint64_t bytes, bool blobComplete) {
+        lock_guard<mutex> lock(_mutex);
+        _stats.bytesPushed += bytes;
+        if (blobComplete)
+            ++_stats.blobsPushed;
+    }
+
+
+    C4BlobTransferStats BlobTransferBudget::stats() const {
+        lock_guard<mutex> lock(_mutex);
+        C4BlobTransferStats s = _stats;
+        auto active = _activeTime;
+        if (_reservations > 0)
+            active += clock::now() - _activeSince;
+        double secs = chrono::duration<double>(active).count();
+        if (secs > 0)
+            s.pullBytesPerSec = uint64_t(s.bytesPulled / secs);
+        return s;
+    }
+
+} }
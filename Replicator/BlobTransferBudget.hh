@@ -0,0 +1,71 @@
+//
+// BlobTransferBudget.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "c4Replicator.h"
+#include "fleece/RefCounted.hh"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+namespace litecore { namespace repl {
+
+    /** Limits the blobs being downloaded at once, across all incoming revisions, by their total
+        size; and measures blob transfers in both directions.
+
+        Before requesting a blob, an IncomingRev reserves its length (capped at the budget) and
+        releases it when the response ends. Since a blob's data is written to disk as it arrives,
+        the budget bounds the blob data that can be held in memory, while still letting several
+        small blobs, or the blobs of several revisions, download in parallel. A reservation is
+        always granted if nothing else is reserved, so a blob bigger than the budget can still be
+        downloaded, by itself.
+        Thread-safe. */
+    class BlobTransferBudget : public fleece::RefCounted {
+    public:
+        using clock     = std::chrono::steady_clock;
+
+        explicit BlobTransferBudget(uint64_t maxBytes);
+
+        uint64_t maxBytes() const               {return _maxBytes;}
+
+        /** Reserves room for downloading a blob of size `bytes`. If there isn't room, returns
+            false and remembers `onAvailable`, which will be called (on an arbitrary thread) the
+            next time a reservation is released; the caller should then try again. */
+        bool reserve(uint64_t bytes, std::function<void()> onAvailable);
+
+        /** Releases a reservation made by `reserve` with the same `bytes`, once the blob's
+            download has ended, successfully or not. */
+        void release(uint64_t bytes);
+
+        /** Records that `bytes` of a downloading blob have been received. */
+        void received(uint64_t bytes);
+
+        /** Records a blob successfully downloaded. */
+        void pulledBlob();
+
+        /** Records `bytes` of a blob sent to the peer, and whether the blob is complete. */
+        void pushed(uint64_t bytes, bool blobComplete);
+
+        /** The statistics so far. */
+        C4BlobTransferStats stats() const;
+
+    private:
+        uint64_t reservationFor(uint64_t bytes) const   {return std::min(bytes, _maxBytes);}
+
+        uint64_t const                  _maxBytes;
+        mutable std::mutex              _mutex;
+        uint64_t                        _reserved {0};          // Bytes currently reserved
+        unsigned                        _reservations {0};      // # blobs currently reserved
+        std::vector<std::function<void()>> _waiters;            // Callbacks waiting for room
+        clock::time_point               _activeSince;           // When _reservations became >0
+        clock::duration                 _activeTime {};         // Total time _reservations was >0
+        C4BlobTransferStats             _stats {};
+    };
+
+} }
@@ -27,6 +27,7 @@
 #include "c4DocEnumerator.h"
 #include "c4Private.h"
 #include "c4Transaction.hh"
+#include <algorithm>
 #include <functional>
 #include <set>
 #include <utility>
@@ -38,7 +39,7 @@ namespace litecore { namespace repl {
     using namespace fleece;
 
 
-    DBAccess::DBAccess(C4Database* db, bool disableBlobSupport)
+    DBAccess::DBAccess(C4Database* db, bool disableBlobSupport, unsigned maxReadOnlyDBs)
     :access_lock(move(db))
     ,Logging(SyncLog)
     ,_blobStore(c4db_getBlobStore(db, nullptr))
@@ -47,7 +48,10 @@ namespace litecore { namespace repl {
                        bind(&DBAccess::markRevsSyncedLater, this),
                        tuning::kInsertionDelay)
     ,_timer(bind(&DBAccess::markRevsSyncedNow, this))
+    ,_maxReadOnlyDBs(std::max(maxReadOnlyDBs, 1u))
     ,_usingVersionVectors((c4db_getConfig2(db)->flags & kC4DB_VersionVectors) != 0)
+    // The peer ID is read now, since RevEncoders on other threads need it:
+    ,_myPeerID(_usingVersionVectors ? string(alloc_slice(c4db_getPeerID(db))) : string())
     {
         c4db_retain(db);
         // Copy database's sharedKeys:
@@ -73,6 +77,59 @@ namespace litecore { namespace repl {
     }
 
 
+    void DBAccess::useReadOnly(function_ref<void(C4Database*)> callback) {
+        // Check out an idle handle, or open a new one if there's room in the pool:
+        C4Database *rdb = nullptr;
+        {
+            unique_lock<mutex> lock(_readOnlyMutex);
+            _readOnlyCond.wait(lock, [&] {
+                return !_readOnlyDBs.empty() || _readOnlyDBCount < _maxReadOnlyDBs;
+            });
+            if (!_readOnlyDBs.empty()) {
+                rdb = _readOnlyDBs.back();
+                _readOnlyDBs.pop_back();
+            } else {
+                ++_readOnlyDBCount;
+            }
+        }
+        if (!rdb) {
+            C4Error error;
+            use([&](C4Database *db) {
+                C4DatabaseConfig2 config = *c4db_getConfig2(db);
+                config.flags = C4DatabaseFlags((config.flags | kC4DB_ReadOnly) & ~kC4DB_Create);
+                rdb = c4db_openNamed(c4db_getName(db), &config, &error);
+            });
+            if (!rdb) {
+                logError("Couldn't open read-only db connection: %s",
+                         c4error_descriptionStr(error));
+                {
+                    lock_guard<mutex> lock(_readOnlyMutex);
+                    --_readOnlyDBCount;
+                }
+                _readOnlyCond.notify_one();
+                use(callback);
+                return;
+            }
+        }
+
+        // Return the handle to the pool afterwards, even if the callback throws:
+        auto checkIn = [&] {
+            {
+                lock_guard<mutex> lock(_readOnlyMutex);
+                _readOnlyDBs.push_back(rdb);
+            }
+            _readOnlyCond.notify_one();
+        };
+        try {
+            callback(rdb);
+        } catch (...) {
+            checkIn();
+            throw;
+        }
+        checkIn();
+    }
+
+
     DBAccess::~DBAccess() {
         _timer.stop();
         use([&](C4Database *db) {
@@ -83,20 +140,15 @@ namespace litecore { namespace repl {
                 c4db_release(idb);
             });
         }
+        for (C4Database *rdb : _readOnlyDBs)
+            c4db_release(rdb);
     }
 
 
-    string DBAccess::convertVersionToAbsolute(slice revID) {
+    string DBAccess::convertVersionToAbsolute(slice revID) const {
         string version(revID);
-        if (_usingVersionVectors) {
-            if (_myPeerID.empty()) {
-                use([&](C4Database *c4db) {
-                    if (_myPeerID.empty())
-                        _myPeerID = string(alloc_slice(c4db_getPeerID(c4db)));
-                });
-            }
+        if (_usingVersionVectors)
             replace(version, "*", _myPeerID);
-        }
         return version;
     }
 
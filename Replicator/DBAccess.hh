@@ -23,12 +23,15 @@
 #include "Batcher.hh"
 #include "Logging.hh"
 #include "Timer.hh"
+#include "ReplicatorTuning.hh"
 #include "access_lock.hh"
 #include "function_ref.hh"
 #include "fleece/Fleece.hh"
 #include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 
 namespace litecore { namespace repl {
@@ -41,7 +44,8 @@ namespace litecore { namespace repl {
         using alloc_slice = fleece::alloc_slice;
         using Dict = fleece::Dict;
 
-        DBAccess(C4Database* db, bool disableBlobSupport);
+        DBAccess(C4Database* db, bool disableBlobSupport,
+                 unsigned maxReadOnlyDBs =tuning::kMaxRevEncoders);
         ~DBAccess();
 
         /** Looks up the remote DB identifier of this replication. */
@@ -52,7 +56,9 @@ namespace litecore { namespace repl {
 
         bool usingVersionVectors() const                {return _usingVersionVectors;}
 
-        string convertVersionToAbsolute(slice revID);
+        /** Replaces the local peer ID "*" in a version with the real peer ID.
+            Thread-safe, since RevEncoders call it. */
+        string convertVersionToAbsolute(slice revID) const;
 
         // (The "use" method is inherited from access_lock)
 
@@ -158,6 +164,12 @@ namespace litecore { namespace repl {
             return insertionDB().use<RESULT>(callback);
         }
 
+        /** Calls the callback with one of a pool of read-only database handles, so several
+            threads can read documents at once without contending for the main handle. Blocks
+            if all of the (up to `maxReadOnlyDBs`) handles are busy. If a read-only handle can't
+            be opened, falls back to "use()". */
+        void useReadOnly(fleece::function_ref<void(C4Database*)> callback);
+
         /** Manages a transaction safely. The begin() method calls beginTransaction, then commit()
             or abort() end it. If the object exits scope when it's been begun but not yet
             ended, it aborts the transaction. */
@@ -217,8 +229,13 @@ namespace litecore { namespace repl {
         actor::Timer _timer;                                // Implements Batcher delay
         bool _inTransaction {false};                        // True while in a transaction
         std::unique_ptr<access_lock<C4Database*>> _insertionDB; // DB handle to use for insertions
-        std::string _myPeerID;
+        std::mutex _readOnlyMutex;                          // Guards the _readOnlyDBs pool
+        std::condition_variable _readOnlyCond;              // Signaled when a handle is returned
+        std::vector<C4Database*> _readOnlyDBs;              // Idle read-only DB handles
+        unsigned _readOnlyDBCount {0};                      // Total read-only handles opened
+        unsigned const _maxReadOnlyDBs;                     // Max size of the _readOnlyDBs pool
         const bool _usingVersionVectors;                    // True if DB uses version vectors
+        std::string const _myPeerID;                        // Local peer ID, if using versions
     };
 
 } }
@@ -0,0 +1,123 @@
+//
+// FlowController.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#include "FlowController.hh"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace litecore { namespace repl {
+
+    static inline double toSeconds(FlowController::duration d) {
+        return duration_cast<std::chrono::duration<double>>(d).count();
+    }
+
+    static inline uint64_t clampTo(double value, const FlowController::Range &range) {
+        return uint64_t(max(double(range.min), min(value, double(range.max))));
+    }
+
+
+    FlowController::FlowController(const Config &config, bool adaptive)
+    :_config(config)
+    ,_adaptive(adaptive)
+    ,_window(double(config.inFlight.initial))
+    ,_maxInFlight(unsigned(config.inFlight.initial))
+    ,_maxBytesInFlight(config.bytesInFlight.initial)
+    ,_batchSize(unsigned(config.batchSize.initial))
+    { }
+
+
+    void FlowController::completed(duration rtt, uint64_t bytes, unsigned count,
+                                   clock::time_point now)
+    {
+        lock_guard<mutex> lock(_mutex);
+        rtt = max(rtt, duration(microseconds(1)));
+
+        // Round-trip time:
+        if (_minRTT == duration::zero() || rtt <= _minRTT || now - _minRTTTime > kMinRTTLifetime) {
+            _minRTT = rtt;
+            _minRTTTime = now;
+        }
+        if (_smoothedRTT == duration::zero())
+            _smoothedRTT = rtt;
+        else
+            _smoothedRTT = (7 * _smoothedRTT + rtt) / 8;
+
+        // Throughput, sampled over intervals of about one round trip:
+        if (_sampleStart == clock::time_point())
+            _sampleStart = now - rtt;
+        _sampleBytes += bytes;
+        _sampleCount += count;
+        auto elapsed = now - _sampleStart;
+        if (elapsed >= max(_smoothedRTT, duration(kMinSampleInterval))) {
+            double secs = toSeconds(elapsed);
+            _bandwidthSamples[_bandwidthIndex++ % kBandwidthSamples] = _sampleBytes / secs;
+            _bandwidth = *max_element(begin(_bandwidthSamples), end(_bandwidthSamples));
+            double rate = _sampleCount / secs;
+            _completionRate = (_completionRate > 0) ? (3 * _completionRate + rate) / 4 : rate;
+            _sampleStart = now;
+            _sampleBytes = _sampleCount = 0;
+        }
+
+        // Request window. (The peer's deliberate reply delay isn't queueing, so allow for it.)
+        if (double(rtt.count()) > kQueueingFactor * double(_minRTT.count())
+                                  + double(_config.replyDelay.count()))
+            decrease(kDecreaseFactor, now);
+        else if (_slowStart)
+            _window += count;
+        else
+            _window += count / _window;
+
+        updateLimits();
+    }
+
+
+    void FlowController::failed(clock::time_point now) {
+        lock_guard<mutex> lock(_mutex);
+        decrease(kFailureFactor, now);
+        updateLimits();
+    }
+
+
+    // Shrinks the window, but no more than once per round trip, since the requests already
+    // in flight will report the same congestion.
+    void FlowController::decrease(double factor, clock::time_point now) {
+        if (!_slowStart && now - _lastDecrease < _smoothedRTT)
+            return;
+        _window = max(_window * factor, double(_config.inFlight.min));
+        _slowStart = false;
+        _lastDecrease = now;
+    }
+
+
+    void FlowController::updateLimits() {
+        if (!_adaptive)
+            return;
+        _window = min(_window, double(_config.inFlight.max));
+        _maxInFlight = unsigned(clampTo(floor(_window), _config.inFlight));
+        if (_bandwidth > 0 && _config.bytesInFlight.max > 0)
+            _maxBytesInFlight = clampTo(2 * _bandwidth * toSeconds(_minRTT), _config.bytesInFlight);
+        if (_completionRate > 0)
+            _batchSize = unsigned(clampTo(_completionRate * toSeconds(_smoothedRTT),
+                                          _config.batchSize));
+    }
+
+
+    C4FlowControlState FlowController::state() const {
+        lock_guard<mutex> lock(_mutex);
+        C4FlowControlState s;
+        s.roundTripMS       = uint32_t(duration_cast<milliseconds>(_smoothedRTT).count());
+        s.minRoundTripMS    = uint32_t(duration_cast<milliseconds>(_minRTT).count());
+        s.bytesPerSec       = uint64_t(_bandwidth);
+        s.maxInFlight       = _maxInFlight;
+        s.maxBytesInFlight  = _maxBytesInFlight;
+        s.batchSize         = _batchSize;
+        return s;
+    }
+
+} }
@@ -0,0 +1,103 @@
+//
+// FlowController.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "c4Replicator.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdint.h>
+
+namespace litecore { namespace repl {
+
+    /** Adaptive flow control for one direction of replication. It replaces fixed limits on the
+        number and size of revisions in flight with ones tuned from the round-trip time and
+        throughput measured on the connection, loosely following TCP congestion control:
+
+        - The request window (`maxInFlight`) starts in "slow start", growing by one per
+          completed request, i.e. doubling every round trip. Once a round trip takes much longer
+          than the shortest one seen recently, requests are queueing somewhere, so the window is
+          cut multiplicatively; from then on it grows by one per round trip (AIMD.)
+          The peer may deliberately hold a request for up to `replyDelay` before answering (as
+          a LiteCore peer does while it batches inserts), so a round trip has to exceed the
+          queueing threshold by more than that to count.
+        - The byte limit is twice the bandwidth-delay product: the best recent throughput times
+          the minimum RTT, as in BBR.
+        - The batch size is the number of requests completed in one round trip, so the next
+          batch of changes arrives before the current one is used up.
+
+        All limits stay within the ranges given in the Config. If not adaptive, the limits stay
+        at their initial values but measurements are still made.
+        Thread-safe: the limits can be read from any thread. */
+    class FlowController {
+    public:
+        using clock     = std::chrono::steady_clock;
+        using duration  = clock::duration;
+
+        struct Range {
+            uint64_t min, initial, max;
+        };
+
+        struct Config {
+            Range inFlight;         ///< Number of requests in flight
+            Range bytesInFlight;    ///< Bytes in flight (max=0 for no limit)
+            Range batchSize;        ///< Number of changes per `changes` message
+            duration replyDelay;    ///< Max time the peer may hold a request before replying
+        };
+
+        explicit FlowController(const Config&, bool adaptive =true);
+
+        /** Records the completion of `count` requests totaling `bytes`, the first of which took
+            `rtt` from being sent to being answered. */
+        void completed(duration rtt, uint64_t bytes, unsigned count =1,
+                       clock::time_point now =clock::now());
+
+        /** Records a transient failure, like a timeout or 503 error; shrinks the window. */
+        void failed(clock::time_point now =clock::now());
+
+        unsigned maxInFlight() const        {return _maxInFlight;}
+        uint64_t maxBytesInFlight() const   {return _maxBytesInFlight;}
+        unsigned batchSize() const          {return _batchSize;}
+
+        /** The current measurements and limits. */
+        C4FlowControlState state() const;
+
+    private:
+        void decrease(double factor, clock::time_point now);
+        void updateLimits();
+
+        static constexpr double   kQueueingFactor = 2.0;    // RTT/minRTT that implies queueing
+        static constexpr double   kDecreaseFactor = 0.75;   // Window multiplier on queueing
+        static constexpr double   kFailureFactor  = 0.5;    // Window multiplier on failure
+        static constexpr unsigned kBandwidthSamples = 8;    // # samples to take max throughput of
+        static constexpr auto     kMinRTTLifetime = std::chrono::seconds(10);
+        static constexpr auto     kMinSampleInterval = std::chrono::milliseconds(10);
+
+        Config const            _config;
+        bool const              _adaptive;
+        mutable std::mutex      _mutex;
+
+        duration                _minRTT {};             // Lowest recent round-trip time
+        clock::time_point       _minRTTTime;            // When _minRTT was measured
+        duration                _smoothedRTT {};        // Moving average of round-trip time
+        double                  _window;                // Fractional request window
+        bool                    _slowStart {true};      // Still growing exponentially?
+        clock::time_point       _lastDecrease;          // When window was last decreased
+
+        clock::time_point       _sampleStart;           // Start of current throughput sample
+        uint64_t                _sampleBytes {0};       // Bytes completed in current sample
+        uint64_t                _sampleCount {0};       // Requests completed in current sample
+        double                  _bandwidthSamples[kBandwidthSamples] {};  // Bytes/sec
+        unsigned                _bandwidthIndex {0};
+        double                  _bandwidth {0};         // Max of _bandwidthSamples
+        double                  _completionRate {0};    // Smoothed requests/sec
+
+        std::atomic<unsigned>   _maxInFlight;           // Current limits (readable w/o lock)
+        std::atomic<uint64_t>   _maxBytesInFlight;
+        std::atomic<unsigned>   _batchSize;
+    };
+
+} }
@@ -19,9 +19,11 @@
 #include "IncomingRev.hh"
 #include "Replicator.hh"
 #include "DBAccess.hh"
+#include "ReplicatorTuning.hh"
 #include "StringUtil.hh"
 #include "MessageBuilder.hh"
 #include "c4BlobStore.h"
+#include "c4Private.h"
 #include <atomic>
 
 using namespace fleece;
@@ -34,14 +36,30 @@ namespace litecore { namespace repl {
     static std::atomic_int sMaxOpenWriters {0};
 #endif
 
-    // Looks for another blob to download; when they're all done, finishes up the revision.
-    void IncomingRev::fetchNextBlob() {
-        while (_blob != _pendingBlobs.end()) {
-            if (startBlob())
+    // Requests as many of the remaining blobs as the per-revision limit and the replicator's
+    // blob budget allow; when they're all done, finishes up the revision.
+    void IncomingRev::fetchBlobs() {
+        while (_nextBlob < _pendingBlobs.size() && _blobsInFlight < tuning::kMaxBlobsPerIncomingRev) {
+            const PendingBlob &blob = _pendingBlobs[_nextBlob];
+            if (c4blob_getSize(_db->blobStore(), blob.key) >= 0) {
+                ++_nextBlob;  // already have it
+                continue;
+            }
+            Retained<IncomingRev> retainSelf = this;
+            if (!_blobBudget->reserve(blob.length, [retainSelf] {
+                retainSelf->enqueue(FUNCTION_TO_QUEUE(IncomingRev::blobBudgetAvailable));
+            })) {
+                logVerbose("Waiting for other blobs to download (%u of mine in flight)",
+                           _blobsInFlight);
+                _waitingForBudget = true;
                 return;
-            ++_blob;
+            }
+            startBlob(_nextBlob++);
         }
 
+        if (_nextBlob < _pendingBlobs.size() || _blobsInFlight > 0)
+            return;
+
         // All blobs completed, now finish:
         if (_rev->error.code == 0) {
             logVerbose("All blobs received, now inserting revision");
@@ -52,58 +70,217 @@ namespace litecore { namespace repl {
     }
 
 
-    // If the blob described by `_blob` exists locally, returns false.
-    // Else sends a request for its data.
-    bool IncomingRev::startBlob() {
-        Assert(!_writer);
-        if (c4blob_getSize(_db->blobStore(), _blob->key) >= 0)
-            return false;  // already have it
+    // Called when another blob download has ended, after `fetchBlobs` was turned down.
+    void IncomingRev::blobBudgetAvailable() {
+        if (_waitingForBudget && !_pendingBlobs.empty()) {
+            _waitingForBudget = false;
+            fetchBlobs();
+        }
+    }
+
+
+    // Starts downloading a blob; room for it has been reserved in the budget.
+    void IncomingRev::startBlob(size_t index) {
+        const PendingBlob &blob = _pendingBlobs[index];
+        BlobDownload &download = _blobDownloads[index];
+        Assert(!download.active);
 
-        logVerbose("Requesting blob (%" PRIu64 " bytes, compress=%d)", _blob->length, _blob->compressible);
+        addProgress({0, blob.length});
+        download.active = true;
+        download.bytesWritten = 0;
+        download.chunks.clear();
+        download.nextChunk = 0;
+        download.chunkBytesReceived = 0;
+        ++_blobsInFlight;
+
+        if (blob.length >= tuning::kMinChunkedBlobDownload && c4blob_isChunkedStore(_db->blobStore()))
+            requestBlobChunkList(index);
+        else
+            requestBlob(index);
+    }
 
-        addProgress({0, _blob->length});
-        _blobBytesWritten = 0;
 
+    // Sends a request for the data of a blob.
+    void IncomingRev::requestBlob(size_t index) {
+        const PendingBlob &blob = _pendingBlobs[index];
+        logVerbose("Requesting blob (%" PRIu64 " bytes, compress=%d)", blob.length, blob.compressible);
         MessageBuilder req("getAttachment"_sl);
-        alloc_slice digest = c4blob_keyToString(_blob->key);
+        alloc_slice digest = c4blob_keyToString(blob.key);
         req["digest"_sl] = digest;
-        if (_blob->compressible)
+        if (blob.compressible)
             req["compress"_sl] = "true"_sl;
+        Retained<RevToInsert> rev = _rev;
+        uint64_t reserved = blob.length;
         sendRequest(req, [=](blip::MessageProgress progress) {
             //... After request is sent:
-            if (_blob != _pendingBlobs.end()) {
-                if (progress.state == MessageProgress::kDisconnected) {
-                    // Set some error, so my IncomingRev will know I didn't complete [CBL-608]
-                    blobGotError({POSIXDomain, ECONNRESET});
-                } else if (progress.reply) {
-                    if (progress.reply->isError()) {
-                        auto err = progress.reply->getError();
-                        logError("Got error response: %.*s %d '%.*s'",
-                                 SPLAT(err.domain), err.code, SPLAT(err.message));
-                        blobGotError(blipToC4Error(err));
-                    } else {
-                        bool complete = progress.state == MessageProgress::kComplete;
-                        auto data = progress.reply->extractBody();
-                        writeToBlob(data);
-                        if (complete || data.size > 0)
-                            notifyBlobProgress(complete);
-                        if (complete)
-                            finishBlob();
-                    }
-                }
+            blobProgress(rev, index, reserved, progress);
+        });
+    }
+
+
+    // Asks the peer for the list of chunks of a blob, so that only the chunks I don't already
+    // have need to be downloaded.
+    void IncomingRev::requestBlobChunkList(size_t index) {
+        const PendingBlob &blob = _pendingBlobs[index];
+        logVerbose("Requesting chunk list of blob (%" PRIu64 " bytes)", blob.length);
+        MessageBuilder req("getAttachmentChunkList"_sl);
+        alloc_slice digest = c4blob_keyToString(blob.key);
+        req["digest"_sl] = digest;
+        Retained<RevToInsert> rev = _rev;
+        uint64_t reserved = blob.length;
+        sendRequest(req, [=](blip::MessageProgress progress) {
+            gotBlobChunkList(rev, index, reserved, progress);
+        });
+    }
+
+
+    // Handles the response to `requestBlobChunkList`, by requesting the missing chunks; or the
+    // whole blob, if the peer can't send chunks. The budget stays reserved until the data
+    // request ends.
+    void IncomingRev::gotBlobChunkList(Retained<RevToInsert> rev, size_t index, uint64_t reserved,
+                                       blip::MessageProgress progress)
+    {
+        if (progress.state < MessageProgress::kComplete)
+            return;
+        bool current = (rev == _rev && index < _blobDownloads.size()
+                                    && _blobDownloads[index].active);
+        if (!current || progress.state == MessageProgress::kDisconnected) {
+            _blobBudget->release(reserved);
+            if (current) {
+                --_blobsInFlight;
+                blobGotError({POSIXDomain, ECONNRESET});
             }
+            return;
+        }
+
+        if (progress.reply->isError()) {
+            // An older peer, or one whose blob isn't stored in chunks:
+            auto err = progress.reply->getError();
+            logVerbose("Can't get chunk list (%.*s %d); requesting entire blob",
+                       SPLAT(err.domain), err.code);
+            requestBlob(index);
+            return;
+        }
+
+        if (!readBlobChunkList(index, progress.reply->JSONBody().asArray())) {
+            _blobBudget->release(reserved);
+            --_blobsInFlight;
+            blobGotError({LiteCoreDomain, kC4ErrorRemoteError});
+            return;
+        }
+
+        BlobDownload &download = _blobDownloads[index];
+        MessageBuilder req("getAttachmentChunks"_sl);
+        alloc_slice digest = c4blob_keyToString(_pendingBlobs[index].key);
+        req["digest"_sl] = digest;
+        if (_pendingBlobs[index].compressible)
+            req["compress"_sl] = "true"_sl;
+        auto &enc = req.jsonBody();
+        enc.beginArray();
+        unsigned nWanted = 0;
+        for (auto &chunk : download.chunks) {
+            if (!chunk.local) {
+                enc.writeString(alloc_slice(c4blob_keyToString(chunk.key)));
+                ++nWanted;
+            }
+        }
+        enc.endArray();
+        logVerbose("Blob has %zu chunks; requesting %u", download.chunks.size(), nWanted);
+
+        if (nWanted == 0) {
+            // I have all the chunks, so assemble the blob without asking the peer for anything:
+            _blobBudget->release(reserved);
+            --_blobsInFlight;
+            if (!writeToBlob(index, alloc_slice()))
+                return;
+            notifyBlobProgress(index, true);
+            finishBlob(index);
+            return;
+        }
+
+        sendRequest(req, [=](blip::MessageProgress progress) {
+            blobProgress(rev, index, reserved, progress);
         });
+    }
+
+
+    // Parses a chunk list sent by the peer, noting which chunks I already have.
+    bool IncomingRev::readBlobChunkList(size_t index, Array list) {
+        BlobDownload &download = _blobDownloads[index];
+        C4BlobStore *blobStore = _db->blobStore();
+        uint64_t totalLength = 0;
+        download.chunks.clear();
+        download.chunks.reserve(list.count());
+        for (Array::iterator i(list); i; ++i) {
+            Array item = i->asArray();
+            BlobChunk chunk;
+            if (!c4blob_keyFromString(item[0].asString(), &chunk.key) || item[1].asUnsigned() == 0) {
+                warn("Invalid chunk list from peer");
+                return false;
+            }
+            chunk.length = uint32_t(item[1].asUnsigned());
+            chunk.local = c4blob_hasChunk(blobStore, chunk.key);
+            totalLength += chunk.length;
+            download.chunks.push_back(chunk);
+        }
+        if (totalLength != _pendingBlobs[index].length) {
+            warn("Chunk list from peer doesn't match blob length");
+            return false;
+        }
         return true;
     }
 
 
-    // Writes data to the blob on disk.
-    void IncomingRev::writeToBlob(alloc_slice data) {
+    // Handles the progress of a blob request, writing any data that's arrived to disk. Since an
+    // error ends the revision while other blobs are still downloading, progress of a blob
+    // request that no longer belongs to the current revision is ignored.
+    void IncomingRev::blobProgress(Retained<RevToInsert> rev, size_t index, uint64_t reserved,
+                                   blip::MessageProgress progress)
+    {
+        bool current = (rev == _rev && index < _blobDownloads.size()
+                                    && _blobDownloads[index].active);
+        if (progress.state >= MessageProgress::kComplete) {
+            // The response has ended, so let other blobs use its part of the budget:
+            _blobBudget->release(reserved);
+            if (current)
+                --_blobsInFlight;
+        }
+        if (!current)
+            return;
+
+        if (progress.state == MessageProgress::kDisconnected) {
+            // Set some error, so my IncomingRev will know I didn't complete [CBL-608]
+            blobGotError({POSIXDomain, ECONNRESET});
+        } else if (progress.reply) {
+            if (progress.reply->isError()) {
+                auto err = progress.reply->getError();
+                logError("Got error response: %.*s %d '%.*s'",
+                         SPLAT(err.domain), err.code, SPLAT(err.message));
+                blobGotError(blipToC4Error(err));
+            } else {
+                bool complete = progress.state == MessageProgress::kComplete;
+                auto data = progress.reply->extractBody();
+                if (!writeToBlob(index, data))
+                    return;
+                if (complete || data.size > 0)
+                    notifyBlobProgress(index, complete);
+                if (complete)
+                    finishBlob(index);
+            }
+        }
+    }
+
+
+    // Writes data to the blob on disk, as it arrives.
+    bool IncomingRev::writeToBlob(size_t index, alloc_slice data) {
+        BlobDownload &download = _blobDownloads[index];
         C4Error err;
-		if(_writer == nullptr) {
-            _writer = c4blob_openWriteStream(_db->blobStore(), &err);
-            if (!_writer)
-                return gotError(err);
+        if (download.writer == nullptr) {
+            download.writer = c4blob_openWriteStream(_db->blobStore(), &err);
+            if (!download.writer) {
+                blobGotError(err);
+                return false;
+            }
 #if DEBUG
             int n = ++sNumOpenWriters;
             if (n > sMaxOpenWriters) {
@@ -112,51 +289,103 @@ namespace litecore { namespace repl {
             }
             logVerbose("Opened blob writer  [%d open; max %d]", n, (int)sMaxOpenWriters);
 #endif
-		}
+        }
+        _blobBudget->received(data.size);
+        if (download.chunks.empty())
+            return writeBlobData(download, data);
+        else
+            return writeBlobChunks(download, data);
+    }
+
+
+    // Writes the data of the missing chunks, received from the peer, to a blob being downloaded
+    // by chunk; and copies the local chunks that come before, between and after them.
+    bool IncomingRev::writeBlobChunks(BlobDownload &download, slice data) {
+        while (download.nextChunk < download.chunks.size()) {
+            const BlobChunk &chunk = download.chunks[download.nextChunk];
+            if (chunk.local) {
+                C4Error err;
+                alloc_slice chunkData(c4blob_getChunk(_db->blobStore(), chunk.key, &err));
+                if (!chunkData) {
+                    blobGotError(err);
+                    return false;
+                }
+                if (!writeBlobData(download, chunkData))
+                    return false;
+                ++download.nextChunk;
+            } else if (data.size > 0) {
+                size_t n = std::min(data.size, size_t(chunk.length - download.chunkBytesReceived));
+                if (!writeBlobData(download, data.upTo(n)))
+                    return false;
+                data.moveStart(n);
+                download.chunkBytesReceived += uint32_t(n);
+                if (download.chunkBytesReceived == chunk.length) {
+                    ++download.nextChunk;
+                    download.chunkBytesReceived = 0;
+                }
+            } else {
+                break;  // Wait for more data
+            }
+        }
         if (data.size > 0) {
-            if (!c4stream_write(_writer, data.buf, data.size, &err))
-                return gotError(err);
-            _blobBytesWritten += data.size;
-            addProgress({data.size, 0});
+            // The peer sent more than the missing chunks:
+            blobGotError({LiteCoreDomain, kC4ErrorCorruptData});
+            return false;
         }
+        return true;
     }
 
 
-    // Saves the blob to the database, and starts working on the next one (if any).
-    void IncomingRev::finishBlob() {
-        alloc_slice digest = c4blob_keyToString(_blob->key);
-        logVerbose("Finished receiving blob %.*s (%" PRIu64 " bytes)", SPLAT(digest), _blob->length);
+    bool IncomingRev::writeBlobData(BlobDownload &download, slice data) {
+        if (data.size == 0)
+            return true;
         C4Error err;
-        if (!c4stream_install(_writer, &_blob->key, &err)) {
+        if (!c4stream_write(download.writer, data.buf, data.size, &err)) {
             blobGotError(err);
-            return;
+            return false;
         }
-        closeBlobWriter();
+        download.bytesWritten += data.size;
+        addProgress({data.size, 0});
+        return true;
+    }
+
 
-        ++_blob;
-        fetchNextBlob();
+    // Saves the blob to the database, and starts downloading another one (if any).
+    void IncomingRev::finishBlob(size_t index) {
+        const PendingBlob &blob = _pendingBlobs[index];
+        BlobDownload &download = _blobDownloads[index];
+        alloc_slice digest = c4blob_keyToString(blob.key);
+        logVerbose("Finished receiving blob %.*s (%" PRIu64 " bytes)", SPLAT(digest), blob.length);
+        C4Error err;
+        if (!c4stream_install(download.writer, &blob.key, &err)) {
+            blobGotError(err);
+            return;
+        }
+        closeBlobWriter(download);
+        download.active = false;
+        _blobBudget->pulledBlob();
+        fetchBlobs();
     }
 
 
     void IncomingRev::blobGotError(C4Error err) {
-        closeBlobWriter();
-        // Bump bytes-completed to end so as not to mess up overall progress:
-        addProgress({_blob->length - _blobBytesWritten, 0});
+        // (closeBlobWriters, called by finish, takes care of the progress of this blob.)
         failWithError(err);
     }
 
 
     // Sends periodic notifications to the Replicator if desired.
-    void IncomingRev::notifyBlobProgress(bool always) {
+    void IncomingRev::notifyBlobProgress(size_t index, bool always) {
         if (progressNotificationLevel() < 2)
             return;
         auto now = actor::Timer::clock::now();
         if (always || now - _lastNotifyTime > 250ms) {
             _lastNotifyTime = now;
+            const PendingBlob &blob = _pendingBlobs[index];
             Replicator::BlobProgress prog {
                 Dir::kPulling,
-                _blob->docID, _blob->docProperty,
-                _blob->key,
+                blob.docID, blob.docProperty,
+                blob.key,
                 status().progress.unitsCompleted,
                 status().progress.unitsTotal};
             logVerbose("blob progress: %" PRIu64 " / %" PRIu64, prog.bytesCompleted, prog.bytesTotal);
@@ -165,14 +394,30 @@ namespace litecore { namespace repl {
     }
 
 
-    void IncomingRev::closeBlobWriter() {
+    void IncomingRev::closeBlobWriter(BlobDownload &download) {
 #if DEBUG
-        if (_writer) {
+        if (download.writer) {
             int n = --sNumOpenWriters;
             logVerbose("Closed blob writer  [%d open]", n);
         }
 #endif
-        _writer = nullptr;
+        download.writer = nullptr;
+    }
+
+
+    // Abandons any blobs still being downloaded.
+    void IncomingRev::closeBlobWriters() {
+        for (size_t i = 0; i < _blobDownloads.size(); ++i) {
+            BlobDownload &download = _blobDownloads[i];
+            if (download.active) {
+                // Bump bytes-completed to end so as not to mess up overall progress:
+                addProgress({_pendingBlobs[i].length - download.bytesWritten, 0});
+                download.active = false;
+            }
+            closeBlobWriter(download);
+        }
+        _blobsInFlight = 0;
+        _waitingForBudget = false;
     }
 
 } }
@@ -18,6 +18,7 @@
 
 #include "IncomingRev.hh"
 #include "Puller.hh"
+#include "Replicator.hh"
 #include "DBAccess.hh"
 #include "Increment.hh"
 #include "StringUtil.hh"
@@ -42,9 +43,14 @@ namespace litecore { namespace repl {
         return json.containsBytes("\"digest\""_sl);
     }
 
+    static inline bool fleeceMightContainBlobs(slice fleece) {
+        return fleece.containsBytes("digest"_sl);
+    }
+
     IncomingRev::IncomingRev(Puller *puller)
     :Worker(puller, "inc")
     ,_puller(puller)
+    ,_blobBudget(&puller->replicator()->blobBudget())
     {
         _passive = _options.pull <= kC4Passive;
         _important = false;
@@ -61,8 +67,8 @@ namespace litecore { namespace repl {
         // (Re)initialize state (I can be used multiple times by the Puller):
         _parent = _puller;  // Necessary because Worker clears _parent when first completed
         _provisionallyInserted = false;
-        DebugAssert(_pendingCallbacks == 0 && !_writer && _pendingBlobs.empty());
-        _blob = _pendingBlobs.end();
+        DebugAssert(_pendingCallbacks == 0 && _blobsInFlight == 0 && _pendingBlobs.empty());
+        _nextBlob = 0;
 
         // Set up to handle the current message:
         DebugAssert(!_revMessage);
@@ -75,6 +81,7 @@ namespace litecore { namespace repl {
                                _revMessage->boolProperty("noconflicts"_sl)
                                    || _options.noIncomingConflicts());
         _rev->deltaSrcRevID = _revMessage->property("deltaSrc"_sl);
+        _bodyIsFleece = (_revMessage->property("bodyEncoding"_sl) == "fleece"_sl);
         slice sequenceStr = _revMessage->property(slice("sequence"));
         _remoteSequence = RemoteSequence(sequenceStr);
 
@@ -123,8 +130,10 @@ namespace litecore { namespace repl {
             _revMessage = nullptr;
 
         // Decide whether to continue now (on the Puller thread) or asynchronously on my own:
+        bool mightContainBlobs = _bodyIsFleece ? fleeceMightContainBlobs(jsonBody)
+                                               : jsonMightContainBlobs(jsonBody);
         if (_options.pullValidator|| jsonBody.size > kMaxImmediateParseSize
-                                  || jsonMightContainBlobs(jsonBody))
+                                  || mightContainBlobs)
             enqueue(FUNCTION_TO_QUEUE(IncomingRev::parseAndInsert), move(jsonBody));
         else
             parseAndInsert(move(jsonBody));
@@ -135,7 +144,15 @@ namespace litecore { namespace repl {
         // First create a Fleece document:
         Doc fleeceDoc;
         C4Error err = {};
-        if (_rev->deltaSrcRevID == nullslice) {
+        if (_bodyIsFleece) {
+            // The peer sent the body as Fleece (without SharedKeys), so it needs only to be
+            // validated, not parsed. It'll be re-encoded with the db's SharedKeys on insertion.
+            if (_rev->deltaSrcRevID == nullslice)
+                fleeceDoc = Doc(jsonBody, kFLUntrusted);
+            if (!fleeceDoc || !fleeceDoc.root().asDict())
+                err = c4error_make(WebSocketDomain, 400, "Incoming rev has invalid Fleece body"_sl);
+
+        } else if (_rev->deltaSrcRevID == nullslice) {
             // It's not a delta. Convert body to Fleece and process:
             FLError encodeErr;
             fleeceDoc = _db->tempEncodeJSON(jsonBody, &encodeErr);
@@ -201,7 +218,6 @@ namespace litecore { namespace repl {
                                      key,
                                      blob["length"_sl].asUnsigned(),
                                      c4doc_blobIsCompressible(blob)});
-            _blob = _pendingBlobs.begin();
         });
 
         // Call the custom validation function if any:
@@ -209,15 +225,14 @@ namespace litecore { namespace repl {
             if (!_options.pullValidator(_rev->docID, _rev->revID, _rev->flags, root,
                                         _options.callbackContext)) {
                 failWithError(WebSocketDomain, 403, "rejected by validation function"_sl);
-                _pendingBlobs.clear();
-                _blob = _pendingBlobs.end();
                 return;
             }
         }
 
-        // Request the first blob, or if there are none, insert the revision into the DB:
+        // Request the blobs, or if there are none, insert the revision into the DB:
         if (!_pendingBlobs.empty()) {
-            fetchNextBlob();
+            _blobDownloads.resize(_pendingBlobs.size());
+            fetchBlobs();
         } else {
             insertRevision();
         }
@@ -226,7 +241,7 @@ namespace litecore { namespace repl {
 
     // Asks the Inserter (via the Puller) to insert the revision into the database.
     void IncomingRev::insertRevision() {
-        Assert(_blob == _pendingBlobs.end());
+        Assert(_nextBlob == _pendingBlobs.size() && _blobsInFlight == 0);
         Assert(_rev->error.code == 0);
         Assert(_rev->deltaSrc || _rev->doc);
         increment(_pendingCallbacks);
@@ -290,9 +305,10 @@ namespace litecore { namespace repl {
 
         // Free up memory now that I'm done:
         Assert(_pendingCallbacks == 0);
-        closeBlobWriter();
+        closeBlobWriters();
         _pendingBlobs.clear();
-        _blob = _pendingBlobs.end();
+        _blobDownloads.clear();
+        _nextBlob = 0;
         _rev->trim();
 
         _puller->revWasHandled(this);
@@ -314,7 +330,8 @@ namespace litecore { namespace repl {
 
     Worker::ActivityLevel IncomingRev::computeActivityLevel() const {
         if (Worker::computeActivityLevel() == kC4Busy || _pendingCallbacks > 0
-                                                      || (_blob != _pendingBlobs.end())) {
+                                                      || _nextBlob < _pendingBlobs.size()
+                                                      || _blobsInFlight > 0) {
             return kC4Busy;
         } else {
             return kC4Stopped;
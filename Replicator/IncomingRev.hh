@@ -20,6 +20,7 @@
 #include "Worker.hh"
 #include "ReplicatorTypes.hh"
 #include "RemoteSequence.hh"
+#include "BlobTransferBudget.hh"
 #include "Timer.hh"
 #include "c4.hh"
 #include <atomic>
@@ -52,6 +53,21 @@ namespace litecore { namespace repl {
         ActivityLevel computeActivityLevel() const override;
 
     private:
+        struct BlobChunk {                                  // A chunk of a chunked download
+            C4BlobKey               key;                    // Digest of the chunk's data
+            uint32_t                length;                 // Length of the chunk
+            bool                    local;                  // Do I have it already?
+        };
+
+        struct BlobDownload {                               // State of a blob being downloaded
+            c4::ref<C4WriteStream>  writer;                 // Stream the data is written to
+            uint64_t                bytesWritten {0};       // Bytes written so far
+            bool                    active {false};         // Has it been requested?
+            std::vector<BlobChunk>  chunks;                 // Chunks, if downloading by chunk
+            size_t                  nextChunk {0};          // Index of chunk being written
+            uint32_t                chunkBytesReceived {0}; // Bytes received of that chunk
+        };
+
         void parseAndInsert(alloc_slice jsonBody);
         bool nonPassive() const                 {return _options.pull > kC4Passive;}
         void _handleRev(Retained<blip::MessageIn>);
@@ -65,13 +81,24 @@ namespace litecore { namespace repl {
         void finish();
 
         // blob stuff:
-        void fetchNextBlob();
-        bool startBlob();
-        void writeToBlob(fleece::alloc_slice);
-        void finishBlob();
+        void fetchBlobs();
+        void blobBudgetAvailable();
+        void startBlob(size_t index);
+        void requestBlob(size_t index);
+        void requestBlobChunkList(size_t index);
+        void gotBlobChunkList(Retained<RevToInsert>, size_t index, uint64_t reserved,
+                              blip::MessageProgress);
+        bool readBlobChunkList(size_t index, fleece::Array list);
+        void blobProgress(Retained<RevToInsert>, size_t index, uint64_t reserved,
+                          blip::MessageProgress);
+        bool writeToBlob(size_t index, fleece::alloc_slice);
+        bool writeBlobData(BlobDownload&, fleece::slice);
+        bool writeBlobChunks(BlobDownload&, fleece::slice);
+        void finishBlob(size_t index);
         void blobGotError(C4Error);
-        void notifyBlobProgress(bool always);
-        void closeBlobWriter();
+        void notifyBlobProgress(size_t index, bool always);
+        void closeBlobWriter(BlobDownload&);
+        void closeBlobWriters();
 
         Puller*                     _puller;
         Retained<blip::MessageIn>   _revMessage;
@@ -81,11 +108,14 @@ namespace litecore { namespace repl {
         RemoteSequence              _remoteSequence;
         uint32_t                    _serialNumber {0};
         std::atomic<bool>           _provisionallyInserted {false};
+        bool                        _bodyIsFleece {false};  // Is body Fleece instead of JSON?
         // blob stuff:
-        std::vector<PendingBlob>    _pendingBlobs;
-        std::vector<PendingBlob>::const_iterator _blob;
-        c4::ref<C4WriteStream>      _writer;
-        uint64_t                    _blobBytesWritten;
+        Retained<BlobTransferBudget> _blobBudget;           // Limits blob downloads in flight
+        std::vector<PendingBlob>    _pendingBlobs;          // Blobs of the current revision
+        std::vector<BlobDownload>   _blobDownloads;         // Indexed like _pendingBlobs
+        size_t                      _nextBlob {0};          // Index of next blob to request
+        unsigned                    _blobsInFlight {0};     // # blobs being downloaded
+        bool                        _waitingForBudget {false}; // Waiting to reserve a blob?
         actor::Timer::time          _lastNotifyTime;
     };
 
@@ -69,24 +69,20 @@ namespace litecore { namespace repl {
             // of them apply to the docs we're updating:
             _db->markRevsSyncedNow();
 
+            // Consecutive revs are saved together by a single c4db_putDocs call; a purge ends
+            // the group, so revs are still applied in order.
+            PendingPuts puts;
             for (RevToInsert *rev : *revs) {
-                C4Error docErr;
-                bool docSaved = insertRevisionNow(rev, &docErr);
-                rev->trimBody();                // don't need body any more
-                if (docSaved) {
-                    rev->owner->revisionProvisionallyInserted();
+                if (rev->flags & kRevPurged) {
+                    putRevisionsNow(puts);
+                    C4Error docErr;
+                    bool purged = purgeRevisionNow(rev, &docErr);
+                    revisionInsertionFinished(rev, purged, docErr);
                 } else {
-                    // Notify owner of a rev that failed:
-                    alloc_slice desc = c4error_getDescription(docErr);
-                    warn("Failed to insert '%.*s' #%.*s : %.*s",
-                         SPLAT(rev->docID), SPLAT(rev->revID), SPLAT(desc));
-                    rev->error = docErr;
-                    if (docErr == C4Error{LiteCoreDomain, kC4ErrorDeltaBaseUnknown}
-                            || docErr == C4Error{LiteCoreDomain, kC4ErrorCorruptDelta})
-                        rev->errorIsTransient = true;
-                    rev->owner->revisionInserted();     // Tell the IncomingRev
+                    addPut(puts, rev);
                 }
             }
+            putRevisionsNow(puts);
 
             Stopwatch stCommit;
             if (transaction.commit(&transactionErr))
@@ -100,6 +96,7 @@ namespace litecore { namespace repl {
         // Notify owners of all revs that didn't already fail:
         for (auto &rev : *revs) {
             if (rev->error.code == 0) {
+                rev->trimBody();
                 rev->error = transactionErr;
                 rev->owner->revisionInserted();
             }
@@ -115,62 +112,107 @@ namespace litecore { namespace repl {
     }
 
 
-    // Inserts one revision.
-    bool Inserter::insertRevisionNow(RevToInsert *rev, C4Error *outError) {
-        if (rev->flags & kRevPurged) {
-            // Server says the document is no longer accessible, i.e. it's been
-            // removed from all channels the client has access to. Purge it.
-            bool purged;
-            _db->useForInsert([&](C4Database *idb) {
-                purged = c4db_purgeDoc(idb, rev->docID, outError);
-            });
-            if (purged)
-                logVerbose("    {'%.*s' removed (purged)}", SPLAT(rev->docID));
-            else if (outError->domain == LiteCoreDomain && outError->code == kC4ErrorNotFound)
-                purged = true;
-            return purged;
+    // Called when a rev has been (provisionally) saved or purged, or failed to be.
+    void Inserter::revisionInsertionFinished(RevToInsert *rev, bool saved, C4Error docErr) {
+        rev->trimBody();                // don't need body any more
+        if (saved) {
+            rev->owner->revisionProvisionallyInserted();
+        } else {
+            // Notify owner of a rev that failed:
+            alloc_slice desc = c4error_getDescription(docErr);
+            warn("Failed to insert '%.*s' #%.*s : %.*s",
+                 SPLAT(rev->docID), SPLAT(rev->revID), SPLAT(desc));
+            rev->error = docErr;
+            if (docErr == C4Error{LiteCoreDomain, kC4ErrorDeltaBaseUnknown}
+                    || docErr == C4Error{LiteCoreDomain, kC4ErrorCorruptDelta})
+                rev->errorIsTransient = true;
+            rev->owner->revisionInserted();     // Tell the IncomingRev
+        }
+    }
+
+
+    // Purges a document, when the server says it's no longer accessible.
+    bool Inserter::purgeRevisionNow(RevToInsert *rev, C4Error *outError) {
+        // Server says the document is no longer accessible, i.e. it's been
+        // removed from all channels the client has access to. Purge it.
+        bool purged;
+        _db->useForInsert([&](C4Database *idb) {
+            purged = c4db_purgeDoc(idb, rev->docID, outError);
+        });
+        if (purged)
+            logVerbose("    {'%.*s' removed (purged)}", SPLAT(rev->docID));
+        else if (outError->domain == LiteCoreDomain && outError->code == kC4ErrorNotFound)
+            purged = true;
+        return purged;
+    }
+
+
+    // Adds a rev to be saved by the next call to putRevisionsNow().
+    void Inserter::addPut(PendingPuts &puts, RevToInsert *rev) {
+        // Set up the parameter block for c4doc_put():
+        vector<C4String> &history = puts.histories.emplace_back(rev->history());
+        C4DocPutRequest &put = puts.requests.emplace_back();
+        put.docID = rev->docID;
+        put.revFlags = rev->flags;
+        put.existingRevision = true;
+        put.allowConflict = !rev->noConflicts;
+        put.history = history.data();
+        put.historyCount = history.size();
+        put.remoteDBID = _db->remoteDBID();
+        put.save = true;
 
+        alloc_slice &bodyForDB = puts.bodies.emplace_back();
+        if (rev->deltaSrc) {
+            // If this is a delta, put the JSON delta in the put-request:
+            bodyForDB = move(rev->deltaSrc);
+            put.deltaSourceRevID = rev->deltaSrcRevID;
+            put.deltaCB = [](void *context, C4Document *doc,
+                             C4Slice delta, C4Error *outError) {
+                return ((Inserter*)context)->applyDeltaCallback(doc, delta, outError);
+            };
+            put.deltaCBContext = this;
+            // Preserve rev body as the source of a future delta I may push back:
+            put.revFlags |= kRevKeepBody;
         } else {
-            // Set up the parameter block for c4doc_put():
-            vector<C4String> history = rev->history();
-            C4DocPutRequest put = {};
-            put.docID = rev->docID;
-            put.revFlags = rev->flags;
-            put.existingRevision = true;
-            put.allowConflict = !rev->noConflicts;
-            put.history = history.data();
-            put.historyCount = history.size();
-            put.remoteDBID = _db->remoteDBID();
-            put.save = true;
-
-            alloc_slice bodyForDB;
-            if (rev->deltaSrc) {
-                // If this is a delta, put the JSON delta in the put-request:
-                bodyForDB = move(rev->deltaSrc);
-                put.deltaSourceRevID = rev->deltaSrcRevID;
-                put.deltaCB = [](void *context, C4Document *doc,
-                                 C4Slice delta, C4Error *outError) {
-                    return ((Inserter*)context)->applyDeltaCallback(doc, delta, outError);
-                };
-                put.deltaCBContext = this;
-                // Preserve rev body as the source of a future delta I may push back:
+            // If not a delta, encode doc body using database's real sharedKeys:
+            bodyForDB = _db->reEncodeForDatabase(rev->doc);
+            rev->doc = nullptr;
+            // Preserve rev body as the source of a future delta I may push back:
+            if (bodyForDB.size >= tuning::kMinBodySizeForDelta
+                && !_options.disableDeltaSupport())
                 put.revFlags |= kRevKeepBody;
-            } else {
-                // If not a delta, encode doc body using database's real sharedKeys:
-                bodyForDB = _db->reEncodeForDatabase(rev->doc);
-                rev->doc = nullptr;
-                // Preserve rev body as the source of a future delta I may push back:
-                if (bodyForDB.size >= tuning::kMinBodySizeForDelta
-                    && !_options.disableDeltaSupport())
-                    put.revFlags |= kRevKeepBody;
+        }
+        put.allocedBody = {(void*)bodyForDB.buf, bodyForDB.size};
+        puts.revs.push_back(rev);
+    }
+
+
+    // Saves all the pending revs. A rev that fails to save only fails itself.
+    void Inserter::putRevisionsNow(PendingPuts &puts) {
+        size_t count = puts.revs.size();
+        if (count == 0)
+            return;
+        vector<C4Document*> docs(count, nullptr);
+        vector<C4Error> errors(count);
+
+        // The save!!
+        _db->useForInsert([&](C4Database *db) {
+            C4Error batchErr;
+            if (c4db_putDocs(db, puts.requests.data(), count, docs.data(), errors.data(),
+                             &batchErr) < 0) {
+                // The batch as a whole failed, so save the revs one at a time instead:
+                alloc_slice desc = c4error_getDescription(batchErr);
+                warn("Saving %zu revs together failed (%.*s); saving them one by one",
+                     count, SPLAT(desc));
+                for (size_t i = 0; i < count; ++i)
+                    docs[i] = c4doc_put(db, &puts.requests[i], nullptr, &errors[i]);
             }
-            put.allocedBody = {(void*)bodyForDB.buf, bodyForDB.size};
+        });
 
-            // The save!!
-            return _db->useForInsert<bool>([&](C4Database *db) {
-                c4::ref<C4Document> doc = c4doc_put(db, &put, nullptr, outError);
-                if (!doc)
-                    return false;
+        for (size_t i = 0; i < count; ++i) {
+            RevToInsert *rev = puts.revs[i];
+            c4::ref<C4Document> doc = docs[i];
+            if (doc) {
                 logVerbose("    {'%.*s' #%.*s <- %.*s} seq %" PRIu64,
                            SPLAT(rev->docID), SPLAT(rev->revID), SPLAT(rev->historyBuf),
                            doc->selectedRev.sequence);
@@ -181,11 +223,12 @@ namespace litecore { namespace repl {
                             SPLAT(rev->docID), SPLAT(rev->revID));
                     rev->flags |= kRevIsConflict;
                     rev->isWarning = true;
-                    DebugAssert(put.allowConflict);
+                    DebugAssert(puts.requests[i].allowConflict);
                 }
-                return true;
-            });
+            }
+            revisionInsertionFinished(rev, doc != nullptr, errors[i]);
         }
+        puts = PendingPuts();
     }
 
 
@@ -19,6 +19,8 @@
 #pragma once
 #include "Worker.hh"
 #include "Batcher.hh"
+#include "c4Document.h"
+#include <vector>
 
 namespace litecore { namespace repl {
     class Replicator;
@@ -32,8 +34,19 @@ namespace litecore { namespace repl {
         void insertRevision(RevToInsert* NONNULL);
 
     private:
+        // Revisions waiting to be saved by putRevisionsNow(), with their put-requests.
+        struct PendingPuts {
+            std::vector<RevToInsert*>           revs;
+            std::vector<C4DocPutRequest>        requests;
+            std::vector<std::vector<C4String>>  histories;  // Storage for requests' history
+            std::vector<alloc_slice>            bodies;     // Storage for requests' body
+        };
+
         void _insertRevisionsNow(int gen);
-        bool insertRevisionNow(RevToInsert* NONNULL, C4Error*);
+        bool purgeRevisionNow(RevToInsert* NONNULL, C4Error*);
+        void addPut(PendingPuts&, RevToInsert* NONNULL);
+        void putRevisionsNow(PendingPuts&);
+        void revisionInsertionFinished(RevToInsert* NONNULL, bool saved, C4Error docErr);
         C4SliceResult applyDeltaCallback(C4Document *doc NONNULL,
                                          C4Slice deltaJSON,
                                          C4Error *outError);
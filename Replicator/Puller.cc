@@ -70,10 +70,12 @@ namespace litecore { namespace repl {
             msg["since"_sl] = sinceStr;
         if (_options.pull == kC4Continuous)
             msg["continuous"_sl] = "true"_sl;
-        msg["batch"_sl] = tuning::kChangesBatchSize;
+        msg["batch"_sl] = int64_t(tuning::kPullFlowControl.batchSize.initial);
         msg["versioning"] = _db->usingVersionVectors() ? "version-vectors" : "rev-trees";
         if (_skipDeleted)
             msg["activeOnly"_sl] = "true"_sl;
+        if (!_options.disableFleeceBodies())
+            msg["fleece"_sl] = "true"_sl;       // I accept 'rev' bodies in Fleece
 
         auto channels = _options.channels();
         if (channels) {
@@ -145,8 +147,13 @@ namespace litecore { namespace repl {
     }
 
 
+    std::function<void(blip::MessageIn*)> Puller::gRevReceived;
+
+
     // Received an incoming "rev" message, which contains a revision body to insert
     void Puller::handleRev(Retained<MessageIn> msg) {
+        if (gRevReceived)
+            gRevReceived(msg);
         if (_activeIncomingRevs < tuning::kMaxActiveIncomingRevs
                 && _unfinishedIncomingRevs < tuning::kMaxIncomingRevs) {
             startIncomingRev(msg);
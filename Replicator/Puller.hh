@@ -23,6 +23,7 @@
 #include "RemoteSequenceSet.hh"
 #include "Batcher.hh"
 #include <deque>
+#include <functional>
 #include <vector>
 
 namespace litecore { namespace repl {
@@ -49,6 +50,9 @@ namespace litecore { namespace repl {
 
         int progressNotificationLevel() const override;
 
+        /** If set, is called with every incoming "rev" message. For unit tests only. */
+        static std::function<void(blip::MessageIn*)> gRevReceived;
+
     protected:
         virtual void caughtUp() override        {enqueue(FUNCTION_TO_QUEUE(Puller::_setCaughtUp));}
         virtual void expectSequences(std::vector<RevFinder::ChangeSequence> changes) override {
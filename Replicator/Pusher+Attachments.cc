@@ -21,10 +21,13 @@
 #include "BLIP.hh"
 #include "Increment.hh"
 #include "c4BlobStore.h"
+#include "c4Private.h"
 #include "SecureDigest.hh"
 #include "StringUtil.hh"
+#include <unordered_set>
 
 using namespace std;
+using namespace fleece;
 using namespace litecore::blip;
 
 namespace litecore::repl {
@@ -91,6 +94,7 @@ namespace litecore::repl {
                 bytesRead = -1;
                 done = true;
             }
+            repl->blobBudget().pushed(max(bytesRead, ssize_t(0)), done && !err.code);
             if (progressNotificationLevel() >= 2) {
                 auto now = actor::Timer::clock::now();
                 if (done || now - lastNotifyTime > 250ms) {
@@ -109,6 +113,103 @@ namespace litecore::repl {
     }
 
 
+    // Incoming request for the list of chunks of a blob stored in chunks, so the peer can then
+    // request only the chunks it doesn't have:
+    void Pusher::handleGetAttachmentChunkList(Retained<MessageIn> req) {
+        slice digest = req->property("digest"_sl);
+        C4BlobKey key;
+        if (!c4blob_keyFromString(digest, &key)) {
+            req->respondWithError({"BLIP"_sl, 400, "Missing or invalid 'digest'"_sl});
+            return;
+        }
+        C4Error err;
+        alloc_slice chunkList(c4blob_getChunkList(_db->blobStore(), key, &err));
+        if (!chunkList) {
+            req->respondWithError(c4ToBLIPError(err));
+            return;
+        }
+        logVerbose("Sending chunk list of blob %.*s", SPLAT(digest));
+        MessageBuilder reply(req);
+        reply.write(chunkList);
+        req->respond(reply);
+    }
+
+
+    // Incoming request to send some chunks of a blob. The body is a JSON array of the digests of
+    // the chunks wanted, and the response is their data, concatenated.
+    void Pusher::handleGetAttachmentChunks(Retained<MessageIn> req) {
+        auto blobStore = _db->blobStore();
+        slice digest = req->property("digest"_sl);
+        C4BlobKey key;
+        if (!c4blob_keyFromString(digest, &key)) {
+            req->respondWithError({"BLIP"_sl, 400, "Missing or invalid 'digest'"_sl});
+            return;
+        }
+        C4Error err;
+        alloc_slice chunkListJSON(c4blob_getChunkList(blobStore, key, &err));
+        if (!chunkListJSON) {
+            req->respondWithError(c4ToBLIPError(err));
+            return;
+        }
+
+        // Only chunks of that blob may be requested:
+        Doc chunkList = Doc::fromJSON(chunkListJSON);
+        unordered_set<string> blobChunks;
+        for (Array::iterator i(chunkList.asArray()); i; ++i)
+            blobChunks.insert(string(i->asArray()[0].asString()));
+        auto chunks = make_shared<vector<C4BlobKey>>();
+        for (Array::iterator i(req->JSONBody().asArray()); i; ++i) {
+            slice chunkDigest = i->asString();
+            C4BlobKey chunkKey;
+            if (blobChunks.count(string(chunkDigest)) == 0
+                    || !c4blob_keyFromString(chunkDigest, &chunkKey)) {
+                req->respondWithError({"BLIP"_sl, 400, "Invalid chunk digest"_sl});
+                return;
+            }
+            chunks->push_back(chunkKey);
+        }
+
+        increment(_blobsInFlight);
+        MessageBuilder reply(req);
+        reply.compressed = req->boolProperty("compress"_sl);
+        logVerbose("Sending %zu chunks of blob %.*s (compress=%d)",
+                   chunks->size(), SPLAT(digest), reply.compressed);
+        Retained<Replicator> repl = replicator();
+        size_t nextChunk = 0;
+        alloc_slice chunk;
+        slice unsent;
+        reply.dataSource = [=](void *buf, size_t capacity) mutable {
+            // Callback to copy the chunks, one after another, into the BLIP message. Like the
+            // one in handleGetAttachment, this is NOT run on my actor thread.
+            size_t bytesRead = 0;
+            while (bytesRead < capacity) {
+                if (unsent.size == 0) {
+                    if (nextChunk == chunks->size())
+                        break;
+                    C4Error err;
+                    chunk = alloc_slice(c4blob_getChunk(blobStore, (*chunks)[nextChunk++], &err));
+                    if (!chunk) {
+                        this->warn("Error reading blob chunk: %d/%d", err.domain, err.code);
+                        this->enqueue(FUNCTION_TO_QUEUE(Pusher::_attachmentSent));
+                        return -1;
+                    }
+                    unsent = chunk;
+                }
+                size_t n = min(capacity - bytesRead, unsent.size);
+                memcpy((uint8_t*)buf + bytesRead, unsent.buf, n);
+                unsent.moveStart(n);
+                bytesRead += n;
+            }
+            bool done = (bytesRead < capacity);
+            if (done)
+                this->enqueue(FUNCTION_TO_QUEUE(Pusher::_attachmentSent));
+            repl->blobBudget().pushed(bytesRead, done);
+            return (int)bytesRead;
+        };
+        req->respond(reply);
+    }
+
+
     // Incoming request to prove I have an attachment that I'm pushing, without sending it:
     void Pusher::handleProveAttachment(Retained<MessageIn> request) {
         slice digest;
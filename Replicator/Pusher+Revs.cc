@@ -32,100 +32,83 @@ using namespace litecore::blip;
 namespace litecore::repl {
 
     void Pusher::maybeSendMoreRevs() {
-        while (_revisionsInFlight < tuning::kMaxRevsInFlight
-                   && _revisionBytesAwaitingReply <= tuning::kMaxRevBytesAwaitingReply
+        while (_revisionsInFlight < _flow.maxInFlight()
+                   && _revisionBytesAwaitingReply <= _flow.maxBytesInFlight()
+                   && _revsEncoding.size() < _maxRevEncoders
                    && !_revQueue.empty()) {
             Retained<RevToSend> first = move(_revQueue.front());
             _revQueue.pop_front();
-            sendRevision(first);
+            encodeRevision(first);
             if (_revQueue.size() == tuning::kMaxRevsQueued - 1)
                 maybeGetMoreChanges();          // I may now be eligible to send more changes
         }
 //        if (!_revQueue.empty())
-//            logVerbose("Throttling sending revs; _revisionsInFlight=%u/%u, _revisionBytesAwaitingReply=%llu/%u",
-//                       _revisionsInFlight, tuning::kMaxRevsInFlight,
-//                       _revisionBytesAwaitingReply, tuning::kMaxRevBytesAwaitingReply);
+//            logVerbose("Throttling sending revs; _revisionsInFlight=%u/%u, _revisionBytesAwaitingReply=%llu/%llu",
+//                       _revisionsInFlight, _flow.maxInFlight(),
+//                       _revisionBytesAwaitingReply, _flow.maxBytesInFlight());
     }
 
 
-    // Send a "rev" message containing a revision body.
-    void Pusher::sendRevision(Retained<RevToSend> request) {
+    // Hands a revision to a RevEncoder, which reads it and prepares its "rev" message on another
+    // thread. The rev counts as in flight from now on. The messages are sent, in the order the
+    // revs were handed out, by _revsEncoded().
+    void Pusher::encodeRevision(Retained<RevToSend> request) {
         if (!connected())
             return;
 
-        logVerbose("Sending rev '%.*s' #%.*s (seq #%" PRIu64 ") [%d/%d]",
+        logVerbose("Encoding rev '%.*s' #%.*s (seq #%" PRIu64 ") [%d/%d]",
                    SPLAT(request->docID), SPLAT(request->revID), request->sequence,
-                   _revisionsInFlight, tuning::kMaxRevsInFlight);
+                   _revisionsInFlight, _flow.maxInFlight());
 
-        // Get the document & revision:
-        C4Error c4err;
-        Dict root;
-        c4::ref<C4Document> doc = _db->getDoc(request->docID, kDocGetAll, &c4err);
-        if (doc) {
-            if (c4doc_selectRevision(doc, request->revID, true, &c4err)) {
-                root = c4doc_getProperties(doc);
-                if (!root)
-                    c4err = {LiteCoreDomain, kC4ErrorNotFound};
-            }
-            if (root) {
-                request->flags = doc->selectedRev.flags;
-            } else {
-                if (c4err.code == kC4ErrorNotFound && c4err.domain == LiteCoreDomain)
-                    revToSendIsObsolete(*request, &c4err);
-            }
+        Retained<RevEncoder> encoder;
+        if (_spareEncoders.empty()) {
+            encoder = new RevEncoder(this);
+        } else {
+            encoder = move(_spareEncoders.back());
+            _spareEncoders.pop_back();
         }
+        increment(_revisionsInFlight);
+        _revsEncoding.push_back(encoder);
+        encoder->encode(request, _fleeceOK);
+    }
 
-        auto fullRevID = alloc_slice(_db->convertVersionToAbsolute(request->revID));
 
-        // Now send the BLIP message. Normally it's "rev", but if this is an error we make it
-        // "norev" and include the error code:
-        MessageBuilder msg(root ? "rev"_sl : "norev"_sl);
-        msg.compressed = true;
-        msg["id"_sl] = request->docID;
-        msg["rev"_sl] = fullRevID;
-        msg["sequence"_sl] = request->sequence;
-        if (root) {
-            if (request->noConflicts)
-                msg["noconflicts"_sl] = true;
-            auto revisionFlags = doc->selectedRev.flags;
-            if (revisionFlags & kRevDeleted)
-                msg["deleted"_sl] = "1"_sl;
+    // Called after RevEncoders finish. Sends the messages that are ready, stopping at the first
+    // one that isn't, so they go out in order.
+    void Pusher::_revsEncoded() {
+        while (!_revsEncoding.empty() && _revsEncoding.front()->done()) {
+            Retained<RevEncoder> encoder = move(_revsEncoding.front());
+            _revsEncoding.pop_front();
+            sendRevision(encoder);
+            encoder->reset();
+            _spareEncoders.push_back(move(encoder));
+        }
+        maybeSendMoreRevs();
+    }
 
-            // Include the document history, but skip the current revision 'cause it's redundant
-            alloc_slice history = request->historyString(doc);
-            if (history.hasPrefix(fullRevID) && history.size > fullRevID.size)
-                msg["history"_sl] = history.from(fullRevID.size + 1);
 
-            bool sendLegacyAttachments = (request->legacyAttachments
-                                          && (revisionFlags & kRevHasAttachments)
-                                          && !_db->disableBlobSupport());
+    // Send the "rev" message prepared by a RevEncoder, or a "norev" if it failed.
+    void Pusher::sendRevision(RevEncoder *encoder) {
+        Retained<RevToSend> request = encoder->rev();
+        if (!connected()) {
+            decrement(_revisionsInFlight);
+            return;
+        }
 
-            // Delta compression:
-            alloc_slice delta = createRevisionDelta(doc, request, root,
-                                                    c4doc_getRevisionBody(doc).size,
-                                                    sendLegacyAttachments);
-            if (delta) {
-                msg["deltaSrc"_sl] = _db->convertVersionToAbsolute(doc->selectedRev.revID);
-                msg.jsonBody().writeRaw(delta);
-            } else if (root.empty()) {
-                msg.write("{}"_sl);
-            } else {
-                auto &bodyEncoder = msg.jsonBody();
-                if (sendLegacyAttachments)
-                    _db->encodeRevWithLegacyAttachments(bodyEncoder, root,
-                                                       c4rev_getGeneration(request->revID));
-                else
-                    bodyEncoder.writeValue(root);
-            }
+        C4Error c4err = encoder->error();
+        if (!c4err.code) {
+            request->flags = encoder->flags();
             logVerbose("Transmitting 'rev' message with '%.*s' #%.*s",
                        SPLAT(request->docID), SPLAT(request->revID));
-            sendRequest(msg, [this, request](MessageProgress progress) {
-                onRevProgress(request, progress);
+            auto sentAt = FlowController::clock::now();
+            sendRequest(encoder->message(), [this, request, sentAt](MessageProgress progress) {
+                onRevProgress(request, progress, sentAt);
             });
-            increment(_revisionsInFlight);
 
         } else {
             // Send an error if we couldn't get the revision:
+            if (encoder->revisionMissing())
+                revToSendIsObsolete(*request, &c4err);
             int blipError;
             if (c4err.domain == WebSocketDomain)
                 blipError = c4err.code;
@@ -136,18 +119,25 @@ namespace litecore::repl {
                      SPLAT(request->docID), SPLAT(request->revID), c4err.domain, c4err.code);
                 blipError = 500;
             }
+            MessageBuilder msg("norev"_sl);
+            msg.compressed = true;
+            msg["id"_sl] = request->docID;
+            msg["rev"_sl] = _db->convertVersionToAbsolute(request->revID);
+            msg["sequence"_sl] = request->sequence;
             msg["error"_sl] = blipError;
             msg.noreply = true;
             sendRequest(msg);
 
+            decrement(_revisionsInFlight);
             doneWithRev(request, false, false);
-            enqueue(FUNCTION_TO_QUEUE(Pusher::maybeSendMoreRevs));  // async call to avoid recursion
         }
     }
 
 
     // "rev" message progress callback:
-    void Pusher::onRevProgress(Retained<RevToSend> rev, const MessageProgress &progress) {
+    void Pusher::onRevProgress(Retained<RevToSend> rev, const MessageProgress &progress,
+                               FlowController::clock::time_point sentAt)
+    {
         switch (progress.state) {
             case MessageProgress::kDisconnected:
                 doneWithRev(rev, false, false);
@@ -165,6 +155,7 @@ namespace litecore::repl {
                 bool completed = true;
                 enum {kNoRetry, kRetryLater, kRetryNow} retry = kNoRetry;
                 if (synced) {
+                    _flow.completed(FlowController::clock::now() - sentAt, progress.bytesSent);
                     logVerbose("Completed rev %.*s #%.*s (seq #%" PRIu64 ")",
                                SPLAT(rev->docID), SPLAT(rev->revID), rev->sequence);
                     finishedDocument(rev);
@@ -175,6 +166,7 @@ namespace litecore::repl {
 
                     if (c4error_mayBeTransient(c4err)) {
                         completed = false;
+                        _flow.failed();
                     } else if (c4err == C4Error{WebSocketDomain, 403}) {
                         // CBL-123: Retry HTTP forbidden once
                         if (rev->retryCount++ == 0) {
@@ -227,67 +219,6 @@ namespace litecore::repl {
     }
 
 
-    // Attempt to delta-compress the revision; returns JSON delta or a null slice.
-    alloc_slice Pusher::createRevisionDelta(C4Document *doc, RevToSend *request,
-                                            Dict root, size_t revisionSize,
-                                            bool sendLegacyAttachments)
-    {
-        alloc_slice delta;
-        if (!request->deltaOK || revisionSize < tuning::kMinBodySizeForDelta
-                              || _options.disableDeltaSupport())
-            return delta;
-
-        // Find an ancestor revision known to the server:
-        C4RevisionFlags ancestorFlags = 0;
-        Dict ancestor;
-        if (request->remoteAncestorRevID)
-            ancestor = DBAccess::getDocRoot(doc, request->remoteAncestorRevID, &ancestorFlags);
-
-        if(ancestorFlags & kRevDeleted)
-            return delta;
-
-        if (!ancestor && request->ancestorRevIDs) {
-            for (auto revID : *request->ancestorRevIDs) {
-                ancestor = DBAccess::getDocRoot(doc, revID, &ancestorFlags);
-                if (ancestor)
-                    break;
-            }
-        }
-        if (ancestor.empty())
-            return delta;
-
-        Doc legacyOld, legacyNew;
-        if (sendLegacyAttachments) {
-            // If server needs legacy attachment layout, transform the bodies:
-            Encoder enc;
-            auto revPos = c4rev_getGeneration(request->revID);
-            _db->encodeRevWithLegacyAttachments(enc, root, revPos);
-            legacyNew = enc.finishDoc();
-            root = legacyNew.root().asDict();
-
-            if (ancestorFlags & kRevHasAttachments) {
-                enc.reset();
-                _db->encodeRevWithLegacyAttachments(enc, ancestor, revPos);
-                legacyOld = enc.finishDoc();
-                ancestor = legacyOld.root().asDict();
-            }
-        }
-
-        delta = FLCreateJSONDelta(ancestor, root);
-        if (!delta || delta.size > revisionSize * 1.2)
-            return {};          // Delta failed, or is (probably) bigger than body; don't use
-
-        if (willLog(LogLevel::Verbose)) {
-            alloc_slice old (ancestor.toJSON());
-            alloc_slice nuu (root.toJSON());
-            logVerbose("Encoded revision as delta, saving %zd bytes:\n\told = %.*s\n\tnew = %.*s\n\tDelta = %.*s",
-                       nuu.size - delta.size,
-                       SPLAT(old), SPLAT(nuu), SPLAT(delta));
-        }
-        return delta;
-    }
-
-
     // Finished sending a revision (successfully or not.)
     // `completed` - whether to mark the sequence as completed in the checkpointer
     // `synced` - whether the revision was successfully stored on the peer
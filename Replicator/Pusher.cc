@@ -38,6 +38,8 @@ namespace litecore { namespace repl {
     ,_continuous(_options.push == kC4Continuous)
     ,_checkpointer(checkpointer)
     ,_changesFeed(*this, _options, *_db, &checkpointer)
+    ,_flow(replicator->pushFlowController())
+    ,_maxRevEncoders(_options.maxRevEncoders())
     {
         if (_options.push <= kC4Passive) {
             // Passive replicator always sends "changes"
@@ -56,6 +58,8 @@ namespace litecore { namespace repl {
         registerHandler("subChanges",      &Pusher::handleSubChanges);
         registerHandler("getAttachment",   &Pusher::handleGetAttachment);
         registerHandler("proveAttachment", &Pusher::handleProveAttachment);
+        registerHandler("getAttachmentChunkList", &Pusher::handleGetAttachmentChunkList);
+        registerHandler("getAttachmentChunks",    &Pusher::handleGetAttachmentChunks);
     }
 
 
@@ -89,6 +93,7 @@ namespace litecore { namespace repl {
         _continuous = req->boolProperty("continuous"_sl);
         _changesFeed.setContinuous(_continuous);
         _changesFeed.setSkipDeletedDocs(req->boolProperty("activeOnly"_sl));
+        _fleeceOK = req->boolProperty("fleece"_sl) && !_options.disableFleeceBodies();
         logInfo("Peer is pulling %schanges from seq #%" PRIu64,
             (_continuous ? "continuous " : ""), since);
 
@@ -126,7 +131,8 @@ namespace litecore { namespace repl {
                      && _revQueue.size() < tuning::kMaxRevsQueued
                      && connected()) {
             _continuousCaughtUp = true;
-            gotChanges(_changesFeed.getMoreChanges(tuning::kDefaultChangeBatchSize));
+            _changesBatchSize = _flow.batchSize();
+            gotChanges(_changesFeed.getMoreChanges(_changesBatchSize));
         }
     }
 
@@ -183,7 +189,7 @@ namespace litecore { namespace repl {
         auto changeCount = changes.revs.size();
         sendChanges(changes.revs);
 
-        if (changeCount < tuning::kDefaultChangeBatchSize) {
+        if (changeCount < _changesBatchSize) {
             if (!_caughtUp) {
                 logInfo("Caught up, at lastSequence #%" PRIu64, changes.lastSequence);
                 _caughtUp = true;
@@ -330,6 +336,8 @@ namespace litecore { namespace repl {
         if (!_deltasOK && reply->boolProperty("deltas"_sl)
                        && !_options.properties[kC4ReplicatorOptionDisableDeltas].asBool())
             _deltasOK = true;
+        if (!_fleeceOK && reply->boolProperty("fleece"_sl) && !_options.disableFleeceBodies())
+            _fleeceOK = true;
 
         // The response body consists of an array that parallels the `changes` array I sent:
         Array::iterator iResponse(reply->JSONBody().asArray());
@@ -21,6 +21,7 @@
 #include "ChangesFeed.hh"
 #include "Replicator.hh" // for BlobProgress
 #include "ReplicatorTypes.hh"
+#include "RevEncoder.hh"
 #include "fleece/slice.hh"
 #include <deque>
 #include <unordered_map>
@@ -43,6 +44,9 @@ namespace litecore { namespace repl {
             enqueue(FUNCTION_TO_QUEUE(Pusher::_docRemoteAncestorChanged), docID, remoteAncestorRevID);
         }
 
+        // Called by a RevEncoder when it's finished preparing a 'rev' message
+        void revEncoded()                       {enqueue(FUNCTION_TO_QUEUE(Pusher::_revsEncoded));}
+
         int progressNotificationLevel() const override;
 
     protected:
@@ -78,6 +82,8 @@ namespace litecore { namespace repl {
         // Pusher+Attachments.cc:
         void handleGetAttachment(Retained<blip::MessageIn>);
         void handleProveAttachment(Retained<blip::MessageIn>);
+        void handleGetAttachmentChunkList(Retained<blip::MessageIn>);
+        void handleGetAttachmentChunks(Retained<blip::MessageIn>);
         void _attachmentSent();
         C4ReadStream* readBlobFromRequest(blip::MessageIn *req NONNULL,
                                           slice &outDigest,
@@ -86,13 +92,13 @@ namespace litecore { namespace repl {
         // Pusher+Revs.cc:
         void maybeSendMoreRevs();
         void retryRevs(RevToSendList, bool immediate);
-        void sendRevision(Retained<RevToSend>);
-        void onRevProgress(Retained<RevToSend> rev, const blip::MessageProgress&);
+        void encodeRevision(Retained<RevToSend>);
+        void _revsEncoded();
+        void sendRevision(RevEncoder* NONNULL);
+        void onRevProgress(Retained<RevToSend> rev, const blip::MessageProgress&,
+                           FlowController::clock::time_point sentAt);
         void couldntSendRevision(RevToSend* NONNULL);
         void doneWithRev(RevToSend*, bool successful, bool pushed);
-        alloc_slice createRevisionDelta(C4Document *doc NONNULL, RevToSend *request NONNULL,
-                                        fleece::Dict root, size_t revSize,
-                                        bool sendLegacyAttachments);
         void revToSendIsObsolete(const RevToSend &request, C4Error *c4err);
 
         using DocIDToRevMap = std::unordered_map<alloc_slice, Retained<RevToSend>>;
@@ -106,15 +112,21 @@ namespace litecore { namespace repl {
         C4SequenceNumber _lastSequenceRead {0};   // Last sequence read from db
         C4SequenceNumber _lastSequenceLogged {0}; // Checkpointed last-sequence
         Checkpointer& _checkpointer;              // Tracks checkpoints & pending sequences
+        FlowController& _flow;                    // Adaptive limits on revs in flight
+        unsigned const _maxRevEncoders;           // Max # of revs being encoded at once
         bool _started {false};
         bool _caughtUp {false};                   // Received backlog of pre-existing changes?
         bool _continuousCaughtUp {true};          // Caught up with change notifications?
         bool _deltasOK {false};                   // OK to send revs in delta form?
+        bool _fleeceOK {false};                   // OK to send rev bodies as Fleece?
         unsigned _changeListsInFlight {0};        // # change lists being requested from db or sent to peer
-        unsigned _revisionsInFlight {0};          // # 'rev' messages being sent
+        unsigned _changesBatchSize {0};           // Max # of changes last requested from db
+        unsigned _revisionsInFlight {0};          // # 'rev' messages being encoded or sent
         blip::MessageSize _revisionBytesAwaitingReply {0}; // # 'rev' message bytes sent but not replied
         unsigned _blobsInFlight {0};              // # of blobs being sent
         std::deque<Retained<RevToSend>> _revQueue;// Revs to send to peer but not sent yet
+        std::deque<Retained<RevEncoder>> _revsEncoding; // Revs being encoded, in send order
+        std::vector<Retained<RevEncoder>> _spareEncoders; // Idle RevEncoders, for reuse
         RevToSendList _revsToRetry;               // Revs that failed with a transient error
         string _myPeerID;
     };
@@ -18,100 +18,149 @@
 
 #pragma once
 #include "RemoteSequence.hh"
+#include <algorithm>
 #include <map>
 #include <utility>
+#include <vector>
 
 namespace litecore { namespace repl {
 
     /** A set of opaque remote sequence IDs, representing server-side database sequences.
-        This is used by the replicator to keep track of which revisions are being pulled. */
+        This is used by the replicator to keep track of which revisions are being pulled.
+
+        \note The sequences are kept in a vector, in the order they were added, with removed
+        ones just marked as such; the dead prefix is skipped and compacted away as the earliest
+        sequences are removed. As long as sequences are added in increasing order -- which
+        they almost always are -- they're looked up by binary search. If one arrives out of
+        order, the set falls back to a secondary index mapping sequences to positions. */
     class RemoteSequenceSet {
     public:
         RemoteSequenceSet()                     { }
 
         /** Empties the set. */
         void clear(RemoteSequence since) {
-            _sequences.clear();
-            _nextOrder = 0;
-            _lastAdded = since;
-            _first = _sequences.end();
+            _entries.clear();
+            _start = 0;
+            _base = 0;
+            _count = 0;
+            _since = std::move(since);
+            _sorted = true;
+            _index.clear();
         }
 
         bool empty() const {
-            return _sequences.empty();
+            return _count == 0;
         }
 
         size_t size() const {
-            return _sequences.size();
+            return _count;
         }
 
         /** Returns the sequence before the earliest one still in the set. */
-        RemoteSequence since() {
-            return (_first != _sequences.end()) ? _first->second.prevSequence : _lastAdded;
+        RemoteSequence since() const {
+            return (_start > 0) ? _entries[_start - 1].sequence : _since;
         }
 
         /** Adds a sequence to the set. */
         void add(RemoteSequence s, uint64_t bodySize) {
-            bool wasEmpty = empty();
-            auto p = _sequences.insert({s, {_nextOrder++, _lastAdded, bodySize}});
-            _lastAdded = std::move(s);
-            if (wasEmpty)
-                _first = p.first;
+            if (_sorted && !_entries.empty() && !(_entries.back().sequence < s)) {
+                if (find(s) != kNotFound)
+                    return;
+                buildIndex();
+            }
+            if (!_sorted) {
+                if (find(s) != kNotFound)
+                    return;
+                _index[s] = _base + _entries.size();
+            }
+            _entries.push_back({std::move(s), bodySize, true});
+            ++_count;
         }
 
         /** Removes the sequence if it's in the set. Returns true if it was the earliest. */
         void remove(const RemoteSequence &s, bool &wasEarliest, uint64_t &outBodySize) {
-            auto i = _sequences.find(s);
-            if (i == _sequences.end()) {
+            size_t i = find(s);
+            if (i == kNotFound) {
                 outBodySize = 0;
                 wasEarliest = false;
                 return;
             }
-            outBodySize = i->second.bodySize;
-            wasEarliest = (i == _first);
+            outBodySize = _entries[i].bodySize;
+            _entries[i].live = false;
+            --_count;
+            if (!_sorted)
+                _index.erase(s);
+            wasEarliest = (i == _start);
             if (wasEarliest) {
-                size_t minOrder = i->second.order;
-                _sequences.erase(i);
-                findFirst(minOrder + 1);
-            } else {
-                _sequences.erase(i);
+                do {
+                    ++_start;
+                } while (_start < _entries.size() && !_entries[_start].live);
+                compact();
             }
         }
 
-        uint64_t bodySizeOfSequence(const RemoteSequence &s) {
-            auto i = _sequences.find(s);
-            return (i == _sequences.end()) ? 0 : i->second.bodySize;
+        uint64_t bodySizeOfSequence(const RemoteSequence &s) const {
+            size_t i = find(s);
+            return (i == kNotFound) ? 0 : _entries[i].bodySize;
         }
 
     private:
+        static constexpr size_t kNotFound = SIZE_MAX;
+        static constexpr size_t kMinCompaction = 64;    // Min dead entries before compacting
+
+        // Returns the index in _entries of a sequence still in the set, or kNotFound.
+        size_t find(const RemoteSequence &s) const {
+            size_t i;
+            if (_sorted) {
+                auto e = std::lower_bound(_entries.begin() + _start, _entries.end(), s,
+                                          [](const entry &e, const RemoteSequence &s) {
+                                              return e.sequence < s;
+                                          });
+                if (e == _entries.end() || e->sequence != s)
+                    return kNotFound;
+                i = e - _entries.begin();
+            } else {
+                auto e = _index.find(s);
+                if (e == _index.end())
+                    return kNotFound;
+                i = e->second - _base;
+            }
+            return _entries[i].live ? i : kNotFound;
+        }
+
+        // Switches to looking up sequences via _index, since they're no longer sorted.
+        void buildIndex() {
+            _sorted = false;
+            for (size_t i = _start; i < _entries.size(); ++i) {
+                if (_entries[i].live)
+                    _index[_entries[i].sequence] = _base + i;
+            }
+        }
 
-        // Updates _first to point to the earliest entry in _sequences
-        void findFirst(size_t minOrderInSet) {
-            sequenceMap::iterator first = _sequences.end();
-            size_t minOrderSoFar = SIZE_MAX;
-            // OPT: Slow linear scan. Keep a secondary collection sorted by order?
-            for (auto i = _sequences.begin(); i != _sequences.end(); ++i) {
-                if (i->second.order < minOrderSoFar) {
-                    minOrderSoFar = i->second.order;
-                    first = i;
-                    if (minOrderSoFar == minOrderInSet)
-                        break;  // we know we've found the minimum
-                }
+        // Erases the dead entries before _start, once there are enough of them.
+        void compact() {
+            if (_start == _entries.size() || (_start >= kMinCompaction
+                                              && 2 * _start >= _entries.size())) {
+                _since = _entries[_start - 1].sequence;
+                _entries.erase(_entries.begin(), _entries.begin() + _start);
+                _base += _start;
+                _start = 0;
             }
-            _first = first;
         }
 
-        struct value {
-            size_t order;                   // Chronological order in which this sequence was added
-            RemoteSequence prevSequence;    // The previously-added sequence
+        struct entry {
+            RemoteSequence sequence;
             uint64_t bodySize;              // Approx doc size, for client's use
+            bool live;                      // False once removed
         };
-        using sequenceMap = std::map<RemoteSequence, value>;
 
-        sequenceMap _sequences;             // Maps sequence to {order, previous seq}
-        size_t _nextOrder {0};              // Order to assign to the next insertion
-        RemoteSequence _lastAdded;          // The last sequence added
-        sequenceMap::iterator _first {};    // Points to the earliest sequence still in _sequences
+        std::vector<entry> _entries;        // Sequences in the order added
+        size_t _start {0};                  // Index of the earliest live entry
+        size_t _base {0};                   // Number of entries compacted away so far
+        size_t _count {0};                  // Number of live entries
+        RemoteSequence _since;              // The sequence added before _entries[0]
+        bool _sorted {true};                // Were all sequences added in increasing order?
+        std::map<RemoteSequence, size_t> _index; // Sequence -> _base + index, if !_sorted
     };
 
 } }
@@ -63,7 +63,8 @@ namespace litecore { namespace repl {
     :Worker(new Connection(webSocket, options.properties, *this),
             nullptr,
             options,
-            make_shared<DBAccess>(db, options.properties["disable_blob_support"_sl].asBool()),
+            make_shared<DBAccess>(db, options.properties["disable_blob_support"_sl].asBool(),
+                                  options.maxRevEncoders()),
             "Repl")
     ,_delegate(&delegate)
     ,_connectionState(connection().state())
@@ -71,6 +72,9 @@ namespace litecore { namespace repl {
     ,_pullStatus(options.pull == kC4Disabled ? kC4Stopped : kC4Busy)
     ,_docsEnded(this, "docsEnded", &Replicator::notifyEndedDocuments, tuning::kMinDocEndedInterval, 100)
     ,_checkpointer(_options, webSocket->url())
+    ,_pushFlow(tuning::kPushFlowControl, !_options.fixedFlowControl())
+    ,_pullFlow(tuning::kPullFlowControl, !_options.fixedFlowControl())
+    ,_blobBudget(new BlobTransferBudget(tuning::kMaxBlobBytesInFlight))
     {
         _loggingID = string(alloc_slice(c4db_getPath(db))) + " " + _loggingID;
         _passive = _options.pull <= kC4Passive && _options.push <= kC4Passive;
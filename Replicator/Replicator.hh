@@ -19,6 +19,8 @@
 #pragma once
 #include "Worker.hh"
 #include "Checkpointer.hh"
+#include "BlobTransferBudget.hh"
+#include "FlowController.hh"
 #include "BLIPConnection.hh"
 #include "Batcher.hh"
 #include "fleece/Fleece.hh"
@@ -101,6 +103,19 @@ namespace litecore { namespace repl {
 
         Checkpointer& checkpointer()            {return _checkpointer;}
 
+        FlowController& pushFlowController()    {return _pushFlow;}
+        FlowController& pullFlowController()    {return _pullFlow;}
+
+        /** The current flow-control state of the pusher and puller. Thread-safe. */
+        C4ReplicatorFlowControl flowControl() const {
+            return {_pushFlow.state(), _pullFlow.state()};
+        }
+
+        BlobTransferBudget& blobBudget()        {return *_blobBudget;}
+
+        /** Statistics of the blobs pushed and pulled. Thread-safe. */
+        C4BlobTransferStats blobStats() const   {return _blobBudget->stats();}
+
         void endedDocument(ReplicatedRev *d NONNULL);
         void onBlobProgress(const BlobProgress &progress) {
             enqueue(FUNCTION_TO_QUEUE(Replicator::_onBlobProgress), progress);
@@ -184,6 +199,9 @@ namespace litecore { namespace repl {
         ReplicatedRevBatcher _docsEnded;               // Recently-completed revs
 
         Checkpointer      _checkpointer;               // Object that manages checkpoints
+        FlowController    _pushFlow;                   // Flow control of revs pushed
+        FlowController    _pullFlow;                   // Flow control of revs pulled
+        Retained<BlobTransferBudget> _blobBudget;      // Limits & measures blob transfers
         bool              _hadLocalCheckpoint {};      // True if local checkpoint pre-existed
         bool              _remoteCheckpointRequested{};// True while "getCheckpoint" request pending
         bool              _remoteCheckpointReceived {};// True if I got a "getCheckpoint" response
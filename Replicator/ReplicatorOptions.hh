@@ -18,7 +18,9 @@
 
 #pragma once
 #include "c4Replicator.h"
+#include "ReplicatorTuning.hh"
 #include "fleece/Fleece.hh"
+#include <algorithm>
 
 namespace litecore { namespace repl {
 
@@ -84,6 +86,15 @@ namespace litecore { namespace repl {
         }
 
         bool disableDeltaSupport() const {return properties[kC4ReplicatorOptionDisableDeltas].asBool();}
+        bool disableFleeceBodies() const {return properties[kC4ReplicatorOptionDisableFleeceBodies].asBool();}
+        bool fixedFlowControl() const {return properties[kC4ReplicatorOptionFixedFlowControl].asBool();}
+
+        /** Max number of pushed revisions to read and encode in parallel. */
+        unsigned maxRevEncoders() const {
+            auto n = properties[kC4ReplicatorOptionMaxRevEncoders].asUnsigned();
+            return n > 0 ? unsigned(std::min(n, uint64_t(tuning::kMaxRevEncodersLimit)))
+                         : tuning::kMaxRevEncoders;
+        }
 
         /** Returns a string that uniquely identifies the remote database; by default its URL,
             or the 'remoteUniqueID' option if that's present (for P2P dbs without stable URLs.) */
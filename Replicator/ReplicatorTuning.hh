@@ -17,6 +17,7 @@
 //
 
 #pragma once
+#include "FlowController.hh"
 #include <chrono>
 #include <stdlib.h>
 
@@ -50,14 +51,24 @@ namespace litecore { namespace repl {
 
         //// Puller:
 
-        /* Number of revisions the peer should include in a single `changes` / `proposeChanges`
-            message. (This is sent as a parameter in the puller's opening `subChanges` message.) */
-        constexpr unsigned kChangesBatchSize = 200;
-
-        /* Maximum desirable number of incoming `rev` messages that aren't being handled yet.
-            Past this number, the puller will stop handling or responding to `changes` messages,
-            to attempt to stop getting more `revs`. */
-        constexpr unsigned kMaxRevsBeingRequested = 200;
+        /* Flow control of the puller, whose FlowController starts with the initial values and
+            adapts them (within the min and max) to the connection's measured round-trip time and
+            throughput:
+            - inFlight: Maximum desirable number of incoming `rev` messages that aren't being
+              handled yet. Past this number, the puller will stop handling or responding to
+              `changes` messages, to attempt to stop getting more `revs`.
+            - bytesInFlight: Not limited.
+            - batchSize: Number of revisions the peer should include in a single `changes` /
+              `proposeChanges` message. (This is sent as a parameter in the puller's opening
+              `subChanges` message.)
+            - replyDelay: None; the round trip is timed from the `changes` response to the
+              first `rev`, which the peer sends as soon as it can. */
+        constexpr FlowController::Config kPullFlowControl = {
+            {50, 200, 1000},                            // inFlight: min, initial, max
+            {0, 0, 0},                                  // bytesInFlight
+            {50, 200, 1000},                            // batchSize
+            0ms,                                        // replyDelay
+        };
 
         /* Maximum number of simultaneous incoming revisions.
            Each one is assigned an IncomingRev actor, so larger values increase memory usage
@@ -68,6 +79,19 @@ namespace litecore { namespace repl {
            (and are thus holding onto the document bodies in memory.) */
         constexpr unsigned kMaxActiveIncomingRevs = 100;
 
+        /* Maximum total size of the blobs being downloaded at once, by all incoming revisions.
+           A blob's data is held in memory only until it's written, so this bounds memory use,
+           but it also limits how many blobs are requested in parallel. (A blob bigger than
+           this is downloaded by itself.) */
+        constexpr uint64_t kMaxBlobBytesInFlight = 8 * 1024 * 1024;
+
+        /* Maximum number of blobs of a single revision to download at once. */
+        constexpr unsigned kMaxBlobsPerIncomingRev = 8;
+
+        /* Minimum size of a blob to download by chunk, when the local blob store is chunked.
+           Smaller blobs aren't worth the extra round-trip to get their chunk list. */
+        constexpr uint64_t kMinChunkedBlobDownload = 1024 * 1024;
+
 
         //// Pusher:
 
@@ -83,15 +107,28 @@ namespace litecore { namespace repl {
             stop querying for more lists of changes. */
         constexpr unsigned kMaxRevsQueued = 600;
 
-        /* Max # of `rev` messages to be transmitting at once. */
-        constexpr unsigned kMaxRevsInFlight = 10;
-
-        /* Max desirable number of bytes of revisions that have been sent but not replied to
-            yet. This is limited to avoid flooding the peer with too much JSON data. */
-        constexpr unsigned kMaxRevBytesAwaitingReply = 2*1024*1024;
-
-        /* Number of changes to send in one "changes" msg */
-        constexpr unsigned kDefaultChangeBatchSize = 200;
+        /* Default max # of revs whose `rev` messages are being prepared at once. Each is read
+            and encoded by a RevEncoder on its own thread, using a read-only database connection.
+            Can be changed with the `maxRevEncoders` replicator option, up to the limit. */
+        constexpr unsigned kMaxRevEncoders = 4;
+        constexpr unsigned kMaxRevEncodersLimit = 32;
+
+        /* Flow control of the pusher, whose FlowController starts with the initial values and
+            adapts them (within the min and max) to the connection's measured round-trip time and
+            throughput:
+            - inFlight: Max # of `rev` messages to be transmitting at once.
+            - bytesInFlight: Max desirable number of bytes of revisions that have been sent but
+              not replied to yet. This is limited to avoid flooding the peer with too much JSON
+              data, and to keep a slow link from queueing more than it can send in a round trip.
+            - batchSize: Number of changes to send in one "changes" msg.
+            - replyDelay: A LiteCore peer doesn't reply to a `rev` until it's inserted it, which
+              can take up to kInsertionDelay while it waits for a batch to fill up. */
+        constexpr FlowController::Config kPushFlowControl = {
+            {10, 10, 100},                              // inFlight: min, initial, max
+            {256*1024, 2*1024*1024, 32*1024*1024},      // bytesInFlight
+            {50, 200, 1000},                            // batchSize
+            kInsertionDelay,                            // replyDelay
+        };
 
         /* Max history length to use, if "changes" response doesn't have one */
         constexpr unsigned kDefaultMaxHistory = 20;
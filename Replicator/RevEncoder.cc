@@ -0,0 +1,189 @@
+//
+// RevEncoder.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#include "RevEncoder.hh"
+#include "Pusher.hh"
+#include "DBAccess.hh"
+#include "ReplicatorTuning.hh"
+#include "StringUtil.hh"
+#include "c4Document+Fleece.h"
+#include "BLIP.hh"
+
+using namespace std;
+using namespace fleece;
+using namespace litecore::blip;
+
+namespace litecore { namespace repl {
+
+    RevEncoder::RevEncoder(Pusher *pusher)
+    :Worker(pusher, "enc")
+    ,_pusher(pusher)
+    {
+        _passive = pusher->passive();
+        _important = false;
+    }
+
+
+    void RevEncoder::encode(RevToSend *rev, bool fleeceOK) {
+        _parent = _pusher;  // Necessary because reset() clears _parent
+        _rev = rev;
+        enqueue(FUNCTION_TO_QUEUE(RevEncoder::_encode), retained(rev), fleeceOK);
+    }
+
+
+    void RevEncoder::reset() {
+        _rev = nullptr;
+        _message.reset();
+        _error = {};
+        _revisionMissing = false;
+        _flags = 0;
+        _done = false;
+        _parent = nullptr;
+    }
+
+
+    void RevEncoder::_encode(Retained<RevToSend> request, bool fleeceOK) {
+        _db->useReadOnly([&](C4Database *db) {
+            encodeRevision(db, request, fleeceOK);
+        });
+        _done = true;
+        _pusher->revEncoded();
+    }
+
+
+    // Reads the revision and creates its "rev" message. On failure just sets _error, leaving it
+    // to the Pusher to send a "norev". The document is released before returning, since `db`
+    // is only lent to us for the duration of the call.
+    void RevEncoder::encodeRevision(C4Database *db, RevToSend *request, bool fleeceOK) {
+        // Get the document & revision:
+        Dict root;
+        c4::ref<C4Document> doc = c4db_getDoc(db, request->docID, true, kDocGetAll, &_error);
+        if (doc) {
+            if (c4doc_selectRevision(doc, request->revID, true, &_error)) {
+                root = c4doc_getProperties(doc);
+                if (!root)
+                    _error = {LiteCoreDomain, kC4ErrorNotFound};
+            }
+            if (!root)
+                _revisionMissing = (_error.code == kC4ErrorNotFound
+                                    && _error.domain == LiteCoreDomain);
+        }
+        if (!root)
+            return;
+        _error = {};
+        _flags = doc->selectedRev.flags;
+
+        auto fullRevID = alloc_slice(_db->convertVersionToAbsolute(request->revID));
+
+        _message = make_unique<MessageBuilder>("rev"_sl);
+        MessageBuilder &msg = *_message;
+        msg.compressed = true;
+        msg["id"_sl] = request->docID;
+        msg["rev"_sl] = fullRevID;
+        msg["sequence"_sl] = request->sequence;
+        if (request->noConflicts)
+            msg["noconflicts"_sl] = true;
+        auto revisionFlags = doc->selectedRev.flags;
+        if (revisionFlags & kRevDeleted)
+            msg["deleted"_sl] = "1"_sl;
+
+        // Include the document history, but skip the current revision 'cause it's redundant
+        alloc_slice history = request->historyString(doc);
+        if (history.hasPrefix(fullRevID) && history.size > fullRevID.size)
+            msg["history"_sl] = history.from(fullRevID.size + 1);
+
+        bool sendLegacyAttachments = (request->legacyAttachments
+                                      && (revisionFlags & kRevHasAttachments)
+                                      && !_db->disableBlobSupport());
+
+        // Delta compression:
+        alloc_slice delta = createRevisionDelta(doc, request, root,
+                                                c4doc_getRevisionBody(doc).size,
+                                                sendLegacyAttachments);
+        if (delta) {
+            msg["deltaSrc"_sl] = _db->convertVersionToAbsolute(doc->selectedRev.revID);
+            msg.jsonBody().writeRaw(delta);
+        } else if (root.empty()) {
+            msg.write("{}"_sl);
+        } else if (fleeceOK && !sendLegacyAttachments) {
+            // The peer is LiteCore, so it can take the body as Fleece, saving both of us
+            // a JSON conversion. It's encoded without my SharedKeys, which the peer lacks.
+            msg["bodyEncoding"_sl] = "fleece"_sl;
+            Encoder enc;
+            enc.writeValue(root);
+            msg.write(enc.finish());
+        } else {
+            auto &bodyEncoder = msg.jsonBody();
+            if (sendLegacyAttachments)
+                _db->encodeRevWithLegacyAttachments(bodyEncoder, root,
+                                                   c4rev_getGeneration(request->revID));
+            else
+                bodyEncoder.writeValue(root);
+        }
+    }
+
+
+    // Attempt to delta-compress the revision; returns JSON delta or a null slice.
+    alloc_slice RevEncoder::createRevisionDelta(C4Document *doc, RevToSend *request,
+                                                Dict root, size_t revisionSize,
+                                                bool sendLegacyAttachments)
+    {
+        alloc_slice delta;
+        if (!request->deltaOK || revisionSize < tuning::kMinBodySizeForDelta
+                              || _options.disableDeltaSupport())
+            return delta;
+
+        // Find an ancestor revision known to the server:
+        C4RevisionFlags ancestorFlags = 0;
+        Dict ancestor;
+        if (request->remoteAncestorRevID)
+            ancestor = DBAccess::getDocRoot(doc, request->remoteAncestorRevID, &ancestorFlags);
+
+        if(ancestorFlags & kRevDeleted)
+            return delta;
+
+        if (!ancestor && request->ancestorRevIDs) {
+            for (auto revID : *request->ancestorRevIDs) {
+                ancestor = DBAccess::getDocRoot(doc, revID, &ancestorFlags);
+                if (ancestor)
+                    break;
+            }
+        }
+        if (ancestor.empty())
+            return delta;
+
+        Doc legacyOld, legacyNew;
+        if (sendLegacyAttachments) {
+            // If server needs legacy attachment layout, transform the bodies:
+            Encoder enc;
+            auto revPos = c4rev_getGeneration(request->revID);
+            _db->encodeRevWithLegacyAttachments(enc, root, revPos);
+            legacyNew = enc.finishDoc();
+            root = legacyNew.root().asDict();
+
+            if (ancestorFlags & kRevHasAttachments) {
+                enc.reset();
+                _db->encodeRevWithLegacyAttachments(enc, ancestor, revPos);
+                legacyOld = enc.finishDoc();
+                ancestor = legacyOld.root().asDict();
+            }
+        }
+
+        delta = FLCreateJSONDelta(ancestor, root);
+        if (!delta || delta.size > revisionSize * 1.2)
+            return {};          // Delta failed, or is (probably) bigger than body; don't use
+
+        if (willLog(LogLevel::Verbose)) {
+            alloc_slice old (ancestor.toJSON());
+            alloc_slice nuu (root.toJSON());
+            logVerbose("Encoded revision as delta, saving %zd bytes:\n\told = %.*s\n\tnew = %.*s\n\tDelta = %.*s",
+                       nuu.size - delta.size,
+                       SPLAT(old), SPLAT(nuu), SPLAT(delta));
+        }
+        return delta;
+    }
+
+} }
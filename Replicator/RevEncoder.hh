@@ -0,0 +1,60 @@
+//
+// RevEncoder.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "Worker.hh"
+#include "ReplicatorTypes.hh"
+#include "MessageBuilder.hh"
+#include <atomic>
+#include <memory>
+
+namespace litecore { namespace repl {
+    class Pusher;
+
+
+    /** Prepares the `rev` message for a revision being pushed: reads the document, creates a
+        delta or encodes the body. It runs on its own thread, using a read-only database
+        connection, so the Pusher can prepare several revisions in parallel. The Pusher sends
+        the finished messages in order. */
+    class RevEncoder : public Worker {
+    public:
+        RevEncoder(Pusher* NONNULL);
+
+        /** Starts preparing the message, asynchronously. Calls Pusher::revEncoded when done. */
+        void encode(RevToSend *rev NONNULL, bool fleeceOK);
+
+        // These may be called by the Pusher only after the encoding is done:
+        bool done() const                       {return _done;}
+        RevToSend* rev() const                  {return _rev;}
+        blip::MessageBuilder& message()         {return *_message;}
+        C4Error error() const                   {return _error;}
+        bool revisionMissing() const            {return _revisionMissing;}
+        C4RevisionFlags flags() const           {return _flags;}
+
+        /** Clears the state, so the RevEncoder can be reused. */
+        void reset();
+
+    protected:
+        // The Pusher keeps track of encodings, so it doesn't need status notifications:
+        ActivityLevel computeActivityLevel() const override     {return kC4Idle;}
+
+    private:
+        void _encode(Retained<RevToSend>, bool fleeceOK);
+        void encodeRevision(C4Database* NONNULL, RevToSend* NONNULL, bool fleeceOK);
+        alloc_slice createRevisionDelta(C4Document *doc NONNULL, RevToSend *request NONNULL,
+                                        fleece::Dict root, size_t revSize,
+                                        bool sendLegacyAttachments);
+
+        Pusher* const                           _pusher;
+        Retained<RevToSend>                     _rev;               // Revision being encoded
+        std::unique_ptr<blip::MessageBuilder>   _message;           // The 'rev' message
+        C4Error                                 _error {};          // Error reading revision
+        bool                                    _revisionMissing {false}; // Doc exists, rev doesn't
+        C4RevisionFlags                         _flags {0};         // Flags of revision
+        std::atomic<bool>                       _done {false};      // Has encoding finished?
+    };
+
+} }
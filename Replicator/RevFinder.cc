@@ -42,6 +42,7 @@ namespace litecore::repl {
     RevFinder::RevFinder(Replicator *replicator, Delegate *delegate)
     :Worker(replicator, "RevFinder")
     ,_delegate(delegate)
+    ,_flow(replicator->pullFlowController())
     {
         _passive = _options.pull <= kC4Passive;
         _mustBeProposed = _passive && _options.noIncomingConflicts()
@@ -72,6 +73,7 @@ namespace litecore::repl {
 
     void RevFinder::_revReceived() {
         decrement(_numRevsBeingRequested);
+        updateFlowControl();
 
         // Process waiting "changes" messages if not throttled:
         while (!_waitingChangesMessages.empty() && pullerHasCapacity()) {
@@ -82,6 +84,23 @@ namespace litecore::repl {
     }
 
 
+    // Called when a rev arrives. Revs are assumed to arrive in the order requested, which is
+    // close enough for measuring the round-trip time (till the first rev of a group arrives)
+    // and the throughput (when the whole group has arrived.)
+    void RevFinder::updateFlowControl() {
+        if (_requestedRevs.empty())
+            return;
+        auto &group = _requestedRevs.front();
+        auto now = FlowController::clock::now();
+        if (group.remaining == group.count)
+            group.firstRevLatency = now - group.requestTime;
+        if (--group.remaining == 0) {
+            _flow.completed(group.firstRevLatency, group.bytes, group.count, now);
+            _requestedRevs.pop_front();
+        }
+    }
+
+
     // Actually handle a "changes" (or "proposeChanges") message:
     void RevFinder::handleChangesNow(MessageIn *req) {
         slice reqType = req->property("Profile"_sl);
@@ -129,6 +148,10 @@ namespace litecore::repl {
                 response["deltas"_sl] = "true"_sl;
                 _announcedDeltaSupport = true;
             }
+            if ( !_announcedFleeceSupport && !_options.disableFleeceBodies()) {
+                response["fleece"_sl] = "true"_sl;
+                _announcedFleeceSupport = true;
+            }
 
             Stopwatch st;
 
@@ -153,6 +176,13 @@ namespace litecore::repl {
             // applies to local to local replication where things can come back over the wire
             // very quickly)
             _numRevsBeingRequested += requested;
+            if (requested > 0) {
+                uint64_t bytes = 0;
+                for (auto &seq : sequences)
+                    bytes += seq.bodySize;
+                _requestedRevs.push_back({FlowController::clock::now(), {}, bytes,
+                                          unsigned(requested), unsigned(requested)});
+            }
             _delegate->expectSequences(move(sequences));
             req->respond(response);
 
@@ -59,7 +59,7 @@ namespace litecore { namespace repl {
     private:
         static const size_t kMaxPossibleAncestors = 10;
 
-        bool pullerHasCapacity() const   {return _numRevsBeingRequested <= tuning::kMaxRevsBeingRequested;}
+        bool pullerHasCapacity() const   {return _numRevsBeingRequested <= _flow.maxInFlight();}
         void handleChanges(Retained<blip::MessageIn>);
         void handleMoreChanges();
         void handleChangesNow(blip::MessageIn *req);
@@ -70,13 +70,26 @@ namespace litecore { namespace repl {
         int findProposedChange(slice docID, slice revID, slice parentRevID,
                                alloc_slice &outCurrentRevID);
         void _revReceived();
+        void updateFlowControl();
         void _reRequestingRev();
         bool checkDocAndRevID(slice docID, slice revID, C4Error*);
 
+        // A group of revs requested by one response to a "changes" message:
+        struct RequestedRevs {
+            FlowController::clock::time_point requestTime;  // When response was sent
+            FlowController::duration firstRevLatency {};    // Time till first rev arrived
+            uint64_t bytes;                                 // Estimated total body size
+            unsigned count;                                 // Number of revs requested
+            unsigned remaining;                             // Number of revs not received yet
+        };
+
         Retained<Delegate> _delegate;
+        FlowController& _flow;                  // Adaptive limit on revs being requested
+        std::deque<RequestedRevs> _requestedRevs; // Revs requested, in order of request
         std::deque<Retained<blip::MessageIn>> _waitingChangesMessages; // Queued 'changes' messages
         unsigned _numRevsBeingRequested {0};    // # of 'rev' msgs requested but not yet received
         bool _announcedDeltaSupport {false};    // Did I send "deltas:true" yet?
+        bool _announcedFleeceSupport {false};   // Did I send "fleece:true" yet?
         bool _mustBeProposed {false};           // Do I handle only "proposedChanges"?
     };
 
@@ -246,7 +246,7 @@ namespace c4Internal {
 
         // Options to pass to the C4Socket
         alloc_slice socketOptions() const {
-            string protocolString = string(blip::Connection::kWSProtocolName) + kReplicatorProtocolName;
+            string protocolString = blip::Connection::webSocketProtocols(kReplicatorProtocolName);
             Replicator::Options opts(kC4Disabled, kC4Disabled, _options.properties);
             opts.setProperty(slice(kC4SocketOptionWSProtocols), protocolString.c_str());
             return opts.properties.data();
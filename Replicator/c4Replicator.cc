@@ -287,6 +287,16 @@ C4ReplicatorStatus c4repl_getStatus(C4Replicator *repl) C4API {
 }
 
 
+C4ReplicatorFlowControl c4repl_getFlowControl(C4Replicator *repl) C4API {
+    return repl->flowControl();
+}
+
+
+C4BlobTransferStats c4repl_getBlobStats(C4Replicator *repl) C4API {
+    return repl->blobStats();
+}
+
+
 C4Slice c4repl_getResponseHeaders(C4Replicator *repl) C4API {
     return repl->responseHeaders();
 }
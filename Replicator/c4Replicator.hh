@@ -161,6 +161,16 @@ struct C4Replicator : public RefCounted,
         }
     }
 
+    C4ReplicatorFlowControl flowControl() {
+        LOCK(_mutex);
+        return _replicator ? _replicator->flowControl() : _flowControl;
+    }
+
+    C4BlobTransferStats blobStats() {
+        LOCK(_mutex);
+        return _replicator ? _replicator->blobStats() : _blobStats;
+    }
+
     virtual void stop() {
         LOCK(_mutex);
         _cancelStop = false;
@@ -379,6 +389,8 @@ protected:
             if (_status.level > kC4Connecting && oldLevel <= kC4Connecting)
                 handleConnected();
             if (_status.level == kC4Stopped) {
+                _flowControl = _replicator->flowControl();
+                _blobStats = _replicator->blobStats();
                 _replicator->terminate();
                 _replicator = nullptr;
                 if (statusFlag(kC4Suspended)) {
@@ -553,6 +565,8 @@ protected:
 
 private:
     alloc_slice                 _responseHeaders;
+    C4ReplicatorFlowControl     _flowControl {};        // Final flow control of last Replicator
+    C4BlobTransferStats         _blobStats {};          // Final blob stats of last Replicator
     mutable alloc_slice         _peerTLSCertificateData;
     mutable c4::ref<C4Cert>     _peerTLSCertificate;
     Retained<C4Replicator>      _selfRetain;            // Keeps me from being deleted
@@ -0,0 +1,388 @@
+//
+// ReplicatorBenchmark.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#include "ReplicatorLoopbackTest.hh"
+#include "Stopwatch.hh"
+#include "StringUtil.hh"
+#include "SecureRandomize.hh"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#ifdef _MSC_VER
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+
+static unsigned envInt(const char *name, unsigned defaultValue) {
+    const char *value = getenv(name);
+    return value ? unsigned(strtoul(value, nullptr, 10)) : defaultValue;
+}
+
+static double envDouble(const char *name, double defaultValue) {
+    const char *value = getenv(name);
+    return value ? strtod(value, nullptr) : defaultValue;
+}
+
+
+/* Replication throughput benchmarks, run over a LoopbackProvider between two local databases.
+   They're tagged [.slow], so they only run when asked for, e.g. `CppTests "[Perf]"`.
+
+   The workload is configured by environment variables:
+       CBL_REPL_BENCH_DOCS          Number of documents per phase (default 10000)
+       CBL_REPL_BENCH_BODY_SIZE     Approximate size of each document body, in bytes (1000)
+       CBL_REPL_BENCH_BLOBS         Number of blobs in each document (0)
+       CBL_REPL_BENCH_BLOB_SIZE     Size of each blob, in bytes (10000)
+       CBL_REPL_BENCH_CONFLICTS     Fraction of docs changed on both sides in push-pull (0.1)
+       CBL_REPL_BENCH_LATENCY_MS    Simulated one-way network latency (1)
+       CBL_REPL_BENCH_OUTPUT        File to append results to, as one JSON object per line
+
+   Each phase reports docs/sec and MB/sec of document bodies plus blobs, the CPU time used by
+   the process (both replicators and the loopback "network"), and the process's peak RSS so far.
+   With blobs, it also reports their download rate, how many were downloaded at once, and the
+   most blob data held in memory before being written. MB are 2^20 bytes. */
+class ReplicatorBenchmark : public ReplicatorLoopbackTest {
+public:
+    struct Config {
+        unsigned docs       = envInt("CBL_REPL_BENCH_DOCS", 10000);
+        unsigned bodySize   = envInt("CBL_REPL_BENCH_BODY_SIZE", 1000);
+        unsigned blobs      = envInt("CBL_REPL_BENCH_BLOBS", 0);
+        unsigned blobSize   = envInt("CBL_REPL_BENCH_BLOB_SIZE", 10000);
+        double conflictRate = envDouble("CBL_REPL_BENCH_CONFLICTS", 0.1);
+        unsigned latencyMS  = envInt("CBL_REPL_BENCH_LATENCY_MS", 1);
+        const char *output  = getenv("CBL_REPL_BENCH_OUTPUT");
+    };
+
+    struct ResourceUsage {
+        double   cpuSeconds {0};        // User + system time of the process
+        uint64_t peakRSS {0};           // Peak resident set size of the process, in bytes
+    };
+
+    ReplicatorBenchmark() {
+        _latency = chrono::milliseconds(_config.latencyMS);
+    }
+
+
+    static ResourceUsage resourceUsage() {
+        ResourceUsage usage;
+#ifdef _MSC_VER
+        FILETIME created, exited, kernel, user;
+        if (GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+            auto ticks = [](FILETIME t) {
+                return (uint64_t(t.dwHighDateTime) << 32) | t.dwLowDateTime;
+            };
+            usage.cpuSeconds = (ticks(kernel) + ticks(user)) / 1.0e7;   // 100ns units
+        }
+        PROCESS_MEMORY_COUNTERS mem;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &mem, sizeof(mem)))
+            usage.peakRSS = mem.PeakWorkingSetSize;
+#else
+        struct rusage ru;
+        if (getrusage(RUSAGE_SELF, &ru) == 0) {
+            usage.cpuSeconds = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1.0e6
+                             + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1.0e6;
+#ifdef __APPLE__
+            usage.peakRSS = ru.ru_maxrss;                   // in bytes
+#else
+            usage.peakRSS = uint64_t(ru.ru_maxrss) * 1024;  // in KB
+#endif
+        }
+#endif
+        return usage;
+    }
+
+
+#pragma mark - WORKLOAD:
+
+
+    // Appends a random property value to a body being encoded.
+    static void writeRandomString(Encoder &enc) {
+        char str[33];
+        sprintf(str, "%08x%08x%08x%08x",
+                RandomNumber(), RandomNumber(), RandomNumber(), RandomNumber());
+        enc.writeString(str);
+    }
+
+    // Creates the blobs for a new doc and writes their metadata as the "blobs" property.
+    void writeBlobs(C4Database *inDB, Encoder &enc) {
+        C4BlobStore *store = c4db_getBlobStore(inDB, nullptr);
+        alloc_slice data(_config.blobSize);
+        enc.writeKey("blobs"_sl);
+        enc.beginArray();
+        for (unsigned b = 0; b < _config.blobs; ++b) {
+            SecureRandomize({(void*)data.buf, data.size});
+            C4BlobKey key;
+            C4Error error;
+            Assert(c4blob_create(store, data, nullptr, &key, &error));  // (may be on a bg thread)
+            alloc_slice keyStr = c4blob_keyToString(key);
+            enc.beginDict();
+            enc.writeKey(slice(kC4ObjectTypeProperty));
+            enc.writeString(kC4ObjectType_Blob);
+            enc.writeKey("digest"_sl);
+            enc.writeString(keyStr);
+            enc.writeKey("length"_sl);
+            enc.writeUInt(data.size);
+            enc.writeKey("content_type"_sl);
+            enc.writeString("application/octet-stream");
+            enc.endDict();
+            _payloadBytes += data.size;
+        }
+        enc.endArray();
+    }
+
+    // Creates `count` new docs, with IDs starting with `prefix`. Safe to call on a background
+    // thread, since it doesn't use Catch.
+    void createDocs(C4Database *inDB, const char *prefix, unsigned count) {
+        unsigned numFields = max(1u, _config.bodySize / 45);  // ~45 bytes per field as JSON
+        C4RevisionFlags flags = _config.blobs ? kRevHasAttachments : 0;
+        TransactionHelper t(inDB);
+        Encoder enc(c4db_createFleeceEncoder(inDB));
+        for (unsigned docNo = 0; docNo < count; ++docNo) {
+            string docID = format("%s-%07u", prefix, docNo);
+            enc.beginDict();
+            for (unsigned f = 0; f < numFields; ++f) {
+                enc.writeKey(format("field%03u", f));
+                writeRandomString(enc);
+            }
+            if (_config.blobs)
+                writeBlobs(inDB, enc);
+            enc.endDict();
+            alloc_slice body = enc.finish();
+            enc.reset();
+            _payloadBytes += body.size;
+            createNewRev(inDB, slice(docID), nullslice, body, flags);
+        }
+    }
+
+    // Updates a random tenth of the top-level string properties of each doc, leaving the rest
+    // of the body (and its blobs) alone, as a typical edit would.
+    void mutateDocs(C4Database *inDB, const char *prefix, unsigned count) {
+        TransactionHelper t(inDB);
+        Encoder enc(c4db_createFleeceEncoder(inDB));
+        for (unsigned docNo = 0; docNo < count; ++docNo) {
+            string docID = format("%s-%07u", prefix, docNo);
+            C4Error error;
+            c4::ref<C4Document> doc = c4doc_get(inDB, slice(docID), true, ERROR_INFO(error));
+            REQUIRE(doc);
+            enc.beginDict();
+            for (Dict::iterator i(c4doc_getProperties(doc)); i; ++i) {
+                enc.writeKey(i.key());
+                if (i.value().type() == kFLString && RandomNumber() % 10 == 0)
+                    writeRandomString(enc);
+                else
+                    enc.writeValue(i.value());
+            }
+            enc.endDict();
+            alloc_slice body = enc.finish();
+            enc.reset();
+            _payloadBytes += body.size;
+            createNewRev(inDB, slice(docID), doc->revID, body,
+                         doc->selectedRev.flags & kRevHasAttachments);
+        }
+    }
+
+
+#pragma mark - MEASUREMENT:
+
+
+    // Runs one phase of the benchmark and reports its results. Only `run` is timed; the bytes
+    // counted are the ones added to _payloadBytes since the last call to `resetPayload`.
+    void measure(const char *phase, uint64_t docs, function<void()> run) {
+        ResourceUsage before = resourceUsage();
+        Stopwatch st;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _stopwatch = &st;
+        }
+        run();
+        {
+            // (In the continuous phase, replicatorStatusChanged may have stopped it already.)
+            std::unique_lock<std::mutex> lock(_mutex);
+            _stopwatch = nullptr;
+            st.stop();
+        }
+        double elapsed = st.elapsed();
+        ResourceUsage after = resourceUsage();
+
+        double cpu = after.cpuSeconds - before.cpuSeconds;
+        double mb = _payloadBytes / (1024.0 * 1024.0);
+        const char *versioning = isRevTrees() ? "rev-trees" : "version-vectors";
+        char label[100];
+        sprintf(label, "Replication %s (%s)", phase, versioning);
+        st.printReport(label, unsigned(docs), "doc");
+        C4Log("%s: %.2f MB at %.2f MB/sec; %.3f CPU-sec; peak RSS %.1f MB",
+              label, mb, mb / elapsed, cpu, after.peakRSS / (1024.0 * 1024.0));
+
+        // Blob downloads, by whichever side pulled them:
+        const C4BlobTransferStats &blobStats = _clientBlobStats.blobsPulled ? _clientBlobStats
+                                                                            : _serverBlobStats;
+        if (_config.blobs) {
+            C4Log("%s: %u blobs pulled at %.2f MB/sec, up to %u at once; "
+                  "peak %.1f KB reserved",
+                  label, blobStats.blobsPulled, blobStats.pullBytesPerSec / (1024.0 * 1024.0),
+                  blobStats.maxBlobsPulling, blobStats.peakBytesReserved / 1024.0);
+        }
+
+        if (_config.output) {
+            JSONEncoder enc;
+            enc.beginDict();
+            enc.writeKey("benchmark"_sl);       enc.writeString("replication");
+            enc.writeKey("phase"_sl);           enc.writeString(phase);
+            enc.writeKey("versioning"_sl);      enc.writeString(versioning);
+            enc.writeKey("docs"_sl);            enc.writeUInt(docs);
+            enc.writeKey("bodySize"_sl);        enc.writeUInt(_config.bodySize);
+            enc.writeKey("blobs"_sl);           enc.writeUInt(_config.blobs);
+            enc.writeKey("blobSize"_sl);        enc.writeUInt(_config.blobSize);
+            enc.writeKey("conflictRate"_sl);    enc.writeDouble(_config.conflictRate);
+            enc.writeKey("latencyMS"_sl);       enc.writeUInt(_config.latencyMS);
+            enc.writeKey("bytes"_sl);           enc.writeUInt(_payloadBytes);
+            enc.writeKey("seconds"_sl);         enc.writeDouble(elapsed);
+            enc.writeKey("docsPerSec"_sl);      enc.writeDouble(docs / elapsed);
+            enc.writeKey("MBPerSec"_sl);        enc.writeDouble(mb / elapsed);
+            enc.writeKey("cpuSeconds"_sl);      enc.writeDouble(cpu);
+            enc.writeKey("peakRSS"_sl);         enc.writeUInt(after.peakRSS);
+            enc.writeKey("conflicts"_sl);       enc.writeUInt(_conflicts);
+            enc.writeKey("blobBytesPerSec"_sl); enc.writeUInt(blobStats.pullBytesPerSec);
+            enc.writeKey("maxBlobsPulling"_sl); enc.writeUInt(blobStats.maxBlobsPulling);
+            enc.writeKey("peakBlobBytesReserved"_sl); enc.writeUInt(blobStats.peakBytesReserved);
+            enc.endDict();
+            alloc_slice json = enc.finish();
+
+            FILE *out = fopen(_config.output, "a");
+            REQUIRE(out);
+            fprintf(out, "%.*s\n", SPLAT(json));
+            fclose(out);
+        }
+    }
+
+    void resetPayload()     {_payloadBytes = 0;}
+
+
+    // In the continuous phase, the clock stops when the expected number of docs has been
+    // replicated, not when the replicator eventually notices it's idle and stops.
+    virtual void replicatorStatusChanged(Replicator* repl,
+                                         const Replicator::Status &status) override
+    {
+        if (repl == _replClient && _continuousTarget > 0) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_stopwatch && !_stopOnIdle
+                    && status.progress.documentCount >= _continuousTarget) {
+                _stopwatch->stop();
+                _stopOnIdle = true;
+            }
+        }
+        ReplicatorLoopbackTest::replicatorStatusChanged(repl, status);
+    }
+
+    // Conflicts are an expected part of the push-pull workload, so they're counted instead of
+    // being reported as errors. Pulled ones are still resolved by the conflict handler.
+    virtual void replicatorDocumentsEnded(Replicator *repl,
+                                          const std::vector<Retained<ReplicatedRev>> &revs) override
+    {
+        std::vector<Retained<ReplicatedRev>> others;
+        for (auto &rev : revs) {
+            bool conflict = (rev->error.domain == LiteCoreDomain
+                                    && rev->error.code == kC4ErrorConflict)
+                         || (rev->error.domain == WebSocketDomain && rev->error.code == 409);
+            if (conflict && repl == _replClient) {
+                ++_conflicts;
+                if (rev->dir() == Dir::kPushing)
+                    continue;
+            }
+            others.push_back(rev);
+        }
+        ReplicatorLoopbackTest::replicatorDocumentsEnded(repl, others);
+    }
+
+
+    Config const                        _config;
+    uint64_t                            _payloadBytes {0};
+    std::atomic<unsigned>               _conflicts {0};
+    uint64_t                            _continuousTarget {0};
+    Stopwatch*                          _stopwatch {nullptr};   // Running in measure()
+};
+
+
+TEST_CASE_METHOD(ReplicatorBenchmark, "Replication Throughput Benchmark", "[Push][Pull][Perf][.slow]") {
+    const unsigned n = _config.docs;
+
+    SECTION("Push") {
+        createDocs(db, "doc", n);
+        _expectedDocumentCount = n;
+        measure("push", n, [&] {
+            runPushReplication();
+        });
+        compareDatabases();
+    }
+
+    SECTION("Pull") {
+        createDocs(db2, "doc", n);
+        _expectedDocumentCount = n;
+        measure("pull", n, [&] {
+            runPullReplication();
+        });
+        compareDatabases();
+    }
+
+    SECTION("Push-Pull") {
+        // Start with both sides in sync, then add new docs to each side and change some of the
+        // existing docs on both sides, creating conflicts:
+        createDocs(db, "doc", n);
+        _expectedDocumentCount = n;
+        runPushReplication();
+
+        resetPayload();
+        unsigned conflicted = unsigned(n * _config.conflictRate);
+        createDocs(db, "local", n / 2);
+        createDocs(db2, "remote", n / 2);
+        mutateDocs(db, "doc", conflicted);
+        mutateDocs(db2, "doc", conflicted);
+        installConflictHandler();
+        _clientProgressLevel = kC4ReplProgressPerDocument;
+        _checkDocsFinished = false;
+        _expectedDocumentCount = -1;
+        measure("push-pull", 2 * (n / 2) + 2 * conflicted, [&] {
+            runPushPullReplication();
+        });
+    }
+
+    SECTION("Continuous") {
+        // Docs are written in batches while a continuous push runs, the way an app would:
+        _continuousTarget = n;
+        _expectedDocumentCount = -1;
+        measure("continuous", n, [&] {
+            _parallelThread.reset(runInParallel([this, n]() {
+                static constexpr unsigned kBatchSize = 100;
+                for (unsigned i = 0; i < n; i += kBatchSize)
+                    createDocs(db, format("doc%07u", i).c_str(), min(kBatchSize, n - i));
+            }));
+            runPushReplication(kC4Continuous);
+            _parallelThread->join();
+        });
+        compareDatabases();
+    }
+
+    SECTION("Delta Push") {
+        createDocs(db, "doc", n);
+        _expectedDocumentCount = n;
+        runPushReplication();
+
+        resetPayload();
+        mutateDocs(db, "doc", n);
+        auto deltasBefore = DBAccess::gNumDeltasApplied.load();
+        measure("delta-push", n, [&] {
+            runPushReplication();
+        });
+        compareDatabases();
+        CHECK(DBAccess::gNumDeltasApplied - deltasBefore == n);
+    }
+}
@@ -7,12 +7,18 @@
 //
 
 #include "ReplicatorLoopbackTest.hh"
+#include "BLIPConnection.hh"
+#include "Codec.hh"
 #include "Worker.hh"
 #include "DBAccess.hh"
+#include "Puller.hh"
 #include "Timer.hh"
 #include "c4Database.hh"
 #include "PrebuiltCopier.hh"
 #include <chrono>
+#include <ctime>
+#include <map>
+#include <random>
 #include "betterassert.hh"
 #include "fleece/Mutable.hh"
 #include "PlatformCompat.hh"
@@ -44,6 +50,110 @@ TEST_CASE("Options password logging redaction") {
     CHECK(str.find(password) == string::npos);
 }
 
+TEST_CASE("Adaptive Flow Control", "[Push][Pull]") {
+    const FlowController::Config config = {{2, 10, 100}, {100'000, 500'000, 10'000'000}, {20, 50, 500},
+                                           0ms};
+    auto now = FlowController::clock::now();
+
+    SECTION("Request window") {
+        FlowController flow(config);
+        // Slow start: the window grows by one per completed request
+        for (int i = 0; i < 20; ++i)
+            flow.completed(100ms, 1000, 1, now += 5ms);
+        CHECK(flow.maxInFlight() == 30);
+        // A slow round trip means requests are queueing, so the window shrinks, but only
+        // once per round trip:
+        flow.completed(300ms, 1000, 1, now += 5ms);
+        CHECK(flow.maxInFlight() == 22);
+        flow.completed(300ms, 1000, 1, now += 5ms);
+        CHECK(flow.maxInFlight() == 22);
+        // After that it grows by about one per round trip:
+        for (int i = 0; i < 23; ++i)
+            flow.completed(100ms, 1000, 1, now += 5ms);
+        CHECK(flow.maxInFlight() == 23);
+        // Failures shrink it by half:
+        flow.failed(now += 1s);
+        CHECK(flow.maxInFlight() == 11);
+    }
+
+    SECTION("Reply delay") {
+        // A peer that holds replies for up to 20ms (like a LiteCore peer batching its inserts)
+        // shouldn't look like queueing on a LAN with a 1ms round trip:
+        auto delayedConfig = config;
+        delayedConfig.replyDelay = 20ms;
+        FlowController flow(delayedConfig);
+        for (int i = 0; i < 20; ++i)
+            flow.completed((i % 2) ? 1ms : 21ms, 1000, 1, now += 1ms);
+        CHECK(flow.maxInFlight() == 30);
+        // ...but a round trip beyond that still is:
+        flow.completed(30ms, 1000, 1, now += 1ms);
+        CHECK(flow.maxInFlight() == 22);
+    }
+
+    SECTION("Bytes and batch size") {
+        // 10KB revs completing every ms (10MB/sec) with a 100ms round trip:
+        FlowController flow(config);
+        for (int i = 0; i < 3000; ++i)
+            flow.completed(100ms, 10'000, 1, now += 1ms);
+        CHECK(flow.maxInFlight() == 100);
+        // Byte limit is twice the bandwidth-delay product:
+        CHECK(flow.maxBytesInFlight() == Approx(2'000'000).epsilon(0.01));
+        // Batch size is the number of requests completed in a round trip:
+        CHECK(flow.batchSize() == Approx(100).epsilon(0.01));
+        auto state = flow.state();
+        CHECK(state.roundTripMS == 100);
+        CHECK(state.minRoundTripMS == 100);
+        CHECK(state.bytesPerSec == Approx(10'000'000).epsilon(0.01));
+    }
+
+    SECTION("Fixed") {
+        FlowController flow(config, false);
+        for (int i = 0; i < 3000; ++i)
+            flow.completed(100ms, 10'000, 1, now += 1ms);
+        flow.failed(now);
+        CHECK(flow.maxInFlight() == 10);
+        CHECK(flow.maxBytesInFlight() == 500'000);
+        CHECK(flow.batchSize() == 50);
+        CHECK(flow.state().roundTripMS == 100);
+    }
+}
+
+
+TEST_CASE("Blob Transfer Budget", "[Pull][blob]") {
+    BlobTransferBudget budget(100'000);
+    int wakeups = 0;
+    auto wake = [&] {++wakeups;};
+
+    // Blobs are admitted until their total size exceeds the budget:
+    CHECK(budget.reserve(60'000, wake));
+    CHECK(budget.reserve(40'000, wake));
+    CHECK(!budget.reserve(10'000, wake));
+    budget.release(40'000);
+    CHECK(wakeups == 1);
+    CHECK(budget.reserve(10'000, wake));
+    budget.release(60'000);
+    budget.release(10'000);
+
+    // A blob bigger than the budget is admitted only by itself:
+    CHECK(budget.reserve(1'000'000, wake));
+    CHECK(!budget.reserve(1, wake));
+    budget.release(1'000'000);
+    CHECK(wakeups == 2);
+
+    budget.received(5000);
+    budget.received(3000);
+    budget.pulledBlob();
+    budget.pushed(1000, true);
+    auto stats = budget.stats();
+    CHECK(stats.bytesPulled == 8000);
+    CHECK(stats.blobsPulled == 1);
+    CHECK(stats.bytesPushed == 1000);
+    CHECK(stats.blobsPushed == 1);
+    CHECK(stats.maxBlobsPulling == 2);
+    CHECK(stats.peakBytesReserved == 100'000);   // 60'000 + 40'000; the 1MB blob reserves 100'000
+}
+
+
 TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push replication from prebuilt database", "[Push]") {
     // Push a doc:
     createRev("doc"_sl, kRevID, kEmptyFleeceBody);
@@ -118,6 +228,187 @@ TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push large docs", "[Push]") {
 }
 
 
+TEST_CASE("BLIP Snappy Codec") {
+    using namespace litecore::blip;
+    string input;
+    for (int i = 0; i < 5000; ++i)
+        input += "{\"n\":" + to_string(i) + ",\"name\":\"snappy\"},";
+
+    SnappyCompressor compressor;
+    slice in(input);
+    alloc_slice buf(2 * input.size() + 100);
+    slice out(buf);
+    while (in.size > 0) {
+        size_t before = in.size;
+        compressor.write(in, out);
+        REQUIRE(in.size < before);
+    }
+    slice compressed(buf.buf, (const char*)out.buf - (const char*)buf.buf);
+    CHECK(compressed.size < input.size() / 2);
+
+    // Decode through a small buffer, so the decoder has to hold back part of each block:
+    SnappyDecompressor decompressor;
+    string result;
+    char chunk[1000];
+    while (compressed.size > 0 || decompressor.unflushedBytes() > 0) {
+        slice dst(chunk, sizeof(chunk));
+        decompressor.write(compressed, dst);
+        result.append(chunk, (const char*)dst.buf - chunk);
+    }
+    CHECK(result == input);
+
+    // A copy reaching back before the start of the block is corrupt:
+    ExpectingExceptions x;
+    SnappyDecompressor bad;
+    slice badInput("\x06\x10\xFF\x01\x00\x00\x00"_sl);
+    char badOutput[100];
+    slice badDst(badOutput, sizeof(badOutput));
+    CHECK_THROWS(bad.write(badInput, badDst));
+}
+
+TEST_CASE("BLIP Compression Negotiation") {
+    using blip::Connection;
+    const string app = "+CBMobile_2";
+    string offered = Connection::webSocketProtocols(app);
+    CHECK(offered == "BLIP_3-snappy+CBMobile_2,BLIP_3+CBMobile_2");
+
+    // The server prefers Snappy, but accepts old clients:
+    CHECK(Connection::selectWebSocketProtocol(slice(offered), app) == "BLIP_3-snappy+CBMobile_2");
+    CHECK(Connection::selectWebSocketProtocol("BLIP_3+CBMobile_2"_sl, app) == "BLIP_3+CBMobile_2");
+    CHECK(Connection::selectWebSocketProtocol("BLIP_3-zstd+CBMobile_2, BLIP_3+CBMobile_2"_sl, app)
+            == "BLIP_3+CBMobile_2");
+    CHECK(Connection::selectWebSocketProtocol("BLIP_3+CBMobile_1"_sl, app) == "");
+
+    // The client gets the algorithm from the accepted protocol:
+    CHECK(string(Connection::compressionForWebSocketProtocol("BLIP_3+CBMobile_2"_sl)) == "deflate");
+    CHECK(string(Connection::compressionForWebSocketProtocol("BLIP_3-snappy+CBMobile_2"_sl)) == "snappy");
+    CHECK(string(Connection::compressionForWebSocketProtocol("BLIP_3-bogus+CBMobile_2"_sl)) == "deflate");
+}
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push large docs with Snappy", "[Push]") {
+    auto snappy = slice(blip::Connection::kCompressionAlgorithmOption);
+    importJSONLines(sFixturesDir + "wikipedia_100.json");
+    _expectedDocumentCount = 100;
+    runReplicators(Replicator::Options::pushing(kC4OneShot).setProperty(snappy, "snappy"),
+                   Replicator::Options::passive().setProperty(snappy, "snappy"));
+    compareDatabases();
+    validateCheckpoints(db, db2, "{\"local\":100}");
+}
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push Flow Control Benchmark", "[Push][Perf][.slow]") {
+    // Compares adaptive flow control with the fixed initial limits, on a simulated fast LAN and
+    // on a slow, high-latency cellular link.
+    const char *network = "LAN";
+    _latency = 1ms;
+    SECTION("LAN") { }
+    SECTION("Cellular") {
+        network = "cellular";
+        _latency = 150ms;
+        _bandwidth = 1024*1024;
+    }
+    bool fixed = GENERATE(false, true);
+    auto option = slice(kC4ReplicatorOptionFixedFlowControl);
+
+    importJSONLines(sFixturesDir + "iTunesMusicLibrary.json");
+    _expectedDocumentCount = 12189;
+    Stopwatch st;
+    runReplicators(Replicator::Options::pushing(kC4OneShot).setProperty(option, fixed),
+                   Replicator::Options::passive().setProperty(option, fixed));
+    st.stop();
+    char label[100];
+    sprintf(label, "Push over %s with %s flow control", network, (fixed ? "fixed" : "adaptive"));
+    st.printReport(label, _expectedDocumentCount, "doc");
+    auto &flow = _clientFlowControl.push;
+    C4Log("%s: RTT %ums (min %ums), %.0f KB/sec; limits: %u revs, %.0f KB, batches of %u",
+          label, flow.roundTripMS, flow.minRoundTripMS, flow.bytesPerSec / 1024.0,
+          flow.maxInFlight, flow.maxBytesInFlight / 1024.0, flow.batchSize);
+    compareDatabases();
+}
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push/Pull Fleece Or JSON Bodies", "[Push][Pull]") {
+    // Revs are sent as Fleece unless either side disables it, in which case they fall back to
+    // JSON (as with Sync Gateway.) Either way the result should be the same.
+    auto noFleece = slice(kC4ReplicatorOptionDisableFleeceBodies);
+    auto pushOpts = Replicator::Options::pushing(kC4OneShot);
+    auto pullOpts = Replicator::Options::pulling(kC4OneShot);
+    auto passiveOpts = Replicator::Options::passive();
+    SECTION("Fleece") { }
+    SECTION("Active peer wants JSON") {
+        pushOpts.setProperty(noFleece, true);
+        pullOpts.setProperty(noFleece, true);
+    }
+    SECTION("Passive peer wants JSON") {
+        passiveOpts.setProperty(noFleece, true);
+    }
+
+    importJSONLines(sFixturesDir + "wikipedia_100.json");
+    _expectedDocumentCount = 100;
+    runReplicators(pushOpts, passiveOpts);
+    compareDatabases();
+
+    // Now pull back a change made on the other side:
+    {
+        TransactionHelper t(db2);
+        createFleeceRev(db2, "fleecy"_sl, "1-cafebabe"_sl,
+                        "{\"name\":\"André\",\"n\":[1,2.5,true,null]}"_sl);
+    }
+    _expectedDocumentCount = 1;
+    runReplicators(pullOpts, passiveOpts);
+    compareDatabases();
+}
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push With Max RevEncoders", "[Push]") {
+    // Revs are encoded in parallel, but sent in order, however many encoders there are:
+    int64_t maxRevEncoders = GENERATE(1, 16);
+    auto option = slice(kC4ReplicatorOptionMaxRevEncoders);
+    importJSONLines(sFixturesDir + "wikipedia_100.json");
+    _expectedDocumentCount = 100;
+
+    // Record the sequence of each rev the passive side receives, by its BLIP message number,
+    // which is assigned in the order the pusher sends the messages:
+    mutex m;
+    map<blip::MessageNo, long> sequencesBySendOrder;
+    Puller::gRevReceived = [&](blip::MessageIn *msg) {
+        lock_guard<mutex> lock(m);
+        sequencesBySendOrder[msg->number()] = msg->intProperty("sequence"_sl);
+    };
+    runReplicators(Replicator::Options::pushing(kC4OneShot).setProperty(option, maxRevEncoders),
+                   Replicator::Options::passive());
+    Puller::gRevReceived = nullptr;
+    compareDatabases();
+
+    vector<long> sequences;
+    for (auto &entry : sequencesBySendOrder)
+        sequences.push_back(entry.second);
+    CHECK(sequences.size() == 100);
+    CHECK(is_sorted(sequences.begin(), sequences.end()));
+    CHECK(sequences.front() > 0);
+}
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push Compression Benchmark", "[Push][Perf][.slow]") {
+    // Measures throughput per CPU-second (of both peers) with each compression algorithm.
+    const char *algorithm = "deflate";
+    SECTION("Deflate") { }
+    SECTION("Snappy") {
+        algorithm = "snappy";
+    }
+    auto option = slice(blip::Connection::kCompressionAlgorithmOption);
+
+    importJSONLines(sFixturesDir + "iTunesMusicLibrary.json");
+    _expectedDocumentCount = 12189;
+    clock_t cpuStart = clock();
+    Stopwatch st;
+    runReplicators(Replicator::Options::pushing(kC4OneShot).setProperty(option, algorithm),
+                   Replicator::Options::passive().setProperty(option, algorithm));
+    st.stop();
+    double cpu = double(clock() - cpuStart) / CLOCKS_PER_SEC;
+    char label[100];
+    sprintf(label, "Push with %s", algorithm);
+    st.printReport(label, _expectedDocumentCount, "doc");
+    C4Log("%s used %.3f CPU-sec: %.0f docs/CPU-sec", label, cpu, _expectedDocumentCount / cpu);
+    compareDatabases();
+}
+
 TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push deletion", "[Push]") {
     createRev("dok"_sl, kRevID, kFleeceBody);
     _expectedDocumentCount = 1;
@@ -717,6 +1008,58 @@ TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull Large Attachments", "[Pull][blob]
     validateCheckpoints(db2, db, "{\"remote\":1}");
 
     checkAttachments(db2, blobKeys, attachments);
+
+    // The blobs are downloaded in parallel:
+    CHECK(_clientBlobStats.blobsPulled == 4);
+    CHECK(_clientBlobStats.bytesPulled == 293000);
+    CHECK(_clientBlobStats.maxBlobsPulling == 4);
+    CHECK(_clientBlobStats.pullBytesPerSec > 0);
+    CHECK(_serverBlobStats.blobsPushed == 4);
+    CHECK(_serverBlobStats.bytesPushed == 293000);
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull Edited Chunked Attachment", "[Pull][blob]") {
+    // Reopen both databases with chunked blob stores:
+    C4DatabaseConfig2 config = dbConfig();
+    config.flags |= kC4DB_ChunkedBlobs;
+    for (C4Database **pdb : {&db, &db2}) {
+        alloc_slice name(c4db_getName(*pdb));
+        REQUIRE(c4db_close(*pdb, WITH_ERROR()));
+        c4db_release(*pdb);
+        *pdb = c4db_openNamed(name, &config, ERROR_INFO());
+        REQUIRE(*pdb);
+    }
+
+    mt19937 rng(1);
+    string att(2000000, '\0');
+    for (auto &c : att)
+        c = char(rng());
+    vector<C4BlobKey> blobKeys;
+    {
+        TransactionHelper t(db);
+        blobKeys = addDocWithAttachments("att1"_sl, {att}, "application/octet-stream");
+        _expectedDocumentCount = 1;
+    }
+    runPullReplication();
+    checkAttachments(db2, blobKeys, {att});
+    CHECK(_clientBlobStats.blobsPulled == 1);
+    CHECK(_clientBlobStats.bytesPulled == att.size());
+
+    // Edit the attachment; only the chunks around the edit are pulled:
+    string edited = att;
+    edited.insert(att.size() / 2, "EDITED");
+    {
+        TransactionHelper t(db);
+        blobKeys = addDocWithAttachments("att2"_sl, {edited}, "application/octet-stream");
+        _expectedDocumentCount = 1;
+    }
+    runPullReplication();
+    checkAttachments(db2, blobKeys, {edited});
+    CHECK(_clientBlobStats.blobsPulled == 1);
+    CHECK(_clientBlobStats.bytesPulled > 0);
+    CHECK(_clientBlobStats.bytesPulled <= 2 * 256 * 1024);
+    CHECK(_serverBlobStats.bytesPushed == _clientBlobStats.bytesPulled);
 }
 
 
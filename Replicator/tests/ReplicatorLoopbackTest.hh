@@ -101,12 +101,14 @@ public:
 
         // Create client (active) and server (passive) replicators:
         _replClient = new Replicator(dbClient,
-                                     new LoopbackWebSocket(alloc_slice("ws://srv/"_sl), Role::Client, kLatency),
+                                     new LoopbackWebSocket(alloc_slice("ws://srv/"_sl), Role::Client,
+                                                           _latency, _bandwidth),
                                      *this, opts1);
 
         _replClient->setProgressNotificationLevel(_clientProgressLevel);
         _replServer = new Replicator(dbServer,
-                                     new LoopbackWebSocket(alloc_slice("ws://cli/"_sl), Role::Server, kLatency),
+                                     new LoopbackWebSocket(alloc_slice("ws://cli/"_sl), Role::Server,
+                                                           _latency, _bandwidth),
                                      *this, opts2);
 
         _replServer->setProgressNotificationLevel(_serverProgressLevel);
@@ -127,6 +129,10 @@ public:
 
         Log(">>> Replication complete (%.3f sec) <<<", st.elapsed());
         _checkpointID = _replClient->checkpointer().checkpointID();
+        _clientFlowControl = _replClient->flowControl();
+        _serverFlowControl = _replServer->flowControl();
+        _clientBlobStats = _replClient->blobStats();
+        _serverBlobStats = _replServer->blobStats();
         _replClient = _replServer = nullptr;
 
         CHECK(_gotResponse);
@@ -577,6 +583,10 @@ public:
     C4Database* db2 {nullptr};
     Retained<Replicator> _replClient, _replServer;
     alloc_slice _checkpointID;
+    duration _latency {kLatency};                   // Simulated one-way network latency
+    size_t _bandwidth {0};                          // Simulated network bytes/sec (0=unlimited)
+    C4ReplicatorFlowControl _clientFlowControl {}, _serverFlowControl {};
+    C4BlobTransferStats _clientBlobStats {}, _serverBlobStats {};
     std::unique_ptr<std::thread> _parallelThread;
     bool _stopOnIdle {0};
     std::mutex _mutex;
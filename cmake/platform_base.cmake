@@ -33,6 +33,7 @@ function(set_litecore_source_base)
         Crypto/SecureDigest.cc
         Crypto/SecureSymmetricCrypto.cc
         LiteCore/BlobStore/BlobStore.cc
+        LiteCore/BlobStore/ContentChunker.cc
         LiteCore/BlobStore/Stream.cc
         LiteCore/Database/BackgroundDB.cc
         LiteCore/Database/Database.cc
@@ -46,6 +47,7 @@ function(set_litecore_source_base)
         LiteCore/Database/TreeDocument.cc
         LiteCore/Database/Upgrader.cc
         LiteCore/Database/VectorDocument.cc
+        LiteCore/Query/CompiledQueryCache.cc
         LiteCore/Query/IndexSpec.cc
         LiteCore/Query/PredictiveModel.cc
         LiteCore/Query/Query.cc
@@ -73,6 +75,8 @@ function(set_litecore_source_base)
         LiteCore/RevTrees/VersionVector.cc
         LiteCore/Storage/DataFile.cc
         LiteCore/Storage/KeyStore.cc
+        LiteCore/Storage/PartitionedEnumerator.cc
+        LiteCore/Storage/ReadConnectionPool.cc
         LiteCore/Storage/Record.cc
         LiteCore/Storage/RecordEnumerator.cc
         LiteCore/Storage/SQLiteDataFile.cc
@@ -89,11 +93,13 @@ function(set_litecore_source_base)
         vendor/SQLiteCpp/src/Transaction.cpp
         Replicator/c4Replicator.cc
         Replicator/c4Socket.cc
+        Replicator/BlobTransferBudget.cc
         Replicator/ChangesFeed.cc
         Replicator/Checkpoint.cc
         Replicator/Checkpointer.cc
         Replicator/DatabaseCookies.cc
         Replicator/DBAccess.cc
+        Replicator/FlowController.cc
         Replicator/IncomingRev.cc
         Replicator/IncomingRev+Blobs.cc
         Replicator/Inserter.cc
@@ -103,6 +109,7 @@ function(set_litecore_source_base)
         Replicator/Pusher+Revs.cc
         Replicator/Replicator.cc
         Replicator/ReplicatorTypes.cc
+        Replicator/RevEncoder.cc
         Replicator/RevFinder.cc
         Replicator/URLTransformer.cc
         Replicator/Worker.cc